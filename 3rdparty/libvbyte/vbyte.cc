@@ -448,7 +448,7 @@ uncompress_sorted(const uint8_t *in, T *out, T previous, size_t length)
 
 template<typename T>
 static inline T
-select_sorted(const uint8_t *in, uint32_t previous, size_t index)
+select_sorted(const uint8_t *in, T previous, size_t index)
 {
   for (size_t i = 0; i <= index; i++) {
     T current;
@@ -140,11 +140,15 @@ extern "C" {
  *   2.1.5:  new freelist; version is 3
  *   2.1.9:  changes in btree node format; version is 4
  *   2.1.13: changes in btree node format; version is 5
+ *   2.2.2:  CRC32C page checksums, page compression and record compression
+ *           dictionaries; version is 6. Files of version 5 can still be
+ *           opened, and are upgraded to version 6 when a dictionary is
+ *           stored
  */
 #define UPS_VERSION_MAJ     2
 #define UPS_VERSION_MIN     2
 #define UPS_VERSION_REV     1
-#define UPS_FILE_VERSION    5
+#define UPS_FILE_VERSION    6
 
 /**
  * The upscaledb Database structure
@@ -537,6 +541,16 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  * upscaledb documentation for more details. This parameter is not
  * persisted.
  *
+ * Pages can be compressed transparently before they are written to disk
+ * by supplying the parameter @ref UPS_PARAM_PAGE_COMPRESSION. Values are
+ * one of @ref UPS_COMPRESSOR_ZLIB, @ref UPS_COMPRESSOR_SNAPPY,
+ * @ref UPS_COMPRESSOR_LZF, @ref UPS_COMPRESSOR_LZ4 or
+ * @ref UPS_COMPRESSOR_ZSTD. A compressed page keeps its position in the file;
+ * the unused space of its slot is released with fallocate(2) on file
+ * systems which support sparse files. Memory mapped I/O is disabled.
+ * Not allowed for In-Memory Environments or in combination with AES
+ * encryption. This parameter is persisted.
+ *
  * Upscaledb can transparently encrypt the generated file using
  * 128bit AES in CBC mode. The transactional journal is not encrypted.
  * Encryption can be enabled by specifying @ref UPS_PARAM_ENCRYPTION_KEY
@@ -545,6 +559,9 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  *
  * CRC32 checksums are stored when a page is flushed, and verified
  * when it is fetched from disk if the flag @ref UPS_ENABLE_CRC32 is set.
+ * New files use CRC32C, which is calculated with the crc32 instruction
+ * on CPUs with SSE4.2; files of older versions continue to use their
+ * original checksum algorithm.
  * API functions will return @ref UPS_INTEGRITY_VIOLATED in case of failed
  * verifications. Not allowed in In-Memory Environments. This flag is not
  * persisted.
@@ -580,6 +597,33 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  *      Environment.
  *     <li>@ref UPS_ENABLE_CRC32</li> Stores (and verifies) CRC32
  *      checksums. Not allowed in combination with @ref UPS_IN_MEMORY.
+ *     <li>@ref UPS_ENABLE_CONCURRENT_READS</li> Lookups, Cursor moves and
+ *      UQI queries of multiple threads are executed in parallel.
+ *      Write operations only lock their Database, but not the whole
+ *      Environment. Cursors must not be shared between threads. Has
+ *      no effect if Transactions are enabled.
+ *     <li>@ref UPS_ENABLE_IO_URING</li> Performs the file I/O with
+ *      io_uring (Linux only). The modified pages of an operation are
+ *      written with a single system call. Falls back to the regular
+ *      file I/O if io_uring is not available.
+ *     <li>@ref UPS_ENABLE_DIRECT_IO</li> Bypasses the page cache of the
+ *      operating system (O_DIRECT) for the database file and the journal
+ *      files. The page buffers are aligned, and the file is never mapped
+ *      (see @ref UPS_DISABLE_MMAP). Unaligned I/O is emulated with a
+ *      bounce buffer. Only supported on Linux; ignored if the file
+ *      system does not support direct I/O.
+ *     <li>@ref UPS_ENABLE_DELTA_JOURNAL</li> Pages which were already
+ *      written to the journal are logged as a list of modified byte ranges
+ *      instead of a full page image. Leaves which were only modified by
+ *      inserts and erases of keys are logged with the inserted and erased
+ *      keys and records, if the records are stored in the leaf. Reduces
+ *      the size of the journal for small modifications of large pages, at
+ *      the cost of an in-memory copy of recently logged pages.
+ *     <li>@ref UPS_ENABLE_BACKGROUND_MERGE</li> Committed Transactions
+ *      are merged into the Database by a background thread instead of
+ *      the committing thread. A commit only merges the Transactions itself
+ *      if more than @ref UPS_PARAM_MERGE_BACKLOG_LIMIT Transactions are
+ *      waiting.
  *    </ul>
  *
  * @param mode File access rights for the new file. This is the @a mode
@@ -607,8 +651,24 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  *      file. Ignored for remote Environments.
  *    <li>@ref UPS_PARAM_NETWORK_TIMEOUT_SEC</li> Timeout (in seconds) when
  *      waiting for data from a remote server. By default, no timeout is set.
+ *    <li>@ref UPS_PARAM_JOURNAL_SYNC_INTERVAL</li> The maximum delay
+ *      (in milliseconds) till a commit with @ref UPS_TXN_COMMIT_DEFERRED
+ *      is synced to disk. Default is 100.
+ *    <li>@ref UPS_PARAM_MERGE_BACKLOG_LIMIT</li> With
+ *      @ref UPS_ENABLE_BACKGROUND_MERGE: the number of committed
+ *      Transactions which can wait for the background thread before
+ *      a commit has to merge them itself. Default is 256.
+ *    <li>@ref UPS_PARAM_CHECKPOINT_INTERVAL</li> Writes a checkpoint
+ *      whenever the current journal file exceeds this size (in bytes).
+ *      Disabled by default.
+ *    <li>@ref UPS_PARAM_CHECKPOINT_INTERVAL_MS</li> Writes a checkpoint
+ *      whenever the current journal file is older than this interval (in
+ *      milliseconds). Disabled by default.
  *    <li>@ref UPS_PARAM_ENABLE_JOURNAL_COMPRESSION</li> Compresses
  *      the journal files to reduce I/O. See notes above.
+ *    <li>@ref UPS_PARAM_PAGE_COMPRESSION</li> Compresses the pages
+ *      of the Environment file to reduce I/O and disk space. See notes
+ *      above.
  *    <li>@ref UPS_PARAM_ENCRYPTION_KEY</li> The 16 byte long AES
  *      encryption key; enables AES encryption for the Environment file. Not
  *      allowed for In-Memory Environments. Ignored for remote Environments.
@@ -666,6 +726,9 @@ ups_env_create(ups_env_t **env, const char *filename,
  *
  * CRC32 checksums are stored when a page is flushed, and verified
  * when it is fetched from disk if the flag @ref UPS_ENABLE_CRC32 is set.
+ * New files use CRC32C, which is calculated with the crc32 instruction
+ * on CPUs with SSE4.2; files of older versions continue to use their
+ * original checksum algorithm.
  * API functions will return @ref UPS_INTEGRITY_VIOLATED in case of failed
  * verifications. This flag is not persisted.
  *
@@ -699,6 +762,18 @@ ups_env_create(ups_env_t **env, const char *filename,
  *      if necessary.
  *     <li>@ref UPS_ENABLE_CRC32</li> Stores (and verifies) CRC32
  *      checksums.
+ *     <li>@ref UPS_ENABLE_CONCURRENT_READS</li> Lookups, Cursor moves and
+ *      UQI queries of multiple threads are executed in parallel.
+ *      See @ref ups_env_create for details.
+ *     <li>@ref UPS_ENABLE_IO_URING</li> Performs the file I/O with
+ *      io_uring. See @ref ups_env_create for details.
+ *     <li>@ref UPS_ENABLE_DIRECT_IO</li> Bypasses the page cache of the
+ *      operating system. See @ref ups_env_create for details.
+ *     <li>@ref UPS_ENABLE_DELTA_JOURNAL</li> Logs modified byte ranges
+ *      instead of full pages. See @ref ups_env_create for details.
+ *     <li>@ref UPS_ENABLE_BACKGROUND_MERGE</li> Merges committed
+ *      Transactions in a background thread. See @ref ups_env_create for
+ *      details.
  *    </ul>
  * @param param An array of ups_parameter_t structures. The following
  *      parameters are available:
@@ -718,6 +793,19 @@ ups_env_create(ups_env_t **env, const char *filename,
  *      file. Ignored for remote Environments.
  *    <li>@ref UPS_PARAM_NETWORK_TIMEOUT_SEC</li> Timeout (in seconds) when
  *      waiting for data from a remote server. By default, no timeout is set.
+ *    <li>@ref UPS_PARAM_JOURNAL_SYNC_INTERVAL</li> The maximum delay
+ *      (in milliseconds) till a commit with @ref UPS_TXN_COMMIT_DEFERRED
+ *      is synced to disk. Default is 100.
+ *    <li>@ref UPS_PARAM_MERGE_BACKLOG_LIMIT</li> With
+ *      @ref UPS_ENABLE_BACKGROUND_MERGE: the number of committed
+ *      Transactions which can wait for the background thread before
+ *      a commit has to merge them itself. Default is 256.
+ *    <li>@ref UPS_PARAM_CHECKPOINT_INTERVAL</li> Writes a checkpoint
+ *      whenever the current journal file exceeds this size (in bytes).
+ *      Disabled by default.
+ *    <li>@ref UPS_PARAM_CHECKPOINT_INTERVAL_MS</li> Writes a checkpoint
+ *      whenever the current journal file is older than this interval (in
+ *      milliseconds). Disabled by default.
  *    <li>@ref UPS_PARAM_JOURNAL_COMPRESSION</li> Compresses
  *      the journal files to reduce I/O. See notes above.
  *    <li>@ref UPS_PARAM_ENCRYPTION_KEY</li> The 16 byte long AES
@@ -766,6 +854,17 @@ ups_env_open(ups_env_t **env, const char *filename,
  *    <li>@ref UPS_PARAM_JOURNAL_COMPRESSION</li> Returns the
  *        selected algorithm for journal compression, or 0 if compression
  *        is disabled
+ *    <li>@ref UPS_PARAM_PAGE_COMPRESSION</li> Returns the
+ *        selected algorithm for page compression, or 0 if compression
+ *        is disabled
+ *    <li>@ref UPS_PARAM_JOURNAL_SYNC_INTERVAL</li> Returns the maximum
+ *        delay of commits with @ref UPS_TXN_COMMIT_DEFERRED
+ *    <li>@ref UPS_PARAM_MERGE_BACKLOG_LIMIT</li> Returns the maximum
+ *        number of committed Transactions waiting for the background merge
+ *    <li>@ref UPS_PARAM_CHECKPOINT_INTERVAL</li> Returns the checkpoint
+ *        interval (in bytes), or 0
+ *    <li>@ref UPS_PARAM_CHECKPOINT_INTERVAL_MS</li> Returns the checkpoint
+ *        interval (in milliseconds), or 0
  *    </ul>
  *
  * @param env A valid Environment handle
@@ -868,6 +967,12 @@ ups_env_get_parameters(ups_env_t *env, ups_parameter_t *param);
  * @ref UPS_COMPRESSOR_ZLIB, @ref UPS_COMPRESSOR_SNAPPY etc. See the
  * upscaledb documentation for more details.
  *
+ * Small records with a similar structure (i.e. JSON documents) do not
+ * compress well on their own. Databases with @ref UPS_COMPRESSOR_ZSTD can
+ * train a dictionary from their existing records with
+ * @ref ups_db_train_dictionary; all records which are written afterwards
+ * are compressed with this dictionary.
+ *
  * Keys can also be compressed by setting the parameter
  * @ref UPS_PARAM_KEY_COMPRESSION. See the upscaledb documentation
  * for more details.
@@ -892,6 +997,18 @@ ups_env_get_parameters(ups_env_t *env, ups_parameter_t *param);
  *      a plain C implementation.</li>
  * </ul>
  *
+ * Databases created with the type @ref UPS_TYPE_UINT64 can use
+ * @ref UPS_COMPRESSOR_UINT64_VARBYTE (delta encoding, good for sparse
+ * keys like timestamps) or @ref UPS_COMPRESSOR_UINT64_FOR (Frame Of
+ * Reference, fast random access for dense keys). Both also require the
+ * default page size of 16kb.
+ *
+ * Variable length binary keys with long common prefixes (i.e. URLs or
+ * file paths) can use @ref UPS_COMPRESSOR_PREFIX. Each key only stores
+ * the bytes which it does not share with its predecessor (or with a
+ * prefix common to all keys of the node), and the separator keys of the
+ * internal nodes are truncated to the shortest distinguishing prefix.
+ *
  * @param env A valid Environment handle.
  * @param db A valid Database handle, which will point to the created
  *      Database. To close the handle, use @ref ups_db_close.
@@ -1188,7 +1305,13 @@ typedef struct ups_txn_t ups_txn_t;
  *    bitwise OR. Possible flags are:
  *    <ul>
  *     <li>@ref UPS_TXN_READ_ONLY </li> This Txn is read-only and
- *      will not modify the Database.
+ *      will not modify the Database. It reads a snapshot of the data
+ *      which was committed when the Txn began; modifications of
+ *      Transactions which were active at that time, or which commit
+ *      later, are invisible and never cause a conflict. Inserting or
+ *      erasing keys fails with @ref UPS_WRITE_PROTECTED. Note that
+ *      Transactions which commit while a read-only Txn is active are
+ *      only flushed to the Btree after the read-only Txn ended.
  *    </ul>
  *
  * @return @ref UPS_SUCCESS upon success
@@ -1221,18 +1344,47 @@ ups_txn_get_name(ups_txn_t *txn);
  * a Cursor was attached to this Txn (with @ref ups_cursor_create
  * or @ref ups_cursor_clone), and the Cursor was not closed.
  *
+ * The flags select how durable the commit is when the function returns.
+ * Without flags, the journal is synced to disk if the Environment was
+ * created or opened with @ref UPS_ENABLE_FSYNC; otherwise the commit is
+ * only written to the buffers of the operating system.
+ *
  * @param txn Pointer to a Txn structure
- * @param flags Optional flags for committing the Txn, combined with
- *    bitwise OR. Unused, set to 0.
+ * @param flags Optional flags for committing the Txn; at most one of:
+ *   <ul>
+ *    <li>@ref UPS_TXN_COMMIT_SYNC </li> The commit is durable when the
+ *      function returns; the journal is synced even if
+ *      @ref UPS_ENABLE_FSYNC was not specified.
+ *    <li>@ref UPS_TXN_COMMIT_DEFERRED </li> The function returns as soon
+ *      as the commit was written to the operating system. A background
+ *      thread syncs the journal within @ref UPS_PARAM_JOURNAL_SYNC_INTERVAL
+ *      milliseconds. If the background thread fails to sync the journal
+ *      then its error is returned by the next deferred commit.
+ *    <li>@ref UPS_TXN_COMMIT_NOSYNC </li> The commit is only written to
+ *      the buffers of the operating system, even if @ref UPS_ENABLE_FSYNC
+ *      was specified.
+ *   </ul>
  *
  * @return @ref UPS_SUCCESS upon success
  * @return @ref UPS_IO_ERROR if writing to the file failed
  * @return @ref UPS_CURSOR_STILL_OPEN if there are Cursors attached to this
  *      Txn
+ * @return @ref UPS_INV_PARAMETER if more than one durability flag was
+ *      specified
  */
 UPS_EXPORT ups_status_t
 ups_txn_commit(ups_txn_t *txn, uint32_t flags);
 
+/** Flag for @ref ups_txn_commit; the commit is durable on return */
+#define UPS_TXN_COMMIT_SYNC                   0x00000100
+
+/** Flag for @ref ups_txn_commit; the commit is durable within
+ * @ref UPS_PARAM_JOURNAL_SYNC_INTERVAL milliseconds */
+#define UPS_TXN_COMMIT_DEFERRED               0x00000200
+
+/** Flag for @ref ups_txn_commit; the commit is not synced to disk */
+#define UPS_TXN_COMMIT_NOSYNC                 0x00000400
+
 /**
  * Aborts a Txn
  *
@@ -1338,6 +1490,10 @@ ups_txn_abort(ups_txn_t *txn, uint32_t flags);
 /* internal use only! (persistent) */
 #define UPS_FORCE_RECORDS_INLINE                    0x00800000
 
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_ENABLE_CONCURRENT_READS                 0x01000000
+
 /** Flag for @ref ups_env_open, @ref ups_env_create.
  * This flag is non persistent. */
 #define UPS_ENABLE_CRC32                            0x02000000
@@ -1349,6 +1505,22 @@ ups_txn_abort(ups_txn_t *txn, uint32_t flags);
  * This flag is non persistent. */
 #define UPS_FLUSH_TRANSACTIONS_IMMEDIATELY          0x08000000
 
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_ENABLE_IO_URING                         0x10000000
+
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_ENABLE_DIRECT_IO                        0x20000000
+
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_ENABLE_DELTA_JOURNAL                    0x40000000
+
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_ENABLE_BACKGROUND_MERGE                 0x80000000
+
 /**
  * Typedef for a key comparison function
  *
@@ -1681,11 +1853,120 @@ ups_db_count(ups_db_t *db, ups_txn_t *txn, uint32_t flags, uint64_t *count);
 UPS_EXPORT ups_status_t UPS_CALLCONV
 ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
 
+/**
+ * Trains a compression dictionary for the records of a Database
+ *
+ * Samples the existing records of the Database and trains a zstd
+ * dictionary of up to @a dictionary_size bytes. The dictionary is
+ * stored in the Environment file and used for all records which are
+ * inserted or overwritten afterwards; existing records remain readable.
+ * A Database can only train a single dictionary. The dictionary is removed
+ * when the Database is erased.
+ *
+ * The Database must have been created with
+ * @ref UPS_PARAM_RECORD_COMPRESSION set to @ref UPS_COMPRESSOR_ZSTD.
+ * Not available for remote Databases.
+ *
+ * @param db A valid Database handle
+ * @param dictionary_size The maximum size of the dictionary, in bytes;
+ *        if 0 then a default of 16kb is used
+ * @param flags Optional flags; unused, set to 0
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_INV_PARAMETER if the @a db pointer is NULL, if the
+ *        records are not compressed with @ref UPS_COMPRESSOR_ZSTD or if
+ *        the Database does not have enough records for training
+ * @return @ref UPS_ALREADY_INITIALIZED if the Database already has a
+ *        dictionary
+ * @return @ref UPS_NOT_IMPLEMENTED if upscaledb was built without zstd,
+ *        or for remote Databases
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_db_train_dictionary(ups_db_t *db, uint32_t dictionary_size,
+            uint32_t flags);
+
+/**
+ * Typedef for the input function of @ref ups_db_bulk_load
+ *
+ * @remark This function stores the next key/record pair of the sorted
+ * input in @a key and @a record and returns 0. The data of both has to
+ * remain valid till the function is called again. After the last pair it
+ * returns @ref UPS_KEY_NOT_FOUND; every other value aborts the load
+ * and is returned by @ref ups_db_bulk_load.
+ */
+typedef ups_status_t UPS_CALLCONV (*ups_bulk_load_func_t)(void *context,
+                  ups_key_t *key, ups_record_t *record);
+
+/**
+ * Loads sorted keys and records into an empty Database
+ *
+ * Instead of inserting the keys one by one, the Btree is built bottom-up:
+ * the leaf pages are filled up to @a fill_factor percent, the internal
+ * pages are created on the fly and all finished pages are written
+ * sequentially. The keys are fetched from @a func till it returns
+ * @ref UPS_KEY_NOT_FOUND; they have to be unique and sorted in ascending
+ * order.
+ *
+ * The load bypasses the journal. Once the last key was loaded, all pages
+ * are written and synced to disk, and the journal is cleared. If the
+ * load fails then the Database is empty; after a crash during the load,
+ * the Database is also empty, but the pages which were already written
+ * are not reclaimed.
+ *
+ * A fill factor below 100 leaves room in each page for keys which are
+ * inserted later. Not available for remote Databases or for
+ * Databases with @ref UPS_RECORD_NUMBER32 or @ref UPS_RECORD_NUMBER64.
+ *
+ * @param db A valid Database handle
+ * @param func The function which returns the keys and records
+ * @param context A user-defined pointer which is passed to @a func
+ * @param fill_factor The fill factor of the pages in percent (10 to 100);
+ *        if 0 then the pages are filled completely
+ * @param flags Optional flags; unused, set to 0
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_INV_PARAMETER if the @a db pointer or @a func is NULL,
+ *        if the fill factor is invalid, if the Database is not empty
+ *        or if the keys are not unique and sorted
+ * @return @ref UPS_INV_KEY_SIZE or @ref UPS_INV_RECORD_SIZE if a key
+ *        or record does not match the configured size
+ * @return @ref UPS_TXN_STILL_OPEN if a Transaction is active
+ * @return @ref UPS_WRITE_PROTECTED if the Database was opened read-only
+ * @return @ref UPS_NOT_IMPLEMENTED for remote Databases
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_db_bulk_load(ups_db_t *db, ups_bulk_load_func_t func, void *context,
+            uint32_t fill_factor, uint32_t flags);
+
 /** Parameter name for @ref ups_env_open, @ref ups_env_create;
  * Journal files are switched whenever the number of new Transactions exceeds
  * this threshold. */
 #define UPS_PARAM_JOURNAL_SWITCH_THRESHOLD 0x00001
 
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * the maximum delay (in milliseconds) till a commit with
+ * @ref UPS_TXN_COMMIT_DEFERRED is synced to disk. Default is 100. */
+#define UPS_PARAM_JOURNAL_SYNC_INTERVAL    0x00002
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * the maximum number of committed Transactions waiting for the background
+ * merge (@ref UPS_ENABLE_BACKGROUND_MERGE). Default is 256. */
+#define UPS_PARAM_MERGE_BACKLOG_LIMIT      0x00003
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * writes a checkpoint whenever the current journal file exceeds this size
+ * (in bytes). Afterwards the older journal file is cleared, therefore the
+ * journal (and the time required for recovery) is bounded. Committed
+ * Transactions which are still in the older file are merged first, even with
+ * @ref UPS_DONT_FLUSH_TRANSACTIONS. Default is 0 (disabled). */
+#define UPS_PARAM_CHECKPOINT_INTERVAL      0x00004
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * same as @ref UPS_PARAM_CHECKPOINT_INTERVAL, but writes a checkpoint
+ * whenever the current journal file is older than this interval (in
+ * milliseconds). Default is 0 (disabled). */
+#define UPS_PARAM_CHECKPOINT_INTERVAL_MS   0x00005
+
 /** Parameter name for @ref ups_env_open, @ref ups_env_create;
  * sets the cache size */
 #define UPS_PARAM_CACHE_SIZE            0x00000100
@@ -1800,6 +2081,12 @@ ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
  */
 #define UPS_PARAM_KEY_COMPRESSION       0x00001002
 
+/**
+ * Parameter name for @ref ups_env_create; enables transparent compression
+ * of the pages in the Environment file.
+ */
+#define UPS_PARAM_PAGE_COMPRESSION      0x00001003
+
 /** helper macro for disabling compression */
 #define UPS_COMPRESSOR_NONE         0
 
@@ -1821,6 +2108,12 @@ ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
  */
 #define UPS_COMPRESSOR_LZF          3
 
+/**
+ * selects lz4 compression
+ * http://lz4.github.io/lz4
+ */
+#define UPS_COMPRESSOR_LZ4          4
+
 /** uint32 key compression (varbyte) */
 #define UPS_COMPRESSOR_UINT32_VARBYTE       5
 #define UPS_COMPRESSOR_UINT32_MASKEDVBYTE   UPS_COMPRESSOR_UINT32_VARBYTE
@@ -1840,6 +2133,22 @@ ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
 /** uint32 key compression (SIMDFOR - Frame Of Reference w/ SIMD) */
 #define UPS_COMPRESSOR_UINT32_SIMDFOR      11
 
+/** uint64 key compression (delta encoding + varbyte) */
+#define UPS_COMPRESSOR_UINT64_VARBYTE      12
+
+/** uint64 key compression (Frame Of Reference) */
+#define UPS_COMPRESSOR_UINT64_FOR          13
+
+/** prefix compression for variable length binary keys */
+#define UPS_COMPRESSOR_PREFIX              14
+
+/**
+ * selects zstd compression; records can additionally use a trained
+ * dictionary (see @ref ups_db_train_dictionary)
+ * http://facebook.github.io/zstd
+ */
+#define UPS_COMPRESSOR_ZSTD                15
+
 /**
  * Retrieves the Environment handle of a Database
  *
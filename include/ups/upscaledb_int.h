@@ -209,7 +209,10 @@ typedef struct btree_metrics_t {
  * Metrics marked "global" are stored globally and shared between multiple
  * Environments.
  */
-#define UPS_METRICS_VERSION         9
+#define UPS_METRICS_VERSION         10
+
+/** The maximum number of shards of the page cache */
+#define UPS_MAX_CACHE_SHARDS        16
 
 typedef struct ups_env_metrics_t {
   /* the version indicator - must be UPS_METRICS_VERSION */
@@ -238,6 +241,14 @@ typedef struct ups_env_metrics_t {
   /* amount of pages written to disk */
   uint64_t page_count_flushed;
 
+  /* bytes of the pages which were compressed before they were written to
+   * disk (@ref UPS_PARAM_PAGE_COMPRESSION) */
+  uint64_t page_bytes_before_compression;
+
+  /* bytes of these pages after compression; pages which do not compress
+   * well are written uncompressed */
+  uint64_t page_bytes_after_compression;
+
   /* number of index pages in this Environment */
   uint64_t page_count_type_index;
 
@@ -259,6 +270,15 @@ typedef struct ups_env_metrics_t {
   /* number of cache misses */
   uint64_t cache_misses;
 
+  /* number of shards of the page cache */
+  uint32_t cache_shards;
+
+  /* number of cache hits per shard */
+  uint64_t cache_shard_hits[UPS_MAX_CACHE_SHARDS];
+
+  /* number of cache misses per shard */
+  uint64_t cache_shard_misses[UPS_MAX_CACHE_SHARDS];
+
   /* number of blobs allocated */
   uint64_t blob_total_allocated;
 
@@ -286,12 +306,56 @@ typedef struct ups_env_metrics_t {
   /* log/journal bytes after compression */
   uint64_t journal_bytes_after_compression;
 
+  /* number of journal syncs of committed Transactions (UPS_ENABLE_FSYNC);
+   * concurrent commits share a single sync */
+  uint64_t journal_commit_syncs;
+
+  /* journal bytes which were saved by logging page deltas instead of full
+   * pages (@ref UPS_ENABLE_DELTA_JOURNAL) */
+  uint64_t journal_delta_bytes_saved;
+
+  /* duration of the recovery (@ref UPS_AUTO_RECOVERY), in microseconds */
+  uint64_t journal_recovery_usec;
+
+  /* number of journal bytes which were read during recovery */
+  uint64_t journal_recovered_bytes;
+
+  /* number of pages which were restored from the changesets during recovery;
+   * each page is written once, even if it is logged in several changesets */
+  uint64_t journal_recovered_pages;
+
+  /* number of journal entries which were re-applied during recovery */
+  uint64_t journal_recovered_operations;
+
+  /* number of checkpoints (@ref UPS_PARAM_CHECKPOINT_INTERVAL); the journal
+   * files are switched at each checkpoint */
+  uint64_t journal_checkpoints;
+
+  /* number of committed Transactions which were merged into the Database
+   * by the background thread (@ref UPS_ENABLE_BACKGROUND_MERGE) */
+  uint64_t txn_background_merges;
+
+  /* number of commits which merged the committed Transactions themselves,
+   * because more than @ref UPS_PARAM_MERGE_BACKLOG_LIMIT were waiting */
+  uint64_t txn_backpressure_merges;
+
   /* record bytes before compression */
   uint64_t record_bytes_before_compression;
 
   /* record bytes after compression */
   uint64_t record_bytes_after_compression;
 
+  /* time spent compressing records, in microseconds; estimated from
+   * a sample of the calls */
+  uint64_t record_compression_usec;
+
+  /* record bytes after decompression */
+  uint64_t record_bytes_decompressed;
+
+  /* time spent decompressing records, in microseconds; estimated from
+   * a sample of the calls */
+  uint64_t record_decompression_usec;
+
   /* key bytes before compression */
   uint64_t key_bytes_before_compression;
 
@@ -354,6 +418,8 @@ ups_env_get_open_database(ups_env_t *env, uint16_t name);
 
 /**
  * Sets the threshold for flushing batched (committed) Transactions to disk.
+ * With @ref UPS_ENABLE_BACKGROUND_MERGE, this is also the number of
+ * Transactions which the background thread merges while holding the lock.
  */
 UPS_EXPORT void UPS_CALLCONV
 ups_set_committed_flush_threshold(int threshold);
@@ -29,6 +29,8 @@
 #include <boost/version.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/tss.hpp>
 #include <boost/thread/condition.hpp>
@@ -46,6 +48,12 @@ typedef boost::thread Thread;
 typedef boost::condition Condition;
 typedef boost::recursive_mutex RecursiveMutex;
 
+// A reader/writer lock; readers use a ScopedReadLock, writers use a
+// ScopedWriteLock
+typedef boost::shared_mutex ReadWriteMutex;
+typedef boost::shared_lock<ReadWriteMutex> ScopedReadLock;
+typedef boost::unique_lock<ReadWriteMutex> ScopedWriteLock;
+
 struct Mutex : public boost::mutex 
 {
   void acquire_ownership() {
@@ -55,6 +63,11 @@ struct Mutex : public boost::mutex
     try_lock();
     unlock();
   }
+
+  // Same interface as Spinlock::spin()
+  static void spin(int) {
+    boost::this_thread::yield();
+  }
 };
 
 template<typename T>
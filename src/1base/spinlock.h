@@ -45,6 +45,26 @@ namespace upscaledb {
 
 #ifdef UPS_ENABLE_HELGRIND
 typedef Mutex Spinlock;
+
+struct ReadWriteSpinlock : public boost::shared_mutex
+{
+  void acquire_ownership() {
+  }
+
+  void safe_unlock() {
+    try_lock();
+    unlock();
+  }
+
+  // optimistic reads are not supported; the readers always lock
+  bool try_lock_optimistic(uint32_t *version) {
+    return false;
+  }
+
+  bool validate_optimistic(uint32_t version) {
+    return false;
+  }
+};
 #else
 
 class Spinlock {
@@ -137,6 +157,129 @@ class Spinlock {
     boost::thread::id m_owner;
 #endif
 };
+
+// A spinlock which can be locked exclusively (by a single writer) or in
+// shared mode (by multiple readers). The exclusive interface is identical
+// to the one of the Spinlock.
+//
+// The lock also maintains a version counter which is incremented whenever
+// an exclusive lock is released. This allows optimistic reads which do not
+// modify the lock at all: the reader fetches the version, reads the
+// protected data and then validates that the version did not change (and
+// that the lock is not held by a writer). If validation fails then the
+// data may be inconsistent, and the reader has to start over.
+class ReadWriteSpinlock {
+    enum {
+      // the state if the lock is held exclusively; otherwise the state
+      // is the number of readers
+      kExclusive = -1
+    };
+
+  public:
+    ReadWriteSpinlock()
+      : m_state(0), m_version(0) {
+    }
+
+    // Initializes an *unlocked* lock; see Spinlock
+    ReadWriteSpinlock(const ReadWriteSpinlock &other)
+      : m_state(0), m_version(0) {
+    }
+
+    ~ReadWriteSpinlock() {
+      assert(m_state == 0);
+    }
+
+    // Only for test verification: lets the current thread acquire ownership
+    // of a locked mutex
+    void acquire_ownership() {
+#ifndef NDEBUG
+      assert(m_state != 0);
+      m_owner = boost::this_thread::get_id();
+#endif
+    }
+
+    // For debugging and verification; unlocks the mutex, even if it was
+    // locked by a different thread
+    void safe_unlock() {
+#ifndef NDEBUG
+      m_owner = boost::this_thread::get_id();
+#endif
+      m_version.fetch_add(1, boost::memory_order_relaxed);
+      m_state.store(0, boost::memory_order_release);
+    }
+
+    bool try_lock() {
+      int expected = 0;
+      if (m_state.compare_exchange_strong(expected, (int)kExclusive,
+                              boost::memory_order_acquire)) {
+#ifndef NDEBUG
+        m_owner = boost::this_thread::get_id();
+#endif
+        return true;
+      }
+      return false;
+    }
+
+    void lock() {
+      int k = 0;
+      while (!try_lock())
+        Spinlock::spin(k++);
+    }
+
+    void unlock() {
+      assert(m_state == kExclusive);
+      assert(m_owner == boost::this_thread::get_id());
+      m_version.fetch_add(1, boost::memory_order_relaxed);
+      m_state.store(0, boost::memory_order_release);
+    }
+
+    bool try_lock_shared() {
+      int state = m_state.load(boost::memory_order_relaxed);
+      while (state != kExclusive) {
+        if (m_state.compare_exchange_weak(state, state + 1,
+                                boost::memory_order_acquire))
+          return true;
+      }
+      return false;
+    }
+
+    void lock_shared() {
+      int k = 0;
+      while (!try_lock_shared())
+        Spinlock::spin(k++);
+    }
+
+    void unlock_shared() {
+      assert(m_state > 0);
+      m_state.fetch_sub(1, boost::memory_order_release);
+    }
+
+    // Starts an optimistic read and stores the current version in
+    // |*version|. Returns false if the lock is held exclusively
+    bool try_lock_optimistic(uint32_t *version) {
+      if (m_state.load(boost::memory_order_acquire) == kExclusive)
+        return false;
+      *version = m_version.load(boost::memory_order_acquire);
+      return true;
+    }
+
+    // Returns true if the lock was not acquired exclusively since
+    // try_lock_optimistic() returned |version|
+    bool validate_optimistic(uint32_t version) {
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      return m_state.load(boost::memory_order_relaxed) != kExclusive
+              && m_version.load(boost::memory_order_relaxed) == version;
+    }
+
+  private:
+    boost::atomic<int> m_state;
+
+    // incremented whenever the exclusive lock is released
+    boost::atomic<uint32_t> m_version;
+#ifndef NDEBUG
+    boost::thread::id m_owner;
+#endif
+};
 #endif // UPS_ENABLE_HELGRIND
 
 class ScopedSpinlock {
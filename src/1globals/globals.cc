@@ -58,6 +58,10 @@ uint64_t Globals::ms_bytes_after_compression;
 
 bool Globals::ms_is_simd_enabled = true;
 
+bool Globals::ms_is_search_directory_enabled = true;
+
+bool Globals::ms_is_txn_btree_enabled = true;
+
 uint64_t Globals::ms_btree_smo_split;
 
 uint64_t Globals::ms_btree_smo_merge;
@@ -82,6 +82,12 @@ struct Globals {
   // enable/disable SIMD
   static bool ms_is_simd_enabled;
 
+  // enable/disable the KeyDirectory of internal nodes with numeric keys
+  static bool ms_is_search_directory_enabled;
+
+  // enable/disable the TxnBtree (otherwise the TxnIndex is a red-black tree)
+  static bool ms_is_txn_btree_enabled;
+
   // usage metrics - number of page splits
   static uint64_t ms_btree_smo_split;
 
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Two allocators for many small objects with a common lifetime.
+ *
+ * The Arena is a bump allocator: memory is handed out from large chunks
+ * and can only be released as a whole. The SlabCache manages objects of
+ * identical size; released objects are kept in a free list and reused.
+ *
+ * @exception_safe: strong
+ * @thread_safe: no
+ */
+
+#ifndef UPS_ARENA_H
+#define UPS_ARENA_H
+
+#include "0root/root.h"
+
+#include <algorithm>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/uncopyable.h"
+#include "1mem/mem.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct Arena : Uncopyable {
+  enum {
+    // the size of the first chunk; each following chunk is twice as large.
+    // Small, because most Txns only store a single operation
+    kInitialChunkSize = 256,
+
+    // the maximum size of a chunk (unless a single allocation is larger)
+    kMaxChunkSize = 1024 * 1024,
+
+    // the chunk header stores the pointer to the next chunk; it is padded
+    // to keep the allocations 8-byte aligned
+    kHeaderSize = 8
+  };
+
+  // Constructor
+  Arena()
+    : chunks(0), ptr(0), end(0), next_chunk_size(kInitialChunkSize) {
+  }
+
+  // Destructor; releases all chunks
+  ~Arena() {
+    clear();
+  }
+
+  // Returns |size| bytes, aligned to 8 bytes
+  void *allocate(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (unlikely(size > (size_t)(end - ptr)))
+      return allocate_chunk(size);
+    void *p = ptr;
+    ptr += size;
+    return p;
+  }
+
+  // Releases all allocated memory at once
+  void clear() {
+    while (chunks) {
+      uint8_t *next = *(uint8_t **)chunks;
+      Memory::release(chunks);
+      chunks = next;
+    }
+    ptr = 0;
+    end = 0;
+    next_chunk_size = kInitialChunkSize;
+  }
+
+ private:
+  // Allocates a new chunk and returns |size| bytes from it. Allocations
+  // which do not fit into a regular chunk get a chunk of their own; then
+  // the current chunk remains in use
+  void *allocate_chunk(size_t size) {
+    size_t chunk_size = std::max((size_t)next_chunk_size, size + kHeaderSize);
+    uint8_t *chunk = Memory::allocate<uint8_t>(chunk_size);
+
+    if (unlikely(chunk_size > next_chunk_size && chunks != 0)) {
+      *(uint8_t **)chunk = *(uint8_t **)chunks;
+      *(uint8_t **)chunks = chunk;
+      return chunk + kHeaderSize;
+    }
+
+    *(uint8_t **)chunk = chunks;
+    chunks = chunk;
+    ptr = chunk + kHeaderSize + size;
+    end = chunk + chunk_size;
+    next_chunk_size = std::min(next_chunk_size * 2, (size_t)kMaxChunkSize);
+    return chunk + kHeaderSize;
+  }
+
+  // linked list of all chunks; the head is the current chunk
+  uint8_t *chunks;
+
+  // the free space in the current chunk
+  uint8_t *ptr;
+  uint8_t *end;
+
+  // the size of the next chunk
+  size_t next_chunk_size;
+};
+
+template<typename T, size_t kObjectsPerSlab = 64>
+struct SlabCache : Uncopyable {
+  // Constructor
+  SlabCache()
+    : slabs(0), free_list(0), live(0) {
+  }
+
+  // Destructor; releases all slabs. All objects must have been destroyed
+  ~SlabCache() {
+    release_slabs();
+  }
+
+  // Returns uninitialized storage for a |T|; use placement new
+  // to construct the object
+  void *allocate() {
+    if (unlikely(free_list == 0))
+      allocate_slab();
+    FreeObject *f = free_list;
+    free_list = f->next;
+    live++;
+    return f;
+  }
+
+  // Destroys an object and keeps its storage for reuse. As soon as no
+  // object is alive, all slabs but one are returned to the allocator; the
+  // remaining slab serves the next (small) batch of objects
+  void destroy(T *t) {
+    t->~T();
+    FreeObject *f = (FreeObject *)t;
+    f->next = free_list;
+    free_list = f;
+    if (--live == 0 && slabs[0].next != 0)
+      shrink();
+  }
+
+ private:
+  union FreeObject {
+    FreeObject *next;
+    uint8_t storage[sizeof(T)];
+    void *align;
+  };
+
+  // Allocates a new slab and adds its objects to the free list
+  void allocate_slab() {
+    FreeObject *slab = Memory::allocate<FreeObject>(sizeof(FreeObject)
+                            * (kObjectsPerSlab + 1));
+    // the first object links the slabs
+    slab[0].next = slabs;
+    slabs = slab;
+    for (size_t i = kObjectsPerSlab; i > 0; i--) {
+      slab[i].next = free_list;
+      free_list = &slab[i];
+    }
+  }
+
+  // Releases all slabs but the first one, and rebuilds the free list
+  // from the remaining slab. Only called if no object is alive
+  void shrink() {
+    FreeObject *head = slabs;
+    slabs = head[0].next;
+    release_slabs();
+
+    head[0].next = 0;
+    slabs = head;
+    for (size_t i = kObjectsPerSlab; i > 0; i--) {
+      head[i].next = free_list;
+      free_list = &head[i];
+    }
+  }
+
+  // Releases all slabs
+  void release_slabs() {
+    while (slabs) {
+      FreeObject *next = slabs[0].next;
+      Memory::release(slabs);
+      slabs = next;
+    }
+    free_list = 0;
+  }
+
+  // linked list of all slabs
+  FreeObject *slabs;
+
+  // the unused objects
+  FreeObject *free_list;
+
+  // the number of objects which were allocated and not yet destroyed
+  size_t live;
+};
+
+} // namespace upscaledb
+
+#endif // UPS_ARENA_H
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A pool of aligned memory buffers of identical size. Used for the page
+ * buffers if direct I/O is enabled; released buffers are kept for reuse
+ * instead of returning them to the allocator.
+ *
+ * @exception_safe: strong
+ * @thread_safe: yes
+ */
+
+#ifndef UPS_BUFFER_POOL_H
+#define UPS_BUFFER_POOL_H
+
+#include "0root/root.h"
+
+#include <vector>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/spinlock.h"
+#include "1mem/mem.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct BufferPool {
+  // Constructor; at most |max_unused| released buffers are kept for reuse
+  BufferPool(size_t buffer_size, size_t alignment, size_t max_unused)
+    : buffer_size(buffer_size), alignment(alignment), max_unused(max_unused) {
+  }
+
+  // Destructor; releases the unused buffers. All other buffers must have
+  // been returned to the pool
+  ~BufferPool() {
+    for (std::vector<uint8_t *>::iterator it = unused.begin();
+                    it != unused.end(); it++)
+      Memory::release_aligned(*it);
+  }
+
+  // Returns a buffer of |buffer_size| bytes
+  uint8_t *allocate() {
+    {
+      ScopedSpinlock lock(mutex);
+      if (!unused.empty()) {
+        uint8_t *p = unused.back();
+        unused.pop_back();
+        return p;
+      }
+    }
+    return Memory::allocate_aligned<uint8_t>(buffer_size, alignment);
+  }
+
+  // Returns a buffer to the pool
+  void release(void *ptr) {
+    if (!ptr)
+      return;
+    {
+      ScopedSpinlock lock(mutex);
+      if (unused.size() < max_unused) {
+        unused.push_back((uint8_t *)ptr);
+        return;
+      }
+    }
+    Memory::release_aligned(ptr);
+  }
+
+  // The size of each buffer
+  size_t buffer_size;
+
+  // The alignment of each buffer
+  size_t alignment;
+
+  // The maximum number of unused buffers
+  size_t max_unused;
+
+  // For synchronizing access to |unused|
+  Spinlock mutex;
+
+  // The unused buffers
+  std::vector<uint8_t *> unused;
+};
+
+} // namespace upscaledb
+
+#endif // UPS_BUFFER_POOL_H
@@ -58,17 +58,24 @@ class File
 #endif
     };
 
+    enum {
+      // Offsets, sizes and buffers of direct I/O are aligned to this size
+      kDirectIoAlignment = 4096
+    };
+
     // Constructor: creates an empty File handle
     File()
-      : m_fd(UPS_INVALID_FD), m_mmaph(UPS_INVALID_FD), m_posix_advice(0) {
+      : m_fd(UPS_INVALID_FD), m_mmaph(UPS_INVALID_FD), m_posix_advice(0),
+        m_direct_io(false) {
     }
 
     // Copy constructor: moves ownership of the file handle
     File(File &&other)
       : m_fd(other.m_fd), m_mmaph(other.m_mmaph),
-        m_posix_advice(other.m_posix_advice) {
+        m_posix_advice(other.m_posix_advice), m_direct_io(other.m_direct_io) {
       other.m_fd = UPS_INVALID_FD;
 	  other.m_mmaph = UPS_INVALID_FD;
+      other.m_direct_io = false;
     }
 
     // Destructor: closes the file
@@ -79,7 +86,9 @@ class File
     // Assignment operator: moves ownership of the file handle
     File &operator=(File &&other) {
       m_fd = other.m_fd;
+      m_direct_io = other.m_direct_io;
       other.m_fd = UPS_INVALID_FD;
+      other.m_direct_io = false;
       return *this;
     }
 
@@ -94,12 +103,42 @@ class File
       return m_fd != UPS_INVALID_FD;
     }
 
+    // Returns the file handle
+    ups_fd_t fd() const {
+      return m_fd;
+    }
+
     // Flushes a file
     void flush();
 
     // Sets the parameter for posix_fadvise()
     void set_posix_advice(int parameter);
 
+    // Bypasses the page cache of the operating system (O_DIRECT).
+    // Reads and writes which are not aligned to kDirectIoAlignment are
+    // performed with an aligned bounce buffer. Returns false if direct
+    // I/O is not supported by the file system (or the platform)
+    bool enable_direct_io();
+
+    // Returns true if direct I/O is enabled
+    bool is_direct_io() const {
+      return m_direct_io;
+    }
+
+    // Returns the lock which serializes the unaligned writes with direct
+    // I/O. Callers which write to the file descriptor directly hold the
+    // shared lock
+    ReadWriteMutex &direct_io_mutex() {
+      return m_direct_io_mutex;
+    }
+
+    // Returns true if a read or write does not require a bounce buffer
+    // when direct I/O is enabled
+    static bool is_aligned(uint64_t offset, const void *buffer, size_t len) {
+      return ((offset | (uint64_t)(uintptr_t)buffer | (uint64_t)len)
+                      & (kDirectIoAlignment - 1)) == 0;
+    }
+
     // Maps a file in memory
     //
     // mmap is called with MAP_PRIVATE - the allocated buffer
@@ -135,6 +174,11 @@ class File
     // Truncate/resize the file
     void truncate(uint64_t newsize);
 
+    // Releases the disk space of a range in the file; the range is read
+    // back as zeroes, the file size does not change. A no-op if the
+    // platform or the file system does not support sparse files
+    void punch_hole(uint64_t addr, size_t len);
+
     // Closes the file descriptor
     void close();
 
@@ -148,10 +192,16 @@ class File
     // Parameter for posix_fadvise()
     int m_posix_advice;
 
-#ifdef WIN32
-	// A mutex; required for Win32
+    // True if direct I/O is enabled
+    bool m_direct_io;
+
+	// A mutex; required for Win32, if pread/pwrite are emulated with seek
+	// and read/write
 	Mutex m_mutex;
-#endif
+
+    // With direct I/O: unaligned writes (and truncate) hold the exclusive
+    // lock, all other writes hold the shared lock
+    ReadWriteMutex m_direct_io_mutex;
 };
 
 } // namespace upscaledb
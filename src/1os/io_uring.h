@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A minimal wrapper around a Linux io_uring submission/completion queue.
+ * Uses the raw system calls; liburing is not required. Throws exceptions
+ * in case of I/O errors.
+ *
+ * On other platforms (or if the kernel does not support io_uring) open()
+ * returns false, and the caller has to fall back to pread/pwrite.
+ *
+ * @exception_safe: basic
+ * @thread_safe: no
+ */
+
+#ifndef UPS_IO_URING_H
+#define UPS_IO_URING_H
+
+#include "0root/root.h"
+
+#include "ups/types.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1os/os.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+class IoUring
+{
+  public:
+    // A single read or write request
+    struct Request {
+      // the offset in the file
+      uint64_t offset;
+
+      // the buffer which is read or written
+      void *buffer;
+
+      // the size of the buffer
+      size_t size;
+    };
+
+    // Constructor creates an empty (closed) queue
+    IoUring()
+      : m_fd(-1), m_entries(0), m_sq_ring(0), m_sq_ring_size(0),
+        m_cq_ring(0), m_cq_ring_size(0), m_sqes(0), m_sqes_size(0),
+        m_sq_head(0), m_sq_tail(0), m_sq_mask(0), m_sq_array(0),
+        m_cq_head(0), m_cq_tail(0), m_cq_mask(0), m_cqes(0) {
+    }
+
+    // Destructor closes the queue
+    ~IoUring() {
+      close();
+    }
+
+    // Sets up a queue with |entries| slots. Returns false if io_uring
+    // is not supported
+    bool open(uint32_t entries);
+
+    // Returns true if the queue was set up successfully
+    bool is_open() const {
+      return m_fd != -1;
+    }
+
+    // Reads all |requests| from |fd|. All reads are submitted with a
+    // single system call, and this function returns when all of them
+    // are completed
+    void read(ups_fd_t fd, Request *requests, size_t count);
+
+    // Writes all |requests| to |fd|. If |sync| is true then a
+    // fdatasync is queued behind the writes, and executed by the kernel
+    // after all writes are completed
+    void write(ups_fd_t fd, Request *requests, size_t count, bool sync);
+
+    // Closes the queue
+    void close();
+
+  private:
+    // Submits |count| requests and waits till they are completed;
+    // |opcode| is the IORING_OP_* code
+    void submit_and_wait(ups_fd_t fd, int opcode, Request *requests,
+                    size_t count, bool sync);
+
+    // The file descriptor of the queue
+    int m_fd;
+
+    // The number of slots in the submission queue
+    uint32_t m_entries;
+
+    // The mapped submission queue ring
+    void *m_sq_ring;
+    size_t m_sq_ring_size;
+
+    // The mapped completion queue ring; can be identical to |m_sq_ring|
+    void *m_cq_ring;
+    size_t m_cq_ring_size;
+
+    // The mapped array of submission queue entries
+    void *m_sqes;
+    size_t m_sqes_size;
+
+    // Pointers into the submission queue ring
+    uint32_t *m_sq_head;
+    uint32_t *m_sq_tail;
+    uint32_t *m_sq_mask;
+    uint32_t *m_sq_array;
+
+    // Pointers into the completion queue ring
+    uint32_t *m_cq_head;
+    uint32_t *m_cq_tail;
+    uint32_t *m_cq_mask;
+    void *m_cqes;
+};
+
+} // namespace upscaledb
+
+#endif /* UPS_IO_URING_H */
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <algorithm>
 #if HAVE_MMAP
 #  include <sys/mman.h>
 #endif
@@ -38,11 +39,17 @@
 #include <netdb.h>
 #include <fcntl.h>
 #include <unistd.h>
+#if HAVE_LINUX_IO_URING_H
+#  include <sys/syscall.h>
+#  include <linux/io_uring.h>
+#endif
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
 #include "1errorinducer/errorinducer.h"
+#include "1mem/mem.h"
 #include "1os/file.h"
+#include "1os/io_uring.h"
 #include "1os/socket.h"
 
 #ifndef UPS_ROOT_H
@@ -169,6 +176,29 @@ File::set_posix_advice(int advice)
 #endif
 }
 
+bool
+File::enable_direct_io()
+{
+#if defined(O_DIRECT) && HAVE_PREAD && HAVE_PWRITE
+  int flags = ::fcntl(m_fd, F_GETFL, 0);
+  if (flags < 0 || ::fcntl(m_fd, F_SETFL, flags | O_DIRECT) < 0) {
+    ups_log(("O_DIRECT is not supported (status %u, %s)", errno,
+                strerror(errno)));
+    return false;
+  }
+  m_direct_io = true;
+  return true;
+#elif defined(F_NOCACHE)
+  // MacOS: disables the page cache, without alignment restrictions
+  if (::fcntl(m_fd, F_NOCACHE, 1) == -1)
+    return false;
+  m_direct_io = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
 void
 File::mmap(uint64_t position, size_t size, bool readonly, uint8_t **buffer)
 {
@@ -218,12 +248,133 @@ File::munmap(void *buffer, size_t size)
 #endif
 }
 
+#if HAVE_PREAD && HAVE_PWRITE
+// Reads up to |len| bytes; returns less than |len| bytes at the end
+// of the file
+static size_t
+os_pread_some(ups_fd_t fd, uint8_t *buffer, size_t len, uint64_t addr)
+{
+  size_t total = 0;
+  while (total < len) {
+    ssize_t r = ::pread(fd, buffer + total, len - total, addr + total);
+    if (r < 0) {
+      ups_log(("File::pread failed with status %u (%s)", errno,
+                              strerror(errno)));
+      throw Exception(UPS_IO_ERROR);
+    }
+    if (r == 0)
+      break;
+    total += r;
+  }
+  return total;
+}
+
+// Returns the range of aligned blocks which covers |addr| and |len|
+static void
+os_aligned_range(uint64_t addr, size_t len, uint64_t *start, size_t *size)
+{
+  const uint64_t alignment = File::kDirectIoAlignment;
+  uint64_t end = addr + len;
+  if (end % alignment)
+    end += alignment - (end % alignment);
+  *start = addr - (addr % alignment);
+  *size = (size_t)(end - *start);
+}
+
+// Unaligned read with direct I/O; reads the aligned blocks into a
+// bounce buffer
+static void
+os_pread_unaligned(ups_fd_t fd, uint64_t addr, void *buffer, size_t len)
+{
+  uint64_t start;
+  size_t size;
+  os_aligned_range(addr, len, &start, &size);
+
+  uint8_t *p = Memory::allocate_aligned<uint8_t>(size,
+                  File::kDirectIoAlignment);
+  size_t total;
+  try {
+    total = os_pread_some(fd, p, size, start);
+  }
+  catch (Exception &) {
+    Memory::release_aligned(p);
+    throw;
+  }
+  if (total < addr + len - start) {
+    Memory::release_aligned(p);
+    ups_log(("File::pread() failed with short read (%u of %u bytes)",
+                (unsigned)total, (unsigned)(addr + len - start)));
+    throw Exception(UPS_IO_ERROR);
+  }
+  ::memcpy(buffer, p + (addr - start), len);
+  Memory::release_aligned(p);
+}
+
+// Unaligned write with direct I/O; reads the aligned blocks into a bounce
+// buffer, modifies them and writes them back. If the file grows then it is
+// truncated to the end of the written data. The caller holds the exclusive
+// direct I/O lock: no other write (or truncate) runs concurrently, because
+// the read-modify-write and the size check are not atomic.
+static void
+os_pwrite_unaligned(ups_fd_t fd, uint64_t addr, const void *buffer,
+                size_t len)
+{
+  uint64_t start;
+  size_t size;
+  os_aligned_range(addr, len, &start, &size);
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ups_log(("fstat failed with status %u (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+  uint64_t file_size = (uint64_t)st.st_size;
+
+  uint8_t *p = Memory::allocate_aligned<uint8_t>(size,
+                  File::kDirectIoAlignment);
+  try {
+    size_t total = os_pread_some(fd, p, size, start);
+    if (total < size)
+      ::memset(p + total, 0, size - total);
+    ::memcpy(p + (addr - start), buffer, len);
+
+    total = 0;
+    while (total < size) {
+      ssize_t s = ::pwrite(fd, p + total, size - total, start + total);
+      if (s <= 0) {
+        ups_log(("pwrite() failed with status %u (%s)", errno,
+                    strerror(errno)));
+        throw Exception(UPS_IO_ERROR);
+      }
+      total += s;
+    }
+
+    if (start + size > file_size && start + size > addr + len) {
+      if (::ftruncate(fd, std::max(file_size, addr + len)) != 0)
+        throw Exception(UPS_IO_ERROR);
+    }
+  }
+  catch (Exception &) {
+    Memory::release_aligned(p);
+    throw;
+  }
+  Memory::release_aligned(p);
+}
+#endif // HAVE_PREAD && HAVE_PWRITE
+
 void
 File::pread(uint64_t addr, void *buffer, size_t len)
 {
   os_log(("File::pread: fd=%d, address=%lld, size=%lld", m_fd, addr, len));
 
 #if HAVE_PREAD
+#  if HAVE_PWRITE
+  if (unlikely(m_direct_io && !is_aligned(addr, buffer, len))) {
+    os_pread_unaligned(m_fd, addr, buffer, len);
+    return;
+  }
+#  endif
+
   int r;
   size_t total = 0;
 
@@ -245,6 +396,7 @@ File::pread(uint64_t addr, void *buffer, size_t len)
     throw Exception(UPS_IO_ERROR);
   }
 #else
+  ScopedLock lock(m_mutex);
   File::seek(addr, kSeekSet);
   os_read(m_fd, (uint8_t *)buffer, len);
 #endif
@@ -256,11 +408,25 @@ File::pwrite(uint64_t addr, const void *buffer, size_t len)
   os_log(("File::pwrite: fd=%d, address=%lld, size=%lld", m_fd, addr, len));
 
 #if HAVE_PWRITE
+#  if HAVE_PREAD
+  if (unlikely(m_direct_io && !is_aligned(addr, buffer, len))) {
+    ScopedWriteLock lock(m_direct_io_mutex);
+    os_pwrite_unaligned(m_fd, addr, buffer, len);
+    return;
+  }
+
+  // aligned writes run concurrently, but not during an unaligned write
+  ScopedReadLock lock(m_direct_io_mutex, boost::defer_lock);
+  if (unlikely(m_direct_io))
+    lock.lock();
+#  endif
+
   ssize_t s;
   size_t total = 0;
 
   while (total < len) {
-    s = ::pwrite(m_fd, buffer, len, addr + total);
+    s = ::pwrite(m_fd, (const uint8_t *)buffer + total, len - total,
+                    addr + total);
     if (s < 0) {
       ups_log(("pwrite() failed with status %u (%s)", errno, strerror(errno)));
       throw Exception(UPS_IO_ERROR);
@@ -275,6 +441,7 @@ File::pwrite(uint64_t addr, const void *buffer, size_t len)
     throw Exception(UPS_IO_ERROR);
   }
 #else
+  ScopedLock lock(m_mutex);
   seek(addr, kSeekSet);
   write(buffer, len);
 #endif
@@ -284,6 +451,16 @@ void
 File::write(const void *buffer, size_t len)
 {
   os_log(("File::write: fd=%d, size=%lld", m_fd, len));
+
+  // with direct I/O: write at the current position, then move the
+  // position behind the written data
+  if (m_direct_io) {
+    uint64_t position = tell();
+    pwrite(position, buffer, len);
+    seek(position + len, kSeekSet);
+    return;
+  }
+
   os_write(m_fd, buffer, len);
 }
 
@@ -318,10 +495,35 @@ void
 File::truncate(uint64_t newsize)
 {
   os_log(("File::truncate: fd=%d, size=%lld", m_fd, newsize));
+  if (m_direct_io) {
+    ScopedWriteLock lock(m_direct_io_mutex);
+    if (ftruncate(m_fd, newsize))
+      throw Exception(UPS_IO_ERROR);
+    return;
+  }
   if (ftruncate(m_fd, newsize))
     throw Exception(UPS_IO_ERROR);
 }
 
+void
+File::punch_hole(uint64_t addr, size_t len)
+{
+#if HAVE_FALLOCATE && defined(FALLOC_FL_PUNCH_HOLE)
+  os_log(("File::punch_hole: fd=%d, addr=%lld, len=%lld", m_fd, addr, len));
+  if (::fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                          (off_t)addr, (off_t)len) != 0) {
+    // the file system does not support sparse files
+    if (errno == EOPNOTSUPP || errno == ENOSYS)
+      return;
+    ups_log(("fallocate failed with status %u (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#else
+  (void)addr;
+  (void)len;
+#endif
+}
+
 void
 File::create(const char *filename, uint32_t mode)
 {
@@ -475,4 +677,241 @@ Socket::close()
   }
 }
 
+#if HAVE_LINUX_IO_URING_H && defined(__NR_io_uring_setup)
+#  define UPS_HAVE_IO_URING 1
+#endif
+
+bool
+IoUring::open(uint32_t entries)
+{
+#ifdef UPS_HAVE_IO_URING
+  close();
+
+  struct io_uring_params params;
+  ::memset(&params, 0, sizeof(params));
+  int fd = (int)::syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    ups_log(("io_uring_setup failed with status %u (%s)", errno,
+                strerror(errno)));
+    return false;
+  }
+  m_fd = fd;
+  m_entries = params.sq_entries;
+
+  m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  m_cq_ring_size = params.cq_off.cqes
+                        + params.cq_entries * sizeof(struct io_uring_cqe);
+  // newer kernels map both rings with a single mmap call
+  bool single_mmap = ISSET(params.features, IORING_FEAT_SINGLE_MMAP);
+  if (single_mmap) {
+    if (m_cq_ring_size > m_sq_ring_size)
+      m_sq_ring_size = m_cq_ring_size;
+    m_cq_ring_size = m_sq_ring_size;
+  }
+
+  m_sq_ring = ::mmap(0, m_sq_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (m_sq_ring == MAP_FAILED) {
+    m_sq_ring = 0;
+    close();
+    return false;
+  }
+  if (single_mmap)
+    m_cq_ring = m_sq_ring;
+  else {
+    m_cq_ring = ::mmap(0, m_cq_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (m_cq_ring == MAP_FAILED) {
+      m_cq_ring = 0;
+      close();
+      return false;
+    }
+  }
+
+  m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  m_sqes = ::mmap(0, m_sqes_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (m_sqes == MAP_FAILED) {
+    m_sqes = 0;
+    close();
+    return false;
+  }
+
+  uint8_t *sq = (uint8_t *)m_sq_ring;
+  m_sq_head = (uint32_t *)(sq + params.sq_off.head);
+  m_sq_tail = (uint32_t *)(sq + params.sq_off.tail);
+  m_sq_mask = (uint32_t *)(sq + params.sq_off.ring_mask);
+  m_sq_array = (uint32_t *)(sq + params.sq_off.array);
+
+  uint8_t *cq = (uint8_t *)m_cq_ring;
+  m_cq_head = (uint32_t *)(cq + params.cq_off.head);
+  m_cq_tail = (uint32_t *)(cq + params.cq_off.tail);
+  m_cq_mask = (uint32_t *)(cq + params.cq_off.ring_mask);
+  m_cqes = cq + params.cq_off.cqes;
+  return true;
+#else
+  (void)entries;
+  return false;
+#endif
+}
+
+void
+IoUring::read(ups_fd_t fd, Request *requests, size_t count)
+{
+#ifdef UPS_HAVE_IO_URING
+  submit_and_wait(fd, IORING_OP_READ, requests, count, false);
+#else
+  (void)fd;
+  (void)requests;
+  (void)count;
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
+void
+IoUring::write(ups_fd_t fd, Request *requests, size_t count, bool sync)
+{
+#ifdef UPS_HAVE_IO_URING
+  submit_and_wait(fd, IORING_OP_WRITE, requests, count, sync);
+#else
+  (void)fd;
+  (void)requests;
+  (void)count;
+  (void)sync;
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
+void
+IoUring::submit_and_wait(ups_fd_t fd, int opcode, Request *requests,
+                size_t count, bool sync)
+{
+#ifdef UPS_HAVE_IO_URING
+  assert(is_open());
+  const uint64_t kFsync = ~(uint64_t)0;
+  int error = 0;
+  size_t done = 0;
+
+  // If there are more requests than slots then they are submitted in
+  // several rounds. One slot is reserved for the fsync
+  while (done < count || sync) {
+    size_t n = std::min<size_t>(count - done, m_entries - 1);
+    uint32_t tail = *m_sq_tail;
+    uint32_t mask = *m_sq_mask;
+    uint32_t to_submit = 0;
+
+    for (size_t i = done; i < done + n; i++, to_submit++) {
+      uint32_t index = (tail + to_submit) & mask;
+      struct io_uring_sqe *sqe = &((struct io_uring_sqe *)m_sqes)[index];
+      ::memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = (uint8_t)opcode;
+      sqe->fd = fd;
+      sqe->off = requests[i].offset;
+      sqe->addr = (uint64_t)(uintptr_t)requests[i].buffer;
+      sqe->len = (uint32_t)requests[i].size;
+      sqe->user_data = i;
+      m_sq_array[index] = index;
+    }
+
+    // the fsync is executed after all previous requests are completed
+    if (sync && done + n == count) {
+      uint32_t index = (tail + to_submit) & mask;
+      struct io_uring_sqe *sqe = &((struct io_uring_sqe *)m_sqes)[index];
+      ::memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_FSYNC;
+      sqe->flags = IOSQE_IO_DRAIN;
+      sqe->fd = fd;
+      sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+      sqe->user_data = kFsync;
+      m_sq_array[index] = index;
+      to_submit++;
+      sync = false;
+    }
+
+    __atomic_store_n(m_sq_tail, tail + to_submit, __ATOMIC_RELEASE);
+
+    // submit the requests, then wait till all of them are completed
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+    while (completed < to_submit) {
+      int r = (int)::syscall(__NR_io_uring_enter, m_fd,
+                      to_submit - submitted, to_submit - completed,
+                      IORING_ENTER_GETEVENTS, (void *)0, (size_t)0);
+      if (r < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+          continue;
+        // the submitted requests are still in flight; the buffers must
+        // not be released, therefore this is fatal
+        ups_log(("io_uring_enter failed with status %u (%s)", errno,
+                    strerror(errno)));
+        throw Exception(UPS_IO_ERROR);
+      }
+      submitted += std::min<uint32_t>(r, to_submit - submitted);
+
+      uint32_t head = *m_cq_head;
+      uint32_t cq_tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != cq_tail; head++, completed++) {
+        struct io_uring_cqe *cqe =
+                &((struct io_uring_cqe *)m_cqes)[head & *m_cq_mask];
+        if (cqe->res < 0) {
+          error = -cqe->res;
+          continue;
+        }
+        if (cqe->user_data == kFsync)
+          continue;
+
+        // complete short reads/writes with the synchronous calls
+        Request &req = requests[cqe->user_data];
+        size_t total = (size_t)cqe->res;
+        while (total < req.size) {
+          ssize_t s = opcode == IORING_OP_READ
+                  ? ::pread(fd, (uint8_t *)req.buffer + total,
+                          req.size - total, req.offset + total)
+                  : ::pwrite(fd, (uint8_t *)req.buffer + total,
+                          req.size - total, req.offset + total);
+          if (s <= 0) {
+            error = s < 0 ? errno : EIO;
+            break;
+          }
+          total += s;
+        }
+      }
+      __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    done += n;
+  }
+
+  if (error) {
+    ups_log(("io_uring request failed with status %u (%s)", error,
+                strerror(error)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#else
+  (void)fd;
+  (void)opcode;
+  (void)requests;
+  (void)count;
+  (void)sync;
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
+void
+IoUring::close()
+{
+#ifdef UPS_HAVE_IO_URING
+  if (m_sqes)
+    ::munmap(m_sqes, m_sqes_size);
+  if (m_cq_ring && m_cq_ring != m_sq_ring)
+    ::munmap(m_cq_ring, m_cq_ring_size);
+  if (m_sq_ring)
+    ::munmap(m_sq_ring, m_sq_ring_size);
+  if (m_fd != -1)
+    ::close(m_fd);
+#endif
+  m_fd = -1;
+  m_sq_ring = m_cq_ring = m_sqes = 0;
+}
+
 } // namespace upscaledb
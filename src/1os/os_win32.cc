@@ -29,6 +29,7 @@
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
 #include "1os/file.h"
+#include "1os/io_uring.h"
 #include "1os/socket.h"
 
 #ifndef UPS_ROOT_H
@@ -105,6 +106,14 @@ File::set_posix_advice(int advice)
   // Only available for posix platforms
 }
 
+bool
+File::enable_direct_io()
+{
+  // FILE_FLAG_NO_BUFFERING can only be set when the file is opened;
+  // not supported
+  return false;
+}
+
 void
 File::mmap(uint64_t position, size_t size, bool readonly, uint8_t **buffer)
 {
@@ -329,6 +338,12 @@ File::truncate(uint64_t newsize)
   assert(newsize == file_size());
 }
 
+void
+File::punch_hole(uint64_t addr, size_t len)
+{
+  // Only available for posix platforms
+}
+
 void
 File::create(const char *filename, uint32_t mode)
 {
@@ -552,4 +567,38 @@ Socket::close()
   }
 }
 
+// io_uring is not available on Win32; the callers fall back to the
+// regular file I/O
+bool
+IoUring::open(uint32_t entries)
+{
+  (void)entries;
+  return false;
+}
+
+void
+IoUring::read(ups_fd_t fd, Request *requests, size_t count)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+void
+IoUring::write(ups_fd_t fd, Request *requests, size_t count, bool sync)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+void
+IoUring::submit_and_wait(ups_fd_t fd, int opcode, Request *requests,
+                size_t count, bool sync)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+void
+IoUring::close()
+{
+  m_fd = -1;
+}
+
 } // namespace upscaledb
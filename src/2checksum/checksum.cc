@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include "0root/root.h"
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#  define UPS_CRC32C_DISPATCH 1
+#  include <x86intrin.h>
+#endif
+
+#include "3rdparty/murmurhash3/MurmurHash3.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "2checksum/checksum.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+// The CRC32C polynomial (reversed)
+static const uint32_t kPolynomial = 0x82f63b78;
+
+// The size of the three streams which are processed in parallel. Each
+// round processes 3 * kLongBlock (or 3 * kShortBlock) bytes
+static const size_t kLongBlock = 8192;
+static const size_t kShortBlock = 256;
+
+// Multiplies the 32x32 matrix |mat| (over GF(2)) with the vector |vec|
+static inline uint32_t
+gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1)
+      sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+// Calculates |square| = |mat| * |mat|
+static inline void
+gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+  for (int n = 0; n < 32; n++)
+    square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+// Calculates the operator which appends |size| zero bytes to a crc
+static void
+zeros_operator(uint32_t *even, size_t size)
+{
+  uint32_t odd[32];
+
+  // the operator for one zero bit
+  odd[0] = kPolynomial;
+  uint32_t row = 1;
+  for (int n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  // two zero bits, four zero bits
+  gf2_matrix_square(even, odd);
+  gf2_matrix_square(odd, even);
+
+  // the first squaring in the loop yields the operator for one zero byte;
+  // then square until |size| is reached (it's always a power of two)
+  do {
+    gf2_matrix_square(even, odd);
+    size >>= 1;
+    if (size == 0)
+      return;
+    gf2_matrix_square(odd, even);
+    size >>= 1;
+  } while (size);
+
+  ::memcpy(even, odd, sizeof(odd));
+}
+
+// The lookup tables
+struct Crc32cTables {
+  Crc32cTables() {
+    // the tables for slicing-by-8
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t crc = n;
+      for (int k = 0; k < 8; k++)
+        crc = crc & 1 ? (crc >> 1) ^ kPolynomial : crc >> 1;
+      slices[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t crc = slices[0][n];
+      for (int k = 1; k < 8; k++) {
+        crc = slices[0][crc & 0xff] ^ (crc >> 8);
+        slices[k][n] = crc;
+      }
+    }
+
+    // the tables for shifting a crc over kLongBlock (kShortBlock) zeroes
+    initialize_shift(long_shift, kLongBlock);
+    initialize_shift(short_shift, kShortBlock);
+  }
+
+  void initialize_shift(uint32_t shift[4][256], size_t size) {
+    uint32_t op[32];
+    zeros_operator(op, size);
+    for (uint32_t n = 0; n < 256; n++) {
+      shift[0][n] = gf2_matrix_times(op, n);
+      shift[1][n] = gf2_matrix_times(op, n << 8);
+      shift[2][n] = gf2_matrix_times(op, n << 16);
+      shift[3][n] = gf2_matrix_times(op, n << 24);
+    }
+  }
+
+  uint32_t slices[8][256];
+  uint32_t long_shift[4][256];
+  uint32_t short_shift[4][256];
+};
+
+static const Crc32cTables tables;
+
+// Appends the zeroes of |shift| to |crc|
+static inline uint32_t
+crc32c_shift(const uint32_t shift[4][256], uint32_t crc)
+{
+  return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff]
+          ^ shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+}
+
+uint32_t
+Checksum::crc32c_portable(uint32_t crc, const void *data, size_t size)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t c = ~crc;
+
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    c = tables.slices[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+    size--;
+  }
+
+  while (size >= 8) {
+    uint32_t lo, hi;
+    ::memcpy(&lo, p, sizeof(lo));
+    ::memcpy(&hi, p + 4, sizeof(hi));
+    lo ^= c;
+    c = tables.slices[7][lo & 0xff]
+        ^ tables.slices[6][(lo >> 8) & 0xff]
+        ^ tables.slices[5][(lo >> 16) & 0xff]
+        ^ tables.slices[4][lo >> 24]
+        ^ tables.slices[3][hi & 0xff]
+        ^ tables.slices[2][(hi >> 8) & 0xff]
+        ^ tables.slices[1][(hi >> 16) & 0xff]
+        ^ tables.slices[0][hi >> 24];
+    p += 8;
+    size -= 8;
+  }
+
+  while (size > 0) {
+    c = tables.slices[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+    size--;
+  }
+
+  return ~c;
+}
+
+#ifdef UPS_CRC32C_DISPATCH
+
+// The crc32 instruction has a latency of three cycles, but a throughput of
+// one per cycle. Therefore three independent streams are processed
+// in parallel, and their crcs are combined with the shift tables.
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const void *data, size_t size)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  uint64_t crc0 = ~crc;
+
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    crc0 = _mm_crc32_u8((uint32_t)crc0, *p++);
+    size--;
+  }
+
+  while (size >= kLongBlock * 3) {
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const uint8_t *end = p + kLongBlock;
+    do {
+      crc0 = _mm_crc32_u64(crc0, *(const uint64_t *)p);
+      crc1 = _mm_crc32_u64(crc1, *(const uint64_t *)(p + kLongBlock));
+      crc2 = _mm_crc32_u64(crc2, *(const uint64_t *)(p + kLongBlock * 2));
+      p += 8;
+    } while (p < end);
+    crc0 = crc32c_shift(tables.long_shift, (uint32_t)crc0) ^ crc1;
+    crc0 = crc32c_shift(tables.long_shift, (uint32_t)crc0) ^ crc2;
+    p += kLongBlock * 2;
+    size -= kLongBlock * 3;
+  }
+
+  while (size >= kShortBlock * 3) {
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const uint8_t *end = p + kShortBlock;
+    do {
+      crc0 = _mm_crc32_u64(crc0, *(const uint64_t *)p);
+      crc1 = _mm_crc32_u64(crc1, *(const uint64_t *)(p + kShortBlock));
+      crc2 = _mm_crc32_u64(crc2, *(const uint64_t *)(p + kShortBlock * 2));
+      p += 8;
+    } while (p < end);
+    crc0 = crc32c_shift(tables.short_shift, (uint32_t)crc0) ^ crc1;
+    crc0 = crc32c_shift(tables.short_shift, (uint32_t)crc0) ^ crc2;
+    p += kShortBlock * 2;
+    size -= kShortBlock * 3;
+  }
+
+  while (size >= 8) {
+    crc0 = _mm_crc32_u64(crc0, *(const uint64_t *)p);
+    p += 8;
+    size -= 8;
+  }
+
+  while (size > 0) {
+    crc0 = _mm_crc32_u8((uint32_t)crc0, *p++);
+    size--;
+  }
+
+  return ~(uint32_t)crc0;
+}
+
+static bool
+detect_sse42()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+#endif // UPS_CRC32C_DISPATCH
+
+bool
+Checksum::is_crc32c_accelerated()
+{
+#ifdef UPS_CRC32C_DISPATCH
+  static const bool is_accelerated = detect_sse42();
+  return is_accelerated;
+#else
+  return false;
+#endif
+}
+
+uint32_t
+Checksum::crc32c(uint32_t crc, const void *data, size_t size)
+{
+#ifdef UPS_CRC32C_DISPATCH
+  if (likely(is_crc32c_accelerated()))
+    return crc32c_sse42(crc, data, size);
+#endif
+  return crc32c_portable(crc, data, size);
+}
+
+uint32_t
+Checksum::calculate(int algorithm, const void *data, size_t size,
+                uint32_t seed)
+{
+  if (likely(algorithm == kCrc32c))
+    return crc32c(seed, data, size);
+
+  assert(algorithm == kMurmurHash3);
+  uint32_t hash;
+  MurmurHash3_x86_32(data, (int)size, seed, &hash);
+  return hash;
+}
+
+} // namespace upscaledb
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Checksums of pages and blobs (UPS_ENABLE_CRC32).
+ *
+ * The algorithm is stored in the Environment header. Files which were
+ * created by older versions use MurmurHash3; new files use CRC32C
+ * (Castagnoli). If the CPU supports SSE4.2 then CRC32C uses the crc32
+ * instruction on three independent streams, which are combined
+ * afterwards; otherwise a portable table-driven implementation
+ * (slicing-by-8) is used. Both return identical results.
+ *
+ * @exception_safe: nothrow
+ * @thread_safe: yes
+ */
+
+#ifndef UPS_CHECKSUM_H
+#define UPS_CHECKSUM_H
+
+#include "0root/root.h"
+
+// Always verify that a file of level N does not include headers > N!
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct Checksum {
+  // The algorithms; the values are persisted in the Environment header
+  enum {
+    // MurmurHash3 (x86, 32bit); used by files of older versions
+    kMurmurHash3 = 0,
+
+    // CRC32C (Castagnoli); the default for new files
+    kCrc32c = 1,
+
+    // The algorithm of new files
+    kDefault = kCrc32c
+  };
+
+  // Returns true if |algorithm| is known
+  static bool is_available(int algorithm) {
+    return algorithm == kMurmurHash3 || algorithm == kCrc32c;
+  }
+
+  // Calculates the checksum of |data|; |seed| is usually the address
+  // of the page
+  static uint32_t calculate(int algorithm, const void *data, size_t size,
+                  uint32_t seed);
+
+  // Calculates a CRC32C; |crc| is the CRC32C of the preceding data
+  // (or a seed). Uses the crc32 instruction if it is available
+  static uint32_t crc32c(uint32_t crc, const void *data, size_t size);
+
+  // Same as above, but never uses the crc32 instruction
+  static uint32_t crc32c_portable(uint32_t crc, const void *data,
+                  size_t size);
+
+  // Returns true if the CPU supports the crc32 instruction (SSE4.2)
+  static bool is_crc32c_accelerated();
+};
+
+} // namespace upscaledb
+
+#endif // UPS_CHECKSUM_H
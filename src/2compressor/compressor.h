@@ -30,6 +30,7 @@
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/dynamic_array.h"
+#include "1base/error.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -72,6 +73,22 @@ struct Compressor {
   virtual void decompress(const uint8_t *inp, uint32_t inlength,
                   uint32_t outlength, uint8_t *destination) = 0;
 
+  // Sets a dictionary which is used by all following calls to compress()
+  // and decompress(). Only supported by zstd
+  virtual void set_dictionary(const uint8_t *data, uint32_t size) {
+    throw Exception(UPS_NOT_IMPLEMENTED);
+  }
+
+  // Trains a dictionary of up to |capacity| bytes from |count| samples,
+  // which are stored back to back in |samples|; |sizes| stores the size
+  // of each sample. Returns the size of the dictionary. Only supported
+  // by zstd
+  virtual uint32_t train_dictionary(const uint8_t *samples,
+                  const size_t *sizes, uint32_t count,
+                  uint8_t *dictionary, uint32_t capacity) {
+    throw Exception(UPS_NOT_IMPLEMENTED);
+  }
+
   // Reserves |n| bytes in the output buffer; can be used by the caller
   // to insert flags or sizes
   void reserve(int n) {
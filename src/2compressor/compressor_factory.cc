@@ -23,6 +23,8 @@
 #include "2compressor/compressor_zlib.h"
 #include "2compressor/compressor_snappy.h"
 #include "2compressor/compressor_lzf.h"
+#include "2compressor/compressor_lz4.h"
+#include "2compressor/compressor_zstd.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -45,6 +47,9 @@ CompressorFactory::is_available(int type)
     case UPS_COMPRESSOR_UINT32_VARBYTE:
     case UPS_COMPRESSOR_UINT32_GROUPVARINT:
     case UPS_COMPRESSOR_UINT32_FOR:
+    case UPS_COMPRESSOR_UINT64_VARBYTE:
+    case UPS_COMPRESSOR_UINT64_FOR:
+    case UPS_COMPRESSOR_PREFIX:
       return true;
     case UPS_COMPRESSOR_ZLIB:
 #ifdef HAVE_ZLIB_H
@@ -61,6 +66,18 @@ CompressorFactory::is_available(int type)
     case UPS_COMPRESSOR_LZF:
       // this is always available
       return true;
+    case UPS_COMPRESSOR_LZ4:
+#ifdef HAVE_LZ4_H
+      return true;
+#else
+      return false;
+#endif
+    case UPS_COMPRESSOR_ZSTD:
+#ifdef HAVE_ZSTD_H
+      return true;
+#else
+      return false;
+#endif
     default:
       return false;
   }
@@ -87,6 +104,20 @@ CompressorFactory::create(int type)
     case UPS_COMPRESSOR_LZF:
       // this is always available
       return new CompressorImpl<LzfCompressor>();
+    case UPS_COMPRESSOR_LZ4:
+#ifdef HAVE_LZ4_H
+      return new CompressorImpl<Lz4Compressor>();
+#else
+      ups_log(("upscaledb was built without support for lz4 compression"));
+      throw Exception(UPS_INV_PARAMETER);
+#endif
+    case UPS_COMPRESSOR_ZSTD:
+#ifdef HAVE_ZSTD_H
+      return new ZstdCompressorImpl();
+#else
+      ups_log(("upscaledb was built without support for zstd compression"));
+      throw Exception(UPS_INV_PARAMETER);
+#endif
     default:
       ups_log(("Unknown compressor type %d", type));
       throw Exception(UPS_INV_PARAMETER);
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+/*
+ * A compressor which uses lz4.
+ *
+ * @exception_safe: unknown
+ * @thread_safe: unknown
+ */
+
+#ifndef UPS_COMPRESSOR_LZ4_H
+#define UPS_COMPRESSOR_LZ4_H
+
+#ifdef HAVE_LZ4_H
+
+#include "0root/root.h"
+
+#include <lz4.h>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "2compressor/compressor.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct Lz4Compressor {
+  uint32_t compressed_length(uint32_t length) {
+    return ::LZ4_compressBound((int)length);
+  }
+
+  uint32_t compress(const uint8_t *inp, uint32_t inlength,
+                            uint8_t *outp, uint32_t outlength) {
+    int clen = ::LZ4_compress_default((const char *)inp, (char *)outp,
+                          (int)inlength, (int)outlength);
+    if (clen <= 0)
+      throw Exception(UPS_INTERNAL_ERROR);
+    return (uint32_t)clen;
+  }
+
+  void decompress(const uint8_t *inp, uint32_t inlength,
+                            uint8_t *outp, uint32_t outlength) {
+    int len = ::LZ4_decompress_safe((const char *)inp, (char *)outp,
+                          (int)inlength, (int)outlength);
+    if (len != (int)outlength)
+      throw Exception(UPS_INTERNAL_ERROR);
+  }
+};
+
+}; // namespace upscaledb
+
+#endif // HAVE_LZ4_H
+
+#endif // UPS_COMPRESSOR_LZ4_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+/*
+ * A compressor which uses zstd. Can use a dictionary, which is trained
+ * from sample data.
+ *
+ * @exception_safe: unknown
+ * @thread_safe: compress() is not thread-safe, decompress() is
+ */
+
+#ifndef UPS_COMPRESSOR_ZSTD_H
+#define UPS_COMPRESSOR_ZSTD_H
+
+#ifdef HAVE_ZSTD_H
+
+#include "0root/root.h"
+
+#include <zstd.h>
+#include <zdict.h>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "2compressor/compressor.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct ZstdCompressor {
+  enum {
+    // the compression level
+    kLevel = 3
+  };
+
+  ZstdCompressor()
+    : cctx(0), cdict(0), ddict(0) {
+  }
+
+  ~ZstdCompressor() {
+    clear_dictionary();
+    if (cctx)
+      ::ZSTD_freeCCtx(cctx);
+  }
+
+  uint32_t compressed_length(uint32_t length) {
+    return (uint32_t)::ZSTD_compressBound(length);
+  }
+
+  uint32_t compress(const uint8_t *inp, uint32_t inlength,
+                            uint8_t *outp, uint32_t outlength) {
+    if (!cctx) {
+      cctx = ::ZSTD_createCCtx();
+      if (!cctx)
+        throw Exception(UPS_OUT_OF_MEMORY);
+    }
+
+    size_t clen = cdict
+                    ? ::ZSTD_compress_usingCDict(cctx, outp, outlength,
+                                inp, inlength, cdict)
+                    : ::ZSTD_compressCCtx(cctx, outp, outlength,
+                                inp, inlength, kLevel);
+    if (::ZSTD_isError(clen))
+      throw Exception(UPS_INTERNAL_ERROR);
+    return (uint32_t)clen;
+  }
+
+  // Frames which were compressed before the dictionary was set do not
+  // store a dictionary id, and are decompressed without the dictionary.
+  // Uses a separate context for each call because reads can run
+  // concurrently
+  void decompress(const uint8_t *inp, uint32_t inlength,
+                            uint8_t *outp, uint32_t outlength) {
+    size_t len;
+    if (ddict && ::ZSTD_getDictID_fromFrame(inp, inlength) != 0) {
+      ZSTD_DCtx *dctx = ::ZSTD_createDCtx();
+      if (!dctx)
+        throw Exception(UPS_OUT_OF_MEMORY);
+      len = ::ZSTD_decompress_usingDDict(dctx, outp, outlength,
+                            inp, inlength, ddict);
+      ::ZSTD_freeDCtx(dctx);
+    }
+    else
+      len = ::ZSTD_decompress(outp, outlength, inp, inlength);
+
+    if (::ZSTD_isError(len) || len != outlength)
+      throw Exception(UPS_INTERNAL_ERROR);
+  }
+
+  // Sets the dictionary
+  void set_dictionary(const uint8_t *data, uint32_t size) {
+    clear_dictionary();
+    cdict = ::ZSTD_createCDict(data, size, kLevel);
+    ddict = ::ZSTD_createDDict(data, size);
+    if (!cdict || !ddict) {
+      clear_dictionary();
+      throw Exception(UPS_OUT_OF_MEMORY);
+    }
+  }
+
+  // Trains a dictionary from |count| samples
+  uint32_t train_dictionary(const uint8_t *samples, const size_t *sizes,
+                  uint32_t count, uint8_t *dictionary, uint32_t capacity) {
+    size_t size = ::ZDICT_trainFromBuffer(dictionary, capacity,
+                          samples, sizes, count);
+    if (::ZDICT_isError(size)) {
+      ups_log(("failed to train the dictionary: %s",
+                              ::ZDICT_getErrorName(size)));
+      throw Exception(UPS_INV_PARAMETER);
+    }
+    return (uint32_t)size;
+  }
+
+  // Releases the dictionary
+  void clear_dictionary() {
+    if (cdict)
+      ::ZSTD_freeCDict(cdict);
+    if (ddict)
+      ::ZSTD_freeDDict(ddict);
+    cdict = 0;
+    ddict = 0;
+  }
+
+  // The compression context; reused for all calls
+  ZSTD_CCtx *cctx;
+
+  // The digested dictionary for compression; can be null
+  ZSTD_CDict *cdict;
+
+  // The digested dictionary for decompression; can be null
+  ZSTD_DDict *ddict;
+};
+
+struct ZstdCompressorImpl : public CompressorImpl<ZstdCompressor>
+{
+  // Sets the dictionary for all following calls of compress()
+  virtual void set_dictionary(const uint8_t *data, uint32_t size) {
+    impl.set_dictionary(data, size);
+  }
+
+  // Trains a dictionary of up to |capacity| bytes
+  virtual uint32_t train_dictionary(const uint8_t *samples,
+                  const size_t *sizes, uint32_t count,
+                  uint8_t *dictionary, uint32_t capacity) {
+    return impl.train_dictionary(samples, sizes, count, dictionary,
+                    capacity);
+  }
+};
+
+}; // namespace upscaledb
+
+#endif // HAVE_ZSTD_H
+
+#endif // UPS_COMPRESSOR_ZSTD_H
@@ -34,6 +34,7 @@
 #include <ups/upscaledb.h>
 
 // Always verify that a file of level N does not include headers > N!
+#include "2checksum/checksum.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -51,8 +52,11 @@ struct EnvConfig
       page_size_bytes(UPS_DEFAULT_PAGE_SIZE),
       cache_size_bytes(UPS_DEFAULT_CACHE_SIZE),
       file_size_limit_bytes(std::numeric_limits<size_t>::max()), 
-      remote_timeout_sec(0), journal_compressor(0),
+      remote_timeout_sec(0), journal_compressor(0), page_compressor(0),
       is_encryption_enabled(false), journal_switch_threshold(0),
+      journal_sync_interval_ms(100), merge_backlog_limit(256),
+      checkpoint_interval_bytes(0), checkpoint_interval_ms(0),
+      checksum_algorithm(Checksum::kDefault),
       posix_advice(UPS_POSIX_FADVICE_NORMAL) {
   }
 
@@ -86,6 +90,9 @@ struct EnvConfig
   // the algorithm for journal compression
   int journal_compressor;
 
+  // the algorithm for page compression; stored in the header page
+  int page_compressor;
+
   // true if AES encryption is enabled
   bool is_encryption_enabled;
 
@@ -95,8 +102,32 @@ struct EnvConfig
   // threshold for switching journal files
   size_t journal_switch_threshold;
 
+  // max. delay of deferred commits (in milliseconds)
+  uint32_t journal_sync_interval_ms;
+
+  // max. number of committed transactions waiting for the background merge
+  uint32_t merge_backlog_limit;
+
+  // write a checkpoint if the current journal file exceeds this size
+  uint64_t checkpoint_interval_bytes;
+
+  // write a checkpoint if the current journal file is older than this
+  // interval (in milliseconds)
+  uint32_t checkpoint_interval_ms;
+
+  // the checksum algorithm of pages and blobs (UPS_ENABLE_CRC32); stored
+  // in the header page
+  int checksum_algorithm;
+
   // parameter for posix_fadvise()
   int posix_advice;
+
+  // Returns true if the file must not be memory mapped. Compressed pages
+  // are decompressed when they are fetched, and are never accessed through
+  // the mapping; this is not reported as UPS_DISABLE_MMAP
+  bool is_mmap_disabled() const {
+    return ISSET(flags, UPS_DISABLE_MMAP) || page_compressor != 0;
+  }
 };
 
 } // namespace upscaledb
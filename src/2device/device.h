@@ -43,6 +43,18 @@ namespace upscaledb {
 class Page;
 
 struct Device {
+  // A single buffer for write_batch()
+  struct WriteRequest {
+    // the offset in the file
+    uint64_t offset;
+
+    // the data which is written
+    void *buffer;
+
+    // the size of the data
+    size_t size;
+  };
+
   // Constructor
   Device(const EnvConfig &config)
   : config(config) {
@@ -90,6 +102,26 @@ struct Device {
   // Writes to the device; this function does not use mmap
   virtual void write(uint64_t offset, void *buffer, size_t len) = 0;
 
+  // Returns true if write_batch() submits all buffers at once, instead
+  // of writing them one by one
+  virtual bool supports_batched_writes() const {
+    return false;
+  }
+
+  // Writes multiple buffers to the device, then flushes the device if
+  // |sync| is true
+  virtual void write_batch(WriteRequest *requests, size_t count, bool sync) {
+    for (size_t i = 0; i < count; i++)
+      write(requests[i].offset, requests[i].buffer, requests[i].size);
+    if (sync)
+      flush();
+  }
+
+  // Releases the storage of a range which is no longer used, but keeps
+  // the range allocated (i.e. the tail of a compressed page)
+  virtual void punch_hole(uint64_t offset, size_t len) {
+  }
+
   // Allocate storage from this device; this function
   // will *NOT* use mmap. returns the offset of the allocated storage.
   virtual uint64_t alloc(size_t len) = 0;
@@ -97,6 +129,20 @@ struct Device {
   // Reads a page from the device; this function CAN use mmap
   virtual void read_page(Page *page, uint64_t address) = 0;
 
+  // Returns true if read_page_batch() submits all reads at once, instead
+  // of reading the pages one by one
+  virtual bool supports_batched_reads() const {
+    return false;
+  }
+
+  // Reads multiple pages from the device; like read_page(), this function
+  // CAN use mmap
+  virtual void read_page_batch(Page **pages, const uint64_t *addresses,
+                  size_t count) {
+    for (size_t i = 0; i < count; i++)
+      read_page(pages[i], addresses[i]);
+  }
+
   // Allocate storage for a page from this device; this function
   // can use mmap if available
   virtual void alloc_page(Page *page) = 0;
@@ -29,13 +29,17 @@
 #define UPS_DEVICE_DISK_H
 
 #include <utility>
+#include <vector>
+#include <algorithm>
 
 #include "0root/root.h"
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
 #include "1base/dynamic_array.h"
+#include "1base/scoped_ptr.h"
 #include "1mem/mem.h"
+#include "1mem/buffer_pool.h"
 #include "1os/file.h"
 #ifdef UPS_ENABLE_ENCRYPTION
 #  include "2aes/aes.h"
@@ -53,6 +57,29 @@ namespace upscaledb {
  * a File-based device
  */
 class DiskDevice : public Device {
+    enum {
+      // The mapping is extended if the file grew by at least this many
+      // bytes (or by 1/8th of the mapped size, whatever is larger)
+      kMinMappingGrowth = 1024 * 1024,
+
+      // The maximum number of unused page buffers which are kept for reuse
+      // if direct I/O is enabled
+      kMaxUnusedPageBuffers = 64
+    };
+
+    // A memory mapped region of the file which was added after the file
+    // was opened
+    struct Mapping {
+      // the offset of this region in the file
+      uint64_t offset;
+
+      // the size of this region
+      uint64_t size;
+
+      // pointer to the mapped data
+      uint8_t *ptr;
+    };
+
     struct State {
       State() = default;
       State(const State&) = delete;
@@ -69,6 +96,17 @@ class DiskDevice : public Device {
       // the size of mmapptr as used in mmap
       uint64_t mapped_size;
 
+      // the regions which were mapped when the file grew; they are
+      // adjacent in the file, but not in memory. Their pages are only
+      // returned by read_page(), but not by mapped_pointer()
+      std::vector<Mapping> grown_mappings;
+
+      // the end of the last mapped region; 0 if the file cannot be mapped
+      uint64_t mapped_end;
+
+      // true if the mapping can be extended when the file grows
+      bool can_grow;
+
       // the (cached) size of the file
       uint64_t file_size;
 
@@ -88,6 +126,8 @@ class DiskDevice : public Device {
       State state;
       state.mmapptr = 0;
       state.mapped_size = 0;
+      state.mapped_end = 0;
+      state.can_grow = false;
       state.file_size = 0;
       state.excess_at_end = 0;
       swap(m_state, state);
@@ -100,7 +140,11 @@ class DiskDevice : public Device {
       File file;
       file.create(config.filename.c_str(), config.file_mode);
       file.set_posix_advice(config.posix_advice);
+      if (ISSET(config.flags, UPS_ENABLE_DIRECT_IO))
+        file.enable_direct_io();
       m_state.file = std::move(file);
+      // direct I/O bypasses the page cache, which backs the mapping
+      m_state.can_grow = can_grow_mapping() && !m_state.file.is_direct_io();
     }
 
     // opens an existing device
@@ -114,11 +158,15 @@ class DiskDevice : public Device {
       State state = std::move(m_state);
       state.file.open(config.filename.c_str(), read_only);
       state.file.set_posix_advice(config.posix_advice);
+      if (ISSET(config.flags, UPS_ENABLE_DIRECT_IO))
+        state.file.enable_direct_io();
 
       // the file size which backs the mapped ptr
       state.file_size = state.file.file_size();
+      state.can_grow = can_grow_mapping() && !state.file.is_direct_io();
 
-      if (ISSET(config.flags, UPS_DISABLE_MMAP)) {
+      // direct I/O bypasses the page cache, which backs the mapping
+      if (config.is_mmap_disabled() || state.file.is_direct_io()) {
         swap(m_state, state);
         return;
       }
@@ -135,10 +183,13 @@ class DiskDevice : public Device {
       state.mapped_size = state.file_size;
       try {
         state.file.mmap(0, state.mapped_size, read_only, &state.mmapptr);
+        state.mapped_end = state.mapped_size;
       }
       catch (Exception &ex) {
         ups_log(("mmap failed with error %d, falling back to read/write",
                     ex.code));
+        state.mapped_size = 0;
+        state.can_grow = false;
       }
       swap(m_state, state);
     }
@@ -155,6 +206,13 @@ class DiskDevice : public Device {
       State state = std::move(m_state);
       if (state.mmapptr)
         state.file.munmap(state.mmapptr, state.mapped_size);
+      for (std::vector<Mapping>::iterator it = state.grown_mappings.begin();
+                      it != state.grown_mappings.end(); it++)
+        state.file.munmap(it->ptr, it->size);
+      state.grown_mappings.clear();
+      state.mmapptr = 0;
+      state.mapped_size = 0;
+      state.mapped_end = 0;
       state.file.close();
 
       swap(m_state, state);
@@ -191,9 +249,10 @@ class DiskDevice : public Device {
       return m_state.file.tell();
     }
 
-    // reads from the device; this function does NOT use mmap
+    // reads from the device; this function does NOT use mmap. Positional
+    // I/O does not require the lock, therefore concurrent reads of
+    // different pages run in parallel
     virtual void read(uint64_t offset, void *buffer, size_t len) {
-      ScopedSpinlock lock(m_mutex);
       m_state.file.pread(offset, buffer, len);
 #ifdef UPS_ENABLE_ENCRYPTION
       if (config.is_encryption_enabled) {
@@ -205,9 +264,8 @@ class DiskDevice : public Device {
 
     // writes to the device; this function does not use mmap,
     // and is responsible for writing the data is run through the file
-    // filters
+    // filters. Like read(), this does not require the lock
     virtual void write(uint64_t offset, void *buffer, size_t len) {
-      ScopedSpinlock lock(m_mutex);
 #ifdef UPS_ENABLE_ENCRYPTION
       if (config.is_encryption_enabled) {
         // encryption disables direct I/O -> only full pages are allowed
@@ -223,6 +281,11 @@ class DiskDevice : public Device {
       m_state.file.pwrite(offset, buffer, len);
     }
 
+    // releases the storage of an unused range of the file
+    virtual void punch_hole(uint64_t offset, size_t len) {
+      m_state.file.punch_hole(offset, len);
+    }
+
     // allocate storage from this device; this function
     // will *NOT* return mmapped memory
     virtual uint64_t alloc(size_t requested_length) {
@@ -268,34 +331,19 @@ class DiskDevice : public Device {
     // reads a page from the device; this function CAN return a
 	// pointer to mmapped memory
     virtual void read_page(Page *page, uint64_t address) {
-      ScopedSpinlock lock(m_mutex);
       // if this page is in the mapped area: return a pointer into that area.
       // otherwise fall back to read/write.
-      if (address < m_state.mapped_size && m_state.mmapptr != 0) {
-        // the following line will not throw a C++ exception, but can
-        // raise a signal. If that's the case then we don't catch it because
-        // something is seriously wrong and proper recovery is not possible.
-        page->assign_mapped_buffer(&m_state.mmapptr[address], address);
+      if (assign_mapped_page(page, address))
         return;
-      }
 
-      // this page is not in the mapped area; allocate a buffer
-      if (page->data() == 0) {
-        // note that |p| will not leak if file.pread() throws; |p| is stored
-        // in the |page| object and will be cleaned up by the caller in
-        // case of an exception.
-        uint8_t *p = Memory::allocate<uint8_t>(config.page_size_bytes);
-        page->assign_allocated_buffer(p, address);
-      }
+      // this page is not in the mapped area; allocate a buffer.
+      // note that the buffer will not leak if file.pread() throws; it is
+      // stored in the |page| object and will be cleaned up by the caller in
+      // case of an exception.
+      if (page->data() == 0)
+        allocate_page_buffer(page, address);
 
-      m_state.file.pread(address, page->data(), config.page_size_bytes);
-#ifdef UPS_ENABLE_ENCRYPTION
-      if (config.is_encryption_enabled) {
-        AesCipher aes(config.encryption_key, page->address());
-        aes.decrypt((uint8_t *)page->data(), (uint8_t *)page->data(),
-                config.page_size_bytes);
-      }
-#endif
+      read(address, page->data(), config.page_size_bytes);
     }
 
     // Allocates storage for a page from this device; this function
@@ -305,13 +353,11 @@ class DiskDevice : public Device {
       page->set_address(address);
 
       // allocate a memory buffer
-      uint8_t *p = Memory::allocate<uint8_t>(config.page_size_bytes);
-      page->assign_allocated_buffer(p, address);
+      allocate_page_buffer(page, address);
     }
 
     // Frees a page on the device; plays counterpoint to |alloc_page|
     virtual void free_page(Page *page) {
-      ScopedSpinlock lock(m_mutex);
       assert(page->data() != 0);
       page->free_buffer();
     }
@@ -335,19 +381,172 @@ class DiskDevice : public Device {
       return &m_state.mmapptr[address];
     }
 
+  protected:
+    // Returns the database file
+    File &file() {
+      return m_state.file;
+    }
+
+    // Assigns a pointer into the mapped area to |page|. Returns false if
+    // the page at |address| is not mapped
+    bool assign_mapped_page(Page *page, uint64_t address) {
+      if (address < m_state.mapped_size && m_state.mmapptr != 0) {
+        // the following line will not throw a C++ exception, but can
+        // raise a signal. If that's the case then we don't catch it because
+        // something is seriously wrong and proper recovery is not possible.
+        page->assign_mapped_buffer(&m_state.mmapptr[address], address);
+        return true;
+      }
+
+      // the page might be in a region which was mapped when the file grew.
+      // Only the lookup of the mapping is synchronized; the actual I/O is
+      // performed without holding the lock
+      uint8_t *ptr;
+      {
+        ScopedSpinlock lock(m_mutex);
+        ptr = grown_mapped_pointer(address);
+      }
+      if (ptr) {
+        page->assign_mapped_buffer(ptr, address);
+        return true;
+      }
+      return false;
+    }
+
+    // Allocates the buffer of a page which is not mapped. With direct I/O,
+    // the buffers are aligned and recycled by a BufferPool; the pool is
+    // created when the first page is allocated, after the page size of an
+    // existing file was read from its header
+    void allocate_page_buffer(Page *page, uint64_t address) {
+      if (!m_state.file.is_direct_io()) {
+        uint8_t *p = Memory::allocate<uint8_t>(config.page_size_bytes);
+        page->assign_allocated_buffer(p, address);
+        return;
+      }
+
+      BufferPool *pool;
+      {
+        ScopedSpinlock lock(m_mutex);
+        if (!m_page_buffers.get())
+          m_page_buffers.reset(new BufferPool(config.page_size_bytes,
+                                  File::kDirectIoAlignment,
+                                  kMaxUnusedPageBuffers));
+        pool = m_page_buffers.get();
+      }
+      assert(pool->buffer_size == config.page_size_bytes);
+      page->assign_allocated_buffer(pool->allocate(), address, pool);
+    }
+
   private:
+    // Returns true if the mapping can be extended when the file grows.
+    // Not supported on Win32, which uses one mapping handle per file
+    bool can_grow_mapping() const {
+#ifdef WIN32
+      return false;
+#else
+      return !config.is_mmap_disabled()
+              && NOTSET(config.flags, UPS_READ_ONLY);
+#endif
+    }
+
+    // Returns a pointer to the page at |address| in one of the regions
+    // which were mapped after the file was opened. If the address is not
+    // yet mapped, and the file grew sufficiently, then the mapping is
+    // extended till the end of the file. Returns null if the page is not
+    // mapped.
+    uint8_t *grown_mapped_pointer(uint64_t address) {
+      if (!m_state.can_grow || config.is_mmap_disabled())
+        return 0;
+
+      for (std::vector<Mapping>::iterator it = m_state.grown_mappings.begin();
+                      it != m_state.grown_mappings.end(); it++) {
+        if (address >= it->offset && address < it->offset + it->size)
+          return &it->ptr[address - it->offset];
+      }
+
+      // Pages must not straddle two regions, therefore the regions are
+      // aligned to the page size and to the granularity of the OS
+      uint64_t alignment = std::max<uint64_t>(File::granularity(),
+                              config.page_size_bytes);
+      uint64_t end = m_state.file_size - (m_state.file_size % alignment);
+      if (address < m_state.mapped_end
+            || address + config.page_size_bytes > end
+            || m_state.mapped_end % alignment != 0
+            || end - m_state.mapped_end
+                  < std::max<uint64_t>(kMinMappingGrowth,
+                                  m_state.mapped_end / 8))
+        return 0;
+
+      Mapping mapping;
+      mapping.offset = m_state.mapped_end;
+      mapping.size = end - m_state.mapped_end;
+      try {
+        m_state.file.mmap(mapping.offset, mapping.size, false, &mapping.ptr);
+      }
+      catch (Exception &ex) {
+        ups_log(("mmap failed with error %d, falling back to read/write",
+                    ex.code));
+        m_state.can_grow = false;
+        return 0;
+      }
+      m_state.grown_mappings.push_back(mapping);
+      m_state.mapped_end = end;
+      return &mapping.ptr[address - mapping.offset];
+    }
+
+    // Unmaps the grown regions beyond |new_file_size|. Otherwise private
+    // (modified) copies of their pages would be returned if the file grows
+    // again. The caller makes sure that these pages are no longer in use.
+    void shrink_grown_mappings(uint64_t new_file_size) {
+      uint64_t alignment = std::max<uint64_t>(File::granularity(),
+                              config.page_size_bytes);
+      uint64_t end = new_file_size;
+      if (end % alignment)
+        end += alignment - (end % alignment);
+      if (end >= m_state.mapped_end)
+        return;
+
+      while (!m_state.grown_mappings.empty()) {
+        Mapping &mapping = m_state.grown_mappings.back();
+        if (mapping.offset + mapping.size <= end)
+          break;
+        if (mapping.offset >= end) {
+          m_state.file.munmap(mapping.ptr, mapping.size);
+          m_state.grown_mappings.pop_back();
+          continue;
+        }
+        uint64_t offset = end - mapping.offset;
+        m_state.file.munmap(&mapping.ptr[offset], mapping.size - offset);
+        mapping.size = offset;
+        break;
+      }
+
+      m_state.mapped_end = m_state.grown_mappings.empty()
+                              ? m_state.mapped_size
+                              : m_state.grown_mappings.back().offset
+                                  + m_state.grown_mappings.back().size;
+    }
+
     // truncate/resize the device, sans locking
     void truncate_nolock(uint64_t new_file_size) {
       if (new_file_size > config.file_size_limit_bytes)
         throw Exception(UPS_LIMITS_REACHED);
+      if (new_file_size < m_state.file_size)
+        shrink_grown_mappings(new_file_size);
       m_state.file.truncate(new_file_size);
       m_state.file_size = new_file_size;
     }
 
-    // For synchronizing access
+    // For synchronizing access to the file size, the allocator and the
+    // mappings; not held during pread/pwrite
     Spinlock m_mutex;
 
     State m_state;
+
+    // The aligned page buffers if direct I/O is enabled; declared after
+    // |m_state| because the pages are released before the device is
+    // destroyed
+    ScopedPtr<BufferPool> m_page_buffers;
 };
 
 } // namespace upscaledb
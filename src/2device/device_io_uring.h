@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Device-implementation for disk-based files which performs its I/O with
+ * io_uring (see UPS_ENABLE_IO_URING). The dirty pages of a Changeset are
+ * submitted as a single batch, followed by the fsync. Pages which are
+ * prefetched (see PageManager::prefetch) are also read with a single batch.
+ *
+ * Each thread acquires its own submission queue from a pool, therefore
+ * concurrent cache misses have multiple outstanding reads. If io_uring is
+ * not available (or if the pool is exhausted) then the DiskDevice's
+ * pread/pwrite code path is used.
+ *
+ * @exception_safe: basic/strong
+ * @thread_safe: yes
+ */
+
+#ifndef UPS_DEVICE_IO_URING_H
+#define UPS_DEVICE_IO_URING_H
+
+#include <vector>
+
+#include "0root/root.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/spinlock.h"
+#include "1os/io_uring.h"
+#include "2device/device_disk.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+class IoUringDevice : public DiskDevice {
+    enum {
+      // The number of slots of each submission queue
+      kQueueSize = 64,
+
+      // The maximum number of submission queues
+      kMaxQueues = 16
+    };
+
+  public:
+    IoUringDevice(const EnvConfig &config)
+      : DiskDevice(config), m_is_available(false), m_num_queues(0) {
+    }
+
+    ~IoUringDevice() {
+      close_queues();
+    }
+
+    // Create a new device
+    virtual void create() {
+      DiskDevice::create();
+      open_queues();
+    }
+
+    // opens an existing device
+    virtual void open() {
+      DiskDevice::open();
+      open_queues();
+    }
+
+    // closes the device
+    virtual void close() {
+      close_queues();
+      DiskDevice::close();
+    }
+
+    // reads from the device
+    virtual void read(uint64_t offset, void *buffer, size_t len) {
+      IoUring::Request request = {offset, buffer, len};
+      read_requests(&request, 1);
+    }
+
+    // Returns true if io_uring is available
+    virtual bool supports_batched_reads() const {
+      return m_is_available;
+    }
+
+    // Reads all pages which are not mapped with a single system call
+    virtual void read_page_batch(Page **pages, const uint64_t *addresses,
+                    size_t count) {
+      std::vector<IoUring::Request> list;
+      list.reserve(count);
+      for (size_t i = 0; i < count; i++) {
+        if (assign_mapped_page(pages[i], addresses[i]))
+          continue;
+        if (pages[i]->data() == 0)
+          allocate_page_buffer(pages[i], addresses[i]);
+        IoUring::Request request = {addresses[i], pages[i]->data(),
+                                    config.page_size_bytes};
+        list.push_back(request);
+      }
+
+      if (!list.empty())
+        read_requests(list.data(), list.size());
+    }
+
+    // Returns true if io_uring is available
+    virtual bool supports_batched_writes() const {
+      return m_is_available;
+    }
+
+    // Submits all buffers with a single system call; the fsync is executed
+    // by the kernel after all writes are completed
+    virtual void write_batch(WriteRequest *requests, size_t count,
+                    bool sync) {
+      bool is_aligned = true;
+      for (size_t i = 0; i < count && is_aligned; i++)
+        is_aligned = !requires_bounce_buffer(requests[i].offset,
+                                requests[i].buffer, requests[i].size);
+
+      IoUring *queue = is_aligned ? acquire_queue() : 0;
+      if (!queue) {
+        DiskDevice::write_batch(requests, count, sync);
+        return;
+      }
+
+      std::vector<IoUring::Request> list(count);
+      for (size_t i = 0; i < count; i++) {
+        list[i].offset = requests[i].offset;
+        list[i].buffer = requests[i].buffer;
+        list[i].size = requests[i].size;
+      }
+
+      // with direct I/O: do not overlap with an unaligned write of the File
+      ScopedReadLock lock(file().direct_io_mutex(), boost::defer_lock);
+      if (file().is_direct_io())
+        lock.lock();
+
+      try {
+        queue->write(file().fd(), list.data(), count, sync);
+      }
+      catch (Exception &) {
+        release_queue(queue);
+        throw;
+      }
+      release_queue(queue);
+    }
+
+  private:
+    // Reads all |requests| with a single system call, or with pread if
+    // io_uring cannot be used
+    void read_requests(IoUring::Request *requests, size_t count) {
+      bool is_aligned = true;
+      for (size_t i = 0; i < count && is_aligned; i++)
+        is_aligned = !requires_bounce_buffer(requests[i].offset,
+                                requests[i].buffer, requests[i].size);
+
+      IoUring *queue = is_aligned ? acquire_queue() : 0;
+      if (!queue) {
+        for (size_t i = 0; i < count; i++)
+          DiskDevice::read(requests[i].offset, requests[i].buffer,
+                          requests[i].size);
+        return;
+      }
+
+      try {
+        queue->read(file().fd(), requests, count);
+      }
+      catch (Exception &) {
+        release_queue(queue);
+        throw;
+      }
+      release_queue(queue);
+    }
+
+    // Returns true if the file uses direct I/O, and the request is not
+    // aligned; such requests are performed by the File with a bounce buffer
+    bool requires_bounce_buffer(uint64_t offset, const void *buffer,
+                    size_t len) {
+      return file().is_direct_io() && !File::is_aligned(offset, buffer, len);
+    }
+
+    // Sets up the first submission queue; if this fails then io_uring is
+    // not available, and all I/O is performed with pread/pwrite.
+    // Encrypted files also use pread/pwrite
+    void open_queues() {
+      close_queues();
+
+      ScopedSpinlock lock(m_queue_mutex);
+      m_is_available = false;
+#ifdef UPS_ENABLE_ENCRYPTION
+      if (config.is_encryption_enabled)
+        return;
+#endif
+
+      IoUring *queue = new IoUring;
+      if (!queue->open(kQueueSize)) {
+        ups_log(("io_uring is not available, falling back to read/write"));
+        delete queue;
+        return;
+      }
+      m_free_queues.push_back(queue);
+      m_num_queues = 1;
+      m_is_available = true;
+    }
+
+    // Closes all queues; they must not be in use
+    void close_queues() {
+      ScopedSpinlock lock(m_queue_mutex);
+      assert(m_free_queues.size() == m_num_queues);
+      for (std::vector<IoUring *>::iterator it = m_free_queues.begin();
+                      it != m_free_queues.end(); it++)
+        delete *it;
+      m_free_queues.clear();
+      m_num_queues = 0;
+      m_is_available = false;
+    }
+
+    // Returns an unused submission queue, or null if the caller has to
+    // fall back to pread/pwrite
+    IoUring *acquire_queue() {
+      if (!m_is_available)
+        return 0;
+
+      {
+        ScopedSpinlock lock(m_queue_mutex);
+        if (!m_free_queues.empty()) {
+          IoUring *queue = m_free_queues.back();
+          m_free_queues.pop_back();
+          return queue;
+        }
+        if (m_num_queues >= kMaxQueues)
+          return 0;
+        m_num_queues++;
+      }
+
+      // all queues are in use; create a new one
+      IoUring *queue = new IoUring;
+      if (!queue->open(kQueueSize)) {
+        delete queue;
+        ScopedSpinlock lock(m_queue_mutex);
+        m_num_queues--;
+        return 0;
+      }
+      return queue;
+    }
+
+    // Returns a submission queue to the pool
+    void release_queue(IoUring *queue) {
+      ScopedSpinlock lock(m_queue_mutex);
+      m_free_queues.push_back(queue);
+    }
+
+    // Protects the pool of submission queues
+    Spinlock m_queue_mutex;
+
+    // true if io_uring is available
+    bool m_is_available;
+
+    // The number of submission queues, including those in use
+    size_t m_num_queues;
+
+    // The unused submission queues
+    std::vector<IoUring *> m_free_queues;
+};
+
+} // namespace upscaledb
+
+#endif /* UPS_DEVICE_IO_URING_H */
@@ -19,20 +19,64 @@
 #include "0root/root.h"
 
 #include <string.h>
-#include "3rdparty/murmurhash3/MurmurHash3.h"
+#include <utility>
 
 #include "1base/error.h"
+#include "1base/scoped_ptr.h"
 #include "1os/os.h"
+#include "2checksum/checksum.h"
+#include "2compressor/compressor_factory.h"
 #include "2page/page.h"
 #include "2device/device.h"
 #include "3btree/btree_node_proxy.h"
 
 namespace upscaledb {
 
+#include "1base/packstart.h"
+
+/*
+ * The header of a compressed page (UPS_PARAM_PAGE_COMPRESSION); followed
+ * by the compressed data. The rest of the page's slot in the file is not
+ * used and released with File::punch_hole()
+ *
+ * The |flags| overlap PPageHeader::flags; they store the page's flags
+ * and kCompressedPageFlag. Only pages with a persistent header are
+ * compressed, because the payload of a headerless page (i.e. a blob
+ * continuation page) is user data and cannot carry the flag.
+ */
+typedef UPS_PACK_0 struct UPS_PACK_1 PCompressedPageHeader {
+  // the page's flags, or'ed with kCompressedPageFlag
+  uint32_t flags;
+
+  // size of the compressed data
+  uint32_t compressed_size;
+
+  // crc32c of the compressed data
+  uint32_t crc32;
+
+  // reserved
+  uint32_t _reserved1;
+
+} UPS_PACK_2 PCompressedPageHeader;
+
+#include "1base/packstop.h"
+
+enum {
+  // set in PCompressedPageHeader::flags if the page is compressed; does
+  // not collide with the Page::kType* codes
+  kCompressedPageFlag = 0x00000100,
+
+  // compressed pages are padded to this size, and the storage is
+  // released in multiples of this size
+  kCompressedPageAlignment = 4096
+};
+
 uint64_t Page::ms_page_count_flushed = 0;
+uint64_t Page::ms_page_bytes_before_compression = 0;
+uint64_t Page::ms_page_bytes_after_compression = 0;
 
 Page::Page(Device *device, LocalDb *db)
-  : device_(device), db_(db), node_proxy_(0)
+  : cache_flags(0), device_(device), db_(db), node_proxy_(0)
 {
   persisted_data.raw_data = 0;
   persisted_data.is_dirty = false;
@@ -73,27 +117,196 @@ Page::fetch(uint64_t address)
 {
   device_->read_page(this, address);
   set_address(address);
+
+  if (device_->config.page_compressor)
+    decompress();
 }
 
 void
-Page::flush()
+Page::flush(bool allow_compression)
 {
   if (persisted_data.is_dirty) {
-    // update crc32
-    if (ISSET(device_->config.flags, UPS_ENABLE_CRC32)
-        && likely(!persisted_data.is_without_header)) {
-      MurmurHash3_x86_32(persisted_data.raw_data->header.payload,
-                         persisted_data.size - (sizeof(PPageHeader) - 1),
-                         (uint32_t)persisted_data.address,
-                         &persisted_data.raw_data->header.crc32);
+    update_crc32();
+
+    uint32_t len = 0;
+    ByteArray image;
+    if (device_->config.page_compressor && allow_compression) {
+      ScopedPtr<Compressor> compressor(CompressorFactory::create(
+                              device_->config.page_compressor));
+      image.resize(persisted_data.size);
+      len = compress(compressor.get(), image.data());
+    }
+
+    if (len) {
+      device_->write(persisted_data.address, image.data(), len);
+      device_->punch_hole(persisted_data.address + len,
+                      persisted_data.size - len);
     }
-    device_->write(persisted_data.address, persisted_data.raw_data,
+    else
+      device_->write(persisted_data.address, persisted_data.raw_data,
                     persisted_data.size);
     persisted_data.is_dirty = false;
     ms_page_count_flushed++;
   }
 }
 
+void
+Page::flush_all(Device *device, std::vector<Page *> &pages, bool sync)
+{
+  std::vector<Device::WriteRequest> requests;
+  requests.reserve(pages.size());
+
+  // the compressed images are stored in a single buffer, with one slot
+  // of |page_size| bytes for each page
+  ByteArray images;
+  ScopedPtr<Compressor> compressor;
+  if (device->config.page_compressor) {
+    compressor.reset(CompressorFactory::create(
+                            device->config.page_compressor));
+    images.resize(pages.size() * device->page_size());
+  }
+
+  // the unused storage of the compressed pages: offset and length
+  std::vector<std::pair<uint64_t, size_t> > holes;
+
+  for (std::vector<Page *>::iterator it = pages.begin();
+                  it != pages.end(); it++) {
+    Page *page = *it;
+    if (!page->persisted_data.is_dirty)
+      continue;
+    page->update_crc32();
+
+    if (compressor.get()) {
+      uint8_t *image = images.data()
+                          + (it - pages.begin()) * device->page_size();
+      uint32_t len = page->compress(compressor.get(), image);
+      if (len) {
+        Device::WriteRequest request = {page->persisted_data.address,
+                                        image, len};
+        requests.push_back(request);
+        holes.push_back(std::make_pair(page->persisted_data.address + len,
+                                (size_t)(page->persisted_data.size - len)));
+        continue;
+      }
+    }
+
+    Device::WriteRequest request = {page->persisted_data.address,
+                                    page->persisted_data.raw_data,
+                                    page->persisted_data.size};
+    requests.push_back(request);
+  }
+
+  device->write_batch(requests.data(), requests.size(), sync);
+
+  for (std::vector<std::pair<uint64_t, size_t> >::iterator it
+                  = holes.begin(); it != holes.end(); it++)
+    device->punch_hole(it->first, it->second);
+
+  for (std::vector<Page *>::iterator it = pages.begin();
+                  it != pages.end(); it++) {
+    if ((*it)->persisted_data.is_dirty) {
+      (*it)->persisted_data.is_dirty = false;
+      ms_page_count_flushed++;
+    }
+  }
+}
+
+void
+Page::fetch_all(Device *device, std::vector<Page *> &pages,
+                const std::vector<uint64_t> &addresses)
+{
+  assert(pages.size() == addresses.size());
+  device->read_page_batch(pages.data(), addresses.data(), pages.size());
+
+  for (size_t i = 0; i < pages.size(); i++) {
+    pages[i]->set_address(addresses[i]);
+    if (device->config.page_compressor)
+      pages[i]->decompress();
+  }
+}
+
+void
+Page::update_crc32()
+{
+  if (ISSET(device_->config.flags, UPS_ENABLE_CRC32)
+      && likely(!persisted_data.is_without_header)) {
+    persisted_data.raw_data->header.crc32 = Checksum::calculate(
+                       device_->config.checksum_algorithm,
+                       persisted_data.raw_data->header.payload,
+                       persisted_data.size - (sizeof(PPageHeader) - 1),
+                       (uint32_t)persisted_data.address);
+  }
+}
+
+uint32_t
+Page::compress(Compressor *compressor, uint8_t *image)
+{
+  // the header page is read before the compression algorithm is known
+  if (persisted_data.address == 0 || persisted_data.is_without_header)
+    return 0;
+
+  compressor->reserve(sizeof(PCompressedPageHeader));
+  uint32_t clen = compressor->compress((uint8_t *)persisted_data.raw_data,
+                          persisted_data.size);
+  uint32_t len = sizeof(PCompressedPageHeader) + clen;
+  len = (len + kCompressedPageAlignment - 1)
+          & ~(uint32_t)(kCompressedPageAlignment - 1);
+
+  // not worth the effort if the page does not release any storage
+  if (len >= persisted_data.size)
+    return 0;
+
+  PCompressedPageHeader *header = (PCompressedPageHeader *)image;
+  header->flags = persisted_data.raw_data->header.flags | kCompressedPageFlag;
+  header->compressed_size = clen;
+  header->crc32 = Checksum::crc32c(0, compressor->arena.data()
+                          + sizeof(PCompressedPageHeader), clen);
+  header->_reserved1 = 0;
+  ::memcpy(image + sizeof(PCompressedPageHeader),
+                  compressor->arena.data() + sizeof(PCompressedPageHeader),
+                  clen);
+  ::memset(image + sizeof(PCompressedPageHeader) + clen, 0,
+                  len - sizeof(PCompressedPageHeader) - clen);
+
+  ms_page_bytes_before_compression += persisted_data.size;
+  ms_page_bytes_after_compression += len;
+  return len;
+}
+
+void
+Page::decompress()
+{
+  // headerless pages are never compressed, and pages which did not
+  // compress well are stored uncompressed without kCompressedPageFlag
+  if (persisted_data.address == 0 || persisted_data.is_without_header)
+    return;
+
+  PCompressedPageHeader *header
+          = (PCompressedPageHeader *)persisted_data.raw_data;
+  if (NOTSET(header->flags, kCompressedPageFlag))
+    return;
+
+  // a freed page can be fetched with a stale (or foreign) image; it is
+  // overwritten by the caller and therefore not decompressed
+  if (header->compressed_size
+                > persisted_data.size - sizeof(PCompressedPageHeader))
+    return;
+
+  uint8_t *data = (uint8_t *)persisted_data.raw_data
+                          + sizeof(PCompressedPageHeader);
+  if (header->crc32 != Checksum::crc32c(0, data, header->compressed_size))
+    return;
+
+  assert(persisted_data.is_allocated);
+  ByteArray tmp;
+  tmp.copy(data, header->compressed_size);
+
+  ScopedPtr<Compressor> compressor(CompressorFactory::create(
+                          device_->config.page_compressor));
+  compressor->decompress(tmp.data(), (uint32_t)tmp.size(),
+                  persisted_data.size, (uint8_t *)persisted_data.raw_data);
+}
+
 void
 Page::free_buffer()
 {
@@ -21,16 +21,19 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <vector>
 
 #include "1base/error.h"
 #include "1base/spinlock.h"
 #include "1mem/mem.h"
+#include "1mem/buffer_pool.h"
 #include "1base/intrusive_list.h"
 #include "3btree/btree_cursor.h"
 
 namespace upscaledb {
 
 struct Device;
+struct Compressor;
 struct BtreeCursor;
 struct BtreeNodeProxy;
 struct LocalDb;
@@ -84,26 +87,32 @@ class Page {
     struct PersistedData {
       PersistedData()
         : address(0), size(0), is_dirty(false), is_allocated(false),
-          is_without_header(false), raw_data(0) {
+          is_without_header(false), raw_data(0), pool(0) {
       }
 
       PersistedData(const PersistedData &other)
         : address(other.address), size(other.size), is_dirty(other.is_dirty),
           is_allocated(other.is_allocated),
-          is_without_header(other.is_without_header), raw_data(other.raw_data) {
+          is_without_header(other.is_without_header), raw_data(other.raw_data),
+          pool(other.pool) {
       }
 
       ~PersistedData() {
 #ifdef NDEBUG
         mutex.safe_unlock();
 #endif
-        if (is_allocated)
-          Memory::release(raw_data);
+        if (is_allocated) {
+          if (pool)
+            pool->release(raw_data);
+          else
+            Memory::release(raw_data);
+        }
         raw_data = 0;
       }
 
-      // The spinlock is locked if the page is in use or written to disk
-      Spinlock mutex;
+      // The spinlock is locked if the page is in use or written to disk;
+      // read-only operations lock it in shared mode
+      ReadWriteSpinlock mutex;
 
       // address of this page - the absolute offset in the file
       uint64_t address;
@@ -123,6 +132,10 @@ class Page {
 
       // the persistent data of this page
       PPageData *raw_data;
+
+      // the BufferPool which allocated |raw_data|; null if it was allocated
+      // with Memory::allocate()
+      BufferPool *pool;
     };
 
     // Misc. enums
@@ -196,7 +209,7 @@ class Page {
     uint32_t usable_page_size();
 
     // Returns the spinlock
-    Spinlock &mutex() {
+    ReadWriteSpinlock &mutex() {
       return persisted_data.mutex;
     }
 
@@ -301,12 +314,15 @@ class Page {
       persisted_data.is_without_header = is_without_header;
     }
 
-    // Assign a buffer which was allocated with malloc()
-    void assign_allocated_buffer(void *buffer, uint64_t address) {
+    // Assign a buffer which was allocated with malloc(), or (if |pool| is
+    // not null) by a BufferPool
+    void assign_allocated_buffer(void *buffer, uint64_t address,
+                    BufferPool *pool = 0) {
       free_buffer();
       persisted_data.raw_data = (PPageData *)buffer;
       persisted_data.is_allocated = true;
       persisted_data.address = address;
+      persisted_data.pool = pool;
     }
 
     // Assign a buffer from mmapped storage
@@ -315,6 +331,7 @@ class Page {
       persisted_data.raw_data = (PPageData *)buffer;
       persisted_data.is_allocated = false;
       persisted_data.address = address;
+      persisted_data.pool = 0;
     }
 
     // Free resources associated with the buffer
@@ -324,11 +341,24 @@ class Page {
     // |flags|: either 0 or kInitializeWithZeroes
     void alloc(uint32_t type, uint32_t flags = 0);
 
-    // Reads a page from the device
+    // Reads a page from the device; call set_without_header() before
+    // fetching a headerless page, otherwise its payload could be mistaken
+    // for a compressed image
     void fetch(uint64_t address);
 
-    // Flushes the page to disk, clears the "dirty" flag
-    void flush();
+    // Flushes the page to disk, clears the "dirty" flag. The page is
+    // stored uncompressed if |allow_compression| is false
+    void flush(bool allow_compression = true);
+
+    // Flushes multiple pages with a single call to Device::write_batch();
+    // if |sync| is true then the device is flushed afterwards
+    static void flush_all(Device *device, std::vector<Page *> &pages,
+                    bool sync);
+
+    // Reads multiple pages with a single call to Device::read_page_batch();
+    // |pages[i]| is read from |addresses[i]|
+    static void fetch_all(Device *device, std::vector<Page *> &pages,
+                    const std::vector<uint64_t> &addresses);
 
     // Returns the cached BtreeNodeProxy
     BtreeNodeProxy *node_proxy() {
@@ -353,6 +383,12 @@ class Page {
     // tracks number of flushed pages
     static uint64_t ms_page_count_flushed;
 
+    // tracks the size of compressed pages before compression
+    static uint64_t ms_page_bytes_before_compression;
+
+    // tracks the size of compressed pages after compression
+    static uint64_t ms_page_bytes_after_compression;
+
     // the persistent data of this page
     PersistedData persisted_data;
 
@@ -362,7 +398,23 @@ class Page {
     // Intrusive linked btree cursors
     IntrusiveList<BtreeCursor> cursor_list;
 
+    // Bookkeeping of the Cache (i.e. the reference bit); only modified
+    // by the Cache
+    uint8_t cache_flags;
+
   private:
+    // Updates the crc32 checksum before the page is flushed
+    void update_crc32();
+
+    // Compresses the page (UPS_PARAM_PAGE_COMPRESSION) and writes the
+    // padded image to |image|, which has room for a full page. Returns the
+    // length of the image, or 0 if the page is stored uncompressed
+    uint32_t compress(Compressor *compressor, uint8_t *image);
+
+    // Decompresses the page after it was read from disk; does nothing if
+    // the page was stored uncompressed
+    void decompress();
+
     // the Device for allocating storage
     Device *device_;
 
@@ -20,8 +20,19 @@
 /*
  * SIMD search functions.
  *
- * @exception_safe: unknown
- * @thread_safe: unknown
+ * Searches sorted arrays of uint8_t, uint16_t, uint32_t, uint64_t, float
+ * and double (the keys of the PodKeyList). A binary search narrows the
+ * range down to a small window, which is then scanned with vector
+ * comparisons. Since the keys are sorted, the number of keys which are
+ * smaller than the search key is the lower bound.
+ *
+ * The SSE4.2, AVX2 and AVX-512 kernels are compiled with function-specific
+ * target attributes, and selected at runtime (cpuid). Therefore the
+ * library does not require compiler flags like -mavx2, and still runs on
+ * older CPUs. Other compilers and platforms use the scalar code.
+ *
+ * @exception_safe: nothrow
+ * @thread_safe: yes
  */
 
 #ifndef UPS_SIMD_H
@@ -29,27 +40,18 @@
 
 #include "0root/root.h"
 
-#ifdef __SSE__
+#include <algorithm>
 
-#ifdef WIN32
-//#  include <xmmintrin.h>
-//#  include <smmintrin.h>
-#  include <intrin.h>
-#  include <windows.h>
-uint32_t __inline ctz(uint32_t value)
-{
-  DWORD trailing_zero = 0;
-  if (_BitScanForward(&trailing_zero, value))
-    return trailing_zero;
-  return 0;
-}
-#else
+#if (defined(__GNUC__) || defined(__clang__)) \
+      && (defined(__x86_64__) || defined(__i386__))
+#  define UPS_SIMD_DISPATCH 1
+#  define UPS_SIMD_TARGET(isa) __attribute__((target(isa)))
 #  include <x86intrin.h>
-#  define ctz(x) __builtin_ctz(x)
 #endif
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
+#include "1globals/globals.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -57,284 +59,455 @@ uint32_t __inline ctz(uint32_t value)
 
 namespace upscaledb {
 
-template<typename T>
-int
-linear_search(T *data, int start, int count, T key)
-{
-  register uint32_t c = start;
-  uint32_t end = start + count;
+// The instruction sets of the search kernels
+enum SimdLevel {
+  // Plain C++
+  kSimdScalar = 0,
 
-#undef COMPARE
-#define COMPARE(c)      if (key <= data[c]) {                           \
-                          if (key < data[c])                            \
-                            return -1;                                  \
-                          return c;                                     \
-                        }
+  // SSE4.2 (128bit)
+  kSimdSse42 = 1,
 
-  while (c + 8 <= end) {
-    COMPARE(c)
-    COMPARE(c + 1)
-    COMPARE(c + 2)
-    COMPARE(c + 3)
-    COMPARE(c + 4)
-    COMPARE(c + 5)
-    COMPARE(c + 6)
-    COMPARE(c + 7)
-    c += 8;
-  }
+  // AVX2 (256bit)
+  kSimdAvx2 = 2,
 
-  while (c < end) {
-    COMPARE(c)
-    c++;
-  }
+  // AVX-512F and AVX-512BW (512bit)
+  kSimdAvx512 = 3
+};
 
-  /* the new key is > the last key in the page */
-  return -1;
-}
-
-template<typename T>
-inline int
-linear_search_sse(T *data, int start, int count, T key)
+// Returns the best instruction set which is supported by this CPU (and
+// the operating system)
+inline SimdLevel
+simd_detect_level()
 {
-  return linear_search(data, start, count, key);
+#ifdef UPS_SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return kSimdAvx512;
+  if (__builtin_cpu_supports("avx2"))
+    return kSimdAvx2;
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+    return kSimdSse42;
+#endif
+  return kSimdScalar;
 }
 
-template<typename T>
-inline int
-sse_threshold()
+// Returns the instruction set which is used by the search functions; the
+// cpuid is only queried once. Returns kSimdScalar if SIMD was disabled
+// (Globals::ms_is_simd_enabled)
+inline SimdLevel
+simd_level()
 {
-  return 16;
+  static const SimdLevel level = simd_detect_level();
+  return Globals::ms_is_simd_enabled ? level : kSimdScalar;
 }
 
-template<>
+// Returns the size of the window (in keys) which is scanned linearly.
+// Measured with random lookups in sorted arrays of the size of a PAX leaf
+// node (16kb pages): the best window is roughly 256 bytes for SSE4.2,
+// 512 bytes for AVX2 and 1024 bytes for AVX-512, independent of the key
+// type. The scalar loop is fastest with 32 keys.
+template<typename T>
 inline int
-sse_threshold<uint32_t>()
+simd_threshold(SimdLevel level)
 {
-  return 16;
+  switch (level) {
+    case kSimdAvx512:
+      return 1024 / sizeof(T);
+    case kSimdAvx2:
+      return 512 / sizeof(T);
+    case kSimdSse42:
+      return 256 / sizeof(T);
+    default:
+      return 32;
+  }
 }
 
-template<>
+// Returns the number of keys in |data[0..count[| which are smaller than
+// |key|
+template<typename T>
 inline int
-sse_threshold<float>()
+scalar_count_less(const T *data, int count, T key)
 {
-  return 16;
+  int n = 0;
+  for (int i = 0; i < count; i++)
+    n += data[i] < key;
+  return n;
 }
 
-template<>
-inline int
-sse_threshold<uint64_t>()
-{
-  return 4;
-}
+#ifdef UPS_SIMD_DISPATCH
+
+// The SSE4.2 kernels. There are no unsigned comparisons; the sign bit of
+// both operands is flipped, then a signed comparison is used
+struct Sse42Search {
+  UPS_SIMD_TARGET("sse4.2,popcnt")
+  static int count_less(const uint8_t *data, int count, uint8_t key) {
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i k = _mm_xor_si128(_mm_set1_epi8((char)key), bias);
+    int n = 0, i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+      __m128i c = _mm_cmpgt_epi8(k, _mm_xor_si128(v, bias));
+      n += _mm_popcnt_u32(_mm_movemask_epi8(c));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-template<>
-inline int
-sse_threshold<double>()
-{
-  return 4;
-}
+  UPS_SIMD_TARGET("sse4.2,popcnt")
+  static int count_less(const uint16_t *data, int count, uint16_t key) {
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    const __m128i k = _mm_xor_si128(_mm_set1_epi16((short)key), bias);
+    int n = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+      __m128i c = _mm_cmpgt_epi16(k, _mm_xor_si128(v, bias));
+      n += _mm_popcnt_u32(_mm_movemask_epi8(c)) / 2;
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-template<typename T>
-int
-find_simd_sse(size_t node_count, T *data, const ups_key_t *hkey)
-{
-  assert(hkey->size == sizeof(T));
-  T key = *(T *)hkey->data;
+  UPS_SIMD_TARGET("sse4.2,popcnt")
+  static int count_less(const uint32_t *data, int count, uint32_t key) {
+    const __m128i bias = _mm_set1_epi32((int)0x80000000);
+    const __m128i k = _mm_xor_si128(_mm_set1_epi32((int)key), bias);
+    int n = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+      __m128i c = _mm_cmpgt_epi32(k, _mm_xor_si128(v, bias));
+      n += _mm_popcnt_u32(_mm_movemask_ps(_mm_castsi128_ps(c)));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-  // Run a binary search, but fall back to linear search as soon as
-  // the remaining range is too small
-  int threshold = sse_threshold<T>();
-  int i, l = 0, r = (int)node_count;
-  int last = (int)node_count + 1;
+  UPS_SIMD_TARGET("sse4.2,popcnt")
+  static int count_less(const uint64_t *data, int count, uint64_t key) {
+    const __m128i bias = _mm_set1_epi64x((long long)0x8000000000000000ull);
+    const __m128i k = _mm_xor_si128(_mm_set1_epi64x((long long)key), bias);
+    int n = 0, i = 0;
+    for (; i + 2 <= count; i += 2) {
+      __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+      __m128i c = _mm_cmpgt_epi64(k, _mm_xor_si128(v, bias));
+      n += _mm_popcnt_u32(_mm_movemask_pd(_mm_castsi128_pd(c)));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-  /* repeat till we found the key or the remaining range is so small that
-   * we rather perform a linear search (which is faster for small ranges) */
-  while (r - l > threshold) {
-    /* get the median item; if it's identical with the "last" item,
-     * we've found the slot */
-    i = (l + r) / 2;
-
-    if (i == last) {
-      assert(i >= 0);
-      assert(i < (int)node_count);
-      return -1;
+  UPS_SIMD_TARGET("sse4.2,popcnt")
+  static int count_less(const float *data, int count, float key) {
+    const __m128 k = _mm_set1_ps(key);
+    int n = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128 c = _mm_cmplt_ps(_mm_loadu_ps(&data[i]), k);
+      n += _mm_popcnt_u32(_mm_movemask_ps(c));
     }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-    /* found it? */
-    register T d = data[i];
-    /* if the key is < the current item: search "to the left" */
-    if (key < d) {
-      if (r == 0) {
-        assert(i == 0);
-        return -1;
-      }
-      r = i;
+  UPS_SIMD_TARGET("sse4.2,popcnt")
+  static int count_less(const double *data, int count, double key) {
+    const __m128d k = _mm_set1_pd(key);
+    int n = 0, i = 0;
+    for (; i + 2 <= count; i += 2) {
+      __m128d c = _mm_cmplt_pd(_mm_loadu_pd(&data[i]), k);
+      n += _mm_popcnt_u32(_mm_movemask_pd(c));
     }
-    /* if the key is > the current item: search "to the right" */
-    else if (key > d) {
-      last = i;
-      l = i;
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
+};
+
+// The AVX2 kernels; same as above, with 256bit vectors
+struct Avx2Search {
+  UPS_SIMD_TARGET("avx2,popcnt")
+  static int count_less(const uint8_t *data, int count, uint8_t key) {
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi8((char)key), bias);
+    int n = 0, i = 0;
+    for (; i + 32 <= count; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+      __m256i c = _mm256_cmpgt_epi8(k, _mm256_xor_si256(v, bias));
+      n += _mm_popcnt_u32((uint32_t)_mm256_movemask_epi8(c));
     }
-    /* otherwise we found the key */
-    else
-      return i;
+    return n + scalar_count_less(&data[i], count - i, key);
   }
 
-  // still here? then perform a linear search for the remaining range
-  assert(r - l <= threshold);
-  if (r + threshold < (int)node_count)
-    return linear_search_sse(data, l, threshold, key);
-  return linear_search(data, l, r - l, key);
-}
-
-template<>
-inline int
-linear_search_sse<uint16_t>(uint16_t *data, int start, int count, uint16_t key)
-{
-  assert(count == 16);
-  __m128i key8 = _mm_set1_epi16(key);
+  UPS_SIMD_TARGET("avx2,popcnt")
+  static int count_less(const uint16_t *data, int count, uint16_t key) {
+    const __m256i bias = _mm256_set1_epi16((short)0x8000);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi16((short)key), bias);
+    int n = 0, i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+      __m256i c = _mm256_cmpgt_epi16(k, _mm256_xor_si256(v, bias));
+      n += _mm_popcnt_u32((uint32_t)_mm256_movemask_epi8(c)) / 2;
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-  __m128i v1 = _mm_loadu_si128((const __m128i *)&data[start + 0]);
-  __m128i v2 = _mm_loadu_si128((const __m128i *)&data[start + 8]);
+  UPS_SIMD_TARGET("avx2,popcnt")
+  static int count_less(const uint32_t *data, int count, uint32_t key) {
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi32((int)key), bias);
+    int n = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+      __m256i c = _mm256_cmpgt_epi32(k, _mm256_xor_si256(v, bias));
+      n += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(c)));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-  __m128i cmp0 = _mm_cmpeq_epi16(key8, v1);
-  __m128i cmp1 = _mm_cmpeq_epi16(key8, v2);
+  UPS_SIMD_TARGET("avx2,popcnt")
+  static int count_less(const uint64_t *data, int count, uint64_t key) {
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)key),
+                            bias);
+    int n = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+      __m256i c = _mm256_cmpgt_epi64(k, _mm256_xor_si256(v, bias));
+      n += _mm_popcnt_u32(_mm256_movemask_pd(_mm256_castsi256_pd(c)));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-  __m128i pack01 = _mm_packs_epi16(cmp0, cmp1);
+  UPS_SIMD_TARGET("avx2,popcnt")
+  static int count_less(const float *data, int count, float key) {
+    const __m256 k = _mm256_set1_ps(key);
+    int n = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m256 c = _mm256_cmp_ps(_mm256_loadu_ps(&data[i]), k, _CMP_LT_OQ);
+      n += _mm_popcnt_u32(_mm256_movemask_ps(c));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
 
-  int res = _mm_movemask_epi8(pack01);
-  if (res > 0)
-    return start + ctz(~res + 1);
+  UPS_SIMD_TARGET("avx2,popcnt")
+  static int count_less(const double *data, int count, double key) {
+    const __m256d k = _mm256_set1_pd(key);
+    int n = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m256d c = _mm256_cmp_pd(_mm256_loadu_pd(&data[i]), k, _CMP_LT_OQ);
+      n += _mm_popcnt_u32(_mm256_movemask_pd(c));
+    }
+    return n + scalar_count_less(&data[i], count - i, key);
+  }
+};
+
+// The AVX-512 kernels. AVX-512 has unsigned comparisons, and the
+// remaining keys are processed with a masked load instead of scalar code
+struct Avx512Search {
+  UPS_SIMD_TARGET("avx512f,avx512bw,popcnt")
+  static int count_less(const uint8_t *data, int count, uint8_t key) {
+    const __m512i k = _mm512_set1_epi8((char)key);
+    int n = 0, i = 0;
+    for (; i + 64 <= count; i += 64) {
+      __m512i v = _mm512_loadu_si512(&data[i]);
+      n += (int)_mm_popcnt_u64(_mm512_cmplt_epu8_mask(v, k));
+    }
+    if (i < count) {
+      __mmask64 m = _cvtu64_mask64((1ull << (count - i)) - 1);
+      __m512i v = _mm512_maskz_loadu_epi8(m, &data[i]);
+      n += (int)_mm_popcnt_u64(_mm512_mask_cmplt_epu8_mask(m, v, k));
+    }
+    return n;
+  }
 
-  assert(16 == count);
-  /* the new key is > the last key in the page */
-  return -1;
-}
+  UPS_SIMD_TARGET("avx512f,avx512bw,popcnt")
+  static int count_less(const uint16_t *data, int count, uint16_t key) {
+    const __m512i k = _mm512_set1_epi16((short)key);
+    int n = 0, i = 0;
+    for (; i + 32 <= count; i += 32) {
+      __m512i v = _mm512_loadu_si512(&data[i]);
+      n += _mm_popcnt_u32(_mm512_cmplt_epu16_mask(v, k));
+    }
+    if (i < count) {
+      __mmask32 m = _cvtu32_mask32((1u << (count - i)) - 1);
+      __m512i v = _mm512_maskz_loadu_epi16(m, &data[i]);
+      n += _mm_popcnt_u32(_mm512_mask_cmplt_epu16_mask(m, v, k));
+    }
+    return n;
+  }
 
-template<>
-inline int
-linear_search_sse<uint32_t>(uint32_t *data, int start, int count, uint32_t key)
-{
-  assert(count == 16);
-  __m128i key4 = _mm_set1_epi32(key);
+  UPS_SIMD_TARGET("avx512f,avx512bw,popcnt")
+  static int count_less(const uint32_t *data, int count, uint32_t key) {
+    const __m512i k = _mm512_set1_epi32((int)key);
+    int n = 0, i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m512i v = _mm512_loadu_si512(&data[i]);
+      n += _mm_popcnt_u32(_mm512_cmplt_epu32_mask(v, k));
+    }
+    if (i < count) {
+      __mmask16 m = (__mmask16)((1u << (count - i)) - 1);
+      __m512i v = _mm512_maskz_loadu_epi32(m, &data[i]);
+      n += _mm_popcnt_u32(_mm512_mask_cmplt_epu32_mask(m, v, k));
+    }
+    return n;
+  }
 
-  __m128i v1 = _mm_loadu_si128((const __m128i *)&data[start + 0]);
-  __m128i v2 = _mm_loadu_si128((const __m128i *)&data[start + 4]);
-  __m128i v3 = _mm_loadu_si128((const __m128i *)&data[start + 8]);
-  __m128i v4 = _mm_loadu_si128((const __m128i *)&data[start + 12]);
+  UPS_SIMD_TARGET("avx512f,avx512bw,popcnt")
+  static int count_less(const uint64_t *data, int count, uint64_t key) {
+    const __m512i k = _mm512_set1_epi64((long long)key);
+    int n = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m512i v = _mm512_loadu_si512(&data[i]);
+      n += _mm_popcnt_u32(_mm512_cmplt_epu64_mask(v, k));
+    }
+    if (i < count) {
+      __mmask8 m = (__mmask8)((1u << (count - i)) - 1);
+      __m512i v = _mm512_maskz_loadu_epi64(m, &data[i]);
+      n += _mm_popcnt_u32(_mm512_mask_cmplt_epu64_mask(m, v, k));
+    }
+    return n;
+  }
 
-  __m128i cmp0 = _mm_cmpeq_epi32(key4, v1);
-  __m128i cmp1 = _mm_cmpeq_epi32(key4, v2);
-  __m128i cmp2 = _mm_cmpeq_epi32(key4, v3);
-  __m128i cmp3 = _mm_cmpeq_epi32(key4, v4);
+  UPS_SIMD_TARGET("avx512f,avx512bw,popcnt")
+  static int count_less(const float *data, int count, float key) {
+    const __m512 k = _mm512_set1_ps(key);
+    int n = 0, i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m512 v = _mm512_loadu_ps(&data[i]);
+      n += _mm_popcnt_u32(_mm512_cmp_ps_mask(v, k, _CMP_LT_OQ));
+    }
+    if (i < count) {
+      __mmask16 m = (__mmask16)((1u << (count - i)) - 1);
+      __m512 v = _mm512_maskz_loadu_ps(m, &data[i]);
+      n += _mm_popcnt_u32(_mm512_mask_cmp_ps_mask(m, v, k, _CMP_LT_OQ));
+    }
+    return n;
+  }
 
-  __m128i pack01 = _mm_packs_epi32(cmp0, cmp1);
-  __m128i pack23 = _mm_packs_epi32(cmp2, cmp3);
-  __m128i pack0123 = _mm_packs_epi16(pack01, pack23);
+  UPS_SIMD_TARGET("avx512f,avx512bw,popcnt")
+  static int count_less(const double *data, int count, double key) {
+    const __m512d k = _mm512_set1_pd(key);
+    int n = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m512d v = _mm512_loadu_pd(&data[i]);
+      n += _mm_popcnt_u32(_mm512_cmp_pd_mask(v, k, _CMP_LT_OQ));
+    }
+    if (i < count) {
+      __mmask8 m = (__mmask8)((1u << (count - i)) - 1);
+      __m512d v = _mm512_maskz_loadu_pd(m, &data[i]);
+      n += _mm_popcnt_u32(_mm512_mask_cmp_pd_mask(m, v, k, _CMP_LT_OQ));
+    }
+    return n;
+  }
+};
 
-  int res = _mm_movemask_epi8(pack0123);
-  if (res > 0)
-    return start + ctz(~res + 1);
+#endif // UPS_SIMD_DISPATCH
 
-  assert(16 == count);
-  /* the new key is > the last key in the page */
-  return -1;
+// Returns the number of keys in |data[0..count[| which are smaller than
+// |key|, using the kernels of |level|. |level| must be supported by the CPU
+template<typename T>
+inline int
+simd_count_less(SimdLevel level, const T *data, int count, T key)
+{
+#ifdef UPS_SIMD_DISPATCH
+  switch (level) {
+    case kSimdAvx512:
+      return Avx512Search::count_less(data, count, key);
+    case kSimdAvx2:
+      return Avx2Search::count_less(data, count, key);
+    case kSimdSse42:
+      return Sse42Search::count_less(data, count, key);
+    default:
+      break;
+  }
+#endif
+  return scalar_count_less(data, count, key);
 }
 
-template<>
+// Returns the index of the first key in the sorted array |data| which is
+// not smaller than |key| (like std::lower_bound), or |count| if all keys
+// are smaller
+template<typename T>
 inline int
-linear_search_sse<float>(float *data, int start, int count, float key)
+simd_lower_bound(SimdLevel level, const T *data, int count, T key)
 {
-  assert(count == 16);
-  __m128 key4 = _mm_set1_ps(key);
-
-  __m128 v1 = _mm_loadu_ps((const float *)&data[start + 0]);
-  __m128 v2 = _mm_loadu_ps((const float *)&data[start + 4]);
-  __m128 v3 = _mm_loadu_ps((const float *)&data[start + 8]);
-  __m128 v4 = _mm_loadu_ps((const float *)&data[start + 12]);
-
-  __m128 cmp0 = _mm_cmpeq_ps(key4, v1);
-  __m128 cmp1 = _mm_cmpeq_ps(key4, v2);
-  __m128 cmp2 = _mm_cmpeq_ps(key4, v3);
-  __m128 cmp3 = _mm_cmpeq_ps(key4, v4);
-
-  __m128i pack01 = _mm_packs_epi32(_mm_castps_si128(cmp0),
-                          _mm_castps_si128(cmp1));
-  __m128i pack23 = _mm_packs_epi32(_mm_castps_si128(cmp2),
-                          _mm_castps_si128(cmp3));
-  __m128i pack0123 = _mm_packs_epi16(pack01, pack23);
-
-  int res = _mm_movemask_epi8(pack0123);
-  if (res > 0)
-    return start + ctz(~res + 1);
-
-  assert(16 == count);
-  /* the new key is > the last key in the page */
-  return -1;
+  int threshold = simd_threshold<T>(level);
+  int l = 0, r = count;
+
+  // binary search till the remaining range is small enough
+  while (r - l > threshold) {
+    int i = (l + r) / 2;
+    if (data[i] < key)
+      l = i + 1;
+    else
+      r = i;
+  }
+
+  return l + simd_count_less(level, &data[l], r - l, key);
 }
 
-#ifdef __SSE4_1__
-template<>
+// Same as above, with the best instruction set of this CPU
+template<typename T>
 inline int
-linear_search_sse<double>(double *data, int start, int count, double key)
+simd_lower_bound(const T *data, int count, T key)
 {
-  assert(count == 4);
-  __m128d key2 = _mm_set1_pd(key);
-
-  __m128d v1 = _mm_loadu_pd(&data[start + 0]);
-  __m128d v2 = _mm_loadu_pd(&data[start + 2]);
+  return simd_lower_bound(simd_level(), data, count, key);
+}
 
-  __m128d cmp0 = _mm_cmpeq_pd(key2, v1);
-  __m128d cmp1 = _mm_cmpeq_pd(key2, v2);
+// Searches |data[start..start + count[| for |key| and returns its index,
+// or -1 if the key was not found. This is the scalar implementation.
+template<typename T>
+int
+linear_search(T *data, int start, int count, T key)
+{
+  register uint32_t c = start;
+  uint32_t end = start + count;
 
-  __m128i low  = _mm_shuffle_epi32(_mm_castpd_si128(cmp0), 0xD8);
-  __m128i high = _mm_shuffle_epi32(_mm_castpd_si128(cmp1), 0xD8);
-  __m128i pack = _mm_unpacklo_epi64(low, high);
+#undef COMPARE
+#define COMPARE(c)      if (key <= data[c]) {                           \
+                          if (key < data[c])                            \
+                            return -1;                                  \
+                          return c;                                     \
+                        }
 
-  __m128i pack01 = _mm_packs_epi32(pack, _mm_setzero_si128());
-  __m128i pack0123 = _mm_packs_epi16(pack01, _mm_setzero_si128());
+  while (c + 8 <= end) {
+    COMPARE(c)
+    COMPARE(c + 1)
+    COMPARE(c + 2)
+    COMPARE(c + 3)
+    COMPARE(c + 4)
+    COMPARE(c + 5)
+    COMPARE(c + 6)
+    COMPARE(c + 7)
+    c += 8;
+  }
 
-  int res = _mm_movemask_epi8(pack0123);
-  if (res > 0)
-    return start + ctz(~res + 1);
+  while (c < end) {
+    COMPARE(c)
+    c++;
+  }
 
-  assert(4 == count);
   /* the new key is > the last key in the page */
   return -1;
 }
 
-template<>
+// Same as above, with the SIMD kernels
+template<typename T>
 inline int
-linear_search_sse<uint64_t>(uint64_t *data, int start, int count, uint64_t key)
+linear_search_sse(T *data, int start, int count, T key)
 {
-  assert(count == 4);
-  __m128i key2 = _mm_set1_epi64x(key);
-
-  __m128i v1 = _mm_loadu_si128((const __m128i *)&data[start + 0]);
-  __m128i v2 = _mm_loadu_si128((const __m128i *)&data[start + 2]);
-
-  __m128i cmp0 = _mm_cmpeq_epi64(key2, v1);
-  __m128i cmp1 = _mm_cmpeq_epi64(key2, v2);
-
-  __m128i low  = _mm_shuffle_epi32(cmp0, 0xD8);
-  __m128i high = _mm_shuffle_epi32(cmp1, 0xD8);
-  __m128i pack = _mm_unpacklo_epi64(low, high);
-
-  __m128i pack01 = _mm_packs_epi32(pack, _mm_setzero_si128());
-  __m128i pack0123 = _mm_packs_epi16(pack01, _mm_setzero_si128());
+  int i = start + simd_count_less(simd_level(), &data[start], count, key);
+  if (i < start + count && data[i] == key)
+    return i;
+  return -1;
+}
 
-  int res = _mm_movemask_epi8(pack0123);
-  if (res > 0)
-    return start + ctz(~res + 1);
+// Searches the sorted array |data| for an exact match of |hkey|; returns
+// the index of the key or -1 if the key was not found
+template<typename T>
+int
+find_simd_sse(size_t node_count, T *data, const ups_key_t *hkey)
+{
+  assert(hkey->size == sizeof(T));
+  T key = *(T *)hkey->data;
 
-  assert(4 == count);
-  /* the new key is > the last key in the page */
+  int i = simd_lower_bound(data, (int)node_count, key);
+  if (i < (int)node_count && data[i] == key)
+    return i;
   return -1;
 }
-#endif
 
 } // namespace upscaledb
 
-#endif // __SSE__
-
 #endif /* UPS_SIMD_H */
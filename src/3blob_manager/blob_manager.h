@@ -27,6 +27,9 @@
 
 #include "0root/root.h"
 
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include "ups/upscaledb_int.h"
 
 // Always verify that a file of level N does not include headers > N!
@@ -109,11 +112,46 @@ struct BlobManager {
     kDisableCompression = 0x10000000
   };
 
+  enum {
+    // Only every n-th compression and decompression is timed
+    kTimingSampleRate = 64
+  };
+
+  // Times a compression or decompression, if it is sampled. Reading the
+  // clock costs about as much as compressing a small record, therefore
+  // only every kTimingSampleRate-th call of |calls| is timed, and its time
+  // is added kTimingSampleRate times to |usec|
+  struct SampledTimer {
+    SampledTimer(boost::atomic<uint64_t> &calls,
+                    boost::atomic<uint64_t> &usec_)
+      : usec(usec_),
+        sampled(calls.fetch_add(1, boost::memory_order_relaxed)
+                        % kTimingSampleRate == 0) {
+      if (unlikely(sampled))
+        start = boost::posix_time::microsec_clock::universal_time();
+    }
+
+    ~SampledTimer() {
+      if (unlikely(sampled))
+        usec.fetch_add(kTimingSampleRate
+                    * (boost::posix_time::microsec_clock::universal_time()
+                            - start).total_microseconds(),
+                    boost::memory_order_relaxed);
+    }
+
+    boost::atomic<uint64_t> &usec;
+    bool sampled;
+    boost::posix_time::ptime start;
+  };
+
   BlobManager(const EnvConfig *config_, PageManager *page_manager_,
                   Device *device_)
     : config(config_), page_manager(page_manager_), device(device_),
       metric_before_compression(0), metric_after_compression(0),
-      metric_total_allocated(0), metric_total_read(0) {
+      metric_compressions(0), metric_compression_usec(0),
+      metric_decompressed(0), metric_decompressions(0),
+      metric_decompression_usec(0), metric_total_allocated(0),
+      metric_total_read(0) {
   }
 
   virtual ~BlobManager() { }
@@ -159,6 +197,9 @@ struct BlobManager {
     metrics->blob_total_read = metric_total_read;
     metrics->record_bytes_before_compression = metric_before_compression;
     metrics->record_bytes_after_compression = metric_after_compression;
+    metrics->record_compression_usec = metric_compression_usec;
+    metrics->record_bytes_decompressed = metric_decompressed;
+    metrics->record_decompression_usec = metric_decompression_usec;
   }
 
   // The configuration of the Environment
@@ -170,17 +211,36 @@ struct BlobManager {
   // The device - sometimes it's accessed directly
   Device *device;
 
+  // The usage counters are atomic; concurrent readers
+  // (UPS_ENABLE_CONCURRENT_READS) update them without the Environment's
+  // write lock
+
   // Usage tracking - number of bytes before compression
-  uint64_t metric_before_compression;
+  boost::atomic<uint64_t> metric_before_compression;
 
   // Usage tracking - number of bytes after compression
-  uint64_t metric_after_compression;
+  boost::atomic<uint64_t> metric_after_compression;
+
+  // Usage tracking - number of compressed records
+  boost::atomic<uint64_t> metric_compressions;
+
+  // Usage tracking - time spent in the record compressor (sampled)
+  boost::atomic<uint64_t> metric_compression_usec;
+
+  // Usage tracking - number of bytes after decompression
+  boost::atomic<uint64_t> metric_decompressed;
+
+  // Usage tracking - number of decompressed records
+  boost::atomic<uint64_t> metric_decompressions;
+
+  // Usage tracking - time spent in the record decompressor (sampled)
+  boost::atomic<uint64_t> metric_decompression_usec;
 
   // Usage tracking - number of blobs allocated
-  uint64_t metric_total_allocated;
+  boost::atomic<uint64_t> metric_total_allocated;
 
   // Usage tracking - number of blobs read
-  uint64_t metric_total_read;
+  boost::atomic<uint64_t> metric_total_read;
 };
 
 } // namespace upscaledb
@@ -21,11 +21,10 @@
 #include <algorithm>
 #include <vector>
 
-#include "3rdparty/murmurhash3/MurmurHash3.h"
-
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
 #include "1base/dynamic_array.h"
+#include "2checksum/checksum.h"
 #include "2compressor/compressor.h"
 #include "2device/device_disk.h"
 #include "3blob_manager/blob_manager_disk.h"
@@ -198,10 +197,12 @@ read_chunk(DiskBlobManager *dbm, Context *context, Page *page, Page **ppage,
   uint8_t *data;
 
   if (unlikely(!page)) {
+    // a pointer into the mapped file can only be returned if the page
+    // is mapped; otherwise the page is fetched
     uint32_t flags = 0;
     if (fetch_read_only)
       flags |= PageManager::kReadOnly;
-    if (mapped_pointer)
+    if (mapped_pointer && dbm->device->is_mapped(pageid, page_size))
       flags |= PageManager::kOnlyFromCache;
     page = dbm->page_manager->fetch(context, pageid, flags);
     if (ppage)
@@ -216,7 +217,7 @@ read_chunk(DiskBlobManager *dbm, Context *context, Page *page, Page **ppage,
   else
     data = page->raw_payload();
 
-  uint32_t read_start = (uint32_t)(address - page->address());
+  uint32_t read_start = (uint32_t)(address - pageid);
   return &data[read_start];
 }
 
@@ -316,11 +317,16 @@ DiskBlobManager::allocate(Context *context, ups_record_t *record,
   uint32_t original_size = record->size;
 
   // compression enabled? then try to compress the data
-  Compressor *compressor = context->db->record_compressor.get();
-  if (compressor && !(flags & kDisableCompression)) {
+  Compressor *compressor = context->db && NOTSET(flags, kDisableCompression)
+                                ? context->db->record_compressor.get()
+                                : 0;
+  if (compressor) {
     metric_before_compression += record_size;
-    uint32_t len = compressor->compress((uint8_t *)record->data,
-                        record->size);
+    uint32_t len;
+    {
+      SampledTimer timer(metric_compressions, metric_compression_usec);
+      len = compressor->compress((uint8_t *)record->data, record->size);
+    }
     if (len < record->size) {
       record_data = compressor->arena.data();
       record_size = len;
@@ -375,9 +381,9 @@ DiskBlobManager::allocate(Context *context, ups_record_t *record,
     // multi-page blobs store their CRC in the first freelist offset
     if (unlikely(num_pages > 1
             && (config->flags & UPS_ENABLE_CRC32))) {
-      uint32_t crc32 = 0;
-      MurmurHash3_x86_32(record->data, record->size, 0, &crc32);
-      header->freelist[0].offset = crc32;
+      header->freelist[0].offset = Checksum::calculate(
+                      config->checksum_algorithm, record->data,
+                      record->size, 0);
     }
 
     address = page->address() + kPageOverhead;
@@ -462,8 +468,11 @@ DiskBlobManager::read(Context *context, uint64_t blob_id,
       assert(compressor != 0);
 
       // read into temporary buffer; we reuse the compressor's memory arena
-      // for this
-      ByteArray *dest = &compressor->arena;
+      // for this, unless other threads can read concurrently
+      ByteArray tmp;
+      ByteArray *dest = context->changeset.is_shared
+                          ? &tmp
+                          : &compressor->arena;
       dest->resize(blob_header->allocated_size - sizeof(PBlobHeader));
 
       copy_chunk(this, context, page, 0, blob_id + sizeof(PBlobHeader),
@@ -471,6 +480,7 @@ DiskBlobManager::read(Context *context, uint64_t blob_id,
                     blob_header->allocated_size - sizeof(PBlobHeader), true);
 
       // now uncompress into the caller's memory arena
+      SampledTimer timer(metric_decompressions, metric_decompression_usec);
       if (ISSET(record->flags, UPS_RECORD_USER_ALLOC)) {
         compressor->decompress(dest->data(),
                       blob_header->allocated_size - sizeof(PBlobHeader),
@@ -483,6 +493,7 @@ DiskBlobManager::read(Context *context, uint64_t blob_id,
                       blobsize, arena);
         record->data = arena->data();
       }
+      metric_decompressed += blobsize;
     }
     // if the data is uncompressed then allocate storage and read
     // into the allocated buffer
@@ -503,8 +514,8 @@ DiskBlobManager::read(Context *context, uint64_t blob_id,
   if (unlikely(header->num_pages > 1
         && ISSET(config->flags, UPS_ENABLE_CRC32))) {
     uint32_t old_crc32 = header->freelist[0].offset;
-    uint32_t new_crc32;
-    MurmurHash3_x86_32(record->data, record->size, 0, &new_crc32);
+    uint32_t new_crc32 = Checksum::calculate(config->checksum_algorithm,
+                    record->data, record->size, 0);
 
     if (unlikely(old_crc32 != new_crc32)) {
       ups_trace(("crc32 mismatch in page %lu: 0x%lx != 0x%lx",
@@ -588,9 +599,9 @@ DiskBlobManager::overwrite(Context *context, uint64_t old_blobid,
     // multi-page blobs store their CRC in the first freelist offset
     if (unlikely(header->num_pages > 1
             && ISSET(config->flags, UPS_ENABLE_CRC32))) {
-      uint32_t crc32 = 0;
-      MurmurHash3_x86_32(record->data, record->size, 0, &crc32);
-      header->freelist[0].offset = crc32;
+      header->freelist[0].offset = Checksum::calculate(
+                      config->checksum_algorithm, record->data,
+                      record->size, 0);
     }
 
     // the old rid is the new rid
@@ -684,9 +695,9 @@ DiskBlobManager::overwrite_regions(Context *context, uint64_t old_blob_id,
   // multi-page blobs store their CRC in the first freelist offset
   if (unlikely(header->num_pages > 1
           && ISSET(config->flags, UPS_ENABLE_CRC32))) {
-    uint32_t crc32 = 0;
-    MurmurHash3_x86_32(record->data, record->size, 0, &crc32);
-    header->freelist[0].offset = crc32;
+    header->freelist[0].offset = Checksum::calculate(
+                    config->checksum_algorithm, record->data,
+                    record->size, 0);
     page->set_dirty(true);
   }
 
@@ -43,11 +43,16 @@ InMemoryBlobManager::allocate(Context *context, ups_record_t *record,
   uint32_t original_size = record->size;
 
   // compression enabled? then try to compress the data
-  Compressor *compressor = context->db->record_compressor.get();
+  Compressor *compressor = context->db && NOTSET(flags, kDisableCompression)
+                                ? context->db->record_compressor.get()
+                                : 0;
   if (compressor) {
     metric_before_compression += record_size;
-    uint32_t len = compressor->compress((uint8_t *)record->data,
-                        record->size);
+    uint32_t len;
+    {
+      SampledTimer timer(metric_compressions, metric_compression_usec);
+      len = compressor->compress((uint8_t *)record->data, record->size);
+    }
     if (len < record->size) {
       record_data = compressor->arena.data();
       record_size = len;
@@ -99,9 +104,13 @@ InMemoryBlobManager::read(Context *context, uint64_t blobid,
   // caller's memory arena to avoid additional memcpys
   if (ISSET(blob_header->flags, PBlobHeader::kIsCompressed)) {
     Compressor *compressor = context->db->record_compressor.get();
-    compressor->decompress(blob_data,
+    {
+      SampledTimer timer(metric_decompressions, metric_decompression_usec);
+      compressor->decompress(blob_data,
                   blob_header->allocated_size - sizeof(PBlobHeader),
                   blob_size, arena);
+    }
+    metric_decompressed += blob_size;
     record->data = arena->data();
     return;
   }
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * btree bulk loading
+ *
+ * Builds the btree bottom-up from sorted input. The keys are appended to
+ * the right-most leaf; when it is full then the keys beyond the fill factor
+ * are moved to a new leaf, and the separator is appended to the right-most
+ * page of the next level. The internal levels are therefore created on
+ * the fly, and the last page of the top level becomes the new root.
+ *
+ * A page which is complete is never modified again. The complete pages are
+ * written in batches; afterwards they are released and can be purged
+ * from the cache.
+ */
+
+#include "0root/root.h"
+
+#include <string.h>
+#include <vector>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "1base/dynamic_array.h"
+#include "2page/page.h"
+#include "3page_manager/page_manager.h"
+#include "3btree/btree_index.h"
+#include "3btree/btree_stats.h"
+#include "3btree/btree_node_proxy.h"
+#include "3btree/btree_update.h"
+#include "4db/db.h"
+#include "4env/env_local.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct BtreeBulkLoadAction {
+  enum {
+    // number of complete pages which are written at once
+    kWriteBatchSize = 32
+  };
+
+  BtreeBulkLoadAction(BtreeIndex *btree_, Context *context_,
+                  uint32_t fill_factor_)
+    : btree(btree_), context(context_), fill_factor(fill_factor_),
+      env((LocalEnv *)btree_->db()->env) {
+  }
+
+  // This is the entry point for the actual bulk load
+  ups_status_t run(ups_bulk_load_func_t func, void *func_context) {
+    ByteArray last_key_arena;
+    ups_key_t last_key = {0};
+    bool is_first = true;
+    ups_status_t st = 0;
+
+    try {
+      Page *leaf = allocate_page(true);
+      levels.push_back(leaf);
+      first_pages.push_back(leaf->address());
+
+      while (true) {
+        ups_key_t key = {0};
+        ups_record_t record = {0};
+        st = func(func_context, &key, &record);
+        if (st == UPS_KEY_NOT_FOUND) {
+          st = 0;
+          break;
+        }
+        if (st)
+          break;
+
+        if (unlikely(!is_first && btree->compare_keys(&key, &last_key) <= 0)) {
+          ups_trace(("keys are not unique and sorted in ascending order"));
+          st = UPS_INV_PARAMETER;
+          break;
+        }
+
+        append(0, &key, &record, 0);
+
+        last_key_arena.copy((uint8_t *)key.data, key.size);
+        last_key.data = last_key_arena.data();
+        last_key.size = key.size;
+        is_first = false;
+      }
+
+      if (st == 0)
+        finish();
+    }
+    catch (Exception &ex) {
+      st = ex.code;
+    }
+
+    if (st)
+      release_pages();
+    return st;
+  }
+
+  // Appends a key to the right-most page of |level|. The leaves store
+  // the |record|, the internal pages the page address |rid|
+  void append(size_t level, ups_key_t *key, ups_record_t *record,
+                  uint64_t rid) {
+    Page *page = levels[level];
+    BtreeNodeProxy *node = btree->get_node_from_page(page);
+
+    PBtreeNode::InsertResult result = node->insert(context, key,
+                    PBtreeNode::kInsertAppend);
+    if (result.status == UPS_LIMITS_REACHED) {
+      if (start_sibling(level, key, rid))
+        return;
+      page = levels[level];
+      node = btree->get_node_from_page(page);
+      result = node->insert(context, key, PBtreeNode::kInsertAppend);
+    }
+    if (unlikely(result.status))
+      throw Exception(result.status);
+
+    if (level == 0) {
+      uint32_t new_duplicate_index = 0;
+      node->set_record(context, result.slot, record, 0, 0,
+                      &new_duplicate_index);
+    }
+    else
+      node->set_record_id(context, result.slot, rid);
+    page->set_dirty(true);
+  }
+
+  // The right-most page of |level| is full. Allocates its new right
+  // sibling and moves the keys beyond the fill factor, then appends the
+  // separator to the next level.
+  // Returns true if |key| was consumed, which is the case for internal
+  // pages without a split: the key becomes the separator.
+  bool start_sibling(size_t level, ups_key_t *key, uint64_t rid) {
+    bool is_leaf = level == 0;
+    Page *old_page = levels[level];
+    BtreeNodeProxy *old_node = btree->get_node_from_page(old_page);
+
+    Page *new_page = allocate_page(is_leaf);
+    BtreeNodeProxy *new_node = btree->get_node_from_page(new_page);
+
+    // link the pages immediately; release_pages() follows the siblings
+    old_node->set_right_sibling(new_page->address());
+    new_node->set_left_sibling(old_page->address());
+    old_page->set_dirty(true);
+
+    ByteArray separator_arena;
+    ups_key_t separator = {0};
+    bool consumed = false;
+    bool use_prefixes = is_leaf
+            && btree->db()->config.key_compressor == UPS_COMPRESSOR_PREFIX;
+
+    // split the page at the fill factor; the split moves at least one
+    // key, and the pivot key of internal pages is not moved
+    int length = (int)old_node->length();
+    int pivot = (int)((uint64_t)length * fill_factor / 100);
+    if (pivot > 0 && pivot <= length - (is_leaf ? 1 : 2)) {
+      old_node->key(context, pivot, &separator_arena, &separator);
+      if (use_prefixes) {
+        ByteArray prev_key_arena;
+        ups_key_t prev_key = {0};
+        old_node->key(context, pivot - 1, &prev_key_arena, &prev_key);
+        shorten_separator(&prev_key, &separator);
+      }
+      if (!is_leaf)
+        new_node->set_left_child(old_node->record_id(context, pivot));
+      old_node->split(context, new_node, pivot);
+    }
+    // otherwise the page remains full, and the new key is the separator
+    else {
+      separator = *key;
+      if (use_prefixes) {
+        ByteArray prev_key_arena;
+        ups_key_t prev_key = {0};
+        old_node->key(context, length - 1, &prev_key_arena, &prev_key);
+        shorten_separator(&prev_key, &separator);
+      }
+      if (!is_leaf) {
+        new_node->set_left_child(rid);
+        consumed = true;
+      }
+    }
+
+    uint64_t old_address = old_page->address();
+    uint64_t new_address = new_page->address();
+
+    // the top level is full: create a new level above it
+    if (level + 1 == levels.size()) {
+      Page *page = allocate_page(false);
+      btree->get_node_from_page(page)->set_left_child(old_address);
+      levels.push_back(page);
+      first_pages.push_back(page->address());
+    }
+
+    // the old page is complete
+    levels[level] = new_page;
+    complete(old_page);
+
+    append(level + 1, &separator, 0, new_address);
+    return consumed;
+  }
+
+  // Allocates and initializes a new page
+  Page *allocate_page(bool is_leaf) {
+    Page *page = env->page_manager->alloc(context, Page::kTypeBindex);
+    PBtreeNode *node = PBtreeNode::from_page(page);
+    node->set_flags(is_leaf ? PBtreeNode::kLeafNode : 0);
+    page->set_dirty(true);
+    return page;
+  }
+
+  // Schedules a complete page for writing
+  void complete(Page *page) {
+    pending.push_back(page);
+    if (pending.size() >= kWriteBatchSize)
+      write_pending();
+  }
+
+  // Writes the complete pages with a single (sequential) batch, then
+  // releases all pages and fetches the right-most pages again
+  void write_pending() {
+    if (NOTSET(env->flags(), UPS_IN_MEMORY))
+      Page::flush_all(env->device.get(), pending, false);
+    pending.clear();
+
+    std::vector<uint64_t> addresses;
+    for (size_t i = 0; i < levels.size(); i++)
+      addresses.push_back(levels[i]->address());
+
+    context->changeset.clear();
+    for (size_t i = 0; i < levels.size(); i++)
+      levels[i] = env->page_manager->fetch(context, addresses[i]);
+
+    env->page_manager->purge_cache(context);
+  }
+
+  // Replaces the old (empty) btree with the new one; the right-most page
+  // of the top level is the new root
+  void finish() {
+    btree->drop(context);
+    btree->set_root_page(levels.back());
+
+    Page *header = env->page_manager->fetch(context, 0);
+    header->set_dirty(true);
+  }
+
+  // Moves all pages of the new btree (and their blobs) to the freelist
+  void release_pages() {
+    pending.clear();
+    levels.clear();
+
+    for (size_t i = 0; i < first_pages.size(); i++) {
+      uint64_t address = first_pages[i];
+      while (address) {
+        Page *page = env->page_manager->fetch(context, address);
+        BtreeNodeProxy *node = btree->get_node_from_page(page);
+        address = node->right_sibling();
+        node->erase_everything(context);
+        env->page_manager->del(context, page, 1);
+      }
+    }
+  }
+
+  // the current btree
+  BtreeIndex *btree;
+
+  // The caller's Context
+  Context *context;
+
+  // the fill factor of the pages, in percent
+  uint32_t fill_factor;
+
+  // the Environment
+  LocalEnv *env;
+
+  // the right-most page of each level; index 0 is the leaf level
+  std::vector<Page *> levels;
+
+  // the address of the left-most page of each level
+  std::vector<uint64_t> first_pages;
+
+  // complete pages which were not yet written
+  std::vector<Page *> pending;
+};
+
+ups_status_t
+BtreeIndex::bulk_load(Context *context, ups_bulk_load_func_t func,
+                void *func_context, uint32_t fill_factor)
+{
+  context->db = db();
+
+  BtreeBulkLoadAction bla(this, context, fill_factor);
+  ups_status_t st = bla.run(func, func_context);
+
+  // the cached hints refer to pages of the old btree
+  state.statistics.find_failed();
+  state.statistics.insert_failed();
+  state.statistics.erase_failed();
+  return st;
+}
+
+} // namespace upscaledb
@@ -39,9 +39,9 @@ namespace upscaledb {
 static inline void
 remove_cursor_from_page(BtreeCursor *cursor, Page *page)
 {
-  page->cursor_list.del(cursor);
-
   BtreeCursorState &st_ = cursor->st_;
+  ScopedSpinlock lock(st_.btree->mutex());
+  page->cursor_list.del(cursor);
   st_.coupled_page = 0;
 }
 
@@ -349,6 +349,7 @@ BtreeCursor::couple_to(Page *page, uint32_t index, int duplicate_index)
   st_.coupled_page = page;
 
   // add the cursor to the page
+  ScopedSpinlock lock(st_.btree->mutex());
   page->cursor_list.put(this);
 }
 
@@ -30,7 +30,8 @@
 #include "3btree/btree_index.h"
 #include "3btree/btree_update.h"
 #include "3btree/btree_node_proxy.h"
-#include "4db/db.h"
+#include "3journal/journal_entries.h"
+#include "4db/db_local.h"
 #include "4cursor/cursor_local.h"
 
 #ifndef UPS_ROOT_H
@@ -117,7 +118,14 @@ fall_through:
     // records; they point to pages instead, and we do not want to delete
     // those.
     bool has_duplicates_left = false;
+    bool log_redo = false;
     if (node->is_leaf()) {
+      // the erased record must not be stored in a blob
+      log_redo = is_leaf_redo_allowed(key)
+              && (ISSET(db->flags(), UPS_FORCE_RECORDS_INLINE)
+                    || node->record_size(context, slot, 0)
+                            <= sizeof(uint64_t));
+
       // only delete a duplicate?
       if (duplicate_index > 0)
         node->erase_record(context, slot, duplicate_index - 1, false,
@@ -184,6 +192,10 @@ fall_through:
     // split the page, therefore this case has to be handled
     try {
       node->erase(context, slot);
+      if (unlikely(log_redo))
+        context->changeset.add_leaf_redo(page, PJournalEntryLeafRedo::kErase,
+                      duplicate_index > 0 ? duplicate_index - 1 : 0,
+                      duplicate_index > 0 ? 0 : 1, slot, 0, 0);
     }
     catch (Exception &ex) {
       if (ex.code != UPS_LIMITS_REACHED)
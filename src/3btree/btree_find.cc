@@ -96,8 +96,13 @@ struct BtreeFindAction
     uint32_t is_approx_match = 0;
 
     if (slot == -1) {
-      /* load the root page */
-      page = btree->root_page(context);
+      /* load the root page, or directly move to its child if the root
+       * can be searched without a latch; the pages below the root are
+       * always latched */
+      page = btree->search_root_optimistic(context, key,
+                              PageManager::kReadOnly);
+      if (!page)
+        page = btree->root_page(context);
 
       /* now traverse the root to the leaf nodes till we find a leaf */
       node = btree->get_node_from_page(page);
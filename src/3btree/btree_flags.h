@@ -42,7 +42,11 @@ struct BtreeKey {
     kExtendedKey          = 0x01,
 
     // key is compressed; the original size is stored in the payload
-    kCompressed           = 0x08
+    kCompressed           = 0x08,
+
+    // key is encoded relative to the node prefix, and not relative to
+    // its predecessor (only used by the PrefixKeyList)
+    kPrefixRestart        = 0x10
   };
 
   // flags used with the ups_key_t::_flags (note the underscore - this
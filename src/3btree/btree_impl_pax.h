@@ -107,6 +107,10 @@ struct PaxNodeImpl : public BaseNodeImpl<KeyList, RecordList> {
     size_t rs = P::records.full_record_size();
     size_t capacity = usable_nodesize / (ks + rs);
 
+    // internal nodes are searched far more often than they are modified
+    if (!P::node->is_leaf())
+      P::keys.enable_search_directory();
+
     uint8_t *p = P::node->data();
     if (P::node->length() == 0) {
       P::keys.create(&p[0], capacity * ks);
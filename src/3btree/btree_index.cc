@@ -130,6 +130,37 @@ BtreeIndex::find_lower_bound(Context *context, Page *page, const ups_key_t *key,
   return state.page_manager->fetch(context, record_id, page_manager_flags);
 }
 
+Page *
+BtreeIndex::search_root_optimistic(Context *context, const ups_key_t *key,
+                uint32_t page_manager_flags)
+{
+  // the root page is never purged from the cache; all other pages can be
+  // deleted while they are not latched
+  Page *page = state.root_page;
+  if (!page)
+    return 0;
+
+  // extended keys are read from a blob, and the blob id might be garbage
+  // if the node is modified concurrently
+  if (state.btree_header->key_size == UPS_KEY_SIZE_UNLIMITED)
+    return 0;
+
+  uint32_t version;
+  if (!page->mutex().try_lock_optimistic(&version))
+    return 0;
+
+  BtreeNodeProxy *node = get_node_from_page(page);
+  if (node->is_leaf())
+    return 0;
+
+  uint64_t record_id;
+  node->find_lower_bound(context, (ups_key_t *)key, &record_id);
+  if (!page->mutex().validate_optimistic(version))
+    return 0;
+
+  return state.page_manager->fetch(context, record_id, page_manager_flags);
+}
+
 //
 // visitor object for estimating / counting the number of keys
 ///
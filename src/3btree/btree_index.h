@@ -27,6 +27,7 @@
 #include "1base/abi.h"
 #include "1base/dynamic_array.h"
 #include "1base/scoped_ptr.h"
+#include "1base/spinlock.h"
 #include "1globals/globals.h"
 #include "3btree/btree_cursor.h"
 #include "3btree/btree_stats.h"
@@ -160,6 +161,11 @@ struct BtreeIndexState {
 
   // the btree statistics
   BtreeStatistics statistics;
+
+  // Protects the lazily created node proxies and the cursor lists of the
+  // pages; required if several threads read concurrently
+  // (UPS_ENABLE_CONCURRENT_READS)
+  Spinlock mutex;
 };
 
 //
@@ -172,7 +178,12 @@ struct BtreeIndex {
     kLeafPage = 1,
 
     // for get_node_from_page(): Page is an internal node
-    kInternalPage = 2
+    kInternalPage = 2,
+
+    // flag for insert(): the caller does not have exclusive access to the
+    // Database. The tree is traversed with lock coupling, and
+    // UPS_LIMITS_REACHED is returned if the leaf would have to be split
+    kLatchCoupling = 0x01000000
   };
 
   // Constructor; creates and initializes a new btree
@@ -195,6 +206,11 @@ struct BtreeIndex {
   // Returns the root page
   Page *root_page(Context *context);
 
+  // Returns the address of the root page
+  uint64_t root_address() const {
+    return state.btree_header->root_address;
+  }
+
   // Sets the new root page
   void set_root_page(Page *root_page) {
     root_page->set_type(Page::kTypeBroot);
@@ -228,6 +244,12 @@ struct BtreeIndex {
   ups_status_t insert(Context *context, LocalCursor *cursor, ups_key_t *key,
                   ups_record_t *record, uint32_t flags);
 
+  // Builds the index bottom-up from the sorted keys and records which are
+  // returned by |func| (ups_db_bulk_load). The index must be empty; the
+  // pages are filled up to |fill_factor| percent
+  ups_status_t bulk_load(Context *context, ups_bulk_load_func_t func,
+                  void *func_context, uint32_t fill_factor);
+
   // Erases a key/record from the index (ups_db_erase).
   // If |duplicate_index| is 0 then all duplicates are erased, otherwise only
   // the specified duplicate is erased.
@@ -259,6 +281,16 @@ struct BtreeIndex {
   Page *find_lower_bound(Context *context, Page *parent, const ups_key_t *key,
                   uint32_t page_manager_flags, int *idxptr);
 
+  // Same as find_lower_bound() for the root page, but searches the root
+  // without latching it (see ReadWriteSpinlock::try_lock_optimistic).
+  // Only the root is read optimistically: the returned child and all
+  // pages below it are fetched and latched as usual, because they can be
+  // purged from the cache as soon as they are not latched. Returns null if
+  // the root is a leaf, if it is not yet loaded or if it was modified
+  // concurrently. Then the caller has to latch the root.
+  Page *search_root_optimistic(Context *context, const ups_key_t *key,
+                  uint32_t page_manager_flags);
+
   // Compares two keys
   // Returns -1, 0, +1 or higher positive values are the result of a
   // successful key comparison (0 if both keys match, -1 when
@@ -272,6 +304,10 @@ struct BtreeIndex {
     if (likely(page->node_proxy() != 0))
       return page->node_proxy();
 
+    ScopedSpinlock lock(state.mutex);
+    if (page->node_proxy() != 0)
+      return page->node_proxy();
+
     BtreeNodeProxy *proxy;
     PBtreeNode *node = PBtreeNode::from_page(page);
     if (node->is_leaf())
@@ -295,6 +331,11 @@ struct BtreeIndex {
           = Globals::ms_bytes_after_compression;
   }
 
+  // Returns the mutex which protects the cursor lists of the pages
+  Spinlock &mutex() {
+    return state.mutex;
+  }
+
   // Returns the btree usage statistics
   BtreeStatistics *statistics() {
     return &state.statistics;
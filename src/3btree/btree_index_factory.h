@@ -28,12 +28,15 @@
 #include "3btree/btree_keys_pod.h"
 #include "3btree/btree_keys_binary.h"
 #include "3btree/btree_keys_varlen.h"
+#include "3btree/btree_keys_prefix.h"
 #include "3btree/btree_zint32_groupvarint.h"
 #include "3btree/btree_zint32_simdcomp.h"
 #include "3btree/btree_zint32_for.h"
 #include "3btree/btree_zint32_simdfor.h"
 #include "3btree/btree_zint32_streamvbyte.h"
 #include "3btree/btree_zint32_varbyte.h"
+#include "3btree/btree_zint64_for.h"
+#include "3btree/btree_zint64_varbyte.h"
 #include "3btree/btree_records_default.h"
 #include "3btree/btree_records_inline.h"
 #include "3btree/btree_records_internal.h"
@@ -220,7 +223,15 @@ struct BtreeIndexFactory {
       case UPS_TYPE_UINT64:
         if (!is_leaf)
           PAX_INTERNAL_NUMERIC(uint64_t);
-        PAX_LEAF_NUMERIC(uint64_t);
+        switch (key_compression) {
+          case UPS_COMPRESSOR_UINT64_VARBYTE:
+            PAX_LEAF_NODE(Zint64::VarbyteKeyList, NumericCompare<uint64_t>);
+          case UPS_COMPRESSOR_UINT64_FOR:
+            PAX_LEAF_NODE(Zint64::ForKeyList, NumericCompare<uint64_t>);
+          default:
+            // no key compression
+            PAX_LEAF_NUMERIC(uint64_t);
+        }
       // 32bit float
       case UPS_TYPE_REAL32:
         if (!is_leaf)
@@ -253,6 +264,13 @@ struct BtreeIndexFactory {
           LEAF_NODE_IMPL(PaxNodeImpl, BinaryKeyList, FixedSizeCompare);
         } // fixed keys
 
+        // variable length keys with prefix compression
+        if (key_compression == UPS_COMPRESSOR_PREFIX) {
+          if (!is_leaf)
+            DEF_INTERNAL_NODE(PrefixKeyList, VariableSizeCompare);
+          LEAF_NODE_IMPL(DefaultNodeImpl, PrefixKeyList, VariableSizeCompare);
+        }
+
         // variable length keys, with and without duplicates
         if (!is_leaf)
           DEF_INTERNAL_NODE(VariableLengthKeyList, VariableSizeCompare);
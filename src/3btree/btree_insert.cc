@@ -75,6 +75,11 @@ struct BtreeInsertAction : public BtreeUpdateAction {
      * already full, it will remove the HINT_APPEND (or HINT_PREPEND)
      * flag and call insert()
      */
+    // other threads can insert concurrently: the statistics are not
+    // updated, and the tree must not be modified
+    if (ISSET(flags, BtreeIndex::kLatchCoupling))
+      return insert_latched();
+
     ups_status_t st;
     if (hints.leaf_page_addr
             && ISSETANY(hints.flags, UPS_HINT_APPEND | UPS_HINT_PREPEND)) {
@@ -181,6 +186,18 @@ struct BtreeInsertAction : public BtreeUpdateAction {
     return st;
   }
 
+  // Inserts the key with lock coupling; returns UPS_LIMITS_REACHED if the
+  // leaf would have to be split. The caller then has to restart with
+  // exclusive access to the Database.
+  ups_status_t insert_latched() {
+    Page *page = traverse_tree_latched(context, key);
+    BtreeNodeProxy *node = btree->get_node_from_page(page);
+    if (node->requires_split(context, key))
+      return UPS_LIMITS_REACHED;
+
+    return insert_in_page(page, key, record, hints);
+  }
+
   // the key that is inserted
   ups_key_t *key;
 
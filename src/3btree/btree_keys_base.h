@@ -59,6 +59,11 @@ struct BaseKeyList : BaseList {
     : BaseList(db, node) {
   }
 
+  // Maintains a search directory for faster lookups; not supported by
+  // this KeyList
+  void enable_search_directory() {
+  }
+
   // Erases the extended part of a key; nothing to do here
   void erase_extended_key(Context *context, int slot) const {
   }
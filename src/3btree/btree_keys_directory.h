@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A search directory for sorted arrays of fixed length keys.
+ *
+ * The directory samples every n-th key of the array. The samples occupy
+ * at most two cache lines; they are sorted, and scanned with the SIMD
+ * kernels of 2simd/simd.h. This narrows the search range down to a single
+ * block of the array, which is then searched with simd_lower_bound().
+ * A lookup in a large node therefore touches the (hot) directory and
+ * a few adjacent cache lines of the block, instead of one cache line for
+ * each step of a binary search.
+ *
+ * The directory is not persisted; it is rebuilt whenever the KeyList is
+ * modified. It is never trusted blindly: the boundaries of a block are
+ * only used if the sampled keys are still stored at the expected
+ * positions. A stale directory therefore costs performance, but does not
+ * return wrong results.
+ *
+ * @exception_safe: nothrow
+ * @thread_safe: no
+ */
+
+#ifndef UPS_BTREE_KEYS_DIRECTORY_H
+#define UPS_BTREE_KEYS_DIRECTORY_H
+
+#include "0root/root.h"
+
+#include <algorithm>
+
+// Always verify that a file of level N does not include headers > N!
+#include "2simd/simd.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+template<typename T>
+struct KeyDirectory {
+  enum {
+    // The size of the sampled keys, in bytes (two cache lines)
+    kDirectorySize = 128,
+
+    // The maximum number of sampled keys
+    kMaxSamples = kDirectorySize / sizeof(T),
+
+    // The minimum number of keys per block; smaller arrays are searched
+    // without the directory
+    kMinBlockSize = 32
+  };
+
+  // Constructor; the directory is empty
+  KeyDirectory()
+    : count(0), block_size(0) {
+  }
+
+  // Removes all samples
+  void clear() {
+    count = 0;
+  }
+
+  // Samples the keys of |data|, which has |node_count| elements
+  void build(const T *data, size_t node_count) {
+    int samples = std::min<int>(kMaxSamples,
+                    (int)(node_count / kMinBlockSize) - 1);
+    if (samples <= 0) {
+      count = 0;
+      return;
+    }
+
+    block_size = (int)(node_count / (samples + 1));
+    for (int i = 0; i < samples; i++)
+      keys[i] = data[(i + 1) * block_size - 1];
+    count = samples;
+  }
+
+  // Returns the index of the first key in |data| which is not smaller
+  // than |key| (see simd_lower_bound())
+  int lower_bound(const T *data, size_t node_count, T key) const {
+    int l = 0, r = (int)node_count;
+    int samples = count;
+
+    if (samples > 0) {
+      // all keys of the block |i| are > keys[i - 1] and <= keys[i]
+      int i = simd_count_less(simd_level(), &keys[0], samples, key);
+      if (i > 0) {
+        int p = i * block_size - 1;
+        if (p < r && data[p] == keys[i - 1])
+          l = p + 1;
+      }
+      if (i < samples) {
+        int p = (i + 1) * block_size - 1;
+        if (p < r && data[p] == keys[i])
+          r = p + 1;
+      }
+      if (unlikely(l > r)) {
+        l = 0;
+        r = (int)node_count;
+      }
+    }
+
+    return l + simd_lower_bound(&data[l], r - l, key);
+  }
+
+  // The sampled keys; keys[i] is data[(i + 1) * block_size - 1]
+  T keys[kMaxSamples];
+
+  // The number of sampled keys; 0 if the directory is empty
+  int count;
+
+  // The number of keys per block
+  int block_size;
+};
+
+} // namespace upscaledb
+
+#endif // UPS_BTREE_KEYS_DIRECTORY_H
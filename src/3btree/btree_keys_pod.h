@@ -38,8 +38,10 @@
 #include "1globals/globals.h"
 #include "1base/dynamic_array.h"
 #include "2page/page.h"
+#include "2simd/simd.h"
 #include "3btree/btree_node.h"
 #include "3btree/btree_keys_base.h"
+#include "3btree/btree_keys_directory.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -69,7 +71,7 @@ struct PodKeyList : BaseKeyList {
 
   // Constructor
   PodKeyList(LocalDb *db, PBtreeNode *node)
-    : BaseKeyList(db, node), _data(0) {
+    : BaseKeyList(db, node), _data(0), _has_directory(false) {
   }
 
   // Creates a new PodKeyList starting at |ptr|, total size is
@@ -77,12 +79,21 @@ struct PodKeyList : BaseKeyList {
   void create(uint8_t *ptr, size_t range_size_) {
     _data = (T *)ptr;
     range_size = range_size_;
+    _directory.clear();
   }
 
   // Opens an existing PodKeyList starting at |ptr|
-  void open(uint8_t *ptr, size_t range_size_, size_t) {
+  void open(uint8_t *ptr, size_t range_size_, size_t node_count) {
     _data = (T *)ptr;
     range_size = range_size_;
+    update_directory(node_count);
+  }
+
+  // Maintains a KeyDirectory for faster lookups. Used for internal nodes,
+  // which are searched far more often than they are modified. Has to be
+  // called before create() or open()
+  void enable_search_directory() {
+    _has_directory = Globals::ms_is_search_directory_enabled;
   }
 
   // Returns the required size for the current set of keys
@@ -95,34 +106,31 @@ struct PodKeyList : BaseKeyList {
     return sizeof(T);
   }
 
-  // Finds a key
-#ifdef __SSE__
   // Searches the node for the key and returns the slot of this key
   // - only for exact matches!
   //
-  // This is the SIMD implementation. If SIMD is disabled then the
-  // BaseKeyList::find method is used.
-  template<typename Cmp>
-  int find(Context *, size_t node_count, const ups_key_t *key, Cmp &) {
-    return find_simd_sse<T>(node_count, &_data[0], key);
-  }
-#else
+  // Uses the SIMD kernels of the CPU (SSE4.2, AVX2 or AVX-512), or
+  // scalar code if none of them is available.
   template<typename Cmp>
   int find(Context *, size_t node_count, const ups_key_t *hkey, Cmp &) {
+    if (!_has_directory)
+      return find_simd_sse<T>(node_count, &_data[0], hkey);
+
     T key = *(T *)hkey->data;
-    T *result = std::lower_bound(&_data[0], &_data[node_count], key);
-    if (unlikely(result == &_data[node_count] || *result != key))
-      return -1;
-    return result - &_data[0];
+    int slot = _directory.lower_bound(&_data[0], node_count, key);
+    if (slot < (int)node_count && _data[slot] == key)
+      return slot;
+    return -1;
   }
-#endif
 
   // Performs a lower-bound search for a key
   template<typename Cmp>
   int find_lower_bound(Context *, size_t node_count, const ups_key_t *hkey,
                   Cmp &, int *pcmp) {
     T key = *(T *)hkey->data;
-    T *result = std::lower_bound(&_data[0], &_data[node_count], key);
+    T *result = _has_directory
+                    ? &_data[_directory.lower_bound(&_data[0], node_count, key)]
+                    : &_data[simd_lower_bound(&_data[0], (int)node_count, key)];
     if (unlikely(result == &_data[node_count])) {
       if (key > _data[node_count - 1]) {
         *pcmp = +1;
@@ -178,6 +186,7 @@ struct PodKeyList : BaseKeyList {
     if (slot < (int)node_count - 1)
       ::memmove(&_data[slot], &_data[slot + 1],
                       sizeof(T) * (node_count - slot - 1));
+    update_directory(node_count - 1);
   }
 
   // Inserts a key
@@ -189,6 +198,7 @@ struct PodKeyList : BaseKeyList {
                       sizeof(T) * (node_count - slot));
     assert(key->size == sizeof(T));
     _data[slot] = *(T *)key->data;
+    update_directory(node_count + 1);
     return PBtreeNode::InsertResult(0, slot);
   }
 
@@ -197,6 +207,8 @@ struct PodKeyList : BaseKeyList {
                   size_t other_count, int dstart) {
     ::memcpy(&dest._data[dstart], &_data[sstart],
                     sizeof(T) * (node_count - sstart));
+    dest.update_directory(other_count + node_count - sstart);
+    update_directory(sstart);
   }
 
   // Returns true if the |key| no longer fits into the node
@@ -210,6 +222,7 @@ struct PodKeyList : BaseKeyList {
     ::memmove(new_data_ptr, _data, node_count * sizeof(T));
     _data = (T *)new_data_ptr;
     range_size = new_range_size;
+    update_directory(node_count);
   }
 
   // Fills the btree_metrics structure
@@ -234,8 +247,23 @@ struct PodKeyList : BaseKeyList {
     return (uint8_t *)&_data[slot];
   }
 
+  // Rebuilds the KeyDirectory after the keys were modified. The caller
+  // does not always know the final number of keys (i.e. the pivot key is
+  // removed from a split internal node); then the directory is partially
+  // invalid, which is detected during the lookup
+  void update_directory(size_t node_count) {
+    if (_has_directory)
+      _directory.build(&_data[0], node_count);
+  }
+
   // The actual array of T's
   T *_data;
+
+  // true if the KeyDirectory is maintained
+  bool _has_directory;
+
+  // Samples of the keys, for faster lookups
+  KeyDirectory<T> _directory;
 };
 
 } // namespace upscaledb
@@ -0,0 +1,828 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Prefix compressed KeyList for variable length binary keys
+ *
+ * Uses the same UpfrontIndex as the VariableLengthKeyList, but each key
+ * only stores the bytes which it does not share with another key:
+ *
+ *   - A "restart" key is encoded relative to the node prefix, which is
+ *     stored at the beginning of the KeyList's range. The node prefix is
+ *     (re)calculated whenever the node is split, merged or rebuilt.
+ *   - All other keys are encoded relative to the previous (non-extended)
+ *     key of the node.
+ *
+ * Every |kRestartInterval| keys a restart key is stored. A key is decoded
+ * by walking back to the previous restart key, and the search only
+ * decodes the restart keys (and extended keys) before it scans the keys
+ * of a single run. Extended keys are stored in full (as a blob) and are
+ * skipped when walking back.
+ *
+ * Because the keys are sorted, a key shares at least as many bytes with
+ * a newly inserted predecessor as with its old one. Re-encoding the
+ * successor of an inserted key therefore never requires more space.
+ */
+
+#ifndef UPS_BTREE_KEYS_PREFIX_H
+#define UPS_BTREE_KEYS_PREFIX_H
+
+#include "0root/root.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "3btree/btree_keys_varlen.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+//
+// The format of a single (non-extended) key is:
+//   |Flags|Shared|Suffix...|
+// where Flags and Shared are 8 bit. |Shared| is the number of bytes that
+// are shared with the node prefix (if Flags has kPrefixRestart) or with
+// the previous non-extended key. The key size therefore is
+// Shared + UpfrontIndex::get_chunk_size() - 2.
+//
+// Extended keys have the same format as in the VariableLengthKeyList:
+//   |Flags|Blob Id|
+//
+// The range starts with the node prefix:
+//   |Prefix Size|Prefix...|
+// followed by the UpfrontIndex.
+//
+struct PrefixKeyList : VariableLengthKeyList {
+  enum {
+    // This KeyList has a custom find() implementation
+    kCustomFind = 1,
+
+    // This KeyList has a custom find_lower_bound() implementation
+    kCustomFindLowerBound = 1,
+
+    // The maximum number of keys in a run (a restart key and the keys
+    // which are encoded relative to it)
+    kRestartInterval = 16,
+
+    // The maximum size of the node prefix
+    kMaxPrefixSize = 63,
+
+    // The size of the header with the node prefix
+    kHeaderSize = 1 + kMaxPrefixSize,
+
+    // The maximum size of an inline key; the chunk size has 8 bits
+    kMaxInlineKeySize = 255 - 2
+  };
+
+  // Constructor
+  PrefixKeyList(LocalDb *db, PBtreeNode *node)
+    : VariableLengthKeyList(db, node) {
+    if (_extkey_threshold > kMaxInlineKeySize)
+      _extkey_threshold = kMaxInlineKeySize;
+  }
+
+  // Creates a new KeyList starting at |ptr|, total size is
+  // |range_size| (in bytes)
+  void create(uint8_t *ptr, size_t range_size_) {
+    _data = ptr;
+    range_size = range_size_;
+    *_data = 0; // no node prefix
+    _index.create(_data + kHeaderSize, range_size - kHeaderSize,
+                    (range_size - kHeaderSize) / full_key_size());
+  }
+
+  // Opens an existing KeyList
+  void open(uint8_t *ptr, size_t range_size_, size_t node_count) {
+    _data = ptr;
+    range_size = range_size_;
+    _index.open(_data + kHeaderSize, range_size - kHeaderSize);
+  }
+
+  // Calculates the required size for a range
+  size_t required_range_size(size_t node_count) const {
+    return kHeaderSize + _index.required_range_size(node_count);
+  }
+
+  // Returns the actual key size including overhead. This is an estimate
+  // since we don't know how large the keys will be
+  size_t full_key_size(const ups_key_t *key = 0) const {
+    if (!key)
+      return 24 + _index.full_index_size() + 2;
+    return required_size(key) + _index.full_index_size();
+  }
+
+  // Copies a key into |dest|
+  void key(Context *context, int slot, ByteArray *arena, ups_key_t *dest,
+                  bool deep_copy = true) {
+    ups_key_t tmp = {0};
+    if (unlikely(ISSET(get_key_flags(slot), BtreeKey::kExtendedKey)))
+      get_extended_key(context, get_extended_blob_id(slot), &tmp);
+    else {
+      arena->resize(kMaxInlineKeySize);
+      tmp.data = arena->data();
+      tmp.size = decode_key(slot, arena->data());
+    }
+
+    dest->size = tmp.size;
+
+    if (likely(deep_copy == false)) {
+      dest->data = tmp.data;
+      return;
+    }
+
+    // allocate memory (if required)
+    if (NOTSET(dest->flags, UPS_KEY_USER_ALLOC)) {
+      if (tmp.data == arena->data())
+        dest->data = arena->data();
+      else {
+        arena->resize(tmp.size);
+        dest->data = arena->data();
+        ::memcpy(dest->data, tmp.data, tmp.size);
+      }
+    }
+    else
+      ::memcpy(dest->data, tmp.data, tmp.size);
+  }
+
+  // Searches the node for the key and returns the slot of the largest
+  // key which is <= |hkey|, or -1 if all keys are greater.
+  // First performs a binary search over the keys which can be decoded
+  // without their predecessors, then scans the run of the result.
+  template<typename Cmp>
+  int find_lower_bound(Context *context, size_t node_count,
+                  const ups_key_t *hkey, Cmp &comparator, int *pcmp) {
+    uint8_t buffer[kMaxInlineKeySize];
+    ups_key_t tmp = {0};
+    int slot = -1;
+
+    *pcmp = -1;
+
+    int left = 0;
+    int right = (int)node_count;
+    while (left < right) {
+      int middle = (left + right) / 2;
+      int anchor = anchor_slot(middle);
+      // no anchor in [left, middle]? then continue to the right
+      if (anchor < left) {
+        left = middle + 1;
+        continue;
+      }
+
+      anchor_key(context, anchor, buffer, &tmp);
+      int cmp = comparator(hkey->data, hkey->size, tmp.data, tmp.size);
+      if (cmp == 0) {
+        *pcmp = 0;
+        return anchor;
+      }
+      if (cmp < 0)
+        right = anchor;
+      else {
+        slot = anchor;
+        *pcmp = cmp;
+        left = middle + 1;
+      }
+    }
+
+    if (slot == -1)
+      return -1;
+
+    // now scan the keys which are encoded relative to the anchor
+    int anchor = slot;
+    size_t size = 0;
+    for (int s = anchor + 1; s < (int)node_count; s++) {
+      uint8_t *p = chunk_data(s);
+      if (ISSETANY(*p, BtreeKey::kExtendedKey | BtreeKey::kPrefixRestart))
+        break;
+      if (s == anchor + 1)
+        size = decode_key(s, buffer);
+      else
+        size = apply_delta(s, buffer);
+
+      int cmp = comparator(hkey->data, hkey->size, buffer, size);
+      if (cmp < 0)
+        break;
+      slot = s;
+      *pcmp = cmp;
+      if (cmp == 0)
+        break;
+    }
+
+    return slot;
+  }
+
+  // Searches the node for the key and returns the slot of this key
+  // - only for exact matches!
+  template<typename Cmp>
+  int find(Context *context, size_t node_count, const ups_key_t *hkey,
+                  Cmp &comparator) {
+    int cmp;
+    int slot = find_lower_bound(context, node_count, hkey, comparator, &cmp);
+    return slot >= 0 && cmp == 0 ? slot : -1;
+  }
+
+  // Erases a key's extended blob. The chunk is not modified; this is only
+  // called if the node is discarded, or right before the key is erased.
+  void erase_extended_key(Context *context, int slot) {
+    if (ISSET(get_key_flags(slot), BtreeKey::kExtendedKey))
+      VariableLengthKeyList::erase_extended_key(context,
+                      get_extended_blob_id(slot));
+  }
+
+  // Erases a key, including extended blobs. The successor of the key is
+  // re-encoded if it was encoded relative to the erased key.
+  void erase(Context *context, size_t node_count, int slot) {
+    uint8_t *p = chunk_data(slot);
+    int next = NOTSET(*p, BtreeKey::kExtendedKey)
+                  ? next_plain_slot(node_count, slot + 1)
+                  : -1;
+
+    if (next < 0 || ISSET(get_key_flags(next), BtreeKey::kPrefixRestart)) {
+      erase_extended_key(context, slot);
+      _index.erase(node_count, slot);
+      return;
+    }
+
+    uint8_t key[kMaxInlineKeySize];
+    uint8_t chunk[kMaxInlineKeySize + 2];
+    size_t key_size = decode_key(next, key);
+    size_t chunk_size;
+
+    // the successor starts a new run if the erased key was a restart key
+    if (ISSET(*p, BtreeKey::kPrefixRestart))
+      chunk_size = encode(key, key_size, prefix_data(), prefix_size(),
+                      BtreeKey::kPrefixRestart, chunk);
+    else {
+      uint8_t base[kMaxInlineKeySize];
+      size_t base_size = decode_key(previous_plain_slot(slot), base);
+      chunk_size = encode(key, key_size, base, base_size, 0, chunk);
+    }
+
+    _index.erase(node_count, slot);
+    write_chunk(node_count - 1, next - 1, chunk, chunk_size);
+  }
+
+  // Inserts the |key| at the position identified by |slot|.
+  // This method cannot fail; there MUST be sufficient free space in the
+  // node (otherwise the caller would have split the node).
+  template<typename Cmp>
+  PBtreeNode::InsertResult insert(Context *context, size_t node_count,
+                              const ups_key_t *key, uint32_t flags,
+                              Cmp &comparator, int slot) {
+    uint8_t base[kMaxInlineKeySize];
+    uint8_t chunk[kMaxInlineKeySize + 2];
+    size_t base_size = 0;
+    size_t chunk_size = 0;
+    int next = -1;
+
+    bool is_inline = key->size <= _extkey_threshold;
+    if (likely(is_inline)) {
+      // encode the key relative to its predecessor, unless the run of the
+      // predecessor is already full
+      int previous = previous_plain_slot(slot);
+      if (previous >= 0) {
+        base_size = decode_key(previous, base);
+        if (run_length(node_count, previous) >= kRestartInterval)
+          previous = -1;
+      }
+      if (previous >= 0)
+        chunk_size = encode((uint8_t *)key->data, key->size, base, base_size,
+                        0, chunk);
+      else
+        chunk_size = encode((uint8_t *)key->data, key->size, prefix_data(),
+                        prefix_size(), BtreeKey::kPrefixRestart, chunk);
+
+      next = next_plain_slot(node_count, slot);
+      is_inline = _index.can_allocate_space(node_count, chunk_size);
+    }
+
+    _index.insert(node_count, slot);
+
+    // now there's one additional slot
+    node_count++;
+
+    if (likely(is_inline)) {
+      uint32_t offset = _index.allocate_space(node_count, slot, chunk_size);
+      ::memcpy(_index.get_chunk_data_by_offset(offset), chunk, chunk_size);
+    }
+    else {
+      uint64_t blob_id = add_extended_key(context, key);
+      _index.allocate_space(node_count, slot, 8 + 1);
+      set_extended_blob_id(slot, blob_id);
+      set_key_flags(slot, BtreeKey::kExtendedKey);
+      // extended keys are skipped when keys are decoded; the successor
+      // does not change
+      return PBtreeNode::InsertResult(0, slot);
+    }
+
+    // the successor is now encoded relative to the new key
+    next = next < 0 ? -1 : next + 1;
+    if (next >= 0 && NOTSET(get_key_flags(next), BtreeKey::kPrefixRestart)) {
+      uint8_t *p = chunk_data(next);
+      size_t shared = p[1];
+      size_t suffix = _index.get_chunk_size(next) - 2;
+      ::memcpy(base + shared, p + 2, suffix);
+      chunk_size = encode(base, shared + suffix, (uint8_t *)key->data,
+                      key->size, 0, chunk);
+      write_chunk(node_count, next, chunk, chunk_size);
+    }
+
+    return PBtreeNode::InsertResult(0, slot);
+  }
+
+  // Returns true if the |key| no longer fits into the node and a split
+  // is required. Makes sure that there is ALWAYS enough headroom
+  // for an extended key!
+  //
+  // If there's no key specified then always assume the worst case and
+  // pretend that the key has the maximum length
+  bool requires_split(size_t node_count, const ups_key_t *key) {
+    size_t required = key ? required_size(key) : _extkey_threshold + 2;
+    return _index.requires_split(node_count, required);
+  }
+
+  // Copies |count| key from this[sstart] to dest[dstart]. If |dest| is
+  // empty then it receives a new node prefix.
+  void copy_to(int sstart, size_t node_count, PrefixKeyList &dest,
+                  size_t other_node_count, int dstart) {
+    size_t to_copy = node_count - sstart;
+    assert(to_copy > 0);
+
+    uint8_t key[kMaxInlineKeySize];
+    uint8_t base[kMaxInlineKeySize];
+    uint8_t chunk[kMaxInlineKeySize + 2];
+    size_t key_size = 0;
+    size_t base_size = 0;
+    size_t run = kRestartInterval;
+
+    // make sure that the other node has sufficient capacity in its
+    // UpfrontIndex
+    dest._index.change_range_size(other_node_count, 0, 0, _index.capacity());
+
+    if (other_node_count == 0) {
+      int first = next_plain_slot(node_count, sstart);
+      if (first >= 0) {
+        key_size = decode_key(first, key);
+        base_size = decode_key(previous_plain_slot(node_count), base);
+        dest.set_prefix(key, common_prefix(key, key_size, base, base_size));
+      }
+    }
+    else {
+      int last = dest.previous_plain_slot(other_node_count);
+      if (last >= 0) {
+        base_size = dest.decode_key(last, base);
+        run = dest.run_length(other_node_count, last);
+      }
+    }
+
+    bool is_first = true;
+    for (size_t i = 0; i < to_copy; i++) {
+      int s = sstart + i;
+      uint8_t *p = chunk_data(s);
+      size_t chunk_size;
+
+      if (ISSET(*p, BtreeKey::kExtendedKey)) {
+        chunk_size = _index.get_chunk_size(s);
+        ::memcpy(chunk, p, chunk_size);
+      }
+      else {
+        if (is_first || ISSET(*p, BtreeKey::kPrefixRestart))
+          key_size = decode_key(s, key);
+        else
+          key_size = apply_delta(s, key);
+        is_first = false;
+
+        if (run >= kRestartInterval) {
+          chunk_size = dest.encode(key, key_size, dest.prefix_data(),
+                          dest.prefix_size(), BtreeKey::kPrefixRestart,
+                          chunk);
+          run = 1;
+        }
+        else {
+          chunk_size = encode(key, key_size, base, base_size, 0, chunk);
+          run++;
+        }
+        ::memcpy(base, key, key_size);
+        base_size = key_size;
+      }
+
+      dest._index.insert(other_node_count + i, dstart + i);
+      uint32_t offset = dest._index.allocate_space(other_node_count + i + 1,
+                      dstart + i, chunk_size);
+      ::memcpy(dest._index.get_chunk_data_by_offset(offset), chunk,
+                      chunk_size);
+    }
+
+    // A lot of keys will be invalidated after copying, therefore make
+    // sure that the next_offset is recalculated when it's required
+    _index.invalidate_next_offset();
+  }
+
+  // Checks the integrity of this node. Throws an exception if there is a
+  // violation.
+  void check_integrity(Context *context, size_t node_count) const {
+    ByteArray arena;
+    uint8_t key[kMaxInlineKeySize];
+    size_t key_size = 0;
+    size_t run = 0;
+
+    // verify that the offsets and sizes are not overlapping
+    _index.check_integrity(node_count);
+
+    if (prefix_size() > kMaxPrefixSize) {
+      ups_log(("node prefix size %d exceeds maximum", (int)prefix_size()));
+      throw Exception(UPS_INTEGRITY_VIOLATED);
+    }
+
+    for (size_t i = 0; i < node_count; i++) {
+      uint8_t *p = chunk_data(i);
+
+      if (ISSET(*p, BtreeKey::kExtendedKey)) {
+        uint64_t blobid = get_extended_blob_id(i);
+        if (!blobid) {
+          ups_log(("integrity check failed: item %u "
+                  "is extended, but has no blob", i));
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        }
+
+        // make sure that the extended blob can be loaded
+        ups_record_t record = {0};
+        _blob_manager->read(context, blobid, &record, 0, &arena);
+        continue;
+      }
+
+      // make sure that the runs are not too long, and that each key
+      // only shares existing bytes
+      size_t shared = p[1];
+      if (ISSET(*p, BtreeKey::kPrefixRestart)) {
+        if (shared > prefix_size()) {
+          ups_log(("item %u shares %u bytes with node prefix of size %u",
+                  i, (int)shared, (int)prefix_size()));
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        }
+        run = 1;
+      }
+      else {
+        if (run == 0 || shared > key_size) {
+          ups_log(("item %u shares %u bytes with its predecessor",
+                  i, (int)shared));
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        }
+        if (++run > kRestartInterval) {
+          ups_log(("item %u exceeds the restart interval", i));
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        }
+      }
+
+      key_size = shared + _index.get_chunk_size(i) - 2;
+      if (key_size > _extkey_threshold) {
+        ups_log(("key size %d, but key is not extended", (int)key_size));
+        throw Exception(UPS_INTEGRITY_VIOLATED);
+      }
+      key_size = decode_key(i, key);
+    }
+  }
+
+  // Rearranges the list. A forced vacuumize (after a split or before a
+  // merge) re-encodes all keys with a new node prefix.
+  void vacuumize(size_t node_count, bool force) {
+    if (force && rebuild(node_count))
+      return;
+    VariableLengthKeyList::vacuumize(node_count, force);
+  }
+
+  // Change the range size; the capacity will be adjusted, the data is
+  // copied as necessary
+  void change_range_size(size_t node_count, uint8_t *new_data_ptr,
+                  size_t new_range_size, size_t capacity_hint) {
+    if (!new_data_ptr)
+      new_data_ptr = _data;
+    if (!new_range_size)
+      new_range_size = range_size;
+
+    size_t index_range_size = new_range_size - kHeaderSize;
+
+    // no capacity given? then try to find a good default one
+    if (capacity_hint == 0) {
+      capacity_hint = (index_range_size - _index.next_offset(node_count)
+              - full_key_size()) / _index.full_index_size();
+      if (capacity_hint <= node_count)
+        capacity_hint = node_count + 1;
+    }
+
+    // if there's not enough space for the new capacity then try to reduce
+    // the capacity
+    if (_index.next_offset(node_count) + full_key_size(0)
+                    + capacity_hint * _index.full_index_size()
+                    + UpfrontIndex::kPayloadOffset
+              > index_range_size)
+      capacity_hint = node_count + 1;
+
+    uint8_t header[kHeaderSize];
+    ::memcpy(header, _data, kHeaderSize);
+    _index.change_range_size(node_count, new_data_ptr + kHeaderSize,
+                    index_range_size, capacity_hint);
+    ::memcpy(new_data_ptr, header, kHeaderSize);
+    _data = new_data_ptr;
+    range_size = new_range_size;
+  }
+
+  // Prints a slot to |out| (for debugging)
+  void print(Context *context, int slot, std::stringstream &out) {
+    ByteArray arena;
+    ups_key_t tmp = {0};
+    key(context, slot, &arena, &tmp, false);
+    out << std::string((const char *)tmp.data, tmp.size);
+  }
+
+  // Returns the size of the node prefix
+  size_t prefix_size() const {
+    return *_data;
+  }
+
+  // Returns a pointer to the node prefix
+  uint8_t *prefix_data() const {
+    return _data + 1;
+  }
+
+  // Sets the node prefix; the node must not have any restart keys
+  void set_prefix(const uint8_t *data, size_t size) {
+    if (size > kMaxPrefixSize)
+      size = kMaxPrefixSize;
+    *_data = (uint8_t)size;
+    ::memcpy(_data + 1, data, size);
+  }
+
+  // Returns the number of bytes required to store |key| in the worst case
+  // (a restart key which does not share any bytes with the node prefix)
+  size_t required_size(const ups_key_t *key) const {
+    if (key->size > _extkey_threshold || key->size + 2 < 8 + 1)
+      return 8 + 1;
+    return key->size + 2;
+  }
+
+  // Returns a pointer to the chunk of a key
+  uint8_t *chunk_data(int slot) const {
+    return _index.get_chunk_data_by_offset(_index.get_chunk_offset(slot));
+  }
+
+  // Returns the slot of the last non-extended key before |slot|, or -1
+  int previous_plain_slot(int slot) const {
+    for (int s = slot - 1; s >= 0; s--)
+      if (NOTSET(get_key_flags(s), BtreeKey::kExtendedKey))
+        return s;
+    return -1;
+  }
+
+  // Returns the slot of the first non-extended key at or after |slot|,
+  // or -1
+  int next_plain_slot(size_t node_count, int slot) const {
+    for (int s = slot; s < (int)node_count; s++)
+      if (NOTSET(get_key_flags(s), BtreeKey::kExtendedKey))
+        return s;
+    return -1;
+  }
+
+  // Returns the slot of the last key at or before |slot| which can be
+  // decoded without decoding its predecessors (a restart key or an
+  // extended key)
+  int anchor_slot(int slot) const {
+    while (slot > 0 && NOTSET(get_key_flags(slot),
+                    BtreeKey::kExtendedKey | BtreeKey::kPrefixRestart))
+      slot--;
+    return slot;
+  }
+
+  // Returns the number of keys in the run of the non-extended key at |slot|
+  size_t run_length(size_t node_count, int slot) const {
+    size_t length = 0;
+    for (int s = slot; s >= 0; s--) {
+      uint8_t flags = get_key_flags(s);
+      if (ISSET(flags, BtreeKey::kExtendedKey))
+        continue;
+      length++;
+      if (ISSET(flags, BtreeKey::kPrefixRestart))
+        break;
+    }
+    for (int s = slot + 1; s < (int)node_count; s++) {
+      uint8_t flags = get_key_flags(s);
+      if (ISSET(flags, BtreeKey::kExtendedKey))
+        continue;
+      if (ISSET(flags, BtreeKey::kPrefixRestart))
+        break;
+      length++;
+    }
+    return length;
+  }
+
+  // Decodes an anchor key (see |anchor_slot()|). Restart keys are
+  // decoded into |buffer|, extended keys are returned from the cache.
+  void anchor_key(Context *context, int slot, uint8_t *buffer,
+                  ups_key_t *key) {
+    uint8_t *p = chunk_data(slot);
+    if (ISSET(*p, BtreeKey::kExtendedKey)) {
+      get_extended_key(context, get_extended_blob_id(slot), key);
+      return;
+    }
+
+    assert(ISSET(*p, BtreeKey::kPrefixRestart));
+    size_t shared = p[1];
+    size_t suffix = _index.get_chunk_size(slot) - 2;
+    ::memcpy(buffer, prefix_data(), shared);
+    ::memcpy(buffer + shared, p + 2, suffix);
+    key->data = buffer;
+    key->size = (uint32_t)(shared + suffix);
+  }
+
+  // Decodes the non-extended key at |slot| into |buffer|, which holds its
+  // decoded predecessor. Returns the key size.
+  size_t apply_delta(int slot, uint8_t *buffer) const {
+    uint8_t *p = chunk_data(slot);
+    size_t shared = p[1];
+    size_t suffix = _index.get_chunk_size(slot) - 2;
+    if (ISSET(*p, BtreeKey::kPrefixRestart))
+      ::memcpy(buffer, prefix_data(), shared);
+    ::memcpy(buffer + shared, p + 2, suffix);
+    return shared + suffix;
+  }
+
+  // Decodes the non-extended key at |slot| into |buffer|. Returns the
+  // key size.
+  size_t decode_key(int slot, uint8_t *buffer) const {
+    int chain[kRestartInterval];
+    int length = 0;
+
+    // walk back to the restart key
+    int s = slot;
+    while (true) {
+      assert(s >= 0);
+      uint8_t flags = get_key_flags(s);
+      if (ISSET(flags, BtreeKey::kExtendedKey)) {
+        s--;
+        continue;
+      }
+      chain[length++] = s;
+      if (ISSET(flags, BtreeKey::kPrefixRestart))
+        break;
+      assert(length < kRestartInterval);
+      s--;
+    }
+
+    // then apply all deltas
+    size_t size = 0;
+    while (length > 0)
+      size = apply_delta(chain[--length], buffer);
+    return size;
+  }
+
+  // Encodes |key| relative to |base|; writes the chunk to |out| and
+  // returns its size
+  size_t encode(const uint8_t *key, size_t key_size, const uint8_t *base,
+                  size_t base_size, uint8_t flags, uint8_t *out) const {
+    size_t shared = common_prefix(key, key_size, base, base_size);
+    out[0] = flags;
+    out[1] = (uint8_t)shared;
+    ::memcpy(out + 2, key + shared, key_size - shared);
+    return key_size - shared + 2;
+  }
+
+  // Returns the number of leading bytes which |lhs| and |rhs| share
+  static size_t common_prefix(const uint8_t *lhs, size_t lhs_size,
+                  const uint8_t *rhs, size_t rhs_size) {
+    size_t size = std::min(lhs_size, rhs_size);
+    size_t i = 0;
+    while (i < size && lhs[i] == rhs[i])
+      i++;
+    return i;
+  }
+
+  // Overwrites the chunk of an existing |slot|. If the chunk grows and
+  // there is not enough space then the node is vacuumized.
+  void write_chunk(size_t node_count, int slot, const uint8_t *chunk,
+                  size_t size) {
+    uint32_t old_offset = _index.get_chunk_offset(slot);
+    size_t old_size = _index.get_chunk_size(slot);
+
+    if (size <= old_size) {
+      ::memcpy(_index.get_chunk_data_by_offset(old_offset), chunk, size);
+      _index.set_chunk_size(slot, size);
+      if (size < old_size) {
+        _index.increase_vacuumize_counter(old_size - size);
+        _index.maybe_invalidate_next_offset(old_offset + old_size);
+      }
+      return;
+    }
+
+    if (_index.can_allocate_space(node_count, size)) {
+      uint32_t offset = _index.allocate_space(node_count, slot, size);
+      if (offset != old_offset)
+        _index.add_to_freelist(node_count, old_offset, old_size);
+      ::memcpy(_index.get_chunk_data_by_offset(offset), chunk, size);
+      return;
+    }
+
+    // release the old chunk, then rearrange the node
+    _index.set_chunk_size(slot, 0);
+    _index.increase_vacuumize_counter(100);
+    _index.vacuumize(node_count);
+    uint32_t offset = _index.allocate_space(node_count, slot, size);
+    ::memcpy(_index.get_chunk_data_by_offset(offset), chunk, size);
+  }
+
+  // Re-encodes all keys with a new node prefix, and removes all gaps.
+  // Returns false if the keys would require more space than available.
+  bool rebuild(size_t node_count) {
+    if (node_count == 0) {
+      *_data = 0;
+      return false;
+    }
+
+    uint8_t key[kMaxInlineKeySize];
+    uint8_t base[kMaxInlineKeySize];
+    uint8_t prefix[kMaxPrefixSize];
+    size_t key_size = 0;
+    size_t base_size = 0;
+    size_t prefix_length = 0;
+
+    // the new prefix is shared by the first and the last key
+    int first = next_plain_slot(node_count, 0);
+    if (first >= 0) {
+      key_size = decode_key(first, key);
+      base_size = decode_key(previous_plain_slot(node_count), base);
+      prefix_length = std::min((size_t)kMaxPrefixSize,
+                      common_prefix(key, key_size, base, base_size));
+      ::memcpy(prefix, key, prefix_length);
+    }
+
+    // encode all keys into a temporary buffer
+    ByteArray chunks(_index.usable_data_size() + kMaxInlineKeySize + 2);
+    uint8_t *sizes = (uint8_t *)::alloca(node_count);
+    size_t used = 0;
+    size_t run = kRestartInterval;
+    for (size_t i = 0; i < node_count; i++) {
+      uint8_t *p = chunk_data(i);
+      uint8_t *out = chunks.data() + used;
+      size_t size;
+
+      if (ISSET(*p, BtreeKey::kExtendedKey)) {
+        size = _index.get_chunk_size(i);
+        ::memcpy(out, p, size);
+      }
+      else {
+        key_size = (int)i == first || ISSET(*p, BtreeKey::kPrefixRestart)
+                      ? decode_key(i, key)
+                      : apply_delta(i, key);
+        if (run >= kRestartInterval) {
+          size = encode(key, key_size, prefix, prefix_length,
+                          BtreeKey::kPrefixRestart, out);
+          run = 1;
+        }
+        else {
+          size = encode(key, key_size, base, base_size, 0, out);
+          run++;
+        }
+        ::memcpy(base, key, key_size);
+        base_size = key_size;
+      }
+
+      sizes[i] = (uint8_t)size;
+      used += size;
+      if (used > _index.usable_data_size())
+        return false;
+    }
+
+    // now overwrite the node
+    set_prefix(prefix, prefix_length);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < node_count; i++) {
+      ::memcpy(_index.get_chunk_data_by_offset(offset),
+                      chunks.data() + offset, sizes[i]);
+      _index.set_chunk_offset(i, offset);
+      _index.set_chunk_size(i, sizes[i]);
+      offset += sizes[i];
+    }
+    _index.set_freelist_count(0);
+    _index.set_next_offset(offset);
+    _index.vacuumize_counter = 0;
+    return true;
+  }
+};
+
+} // namespace upscaledb
+
+#endif // UPS_BTREE_KEYS_PREFIX_H
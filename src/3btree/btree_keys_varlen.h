@@ -93,7 +93,8 @@ struct VariableLengthKeyList : BaseKeyList {
 
     size_t page_size = env->config.page_size_bytes;
     int algo = db->config.key_compressor;
-    if (algo)
+    // prefix compression is implemented by the PrefixKeyList
+    if (algo && algo != UPS_COMPRESSOR_PREFIX)
       _compressor.reset(CompressorFactory::create(algo));
     if (unlikely(Globals::ms_extended_threshold))
       _extkey_threshold = Globals::ms_extended_threshold;
@@ -456,6 +457,9 @@ struct VariableLengthKeyList : BaseKeyList {
   // Retrieves the extended key at |blobid| and stores it in |key|; will
   // use the cache.
   void get_extended_key(Context *context, uint64_t blob_id, ups_key_t *key) {
+    // concurrent readers share the cache
+    ScopedSpinlock lock(_extkey_mutex);
+
     if (unlikely(!_extkey_cache))
       _extkey_cache.reset(new ExtKeyCache());
     else {
@@ -558,6 +562,9 @@ struct VariableLengthKeyList : BaseKeyList {
   // Cache for extended keys
   ScopedPtr<ExtKeyCache> _extkey_cache;
 
+  // Protects the |_extkey_cache| if several threads read concurrently
+  Spinlock _extkey_mutex;
+
   // Threshold for extended keys; if key size is > threshold then the
   // key is moved to a blob
   size_t _extkey_threshold;
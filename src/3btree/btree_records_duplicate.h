@@ -550,6 +550,9 @@ struct DuplicateRecordList : BaseRecordList {
 
   // Returns a duplicate table; uses a cache to speed up access
   DuplicateTable *duplicate_table(Context *context, uint64_t table_id) {
+    // concurrent readers share the cache
+    ScopedSpinlock lock(duptable_mutex_);
+
     if (unlikely(!duptable_cache_))
       duptable_cache_.reset(new DuplicateTableCache());
     else {
@@ -637,6 +640,9 @@ struct DuplicateRecordList : BaseRecordList {
 
   // A cache for duplicate tables
   ScopedPtr<DuplicateTableCache> duptable_cache_;
+
+  // Protects the |duptable_cache_| if several threads read concurrently
+  Spinlock duptable_mutex_;
 };
 
 //
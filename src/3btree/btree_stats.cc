@@ -53,6 +53,10 @@ BtreeStatistics::find_succeeded(Page *page)
 void
 BtreeStatistics::find_failed()
 {
+  // avoid the (shared) write if possible; lookups can run concurrently
+  if (state.last_leaf_pages[kOperationFind] == 0
+        && state.last_leaf_count[kOperationFind] == 0)
+    return;
   state.last_leaf_pages[kOperationFind] = 0;
   state.last_leaf_count[kOperationFind] = 0;
 }
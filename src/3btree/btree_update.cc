@@ -19,9 +19,12 @@
 #include "0root/root.h"
 
 #include <string.h>
+#include <algorithm>
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
+#include "1globals/globals.h"
+#include "3journal/journal_entries.h"
 #include "3page_manager/page_manager.h"
 #include "3blob_manager/blob_manager.h"
 #include "3btree/btree_stats.h"
@@ -39,6 +42,19 @@ namespace upscaledb {
 /* a unittest hook triggered when a page is split */
 void (*g_BTREE_INSERT_SPLIT_HOOK)(void);
 
+void
+shorten_separator(const ups_key_t *prev_key, ups_key_t *pivot_key)
+{
+  uint32_t lcp = 0;
+  uint32_t max = std::min(prev_key->size, pivot_key->size);
+  const uint8_t *p1 = (const uint8_t *)prev_key->data;
+  const uint8_t *p2 = (const uint8_t *)pivot_key->data;
+  while (lcp < max && p1[lcp] == p2[lcp])
+    lcp++;
+  if (lcp + 1 < pivot_key->size)
+    pivot_key->size = lcp + 1;
+}
+
 // Calculates the pivot index of a split.
 //
 // For databases with sequential access (this includes recno databases):
@@ -243,6 +259,40 @@ BtreeUpdateAction::traverse_tree(Context *context, const ups_key_t *key,
   return page;
 }
 
+// Traverses the tree with lock coupling. Other threads can read or update
+// the same tree, but they cannot modify its structure (splits and merges
+// require exclusive access to the Database). Therefore the pages on the
+// path do not change while they are latched in shared mode.
+Page *
+BtreeUpdateAction::traverse_tree_latched(Context *context, const ups_key_t *key)
+{
+  LocalEnv *env = (LocalEnv *)btree->db()->env;
+  uint32_t flags = PageManager::kReadOnly | PageManager::kSharedLatch;
+
+  Page *parent = 0;
+  Page *page = env->page_manager->fetch(context, btree->root_address(), flags);
+  BtreeNodeProxy *node = btree->get_node_from_page(page);
+
+  while (!node->is_leaf()) {
+    Page *child_page = btree->find_lower_bound(context, page, key, flags, 0);
+    if (parent)
+      context->changeset.del(parent);
+    parent = page;
+    page = child_page;
+    node = btree->get_node_from_page(page);
+  }
+
+  if (parent)
+    context->changeset.del(parent);
+
+  // now latch the leaf exclusively. The page is fetched again because it
+  // can be evicted from the cache as soon as the shared latch is released;
+  // it's still the correct leaf since the structure cannot change
+  uint64_t address = page->address();
+  context->changeset.del(page);
+  return env->page_manager->fetch(context, address, PageManager::kReadOnly);
+}
+
 Page *
 BtreeUpdateAction::split_page(Page *old_page, Page *parent,
                 const ups_key_t *key, BtreeStatistics::InsertHints &hints)
@@ -286,6 +336,16 @@ BtreeUpdateAction::split_page(Page *old_page, Page *parent,
     /* and store the pivot key for later */
     old_node->key(context, pivot, &pivot_key_arena, &pivot_key);
 
+    /* prefix compression: the separator only needs the shortest prefix
+     * of the pivot key which is still larger than its predecessor */
+    if (old_node->is_leaf() && pivot > 0
+          && btree->db()->config.key_compressor == UPS_COMPRESSOR_PREFIX) {
+      ByteArray prev_key_arena;
+      ups_key_t prev_key = {0};
+      old_node->key(context, pivot - 1, &prev_key_arena, &prev_key);
+      shorten_separator(&prev_key, &pivot_key);
+    }
+
     /* leaf page: uncouple all cursors */
     if (old_node->is_leaf())
       BtreeCursor::uncouple_all_cursors(context, old_page, pivot);
@@ -338,6 +398,27 @@ BtreeUpdateAction::split_page(Page *old_page, Page *parent,
   return to_return;
 }
 
+bool
+BtreeUpdateAction::is_leaf_redo_allowed(const ups_key_t *key)
+{
+  if (likely(!context->changeset.is_leaf_redo_enabled()))
+    return false;
+
+  // duplicate tables and compressed keys can be moved to blobs
+  LocalDb *db = btree->db();
+  if (ISSET(db->flags(), UPS_ENABLE_DUPLICATE_KEYS)
+        || db->config.key_compressor != 0)
+    return false;
+  if (db->config.key_size != UPS_KEY_SIZE_UNLIMITED)
+    return true;
+  // long keys are stored in a blob; 64 bytes is the smallest threshold
+  // for extended keys
+  return key != 0
+            && key->size <= 64
+            && (Globals::ms_extended_threshold == 0
+                  || key->size <= Globals::ms_extended_threshold);
+}
+
 ups_status_t
 BtreeUpdateAction::insert_in_page(Page *page, ups_key_t *key,
                 ups_record_t *record, BtreeStatistics::InsertHints &hints,
@@ -399,6 +480,15 @@ BtreeUpdateAction::insert_in_page(Page *page, ups_key_t *key,
 
         hints.processed_leaf_page = page;
         hints.processed_slot = result.slot;
+
+        // records with more than 8 bytes are stored in a blob, unless they
+        // are forced inline
+        if (unlikely(is_leaf_redo_allowed(key))
+              && duplicate_index == 0
+              && (record->size <= sizeof(uint64_t)
+                    || ISSET(btree->db()->flags(), UPS_FORCE_RECORDS_INLINE)))
+          context->changeset.add_leaf_redo(page, PJournalEntryLeafRedo::kInsert,
+                        flags, hints.flags, result.slot, key, record);
       }
       else {
         // set the internal record id
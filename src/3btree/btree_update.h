@@ -35,6 +35,11 @@ struct Context;
 struct BtreeIndex;
 struct BtreeCursor;
 
+// Prefix compression: shortens the separator |pivot_key| to the shortest
+// prefix which is still larger than |prev_key|, the last key of the left
+// page. Only the size of |pivot_key| is modified.
+void shorten_separator(const ups_key_t *prev_key, ups_key_t *pivot_key);
+
 /*
  * Base class for updates; derived for erasing and inserting keys.
  */
@@ -53,6 +58,12 @@ struct BtreeUpdateAction {
   Page *traverse_tree(Context *context, const ups_key_t *key,
                       BtreeStatistics::InsertHints &hints, Page **parent);
 
+  // Traverses the tree with lock coupling, looking for the leaf with the
+  // specified |key|. Internal nodes are latched in shared mode; a parent
+  // is released as soon as its child is latched. Returns the leaf, which
+  // is latched exclusively. Does not modify the tree.
+  Page *traverse_tree_latched(Context *context, const ups_key_t *key);
+
   // Splits |page| and updates the |parent|. If |parent| is null then
   // it's assumed that |page| is the root node.
   // Returns the new page in the path for |key|; caller can immediately
@@ -60,6 +71,11 @@ struct BtreeUpdateAction {
   Page *split_page(Page *old_page, Page *parent, const ups_key_t *key,
                       BtreeStatistics::InsertHints &hints);
 
+  // Returns true if a leaf operation on |key| can be logged as a logical
+  // redo record (UPS_ENABLE_DELTA_JOURNAL). The operation must not
+  // allocate or free blobs; the caller checks the record
+  bool is_leaf_redo_allowed(const ups_key_t *key);
+
   // Inserts a key in a page
   ups_status_t insert_in_page(Page *page, ups_key_t *key,
                       ups_record_t *record,
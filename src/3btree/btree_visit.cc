@@ -22,6 +22,9 @@
 
 #include "0root/root.h"
 
+#include <vector>
+#include <algorithm>
+
 // Always verify that a file of level N does not include headers > N!
 #include "3page_manager/page_manager.h"
 #include "3btree/btree_index.h"
@@ -36,10 +39,16 @@ namespace upscaledb {
 
 struct BtreeVisitAction
 {
+  enum {
+    // the number of leaves which are prefetched with a single batch
+    kPrefetchSize = 32
+  };
+
   BtreeVisitAction(BtreeIndex *btree_, Context *context_,
                   BtreeVisitor &visitor_, bool visit_internal_nodes_)
     : btree(btree_), context(context_), visitor(visitor_),
-      visit_internal_nodes(visit_internal_nodes_) {
+      visit_internal_nodes(visit_internal_nodes_), next_parent(0),
+      position(0) {
   }
 
   void run() {
@@ -57,6 +66,12 @@ struct BtreeVisitAction
       BtreeNodeProxy *node = btree->get_node_from_page(page);
       uint64_t left_child = node->left_child();
 
+      // the parents of the leaves know the addresses of the leaves; if
+      // the Device supports batched reads then the leaves are prefetched
+      if (left_child != 0 && visitor.is_read_only()
+            && env->device->supports_batched_reads())
+        next_parent = page->address();
+
       // visit internal nodes as well?
       if (left_child != 0 && visit_internal_nodes) {
         while (page) {
@@ -84,11 +99,17 @@ struct BtreeVisitAction
 
     // now visit all leaf nodes
     while (page) {
+      prefetch_leaves(env, page->address(), page_manager_flags);
+
       BtreeNodeProxy *node = btree->get_node_from_page(page);
       uint64_t right = node->right_sibling();
 
       visitor(context, node);
 
+      // a shared Changeset (of a concurrent reader) is never flushed;
+      // release the leaf, otherwise all leaves stay latched till the end
+      release_if_shared(page);
+
       /* follow the pointer to the right sibling */
       if (likely(right))
         page = env->page_manager->fetch(context, right, page_manager_flags);
@@ -97,10 +118,66 @@ struct BtreeVisitAction
     }
   }
 
+  // Prefetches the next leaves when the leaf at |address| is visited.
+  // The leaves are visited in the same order as they are stored in their
+  // parents; if they are not (i.e. because the visitor modified the tree)
+  // then prefetching is stopped
+  void prefetch_leaves(LocalEnv *env, uint64_t address,
+                  uint32_t page_manager_flags) {
+    // load the children of the next parent
+    if (position == children.size() && next_parent != 0) {
+      Page *page = env->page_manager->fetch(context, next_parent,
+                      page_manager_flags);
+      BtreeNodeProxy *node = btree->get_node_from_page(page);
+      children.clear();
+      children.push_back(node->left_child());
+      for (size_t i = 0; i < node->length(); i++)
+        children.push_back(node->record_id(context, i));
+      next_parent = node->right_sibling();
+      position = 0;
+      release_if_shared(page);
+    }
+
+    if (position == children.size())
+      return;
+
+    if (children[position] != address) {
+      children.clear();
+      next_parent = 0;
+      position = 0;
+      return;
+    }
+
+    if (position % kPrefetchSize == 0) {
+      size_t end = std::min<size_t>(position + kPrefetchSize,
+                      children.size());
+      std::vector<uint64_t> batch(children.begin() + position,
+                      children.begin() + end);
+      env->page_manager->prefetch(context, batch);
+    }
+    position++;
+  }
+
+  // Unlatches |page| if the Changeset is shared. Concurrent inserts never
+  // split or merge pages, therefore the sibling pointers (and the addresses
+  // of the leaves) do not change
+  void release_if_shared(Page *page) {
+    if (context->changeset.is_shared)
+      context->changeset.del(page);
+  }
+
   BtreeIndex *btree;
   Context *context;
   BtreeVisitor &visitor;
   bool visit_internal_nodes;
+
+  // the address of the next parent of the leaves, if leaves are prefetched
+  uint64_t next_parent;
+
+  // the children of the current parent, and the position of the leaf
+  // which is visited next
+  std::vector<uint64_t> children;
+  size_t position;
 };
 
 void
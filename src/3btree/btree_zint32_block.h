@@ -18,6 +18,9 @@
 
 /*
  * Base class for key lists where keys are separated in blocks
+ *
+ * The keys are 32bit integers (Zint32), or 64bit integers (Zint64); the
+ * key type is specified by the block index (|Index::KeyType|).
  */
 
 #ifndef UPS_BTREE_KEYS_BLOCK_H
@@ -60,20 +63,25 @@ sort_by_offset(const SortHelper &lhs, const SortHelper &rhs)
 // The BlockCache is used to speed up multiple select() operations for
 // a single block. This is frequently used when iterating over a block
 // with a cursor.
+template<typename T>
 struct BlockCache {
   BlockCache()
     : is_active(false) {
   }
 
   bool is_active;
-  uint32_t index_value;
-  uint32_t data[256]; // TODO replace with kMaxKeysPerBlock
+  T index_value;
+  T data[256]; // TODO replace with kMaxKeysPerBlock
 };
 
 // This structure is an "index" entry which describes the location
 // of a variable-length block
 #include "1base/packstart.h"
-UPS_PACK_0 struct UPS_PACK_1 IndexBase {
+template<typename T>
+UPS_PACK_0 struct UPS_PACK_1 IndexBaseImpl {
+  // the type of the keys
+  typedef T KeyType;
+
   // initialize this block index
   void initialize(uint32_t offset, uint8_t *, size_t) {
     ::memset(this, 0, sizeof(*this));
@@ -91,22 +99,22 @@ UPS_PACK_0 struct UPS_PACK_1 IndexBase {
   }
 
   // returns the initial value
-  uint32_t value() const {
+  T value() const {
     return _value;
   }
 
   // sets the initial value
-  void set_value(uint32_t value) {
+  void set_value(T value) {
     _value = value;
   }
 
   // returns the highest value
-  uint32_t highest() const {
+  T highest() const {
     return _highest;
   }
 
   // sets the highest value
-  void set_highest(uint32_t highest) {
+  void set_highest(T highest) {
     _highest = highest;
   }
 
@@ -115,16 +123,21 @@ UPS_PACK_0 struct UPS_PACK_1 IndexBase {
   uint16_t _offset;
 
   // the start value of this block
-  uint32_t _value;
+  T _value;
 
   // the highest value of this block
-  uint32_t _highest;
+  T _highest;
 } UPS_PACK_2;
 #include "1base/packstop.h"
 
+// The index of the 32bit codecs
+typedef IndexBaseImpl<uint32_t> IndexBase;
+
 // Base class for a BlockCodec
 template <typename Index>
 struct BlockCodecBase {
+  typedef typename Index::KeyType KeyType;
+
   enum {
     kHasCompressApi = 0,
     kHasFindLowerBoundApi = 0,
@@ -135,32 +148,32 @@ struct BlockCodecBase {
     kCompressInPlace = 0,
   };
 
-  static uint32_t compress_block(Index *index, const uint32_t *in,
+  static uint32_t compress_block(Index *index, const KeyType *in,
                   uint32_t *out) {
     assert(!"shouldn't be here");
     throw Exception(UPS_INTERNAL_ERROR);
   }
 
-  static uint32_t *uncompress_block(Index *index, const uint32_t *block_data,
-                  uint32_t *out) {
+  static KeyType *uncompress_block(Index *index, const uint32_t *block_data,
+                  KeyType *out) {
     assert(!"shouldn't be here");
     throw Exception(UPS_INTERNAL_ERROR);
   }
 
   static int find_lower_bound(Index *index, const uint32_t *block_data,
-                  uint32_t key, uint32_t *result) {
+                  KeyType key, KeyType *result) {
     assert(!"shouldn't be here");
     throw Exception(UPS_INTERNAL_ERROR);
   }
 
   static bool insert(Index *index, uint32_t *block_data,
-                  uint32_t key, int *pslot) {
+                  KeyType key, int *pslot) {
     assert(!"shouldn't be here");
     throw Exception(UPS_INTERNAL_ERROR);
   }
 
   static bool append(Index *index, uint32_t *block_data,
-                  uint32_t key, int *pslot) {
+                  KeyType key, int *pslot) {
     assert(!"shouldn't be here");
     throw Exception(UPS_INTERNAL_ERROR);
   }
@@ -172,7 +185,7 @@ struct BlockCodecBase {
     throw Exception(UPS_INTERNAL_ERROR);
   }
 
-  static uint32_t select(Index *index, uint32_t *block_data, int slot) {
+  static KeyType select(Index *index, uint32_t *block_data, int slot) {
     assert(!"shouldn't be here");
     throw Exception(UPS_INTERNAL_ERROR);
   }
@@ -182,9 +195,11 @@ template<typename BlockIndex, typename BlockCodec>
 struct Zint32Codec {
   typedef BlockIndex Index;
   typedef BlockCodec Codec;
+  typedef typename Index::KeyType KeyType;
+  typedef Zint32::BlockCache<KeyType> BlockCache;
 
   static uint32_t compress_block(Index *index, BlockCache *block_cache,
-                    const uint32_t *in, uint32_t *out) {
+                    const KeyType *in, uint32_t *out) {
     block_cache->is_active = false;
 
     if (Codec::kHasCompressApi)
@@ -193,8 +208,8 @@ struct Zint32Codec {
     throw Exception(UPS_INTERNAL_ERROR);
   }
 
-  static uint32_t *uncompress_block(Index *index, const uint32_t *block_data,
-                  uint32_t *out) {
+  static KeyType *uncompress_block(Index *index, const uint32_t *block_data,
+                  KeyType *out) {
     if (likely(index->key_count() > 1))
       return Codec::uncompress_block(index, block_data, out);
     else
@@ -202,40 +217,40 @@ struct Zint32Codec {
   }
 
   static int find_lower_bound(Index *index, const uint32_t *block_data,
-                  uint32_t key, uint32_t *result) {
+                  KeyType key, KeyType *result) {
     if (Codec::kHasFindLowerBoundApi)
       return Codec::find_lower_bound(index, block_data, key, result);
 
-    uint32_t tmp[Index::kMaxKeysPerBlock];
-    uint32_t *begin = uncompress_block(index, block_data, &tmp[0]);
-    uint32_t *end = begin + index->key_count() - 1;
-    uint32_t *it = std::lower_bound(begin, end, key);
+    KeyType tmp[Index::kMaxKeysPerBlock];
+    KeyType *begin = uncompress_block(index, block_data, &tmp[0]);
+    KeyType *end = begin + index->key_count() - 1;
+    KeyType *it = std::lower_bound(begin, end, key);
     *result = *it;
     return it - begin;
   }
 
   static bool insert(Index *index, BlockCache *block_cache,
-                    uint32_t *block_data, uint32_t key, int *pslot) {
+                    uint32_t *block_data, KeyType key, int *pslot) {
     block_cache->is_active = false;
 
     if (Codec::kHasInsertApi)
       return Codec::insert(index, block_data, key, pslot);
 
     // now decode the block
-    uint32_t datap[Index::kMaxKeysPerBlock];
-    uint32_t *data = uncompress_block(index, block_data, datap);
+    KeyType datap[Index::kMaxKeysPerBlock];
+    KeyType *data = uncompress_block(index, block_data, datap);
 
     // swap |key| and |index->value|
     if (key < index->value()) {
-      uint32_t tmp = index->value();
+      KeyType tmp = index->value();
       index->set_value(key);
       key = tmp;
     }
 
     // locate the position of the new key
-    uint32_t *it = data;
-    uint32_t *begin = &data[0];
-    uint32_t *end = &data[index->key_count() - 1];
+    KeyType *it = data;
+    KeyType *begin = &data[0];
+    KeyType *end = &data[index->key_count() - 1];
 
     if (likely(index->key_count() > 1)) {
       it = std::lower_bound(begin, end, key);
@@ -248,7 +263,7 @@ struct Zint32Codec {
 
       // insert the new key
       if (it < end)
-        ::memmove(it + 1, it, (end - it) * sizeof(uint32_t));
+        ::memmove(it + 1, it, (end - it) * sizeof(KeyType));
     }
 
     *it = key;
@@ -262,18 +277,18 @@ struct Zint32Codec {
   }
 
   static bool append(Index *index, BlockCache *block_cache,
-                    uint32_t *block_data, uint32_t key, int *pslot) {
+                    uint32_t *block_data, KeyType key, int *pslot) {
     block_cache->is_active = false;
 
     if (Codec::kHasAppendApi)
       return Codec::append(index, block_data, key, pslot);
 
     // decode the block
-    uint32_t datap[Index::kMaxKeysPerBlock];
-    uint32_t *data = uncompress_block(index, block_data, datap);
+    KeyType datap[Index::kMaxKeysPerBlock];
+    KeyType *data = uncompress_block(index, block_data, datap);
 
     // append the new key
-    uint32_t *it = &data[index->key_count() - 1];
+    KeyType *it = &data[index->key_count() - 1];
     *it = key;
     *pslot = it - &data[0] + 1;
 
@@ -293,8 +308,8 @@ struct Zint32Codec {
       return Codec::del(index, block_data, slot, grow_handler);
 
     // uncompress the block and remove the key
-    uint32_t datap[Index::kMaxKeysPerBlock];
-    uint32_t *data = uncompress_block(index, block_data, datap);
+    KeyType datap[Index::kMaxKeysPerBlock];
+    KeyType *data = uncompress_block(index, block_data, datap);
 
     // delete the first value?
     if (slot == 0) {
@@ -304,7 +319,7 @@ struct Zint32Codec {
 
     if (slot < (int)index->key_count() - 1) {
       ::memmove(&data[slot - 1], &data[slot],
-              sizeof(uint32_t) * (index->key_count() - slot - 1));
+              sizeof(KeyType) * (index->key_count() - slot - 1));
     }
 
     // adjust key count
@@ -323,7 +338,7 @@ struct Zint32Codec {
     }
   }
 
-  static uint32_t select(Index *index, BlockCache *block_cache,
+  static KeyType select(Index *index, BlockCache *block_cache,
                     uint32_t *block_data, int position_in_block) {
     if (unlikely(position_in_block == 0))
       return index->value();
@@ -335,7 +350,7 @@ struct Zint32Codec {
 
     block_cache->is_active = true;
     block_cache->index_value = index->value();
-    uint32_t *data = uncompress_block(index, block_data, block_cache->data);
+    KeyType *data = uncompress_block(index, block_data, block_cache->data);
     return data[position_in_block - 1];
   }
 };
@@ -343,6 +358,8 @@ struct Zint32Codec {
 template<typename Zint32Codec>
 struct BlockKeyList : BaseKeyList {
   typedef typename Zint32Codec::Index Index;
+  typedef typename Zint32Codec::KeyType KeyType;
+  typedef typename Zint32Codec::BlockCache BlockCache;
 
   enum {
     // A flag whether this KeyList supports the scan() call
@@ -504,7 +521,7 @@ struct BlockKeyList : BaseKeyList {
   // but never called
   size_t key_size(int slot) const {
     assert(!"shouldn't be here");
-    return sizeof(uint32_t);
+    return sizeof(KeyType);
   }
 
   // Returns a pointer to the key's data; only required to appease the
@@ -585,7 +602,7 @@ struct BlockKeyList : BaseKeyList {
 
     *pcmp = 0;
 
-    uint32_t key = *(uint32_t *)hkey->data;
+    KeyType key = *(KeyType *)hkey->data;
     int slot = 0;
 
     // first perform a linear search through the index
@@ -602,7 +619,7 @@ struct BlockKeyList : BaseKeyList {
       return slot;
 
     // increment result by 1 because index 0 is index->value()
-    uint32_t result;
+    KeyType result;
     int s = Zint32Codec::find_lower_bound(index,
                     (uint32_t *)block_data(index), key, &result);
     if (result != key || s == (int)index->key_count())
@@ -616,9 +633,9 @@ struct BlockKeyList : BaseKeyList {
                   const ups_key_t *hkey, uint32_t flags, Cmp &comparator,
                   int /* unused */ slot) {
     assert(check_integrity(0, node_count));
-    assert(hkey->size == sizeof(uint32_t));
+    assert(hkey->size == sizeof(KeyType));
 
-    uint32_t key = *(uint32_t *)hkey->data;
+    KeyType key = *(KeyType *)hkey->data;
 
     // if a split is required: vacuumize the node, then retry
     try {
@@ -701,7 +718,7 @@ struct BlockKeyList : BaseKeyList {
                               (uint32_t *)block_data(index),
                               position_in_block);
 
-    dest->size = sizeof(uint32_t);
+    dest->size = sizeof(KeyType);
     if (deep_copy == false) {
       dest->data = (uint8_t *)&dummy;
       return;
@@ -713,7 +730,7 @@ struct BlockKeyList : BaseKeyList {
       dest->data = arena->data();
     }
 
-    *(uint32_t *)dest->data = dummy;
+    *(KeyType *)dest->data = dummy;
   }
 
   // Prints a key to |out| (for debugging)
@@ -729,12 +746,13 @@ struct BlockKeyList : BaseKeyList {
 
   // Scans all keys; used for the UQI APIs.
   ScanResult scan(ByteArray *arena, size_t node_count, uint32_t start) {
-    arena->resize((block_count() * (Index::kMaxKeysPerBlock + 1)) * 4);
+    arena->resize((block_count() * (Index::kMaxKeysPerBlock + 1))
+                    * sizeof(KeyType));
 
     Index *it = block_index(0);
     Index *end = block_index(block_count());
 
-    uint32_t *out = (uint32_t *)arena->data();
+    KeyType *out = (KeyType *)arena->data();
 
     for (; it < end; it++) {
       if (start > it->key_count()) {
@@ -747,7 +765,7 @@ struct BlockKeyList : BaseKeyList {
       out += it->key_count();
     }
 
-    out = (uint32_t *)arena->data();
+    out = (KeyType *)arena->data();
     return std::make_pair(out + start, node_count - start);
   }
 
@@ -780,12 +798,12 @@ struct BlockKeyList : BaseKeyList {
     // If start offset or destination offset > 0: uncompress both blocks,
     // merge them
     if (src_position_in_block > 0 || dst_position_in_block > 0) {
-      uint32_t sdata_buf[Index::kMaxKeysPerBlock];
-      uint32_t ddata_buf[Index::kMaxKeysPerBlock];
-      uint32_t *sdata = uncompress_block(srci, &sdata_buf[0]);
-      uint32_t *ddata = dest.uncompress_block(dsti, &ddata_buf[0]);
+      KeyType sdata_buf[Index::kMaxKeysPerBlock];
+      KeyType ddata_buf[Index::kMaxKeysPerBlock];
+      KeyType *sdata = uncompress_block(srci, &sdata_buf[0]);
+      KeyType *ddata = dest.uncompress_block(dsti, &ddata_buf[0]);
 
-      uint32_t *d = &ddata[srci->key_count()];
+      KeyType *d = &ddata[srci->key_count()];
 
       if (src_position_in_block == 0) {
         assert(dst_position_in_block != 0);
@@ -865,7 +883,8 @@ struct BlockKeyList : BaseKeyList {
     set_used_size(kSizeofOverhead);
     add_block(0, Index::kInitialBlockSize);
     block_cache.is_active = false;
-    assert(sizeof(block_cache.data) >= 4 * (Index::kMaxKeysPerBlock - 1));
+    assert(sizeof(block_cache.data)
+                    >= sizeof(KeyType) * (Index::kMaxKeysPerBlock - 1));
   }
 
   // Calculates the used size and updates the stored value
@@ -883,12 +902,19 @@ struct BlockKeyList : BaseKeyList {
 
   // Implementation for insert()
   virtual PBtreeNode::InsertResult insert_impl(size_t node_count,
-                  uint32_t key, uint32_t flags) {
+                  KeyType key, uint32_t flags) {
     int slot = 0;
+    Index *index;
 
-    // perform a linear search through the index and get the block
-    // which will receive the new key
-    Index *index = find_index(key, &slot);
+    // appended keys (i.e. from a bulk load) always go to the last block;
+    // otherwise perform a linear search through the index and get the
+    // block which will receive the new key
+    if (ISSET(flags, PBtreeNode::kInsertAppend) && node_count > 0) {
+      index = block_index(block_count() - 1);
+      slot = (int)node_count - index->key_count();
+    }
+    else
+      index = find_index(key, &slot);
 
     // first key in an empty block? then don't store a delta
     if (unlikely(index->key_count() == 0)) {
@@ -905,8 +931,8 @@ struct BlockKeyList : BaseKeyList {
       return (PBtreeNode::InsertResult(UPS_DUPLICATE_KEY,
                   slot + index->key_count() - 1));
 
-    uint32_t new_data[Index::kMaxKeysPerBlock];
-    uint32_t datap[Index::kMaxKeysPerBlock];
+    KeyType new_data[Index::kMaxKeysPerBlock];
+    KeyType datap[Index::kMaxKeysPerBlock];
 
     // A split is required if the block overflows
     bool requires_split = index->key_count() + 1 >= Index::kMaxKeysPerBlock;
@@ -952,11 +978,11 @@ struct BlockKeyList : BaseKeyList {
       // to the new block.
       //
       // The pivot position is aligned to 4.
-      uint32_t *data = uncompress_block(index, datap);
+      KeyType *data = uncompress_block(index, datap);
       uint32_t to_copy = (index->key_count() / 2) & ~0x03;
       assert(to_copy > 0);
       uint32_t new_key_count = index->key_count() - to_copy - 1;
-      uint32_t new_value = data[to_copy];
+      KeyType new_value = data[to_copy];
 
       // once more check if the key already exists
       if (unlikely(new_value == key))
@@ -964,7 +990,7 @@ struct BlockKeyList : BaseKeyList {
 
       to_copy++;
       ::memmove(&new_data[0], &data[to_copy],
-                  sizeof(int32_t) * (index->key_count() - to_copy));
+                  sizeof(KeyType) * (index->key_count() - to_copy));
 
       // Now create a new block. This can throw, but so far we have not
       // modified existing data.
@@ -975,7 +1001,7 @@ struct BlockKeyList : BaseKeyList {
 
       // add_block() can invalid the data pointer, therefore fetch it again
       if (Zint32Codec::Codec::kCompressInPlace)
-        data = (uint32_t *)block_data(index);
+        data = (KeyType *)block_data(index);
 
       // Adjust the size of the old block
       index->set_key_count(index->key_count() - new_key_count);
@@ -998,7 +1024,7 @@ struct BlockKeyList : BaseKeyList {
         // hack for BlockIndex: fetch data pointer once more because
         // it was invalidated when the new block was added
         if (Zint32Codec::Codec::kCompressInPlace)
-          data = (uint32_t *)block_data(index);
+          data = (KeyType *)block_data(index);
       }
 
       // the block was modified and needs to be compressed again, even if
@@ -1031,8 +1057,8 @@ struct BlockKeyList : BaseKeyList {
   void print_block(Index *index) const {
     std::cout << "0: " << index->value() << std::endl;
 
-    uint32_t datap[Index::kMaxKeysPerBlock];
-    uint32_t *data = uncompress_block(index, datap);
+    KeyType datap[Index::kMaxKeysPerBlock];
+    KeyType *data = uncompress_block(index, datap);
 
     for (uint32_t i = 1; i < index->key_count(); i++)
       std::cout << i << ": " << data[i - 1] << std::endl;
@@ -1059,7 +1085,7 @@ struct BlockKeyList : BaseKeyList {
 
   // Performs a linear search through the index; returns the index
   // and the slot of the first key in this block in |*pslot|.
-  Index *find_index(uint32_t key, int *pslot) {
+  Index *find_index(KeyType key, int *pslot) {
     Index *index = block_index(0);
     Index *iend = block_index(block_count());
 
@@ -1195,9 +1221,9 @@ struct BlockKeyList : BaseKeyList {
   }
 
   // Performs a lower bound search
-  int lower_bound_search(uint32_t *begin, uint32_t *end, uint32_t key,
+  int lower_bound_search(KeyType *begin, KeyType *end, KeyType key,
                   int *pcmp) const {
-    uint32_t *it = std::lower_bound(begin, end, key);
+    KeyType *it = std::lower_bound(begin, end, key);
     if (likely(it != end))
       *pcmp = (*it == key) ? 0 : +1;
     else // not found
@@ -1238,13 +1264,13 @@ struct BlockKeyList : BaseKeyList {
   }
 
   // Compresses a block of data
-  uint32_t compress_block(Index *index, uint32_t *in) {
+  uint32_t compress_block(Index *index, KeyType *in) {
     return Zint32Codec::compress_block(index, &block_cache,
                             in, (uint32_t *)block_data(index));
   }
 
   // Uncompresses a block of data
-  uint32_t *uncompress_block(Index *index, uint32_t *out) const {
+  KeyType *uncompress_block(Index *index, KeyType *out) const {
     return Zint32Codec::uncompress_block(index,
                             (uint32_t *)block_data(index), out);
   }
@@ -1253,7 +1279,7 @@ struct BlockKeyList : BaseKeyList {
   uint8_t *data_;
 
   // helper variable to avoid returning pointers to local memory
-  uint32_t dummy;
+  KeyType dummy;
 
   // Cache for speeding up the select() operation
   BlockCache block_cache;
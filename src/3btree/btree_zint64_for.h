@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Compressed 64bit integer keys (Frame Of Reference)
+ *
+ * libfor only supports 32bit integers. Each block therefore stores the
+ * bit width of its keys (one byte), followed by the bit-packed differences
+ * of all keys to the first key of the block (|index->value()|). The keys
+ * can be selected without decoding the whole block.
+ */
+
+#ifndef UPS_BTREE_KEYS_FOR64_H
+#define UPS_BTREE_KEYS_FOR64_H
+
+#include "0root/root.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "3btree/btree_zint32_block.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+//
+// The template classes in this file are wrapped in a separate namespace
+// to avoid naming clashes with other KeyLists
+//
+namespace Zint64 {
+
+// Reads the |i|th packed value with |bits| bits from |in|
+static inline uint64_t
+for64_read(const uint8_t *in, uint32_t bits, uint32_t i)
+{
+  uint64_t pos = (uint64_t)i * bits;
+  const uint8_t *p = in + pos / 8;
+  uint32_t shift = pos % 8;
+  uint32_t length = (shift + bits + 7) / 8;
+
+  uint64_t v = 0;
+  ::memcpy(&v, p, length > 8 ? 8 : length);
+  v >>= shift;
+  if (length > 8)
+    v |= (uint64_t)p[8] << (64 - shift);
+  return bits == 64 ? v : v & ((1ull << bits) - 1);
+}
+
+// Writes the |i|th packed value with |bits| bits to |out|; the
+// destination bits must be zeroed
+static inline void
+for64_write(uint8_t *out, uint32_t bits, uint32_t i, uint64_t v)
+{
+  uint64_t pos = (uint64_t)i * bits;
+  uint8_t *p = out + pos / 8;
+  uint32_t shift = pos % 8;
+  uint32_t length = (shift + bits + 7) / 8;
+
+  uint64_t w = 0;
+  ::memcpy(&w, p, length > 8 ? 8 : length);
+  w |= v << shift;
+  ::memcpy(p, &w, length > 8 ? 8 : length);
+  if (length > 8)
+    p[8] |= (uint8_t)(v >> (64 - shift));
+}
+
+// This structure is an "index" entry which describes the location
+// of a variable-length block
+#include "1base/packstart.h"
+UPS_PACK_0 struct UPS_PACK_1 ForIndex : Zint32::IndexBaseImpl<uint64_t> {
+  enum {
+    // Initial size of a new block
+    kInitialBlockSize = 1 + 16,
+
+    // Maximum keys per block; 128 keys with 64 bits each fill 1 kb,
+    // and the block size must not exceed 11 bits
+    kMaxKeysPerBlock = 128 + 1,
+  };
+
+  // initialize this block index
+  void initialize(uint32_t offset, uint8_t *block_data, size_t block_size) {
+    Zint32::IndexBaseImpl<uint64_t>::initialize(offset, block_data,
+                    block_size);
+    _block_size = block_size;
+    _used_size = 0;
+    _key_count = 0;
+
+    // clear the metadata
+    *block_data = 0;
+  }
+
+  // returns the used size of the block
+  uint32_t used_size() const {
+    return _used_size;
+  }
+
+  // sets the used size of the block
+  void set_used_size(uint32_t size) {
+    _used_size = size;
+  }
+
+  // returns the total block size
+  uint32_t block_size() const {
+    return _block_size;
+  }
+
+  // sets the total block size
+  void set_block_size(uint32_t size) {
+    _block_size = size;
+  }
+
+  // returns the key count
+  uint32_t key_count() const {
+    return _key_count;
+  }
+
+  // sets the key count
+  void set_key_count(uint32_t key_count) {
+    _key_count = key_count;
+  }
+
+  // copies this block to the |dest| block
+  void copy_to(const uint8_t *block_data, ForIndex *dest,
+                  uint8_t *dest_data) {
+    dest->set_value(value());
+    dest->set_key_count(key_count());
+    dest->set_used_size(used_size());
+    dest->set_highest(highest());
+    ::memcpy(dest_data, block_data, block_size());
+  }
+
+  // the total size of this block
+  unsigned int _block_size : 11;
+
+  // used size of this block
+  unsigned int _used_size : 11;
+
+  // the number of keys in this block; max 511 (kMaxKeysPerBlock)
+  unsigned int _key_count : 9;
+} UPS_PACK_2;
+#include "1base/packstop.h"
+
+struct ForCodecImpl : Zint32::BlockCodecBase<ForIndex> {
+  enum {
+    kHasCompressApi = 1,
+    kHasFindLowerBoundApi = 1,
+    kHasSelectApi = 1,
+    kHasAppendApi = 1,
+  };
+
+  static uint64_t *uncompress_block(ForIndex *index,
+                  const uint32_t *block_data, uint64_t *out) {
+    const uint8_t *in = (const uint8_t *)block_data;
+    uint32_t bits = *in;
+    uint64_t base = index->value();
+    for (uint32_t i = 0; i < index->key_count() - 1; i++)
+      out[i] = base + for64_read(in + 1, bits, i);
+    return out;
+  }
+
+  static uint32_t compress_block(ForIndex *index, const uint64_t *in,
+                  uint32_t *out32) {
+    assert(index->key_count() > 0);
+    uint32_t count = index->key_count() - 1;
+    if (count == 0)
+      return 0;
+
+    // the keys are sorted; the last one has the largest difference
+    uint64_t base = index->value();
+    uint32_t b = bits(in[count - 1] - base);
+    uint32_t s = required_size(count, b);
+
+    uint8_t *out = (uint8_t *)out32;
+    ::memset(out, 0, s);
+    *out = (uint8_t)b;
+    for (uint32_t i = 0; i < count; i++)
+      for64_write(out + 1, b, i, in[i] - base);
+    return s;
+  }
+
+  static bool append(ForIndex *index, uint32_t *block_data32,
+                  uint64_t key, int *pslot) {
+    uint8_t *data = (uint8_t *)block_data32;
+    uint32_t count = index->key_count() - 1;
+    uint32_t b = *data;
+    uint64_t delta = key - index->value();
+
+    // the new key does not fit? then compress the block again
+    if (count == 0 || bits(delta) > b) {
+      uint64_t tmp[ForIndex::kMaxKeysPerBlock];
+      if (count > 0)
+        uncompress_block(index, block_data32, &tmp[0]);
+      tmp[count] = key;
+      index->set_key_count(index->key_count() + 1);
+      index->set_used_size(compress_block(index, &tmp[0], block_data32));
+    }
+    else {
+      uint32_t s = required_size(count + 1, b);
+      if (s > index->used_size())
+        ::memset(data + index->used_size(), 0, s - index->used_size());
+      for64_write(data + 1, b, count, delta);
+      index->set_key_count(index->key_count() + 1);
+      index->set_used_size(s);
+    }
+
+    *pslot += index->key_count() - 1;
+    return true;
+  }
+
+  static int find_lower_bound(ForIndex *index, const uint32_t *block_data,
+                  uint64_t key, uint64_t *result) {
+    const uint8_t *in = (const uint8_t *)block_data;
+    uint32_t count = index->key_count() - 1;
+    uint32_t bits = *in;
+    uint64_t base = index->value();
+
+    // binary search; all values are accessed directly
+    uint32_t lower = 0;
+    uint32_t upper = count;
+    while (lower < upper) {
+      uint32_t middle = lower + (upper - lower) / 2;
+      if (base + for64_read(in + 1, bits, middle) < key)
+        lower = middle + 1;
+      else
+        upper = middle;
+    }
+
+    if (lower < count)
+      *result = base + for64_read(in + 1, bits, lower);
+    else
+      *result = key + 1;
+    return (int)lower;
+  }
+
+  // Returns a decompressed value
+  static uint64_t select(ForIndex *index, uint32_t *block_data,
+                        int position_in_block) {
+    const uint8_t *in = (const uint8_t *)block_data;
+    return index->value() + for64_read(in + 1, *in, position_in_block);
+  }
+
+  static uint32_t estimate_required_size(ForIndex *index, uint8_t *block_data,
+                        uint64_t key) {
+    uint64_t min = key < index->value() ? key : index->value();
+    uint64_t max = key > index->highest() ? key : index->highest();
+    uint32_t s = required_size(index->key_count(), bits(max - min));
+    return s + 8; // reserve a few bytes for the next key
+  }
+
+  // returns the size of a block with |count| values of |bits| bits
+  static uint32_t required_size(uint32_t count, uint32_t bits) {
+    return 1 + (count * bits + 7) / 8;
+  }
+
+  // returns the integer logarithm of v (bit width)
+  static uint32_t bits(const uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long answer;
+    if (v == 0)
+      return 0;
+    _BitScanReverse64(&answer, v);
+    return answer + 1;
+#else
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+#endif
+  }
+};
+
+typedef Zint32::Zint32Codec<ForIndex, ForCodecImpl> ForCodec;
+
+struct ForKeyList : Zint32::BlockKeyList<ForCodec> {
+  // Constructor
+  ForKeyList(LocalDb *db, PBtreeNode *node)
+    : Zint32::BlockKeyList<ForCodec>(db, node) {
+  }
+};
+
+} // namespace Zint64
+
+} // namespace upscaledb
+
+#endif // UPS_BTREE_KEYS_FOR64_H
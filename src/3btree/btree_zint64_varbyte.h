@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Compressed 64bit integer keys (delta encoding + varbyte)
+ *
+ * Uses the 64bit functions of libvbyte. Inserts and deletes in the
+ * middle of a block uncompress the block, modify it and compress it again.
+ */
+
+#ifndef UPS_BTREE_KEYS_VARBYTE64_H
+#define UPS_BTREE_KEYS_VARBYTE64_H
+
+#include "3rdparty/libvbyte/vbyte.h"
+
+#include "0root/root.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "3btree/btree_zint32_block.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+//
+// The template classes in this file are wrapped in a separate namespace
+// to avoid naming clashes with other KeyLists
+//
+namespace Zint64 {
+
+// This structure is an "index" entry which describes the location
+// of a variable-length block
+#include "1base/packstart.h"
+UPS_PACK_0 struct UPS_PACK_1 VarbyteIndex
+        : Zint32::IndexBaseImpl<uint64_t> {
+  enum {
+    // Initial size of a new block
+    kInitialBlockSize = 16,
+
+    // Maximum keys per block; a delta requires up to 10 bytes, and
+    // the block size must not exceed 11 bits
+    kMaxKeysPerBlock = 128 + 1,
+  };
+
+  // initialize this block index
+  void initialize(uint32_t offset, uint8_t *block_data, size_t block_size) {
+    Zint32::IndexBaseImpl<uint64_t>::initialize(offset, block_data,
+                    block_size);
+    _block_size = block_size;
+    _used_size = 0;
+    _key_count = 0;
+  }
+
+  // returns the used size of the block
+  uint32_t used_size() const {
+    return _used_size;
+  }
+
+  // sets the used size of the block
+  void set_used_size(uint32_t size) {
+    _used_size = size;
+  }
+
+  // returns the total block size
+  uint32_t block_size() const {
+    return _block_size;
+  }
+
+  // sets the total block size
+  void set_block_size(uint32_t size) {
+    _block_size = size;
+  }
+
+  // returns the key count
+  uint32_t key_count() const {
+    return _key_count;
+  }
+
+  // sets the key count
+  void set_key_count(uint32_t key_count) {
+    _key_count = key_count;
+  }
+
+  // copies this block to the |dest| block
+  void copy_to(const uint8_t *block_data, VarbyteIndex *dest,
+                  uint8_t *dest_data) {
+    dest->set_value(value());
+    dest->set_key_count(key_count());
+    dest->set_used_size(used_size());
+    dest->set_highest(highest());
+    ::memcpy(dest_data, block_data, block_size());
+  }
+
+  // the total size of this block
+  unsigned int _block_size : 11;
+
+  // used size of this block
+  unsigned int _used_size : 11;
+
+  // the number of keys in this block; max 511 (kMaxKeysPerBlock)
+  unsigned int _key_count : 9;
+} UPS_PACK_2;
+#include "1base/packstop.h"
+
+struct VarbyteCodecImpl : Zint32::BlockCodecBase<VarbyteIndex> {
+  enum {
+    kHasCompressApi = 1,
+    kHasFindLowerBoundApi = 1,
+    kHasAppendApi = 1,
+    kHasSelectApi = 1,
+  };
+
+  static uint64_t *uncompress_block(VarbyteIndex *index,
+                  const uint32_t *block_data, uint64_t *out) {
+    const uint8_t *in = (const uint8_t *)block_data;
+    vbyte_uncompress_sorted64(in, out, index->value(),
+                    index->key_count() - 1);
+    return out;
+  }
+
+  static uint32_t compress_block(VarbyteIndex *index, const uint64_t *in,
+                  uint32_t *out32) {
+    uint8_t *out = (uint8_t *)out32;
+    return vbyte_compress_sorted64(in, out, index->value(),
+                    index->key_count() - 1);
+  }
+
+  static int find_lower_bound(VarbyteIndex *index, const uint32_t *block_data,
+                  uint64_t key, uint64_t *result) {
+    const uint8_t *in = (const uint8_t *)block_data;
+    *result = key + 1;
+    return vbyte_search_lower_bound_sorted64(in, index->key_count() - 1,
+                    key, index->value(), result);
+  }
+
+  static bool append(VarbyteIndex *index, uint32_t *block_data32,
+                  uint64_t key, int *pslot) {
+    uint8_t *end = (uint8_t *)block_data32 + index->used_size();
+    size_t space = vbyte_append_sorted64(end, index->highest(), key);
+
+    index->set_key_count(index->key_count() + 1);
+    index->set_used_size(index->used_size() + space);
+    *pslot += index->key_count() - 1;
+    return true;
+  }
+
+  // Returns a decompressed value
+  static uint64_t select(VarbyteIndex *index, uint32_t *block_data,
+                        int position_in_block) {
+    const uint8_t *in = (const uint8_t *)block_data;
+    return vbyte_select_sorted64(in, index->key_count() - 1,
+                    index->value(), position_in_block);
+  }
+
+  // The delta of the new key is never larger than its distance to the
+  // first key of the block; the delta of its successor can only shrink
+  static uint32_t estimate_required_size(VarbyteIndex *index,
+                        uint8_t *block_data, uint64_t key) {
+    uint64_t delta = key > index->value()
+                        ? key - index->value()
+                        : index->value() - key;
+    return index->used_size() + calculate_delta_size(delta);
+  }
+
+  // returns the compressed size of |value|
+  static int calculate_delta_size(uint64_t value) {
+    int size = 1;
+    while (value >= (1ull << 7)) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+};
+
+typedef Zint32::Zint32Codec<VarbyteIndex, VarbyteCodecImpl> VarbyteCodec;
+
+struct VarbyteKeyList : Zint32::BlockKeyList<VarbyteCodec> {
+  // Constructor
+  VarbyteKeyList(LocalDb *db, PBtreeNode *node)
+    : Zint32::BlockKeyList<VarbyteCodec>(db, node) {
+  }
+};
+
+} // namespace Zint64
+
+} // namespace upscaledb
+
+#endif // UPS_BTREE_KEYS_VARBYTE64_H
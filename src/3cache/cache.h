@@ -20,11 +20,16 @@
  * The Cache Manager
  *
  * Stores pages in a non-intrusive hash table (each Page instance keeps
- * next/previous pointers for the overflow bucket). Can efficiently purge
- * unused pages, because all pages are also stored in a (non-intrusive)
- * linked list, and whenever a page is accessed it is removed and re-inserted
- * at the head. The tail therefore points to the page which was not used
- * in a long time, and is the primary candidate for purging.
+ * next/previous pointers for the overflow bucket). The hash buckets are
+ * distributed over several shards; each shard has its own lock, and
+ * threads which access pages of different shards do not block each other.
+ *
+ * Each shard stores its pages in two lists (see CacheShard). A cache hit
+ * only sets the "referenced" bit of the page, but does not modify the
+ * lists. Pages which were referenced are promoted (or get a second chance)
+ * when the cache is purged. Pages which were accessed only once are
+ * evicted first; a full table scan therefore does not flush the whole
+ * working set.
  *
  * @exception_safe: nothrow
  * @thread_safe: yes
@@ -62,21 +67,12 @@ calc_hash(uint64_t value)
 
 struct Cache
 {
-  template<typename Purger>
-  struct PurgeIfSelector {
-    PurgeIfSelector(Cache *cache, Purger &purger)
-      : cache_(cache), purger_(purger) {
-    }
-
-    bool operator()(Page *page) {
-      if (purger_(page))
-        cache_->del(page);
-      // don't remove page from list; it was already removed above
-      return false;
-    }
+  enum {
+    // Page::cache_flags: the page was accessed since the cache was purged
+    kReferenced = 1,
 
-    Cache *cache_;
-    Purger &purger_;
+    // Page::cache_flags: the page is stored in the "protected" list
+    kProtected = 2
   };
 
   // The default constructor
@@ -86,43 +82,83 @@ struct Cache
 
   // Fills in the current metrics
   void fill_metrics(ups_env_metrics_t *metrics) const {
-    metrics->cache_hits = state.cache_hits;
-    metrics->cache_misses = state.cache_misses;
+    metrics->cache_hits = 0;
+    metrics->cache_misses = 0;
+    metrics->cache_shards = (uint32_t)state.num_shards;
+    for (size_t i = 0; i < state.num_shards; i++) {
+      const CacheShard &shard = state.shards[i];
+      metrics->cache_shard_hits[i] = shard.cache_hits;
+      metrics->cache_shard_misses[i] = shard.cache_misses;
+      metrics->cache_hits += shard.cache_hits;
+      metrics->cache_misses += shard.cache_misses;
+    }
   }
 
-  // Retrieves a page from the cache, also removes the page from the cache
-  // and re-inserts it at the front. Returns null if the page was not cached.
+  // Retrieves a page from the cache, and sets its "referenced" bit.
+  // Returns null if the page was not cached.
   Page *get(uint64_t address) {
     size_t hash = Impl::calc_hash(address);
+    CacheShard &shard = shard_of(hash);
+    ScopedSpinlock lock(shard.mutex);
 
     Page *page = state.buckets[hash].get(address);
     if (!page) {
-      state.cache_misses++;
+      shard.cache_misses++;
       return 0;
     }
 
-    // Now re-insert the page at the head of the "totallist", and
-    // thus move far away from the tail. The pages at the tail are highest
-    // candidates to be deleted when the cache is purged.
-    state.totallist.del(page);
-    state.totallist.put(page);
-    state.cache_hits++;
+    // Do NOT move the page in the lists; this would require a write
+    // lock on a (shared) list for every single access
+    set_referenced(page);
+    shard.cache_hits++;
+    return page;
+  }
+
+  // Returns true if the page is cached. Does not update the statistics
+  // and does not set the "referenced" bit.
+  bool contains(uint64_t address) {
+    size_t hash = Impl::calc_hash(address);
+    ScopedSpinlock lock(shard_of(hash).mutex);
+    return state.buckets[hash].get(address) != 0;
+  }
+
+  // Same as get(), but calls |visitor(page)| while the shard is locked.
+  // Therefore the page cannot be purged while the visitor is active. If
+  // |visitor| returns false then the lookup is aborted (and null is
+  // returned). A miss is not counted; the caller is expected to retry
+  // with get().
+  template<typename Visitor>
+  Page *get_if(uint64_t address, Visitor &visitor) {
+    size_t hash = Impl::calc_hash(address);
+    CacheShard &shard = shard_of(hash);
+    ScopedSpinlock lock(shard.mutex);
+
+    Page *page = state.buckets[hash].get(address);
+    if (!page || !visitor(page))
+      return 0;
+
+    set_referenced(page);
+    shard.cache_hits++;
     return page;
   }
 
   // Stores a page in the cache
   void put(Page *page) {
     size_t hash = Impl::calc_hash(page->address());
+    CacheShard &shard = shard_of(hash);
+    ScopedSpinlock lock(shard.mutex);
+
+    // If the page is already cached then it's treated like a cache hit;
+    // otherwise it's inserted on probation
+    if (list_of(shard, page).has(page)) {
+      set_referenced(page);
+      return;
+    }
 
-    /* First remove the page from the cache, if it's already cached
-     *
-     * Then re-insert the page at the head of the list. The tail will
-     * point to the least recently used page.
-     */
-    state.totallist.del(page);
-    state.totallist.put(page);
+    page->cache_flags = 0;
+    shard.probation.put(page);
     if (page->is_allocated())
-      state.alloc_elements++;
+      shard.alloc_elements++;
 
     state.buckets[hash].put(page);
   }
@@ -131,56 +167,54 @@ struct Cache
   void del(Page *page) {
     assert(page->address() != 0);
 
-    /* remove it from the list of all cached pages */
-    if (state.totallist.del(page) && page->is_allocated())
-      state.alloc_elements--;
-
-    /* remove the page from the cache buckets */
     size_t hash = Impl::calc_hash(page->address());
-    state.buckets[hash].del(page);
+    CacheShard &shard = shard_of(hash);
+    ScopedSpinlock lock(shard.mutex);
+    del_impl(shard, hash, page);
   }
 
-  // Purges the cache. Implements a LRU eviction algorithm. Dirty pages are
-  // forwarded to the |processor()| for flushing.
+  // Purges the cache. Dirty pages are forwarded to the |processor()| for
+  // flushing.
   // The |ignore_page| is passed by the caller; this page will not be purged
   // under any circumstance. This is used by the PageManager to make sure
   // that the "last blob page" is not evicted by the cache.
+  //
+  // Each shard is locked separately, and only for the time it is purged.
   void purge_candidates(std::vector<uint64_t> &candidates,
                   std::vector<Page *> &garbage,
                   Page *ignore_page) {
-    int limit = (int)(current_elements()
-                      - (state.capacity_bytes / state.page_size_bytes));
-
-    Page *page = state.totallist.tail();
-    for (int i = 0; i < limit && page != 0; i++) {
-      if (page->mutex().try_lock()) {
-        if (page->cursor_list.size() == 0
-              && page != ignore_page
-              && page->type() != Page::kTypeBroot) {
-          if (page->is_dirty())
-            candidates.push_back(page->address());
-          else
-            garbage.push_back(page);
-        }
-        page->mutex().unlock();
-      }
-
-      page = page->previous(Page::kListCache);
+    size_t elements = current_elements();
+    uint64_t capacity = state.capacity_bytes / state.page_size_bytes;
+    if (elements <= capacity)
+      return;
+
+    // every shard evicts its share of the pages
+    size_t limit = (size_t)(elements - capacity);
+    for (size_t i = 0; i < state.num_shards; i++) {
+      CacheShard &shard = state.shards[i];
+      ScopedSpinlock lock(shard.mutex);
+      size_t shard_limit = (limit * shard.size() + elements - 1) / elements;
+      purge_shard(shard, shard_limit, (size_t)(capacity / state.num_shards),
+                      candidates, garbage, ignore_page);
     }
   }
 
-  // Visits all pages in the "totallist". If |cb| returns true then the
-  // page is removed and deleted. This is used by the Environment
+  // Visits all cached pages. If |purger| returns true then the
+  // page is removed from the cache. This is used by the Environment
   // to flush (and delete) pages.
   template<typename Purger>
   void purge_if(Purger &purger) {
-    PurgeIfSelector<Purger> selector(this, purger);
-    state.totallist.extract(selector);
+    for (size_t i = 0; i < state.num_shards; i++) {
+      CacheShard &shard = state.shards[i];
+      ScopedSpinlock lock(shard.mutex);
+      purge_list_if(shard, shard.probation, purger);
+      purge_list_if(shard, shard.protected_pages, purger);
+    }
   }
 
   // Returns true if the capacity limits are exceeded
   bool is_cache_full() const {
-    return state.totallist.size() * state.page_size_bytes
+    return current_elements() * state.page_size_bytes
             > state.capacity_bytes;
   }
 
@@ -191,13 +225,124 @@ struct Cache
 
   // Returns the number of currently cached elements
   size_t current_elements() const {
-    return state.totallist.size();
+    size_t size = 0;
+    for (size_t i = 0; i < state.num_shards; i++)
+      size += state.shards[i].size();
+    return size;
   }
 
   // Returns the number of currently cached elements (excluding those that
   // are mmapped)
   size_t allocated_elements() const {
-    return state.alloc_elements;
+    size_t size = 0;
+    for (size_t i = 0; i < state.num_shards; i++)
+      size += state.shards[i].alloc_elements;
+    return size;
+  }
+
+  // Sets the "referenced" bit of a page; avoids the write if the bit
+  // is already set
+  static void set_referenced(Page *page) {
+    if (!(page->cache_flags & kReferenced))
+      page->cache_flags |= kReferenced;
+  }
+
+  // Returns the shard which manages the bucket |hash|
+  CacheShard &shard_of(size_t hash) {
+    return state.shards[hash % state.num_shards];
+  }
+
+  // Returns the list of a shard which stores |page|
+  static CacheShard::PageList &list_of(CacheShard &shard, Page *page) {
+    return (page->cache_flags & kProtected)
+              ? shard.protected_pages
+              : shard.probation;
+  }
+
+  // Removes a page from the cache; the shard is already locked
+  void del_impl(CacheShard &shard, size_t hash, Page *page) {
+    /* remove it from the list of all cached pages */
+    if (list_of(shard, page).del(page) && page->is_allocated())
+      shard.alloc_elements--;
+    page->cache_flags = 0;
+
+    /* remove the page from the cache buckets */
+    state.buckets[hash].del(page);
+  }
+
+  // Applies |purger| to all pages of a list, and removes those which
+  // were purged
+  template<typename Purger>
+  void purge_list_if(CacheShard &shard, CacheShard::PageList &list,
+                  Purger &purger) {
+    Page *page = list.head();
+    while (page) {
+      Page *next = page->next(Page::kListCache);
+      if (purger(page))
+        del_impl(shard, Impl::calc_hash(page->address()), page);
+      page = next;
+    }
+  }
+
+  // Moves up to |limit| pages of a shard to the |candidates| (if they are
+  // dirty) or to the |garbage| (if they can be deleted).
+  //
+  // Pages on probation are evicted first, unless the probation list
+  // became too small. Referenced pages on probation are promoted instead.
+  // The protected pages are evicted with the CLOCK algorithm: a referenced
+  // page gets a second chance and is moved to the head of the list.
+  void purge_shard(CacheShard &shard, size_t limit, size_t capacity,
+                  std::vector<uint64_t> &candidates,
+                  std::vector<Page *> &garbage, Page *ignore_page) {
+    Page *probation = shard.probation.tail();
+    Page *protected_page = shard.protected_pages.tail();
+    size_t probation_left = shard.probation.size();
+    size_t protected_left = shard.protected_pages.size();
+
+    while (limit > 0) {
+      Page *page;
+      if (probation && (probation_left > capacity / 4 || !protected_left)) {
+        page = probation;
+        probation = page->previous(Page::kListCache);
+        probation_left--;
+
+        // the page was accessed again: promote it
+        if (page->cache_flags & kReferenced) {
+          shard.probation.del(page);
+          shard.protected_pages.put(page);
+          page->cache_flags = kProtected;
+          continue;
+        }
+      }
+      else if (protected_left > 0) {
+        page = protected_page;
+        protected_page = page->previous(Page::kListCache);
+        protected_left--;
+
+        // give the page a second chance
+        if (page->cache_flags & kReferenced) {
+          shard.protected_pages.del(page);
+          shard.protected_pages.put(page);
+          page->cache_flags = kProtected;
+          continue;
+        }
+      }
+      else
+        break;
+
+      if (page->mutex().try_lock()) {
+        if (page->cursor_list.size() == 0
+              && page != ignore_page
+              && page->type() != Page::kTypeBroot) {
+          if (page->is_dirty())
+            candidates.push_back(page->address());
+          else
+            garbage.push_back(page);
+          limit--;
+        }
+        page->mutex().unlock();
+      }
+    }
   }
 
   CacheState state;
@@ -22,10 +22,14 @@
 #include "0root/root.h"
 
 #include <vector>
+#include <limits>
+#include <algorithm>
 
 #include "ups/types.h"
+#include "ups/upscaledb_int.h"
 
 // Always verify that a file of level N does not include headers > N!
+#include "1base/spinlock.h"
 #include "2page/page.h"
 #include "2page/page_collection.h"
 #include "2config/env_config.h"
@@ -36,6 +40,47 @@
 
 namespace upscaledb {
 
+// A shard of the cache. Each shard manages the pages of a subset of
+// the hash buckets, and is protected by its own lock.
+//
+// The pages are stored in two lists (a variant of 2Q): pages which are
+// inserted are on "probation". When they are accessed again then they
+// are moved to the "protected" list as soon as the cache is purged.
+// Pages which are only accessed once (i.e. by a full table scan) are
+// therefore evicted first, and do not replace the working set.
+struct CacheShard
+{
+  typedef PageCollection<Page::kListCache> PageList;
+
+  CacheShard()
+    : alloc_elements(0), cache_hits(0), cache_misses(0) {
+  }
+
+  // Returns the number of pages in this shard
+  size_t size() const {
+    return probation.size() + protected_pages.size();
+  }
+
+  // Protects this shard and its buckets
+  Spinlock mutex;
+
+  // pages which were inserted recently, and not accessed again
+  PageList probation;
+
+  // pages which were accessed more than once
+  PageList protected_pages;
+
+  // the current number of cached elements that were allocated (and not
+  // mapped)
+  size_t alloc_elements;
+
+  // counts the cache hits
+  uint64_t cache_hits;
+
+  // counts the cache misses
+  uint64_t cache_misses;
+};
+
 struct CacheState
 {
   typedef PageCollection<Page::kListBucket> CacheLine;
@@ -44,15 +89,23 @@ struct CacheState
     // The number of buckets should be a prime number or similar, as it
     // is used in a MODULO hash scheme
     kBucketSize = 10317,
+
+    // The maximum number of shards
+    kMaxShards = UPS_MAX_CACHE_SHARDS,
+
+    // Minimum number of pages per shard; small caches are not sharded
+    kMinPagesPerShard = 64
   };
 
   CacheState(const EnvConfig &config)
     : capacity_bytes(ISSET(config.flags, UPS_CACHE_UNLIMITED)
                             ? std::numeric_limits<uint64_t>::max()
                             : config.cache_size_bytes),
-      page_size_bytes(config.page_size_bytes), alloc_elements(0),
-      buckets(kBucketSize), cache_hits(0), cache_misses(0) {
+      page_size_bytes(config.page_size_bytes), buckets(kBucketSize) {
     assert(capacity_bytes > 0);
+    uint64_t capacity_pages = capacity_bytes / page_size_bytes;
+    num_shards = (size_t)std::min<uint64_t>(kMaxShards,
+                    std::max<uint64_t>(1, capacity_pages / kMinPagesPerShard));
   }
 
   // the capacity (in bytes)
@@ -61,21 +114,15 @@ struct CacheState
   // the current page size (in bytes)
   uint64_t page_size_bytes;
 
-  // the current number of cached elements that were allocated (and not
-  // mapped)
-  size_t alloc_elements;
+  // the number of shards which are in use
+  size_t num_shards;
 
-  // linked list of ALL cached pages
-  PageCollection<Page::kListCache> totallist;
+  // the shards
+  CacheShard shards[kMaxShards];
 
-  // The hash table buckets - each is a linked list of Page pointers
+  // The hash table buckets - each is a linked list of Page pointers. A
+  // bucket is protected by the lock of its shard
   std::vector<CacheLine> buckets;
-
-  // counts the cache hits
-  uint64_t cache_hits;
-
-  // counts the cache misses
-  uint64_t cache_misses;
 };
 
 } // namespace upscaledb
@@ -28,6 +28,7 @@
 #include "3changeset/changeset.h"
 #include "3journal/journal.h"
 #include "3page_manager/page_manager.h"
+#include "4db/db_local.h"
 #include "4env/env_local.h"
 
 #ifndef UPS_ROOT_H
@@ -67,6 +68,26 @@ static void
 flush_changeset_to_file(std::vector<Page *> list, Device *device,
                 Journal *journal, uint64_t lsn, bool enable_fsync)
 {
+  // The device submits all pages (and the fsync) with a single call
+  if (device->supports_batched_writes()) {
+    for (std::vector<Page *>::iterator it = list.begin();
+                    it != list.end(); it++) {
+      Page *page = *it;
+      assert(page->mutex().try_lock() == false);
+      page->mutex().acquire_ownership();
+      if (likely(page->is_without_header() == false))
+        page->set_lsn(lsn);
+    }
+
+    Page::flush_all(device, list, enable_fsync);
+
+    for (std::vector<Page *>::iterator it = list.begin();
+                    it != list.end(); it++)
+      (*it)->mutex().unlock();
+    UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
+    return;
+  }
+
   std::vector<Page *>::iterator it = list.begin();
   for (; it != list.end(); it++) {
     Page *page = *it;
@@ -92,18 +113,66 @@ flush_changeset_to_file(std::vector<Page *> list, Device *device,
   UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
 }
 
+bool
+Changeset::is_leaf_redo_enabled() const
+{
+  return env->journal.get() != 0
+            && ISSET(env->config.flags, UPS_ENABLE_DELTA_JOURNAL);
+}
+
+void
+Changeset::add_leaf_redo(Page *page, uint8_t type, uint32_t flags,
+                uint32_t record_flags, uint32_t slot, const ups_key_t *key,
+                const ups_record_t *record)
+{
+  LeafRedo &redo = leaf_redo[page->address()];
+  redo.db = page->db();
+
+  PJournalEntryLeafRedo entry;
+  entry.type = type;
+  entry.dbname = page->db()->name();
+  entry.flags = flags;
+  entry.record_flags = record_flags;
+  entry.slot = slot;
+  entry.key_size = key ? key->size : 0;
+  entry.record_size = record ? record->size : 0;
+
+  const uint8_t *p = (const uint8_t *)&entry;
+  redo.records.insert(redo.records.end(), p, p + sizeof(entry));
+  if (entry.key_size) {
+    p = (const uint8_t *)key->data;
+    redo.records.insert(redo.records.end(), p, p + entry.key_size);
+  }
+  if (entry.record_size) {
+    p = (const uint8_t *)record->data;
+    redo.records.insert(redo.records.end(), p, p + entry.record_size);
+  }
+}
+
 void
 Changeset::clear()
 {
+  for (std::vector<Page *>::iterator it = shared_pages.begin();
+                  it != shared_pages.end(); it++)
+    (*it)->mutex().unlock_shared();
+  shared_pages.clear();
+
   UnlockPage unlocker;
   collection.for_each(unlocker);
   collection.clear();
+  leaf_redo.clear();
 }
 
 void
 Changeset::flush(uint64_t lsn)
 {
   // now flush all modified pages to disk
+  assert(!is_shared);
+
+  // the redo records only describe the modifications of this changeset
+  LeafRedoMap redo;
+  redo.swap(leaf_redo);
+
   if (collection.is_empty())
     return;
   
@@ -119,7 +188,7 @@ Changeset::flush(uint64_t lsn)
   // Append all changes to the journal. This operation basically
   // "write-ahead logs" all changes.
   env->journal->append_changeset(visitor.list,
-                  env->page_manager->last_blob_page_id(), lsn);
+                  env->page_manager->last_blob_page_id(), lsn, &redo);
 
   UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
 
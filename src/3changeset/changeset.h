@@ -30,6 +30,9 @@
 #include "0root/root.h"
 
 #include <stdlib.h>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 // Always verify that a file of level N does not include headers > N!
 #include "2config/env_config.h"
@@ -43,10 +46,29 @@
 namespace upscaledb {
 
 struct LocalEnv;
+struct LocalDb;
 
 struct Changeset {
+  /* With UPS_ENABLE_DELTA_JOURNAL: the logical redo records of a leaf
+   * (PJournalEntryLeafRedo, each followed by the key and the record data)
+   * which describe all modifications of this leaf in the changeset */
+  struct LeafRedo {
+    LeafRedo()
+      : db(0) {
+    }
+
+    /* The Database which owns the leaf */
+    LocalDb *db;
+
+    /* The serialized redo records */
+    std::vector<uint8_t> records;
+  };
+
+  /* The redo records, indexed by page address */
+  typedef std::map<uint64_t, LeafRedo> LeafRedoMap;
+
   Changeset(LocalEnv *env_)
-  : env(env_) {
+  : env(env_), is_shared(false) {
   }
 
   /*
@@ -54,32 +76,89 @@ struct Changeset {
    * of the changeset
    */
   Page *get(uint64_t address) {
+    for (std::vector<Page *>::iterator it = shared_pages.begin();
+                    it != shared_pages.end(); it++)
+      if ((*it)->address() == address)
+        return *it;
     return collection.get(address);
   }
 
-  /* Append a new page to the changeset. The page is locked. */
-  void put(Page *page) {
-    if (!has(page))
-      page->mutex().lock();
+  /* Append a new page to the changeset. The page is locked; in shared
+   * mode if |shared| is true or if the whole changeset is shared. */
+  void put(Page *page, bool shared = false) {
+    if (has(page))
+      return;
+    if (is_shared || shared) {
+      page->mutex().lock_shared();
+      shared_pages.push_back(page);
+      return;
+    }
+    page->mutex().lock();
+    collection.put(page);
+  }
+
+  /* Same as put(), but returns false instead of blocking if the page is
+   * locked by a different thread */
+  bool try_put(Page *page, bool shared = false) {
+    if (has(page))
+      return true;
+    if (is_shared || shared) {
+      if (!page->mutex().try_lock_shared())
+        return false;
+      shared_pages.push_back(page);
+      return true;
+    }
+    if (!page->mutex().try_lock())
+      return false;
     collection.put(page);
+    return true;
   }
 
   /* Removes a page from the changeset. The page is unlocked. */
   void del(Page *page) {
+    std::vector<Page *>::iterator it = std::find(shared_pages.begin(),
+                    shared_pages.end(), page);
+    if (it != shared_pages.end()) {
+      page->mutex().unlock_shared();
+      shared_pages.erase(it);
+      return;
+    }
     page->mutex().unlock();
     collection.del(page);
   }
 
   /* Check if the page is already part of the changeset */
   bool has(Page *page) const {
-    return collection.has(page);
+    return collection.has(page)
+            || std::find(shared_pages.begin(), shared_pages.end(), page)
+                    != shared_pages.end();
   }
 
   /* Returns true if the changeset is empty */
   bool is_empty() const {
-    return collection.is_empty();
+    return shared_pages.empty() && collection.is_empty();
   }
 
+  /* Switches to shared mode; used by read-only operations. Pages are then
+   * locked in shared mode, and several operations can read them at the
+   * same time (see UPS_ENABLE_CONCURRENT_READS). A shared changeset must
+   * not be flushed. */
+  void set_shared() {
+    assert(is_empty());
+    is_shared = true;
+  }
+
+  /* Returns true if the journal logs leaf operations as logical redo
+   * records (UPS_ENABLE_DELTA_JOURNAL) */
+  bool is_leaf_redo_enabled() const;
+
+  /* Appends a logical redo record (PJournalEntryLeafRedo::kInsert or
+   * kErase) for the leaf |page|. The operation must not allocate or free
+   * blobs, otherwise recovery could not replay it on this single page */
+  void add_leaf_redo(Page *page, uint8_t type, uint32_t flags,
+                  uint32_t record_flags, uint32_t slot, const ups_key_t *key,
+                  const ups_record_t *record);
+
   /* Removes all pages from the changeset. The pages are unlocked. */
   void clear();
 
@@ -95,6 +174,17 @@ struct Changeset {
 
   /* The pages which were added to this Changeset */
   PageCollection<Page::kListChangeset> collection;
+
+  /* True if all pages are locked in shared mode */
+  bool is_shared;
+
+  /* The pages which were locked in shared mode; they cannot be stored in
+   * the |collection| because the intrusive list of a Page can only link
+   * a single Changeset */
+  std::vector<Page *> shared_pages;
+
+  /* The logical redo records of the modified leaves */
+  LeafRedoMap leaf_redo;
 };
 
 } // namespace upscaledb
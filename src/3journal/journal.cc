@@ -19,6 +19,14 @@
 #include "0root/root.h"
 
 #include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#include <boost/bind.hpp>
+
 #ifndef WIN32
 #  include <libgen.h>
 #endif
@@ -28,9 +36,11 @@
 #include "1os/os.h"
 #include "2device/device.h"
 #include "2compressor/compressor_factory.h"
+#include "3btree/btree_index.h"
+#include "3btree/btree_node_proxy.h"
 #include "3journal/journal.h"
 #include "3page_manager/page_manager.h"
-#include "4db/db.h"
+#include "4db/db_local.h"
 #include "4txn/txn_local.h"
 #include "4env/env_local.h"
 #include "4context/context.h"
@@ -49,11 +59,34 @@ enum {
 
   // flush buffers if this limit is exceeded
   kBufferLimit = 1024 * 1024, // 1 mb
+
+  // with UPS_ENABLE_DELTA_JOURNAL: the maximum number of page images which
+  // are kept in memory; pages without image are always logged in full
+  kMaxPageImages = 256,
+
+  // the maximum number of threads which restore the changesets during
+  // recovery
+  kMaxRecoveryThreads = 8,
+
+  // do not start a recovery thread for less than |kMinPagesPerRecoveryThread|
+  // pages
+  kMinPagesPerRecoveryThread = 64,
 };
 
 static inline void
 clear_file(JournalState &state, int idx)
 {
+  // deltas must not be based on images in this file anymore
+  JournalState::PageImageMap::iterator it = state.page_images.begin();
+  while (it != state.page_images.end()) {
+    if (it->second.fd == idx)
+      state.page_images.erase(it++);
+    else
+      ++it;
+  }
+
+  state.file_bytes[idx] = 0;
+
   if (state.files[idx].is_open()) {
     state.files[idx].truncate(0);
 
@@ -101,6 +134,7 @@ flush_buffer(JournalState &state, int idx, bool fsync = false)
   if (likely(state.buffer.size() > 0)) {
     state.files[idx].write(state.buffer.data(), state.buffer.size());
     state.count_bytes_flushed += state.buffer.size();
+    state.file_bytes[idx] += state.buffer.size();
 
     state.buffer.clear();
     if (unlikely(fsync))
@@ -199,6 +233,103 @@ append_entry(JournalState &state, int idx,
     state.buffer.append(ptr5, ptr5_size);
 }
 
+// Returns true if the current file exceeds UPS_PARAM_CHECKPOINT_INTERVAL
+// or UPS_PARAM_CHECKPOINT_INTERVAL_MS
+static inline bool
+is_checkpoint_interval_exceeded(JournalState &state)
+{
+  if (state.checkpoint_interval_bytes > 0
+        && state.file_bytes[state.current_fd] >= state.checkpoint_interval_bytes)
+    return true;
+  if (state.checkpoint_interval_ms > 0) {
+    boost::posix_time::ptime now
+            = boost::posix_time::microsec_clock::universal_time();
+    if ((now - state.file_start_time).total_milliseconds()
+            >= state.checkpoint_interval_ms)
+      return true;
+  }
+  return false;
+}
+
+// Returns true if the current file is "full" and a checkpoint is required
+static inline bool
+is_checkpoint_due(JournalState &state)
+{
+  return state.num_transactions > state.threshold
+            || is_checkpoint_interval_exceeded(state);
+}
+
+// Returns true if the file |idx| is no longer required for recovery: all
+// its changesets were written to the database file, and all committed
+// Txns which were written to this file were merged
+static inline bool
+can_clear_file(JournalState &state, int idx)
+{
+  {
+    ScopedLock lock(state.sync_mutex);
+    if (state.checkpoint_pending[idx])
+      return false;
+  }
+
+  if (state.env->txn_manager.get()) {
+    for (Txn *txn = state.env->txn_manager->oldest_txn();
+                    txn != 0;
+                    txn = txn->next()) {
+      if (((LocalTxn *)txn)->log_descriptor == idx)
+        return false;
+    }
+  }
+  return true;
+}
+
+// Runs in the PageManager's worker thread, after the pages of all older
+// changesets were written. Now the file |idx| can be cleared
+static void
+complete_checkpoint(JournalState *state, int idx, bool enable_fsync)
+{
+  try {
+    if (enable_fsync)
+      state->env->device->flush();
+  }
+  catch (Exception &ex) {
+    // the file is not cleared
+    ups_log(("failed to sync the database file (error %d)", ex.code));
+    return;
+  }
+
+  ScopedLock lock(state->sync_mutex);
+  state->checkpoint_pending[idx] = false;
+}
+
+// Writes a checkpoint: the other file is cleared and becomes the current
+// file. The pages of the changesets in the previous file are written
+// asynchronously; this file can be cleared at the next checkpoint
+static inline void
+checkpoint(JournalState &state, int other)
+{
+  int idx = state.current_fd;
+
+  {
+    ScopedLock lock(state.sync_mutex);
+    state.checkpoint_pending[idx] = true;
+  }
+  state.env->page_manager->run_async(boost::bind(&complete_checkpoint,
+                          &state, idx,
+                          ISSET(state.env->flags(), UPS_ENABLE_FSYNC)));
+
+  clear_file(state, other);
+  state.current_fd = other;
+  state.num_transactions = 0;
+  state.file_start_time = boost::posix_time::microsec_clock::universal_time();
+  state.count_checkpoints++;
+
+  // the checkpoint does not consume an lsn
+  PJournalEntry entry;
+  entry.lsn = state.env->lsn_manager.current - 1;
+  entry.type = Journal::kEntryTypeCheckpoint;
+  append_entry(state, other, (uint8_t *)&entry, sizeof(entry));
+}
+
 // Switches the log file if necessary; returns the new log descriptor in the
 // transaction
 static inline int
@@ -209,12 +340,11 @@ switch_files_maybe(JournalState &state)
   // determine the journal file which is used for this transaction 
   // if the "current" file is not yet full, continue to write to this file
   //
-  // otherwise delete the other file and use the other file as the current file
-  if (unlikely(state.num_transactions > state.threshold)) {
-    clear_file(state, other);
-    state.current_fd = other;
-    state.num_transactions = 0;
-  }
+  // otherwise clear the other file and use it as the current file; if the
+  // other file is still required for recovery then continue to write to
+  // the current file
+  if (unlikely(is_checkpoint_due(state)) && can_clear_file(state, other))
+    checkpoint(state, other);
 
   return state.current_fd;
 }
@@ -307,6 +437,222 @@ append_changeset_page(JournalState &state, Page *page, uint32_t page_size)
   return page_size + sizeof(header);
 }
 
+// Writes all ranges of |after| which differ from |before| to |out| (a
+// PJournalEntryDeltaRange, followed by the modified bytes). |size| is a
+// multiple of 8. Returns the size of the delta, or 0 if it would exceed
+// |limit| bytes; |out| must have room for |limit| bytes.
+static inline uint32_t
+encode_page_delta(const uint8_t *before, const uint8_t *after, uint32_t size,
+                uint8_t *out, uint32_t limit)
+{
+  const uint32_t kWord = sizeof(uint64_t);
+  uint32_t out_size = 0;
+  uint32_t i = 0;
+
+  while (i < size) {
+    // skip the unmodified words
+    while (i < size && ::memcmp(&before[i], &after[i], kWord) == 0)
+      i += kWord;
+    if (i == size)
+      break;
+
+    // collect the modified words; a gap which is smaller than a range
+    // header is included in the range
+    uint32_t begin = i;
+    uint32_t end = i + kWord;
+    for (i = end; i < size; i += kWord) {
+      if (::memcmp(&before[i], &after[i], kWord) != 0)
+        end = i + kWord;
+      else if (i - end >= sizeof(PJournalEntryDeltaRange))
+        break;
+    }
+
+    PJournalEntryDeltaRange range;
+    range.offset = begin;
+    range.size = end - begin;
+    if (out_size + sizeof(range) + range.size > limit)
+      return 0;
+    ::memcpy(&out[out_size], &range, sizeof(range));
+    ::memcpy(&out[out_size + sizeof(range)], &after[begin], range.size);
+    out_size += sizeof(range) + range.size;
+    i = end;
+  }
+
+  // the page was not modified; store an empty range, because a delta
+  // size of 0 describes a full page
+  if (out_size == 0) {
+    PJournalEntryDeltaRange range = {0, 0};
+    ::memcpy(out, &range, sizeof(range));
+    out_size = sizeof(range);
+  }
+  return out_size;
+}
+
+// Applies a delta which was created with encode_page_delta()
+static inline void
+apply_page_delta(uint8_t *page, uint32_t page_size, const uint8_t *delta,
+                uint32_t delta_size)
+{
+  const uint8_t *end = delta + delta_size;
+  while (delta < end) {
+    PJournalEntryDeltaRange range;
+    if (unlikely(delta + sizeof(range) > end))
+      throw Exception(UPS_INTEGRITY_VIOLATED);
+    ::memcpy(&range, delta, sizeof(range));
+    delta += sizeof(range);
+    if (unlikely(range.offset + (uint64_t)range.size > page_size
+                || delta + range.size > end))
+      throw Exception(UPS_INTEGRITY_VIOLATED);
+    ::memcpy(page + range.offset, delta, range.size);
+    delta += range.size;
+  }
+}
+
+// Replays the logical redo records of a leaf (see Changeset::add_leaf_redo())
+// on |page|, which belongs to |db|. Throws if a record does not fit the page
+static inline void
+apply_leaf_redo(LocalDb *db, Page *page, const uint8_t *redo, uint32_t size)
+{
+  Context context((LocalEnv *)db->env, 0, db);
+  BtreeNodeProxy *node = db->btree_index->get_node_from_page(page);
+  const uint8_t *end = redo + size;
+
+  while (redo < end) {
+    PJournalEntryLeafRedo entry;
+    if (unlikely(redo + sizeof(entry) > end))
+      throw Exception(UPS_INTEGRITY_VIOLATED);
+    ::memcpy(&entry, redo, sizeof(entry));
+    redo += sizeof(entry);
+    if (unlikely(redo + (uint64_t)entry.key_size + entry.record_size > end))
+      throw Exception(UPS_INTEGRITY_VIOLATED);
+
+    ups_key_t key = ups_make_key((void *)redo, (uint16_t)entry.key_size);
+    redo += entry.key_size;
+    ups_record_t record = ups_make_record((void *)redo, entry.record_size);
+    redo += entry.record_size;
+
+    switch (entry.type) {
+      case PJournalEntryLeafRedo::kInsert: {
+        PBtreeNode::InsertResult result = node->insert(&context, &key,
+                        entry.flags);
+        if (unlikely(result.status != 0 || result.slot != (int)entry.slot))
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        uint32_t new_duplicate_id = 0;
+        node->set_record(&context, result.slot, &record, 0,
+                        entry.record_flags, &new_duplicate_id);
+        break;
+      }
+      case PJournalEntryLeafRedo::kErase: {
+        if (unlikely(entry.slot >= node->length()))
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        bool has_duplicates_left = false;
+        node->erase_record(&context, entry.slot, entry.flags,
+                        entry.record_flags != 0, &has_duplicates_left);
+        if (unlikely(has_duplicates_left))
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        node->erase(&context, entry.slot);
+        break;
+      }
+      default:
+        throw Exception(UPS_INTEGRITY_VIOLATED);
+    }
+  }
+}
+
+// Returns true if the logical redo records of a leaf turn the logged |image|
+// into the current |page|; only then they can replace the page during
+// recovery. The records are replayed on a copy of the image
+static inline bool
+can_replay_leaf_redo(JournalState &state, Page *page, const uint8_t *image,
+                const Changeset::LeafRedo &redo, uint32_t page_size)
+{
+  uint8_t *data = state.redo_arena.resize(page_size);
+  ::memcpy(data, image, page_size);
+  // the persistent header (lsn, crc) is logged literally
+  ::memcpy(data, page->data(), Page::kSizeofPersistentHeader);
+
+  // the scratch page does not own its data
+  Page scratch(state.env->device.get(), redo.db);
+  scratch.set_address(page->address());
+  scratch.set_data((PPageData *)data);
+
+  try {
+    apply_leaf_redo(redo.db, &scratch, redo.records.data(),
+                    (uint32_t)redo.records.size());
+  }
+  catch (Exception &) {
+    return false;
+  }
+  return ::memcmp(data, page->data(), page_size) == 0;
+}
+
+// Same as append_changeset_page(), but for delta changesets: if the page was
+// already logged to the current file then only the modified ranges are
+// appended. Leaves which were only modified by inserts and erases are
+// logged with their logical redo records (|redo|, can be null)
+static inline uint32_t
+append_delta_changeset_page(JournalState &state, Page *page,
+                uint32_t page_size, const Changeset::LeafRedo *redo)
+{
+  PJournalEntryDeltaPageHeader header(page->address());
+  const uint8_t *data = (const uint8_t *)page->data();
+
+  JournalState::PageImageMap::iterator it
+          = state.page_images.find(page->address());
+  if (it != state.page_images.end() && it->second.fd == (int)state.current_fd) {
+    // inserting or erasing a key shifts the following slots, which
+    // produces large byte ranges; the redo records are much smaller
+    if (redo && can_replay_leaf_redo(state, page, it->second.data.data(),
+                            *redo, page_size)) {
+      header.redo_size = Page::kSizeofPersistentHeader
+                            + (uint32_t)redo->records.size();
+      append_entry(state, state.current_fd, (uint8_t *)&header, sizeof(header),
+                    data, Page::kSizeofPersistentHeader,
+                    redo->records.data(), (uint32_t)redo->records.size());
+      ::memcpy(it->second.data.data(), data, page_size);
+      state.count_delta_bytes_saved += page_size - header.redo_size;
+      return header.redo_size + sizeof(header);
+    }
+
+    uint32_t limit = page_size / 2;
+    state.delta_arena.resize(limit);
+    header.delta_size = encode_page_delta(it->second.data.data(), data,
+                    page_size, state.delta_arena.data(), limit);
+    if (header.delta_size > 0) {
+      append_entry(state, state.current_fd, (uint8_t *)&header, sizeof(header),
+                    state.delta_arena.data(), header.delta_size);
+      ::memcpy(it->second.data.data(), data, page_size);
+      state.count_delta_bytes_saved += page_size - header.delta_size;
+      return header.delta_size + sizeof(header);
+    }
+  }
+
+  // otherwise log the full page, and remember its image
+  if (it != state.page_images.end()) {
+    it->second.fd = state.current_fd;
+    ::memcpy(it->second.data.data(), data, page_size);
+  }
+  else if (state.page_images.size() < kMaxPageImages) {
+    JournalState::PageImage &image = state.page_images[page->address()];
+    image.fd = state.current_fd;
+    image.data.assign(data, data + page_size);
+  }
+
+  if (state.compressor.get()) {
+    state.count_bytes_before_compression += page_size;
+    header.compressed_size = state.compressor->compress(data, page_size);
+    append_entry(state, state.current_fd, (uint8_t *)&header, sizeof(header),
+                    state.compressor->arena.data(),
+                    header.compressed_size);
+    state.count_bytes_after_compression += header.compressed_size;
+    return header.compressed_size + sizeof(header);
+  }
+
+  append_entry(state, state.current_fd, (uint8_t *)&header, sizeof(header),
+                data, page_size);
+  return page_size + sizeof(header);
+}
+
 // Scans a file for the oldest changeset. Returns the lsn of this
 // changeset.
 static inline uint64_t
@@ -326,7 +672,8 @@ scan_for_oldest_changeset(JournalState &state, File *file)
       if (entry.lsn == 0)
         break;
 
-      if (entry.type == Journal::kEntryTypeChangeset) {
+      if (entry.type == Journal::kEntryTypeChangeset
+            || entry.type == Journal::kEntryTypeDeltaChangeset) {
         return entry.lsn;
       }
 
@@ -341,115 +688,212 @@ scan_for_oldest_changeset(JournalState &state, File *file)
   return 0;
 }
 
-// Redo all Changesets of a log file, in chronological order
-// Returns the highest lsn of the last changeset applied
+// A page image (or page delta) of a changeset in the journal
+struct ChangesetPage {
+  // the journal file
+  int fdidx;
+
+  // the offset of the page data in the journal file
+  uint64_t offset;
+
+  // the size of the compressed image, or 0
+  uint32_t compressed_size;
+
+  // the size of the delta, or 0 if this is a full image
+  uint32_t delta_size;
+
+  // the size of the persistent header and the logical redo records of a
+  // leaf, or 0
+  uint32_t redo_size;
+};
+
+// For each page address: the newest full image and all newer deltas,
+// in chronological order
+typedef std::vector<ChangesetPage> ChangesetPageList;
+typedef std::map<uint64_t, ChangesetPageList> ChangesetPageMap;
+
+// Collects the page images of all Changesets of a log file, in chronological
+// order. Older images of a page are replaced by newer ones. Returns the
+// lsn of the last changeset
 static inline uint64_t
-redo_all_changesets(JournalState &state, int fdidx)
+collect_changeset_pages(JournalState &state, int fdidx,
+                ChangesetPageMap &pages, uint64_t *last_blob_page)
 {
   Journal::Iterator it;
   PJournalEntry entry;
-  ByteArray buffer;
   uint64_t max_lsn = 0;
+  uint32_t page_size = state.env->config.page_size_bytes;
+  uint64_t log_file_size = state.files[fdidx].file_size();
 
-  // for each entry...
-  try {
-    uint64_t log_file_size = state.files[fdidx].file_size();
-
-    while (it.offset < log_file_size) {
-      state.files[fdidx].pread(it.offset, &entry, sizeof(entry));
+  while (it.offset < log_file_size) {
+    state.files[fdidx].pread(it.offset, &entry, sizeof(entry));
 
-      // Skip all log entries which are NOT from a changeset
-      if (entry.type != Journal::kEntryTypeChangeset) {
-        it.offset += sizeof(entry) + entry.followup_size;
-        continue;
-      }
-
-      max_lsn = entry.lsn;
-
-      it.offset += sizeof(entry);
+    // Skip all log entries which are NOT from a changeset
+    if (entry.type != Journal::kEntryTypeChangeset
+          && entry.type != Journal::kEntryTypeDeltaChangeset) {
+      it.offset += sizeof(entry) + entry.followup_size;
+      continue;
+    }
+    bool is_delta = entry.type == Journal::kEntryTypeDeltaChangeset;
 
-      // Read the Changeset header
-      PJournalEntryChangeset changeset;
-      state.files[fdidx].pread(it.offset, &changeset, sizeof(changeset));
-      it.offset += sizeof(changeset);
+    max_lsn = entry.lsn;
 
-      uint32_t page_size = state.env->config.page_size_bytes;
-      ByteArray arena(page_size);
-      ByteArray tmp;
+    it.offset += sizeof(entry);
 
-      uint64_t file_size = state.env->device->file_size();
+    // Read the Changeset header
+    PJournalEntryChangeset changeset;
+    state.files[fdidx].pread(it.offset, &changeset, sizeof(changeset));
+    it.offset += sizeof(changeset);
 
-      state.env->page_manager->set_last_blob_page_id(changeset.last_blob_page);
+    *last_blob_page = changeset.last_blob_page;
 
-      // for each page in this changeset...
-      for (uint32_t i = 0; i < changeset.num_pages; i++) {
-        PJournalEntryPageHeader page_header;
+    // for each page in this changeset...
+    for (uint32_t i = 0; i < changeset.num_pages; i++) {
+      PJournalEntryDeltaPageHeader page_header;
+      if (is_delta) {
         state.files[fdidx].pread(it.offset, &page_header,
                         sizeof(page_header));
         it.offset += sizeof(page_header);
-        if (page_header.compressed_size > 0) {
-          tmp.resize(page_size);
-          state.files[fdidx].pread(it.offset, tmp.data(),
-                        page_header.compressed_size);
-          it.offset += page_header.compressed_size;
-          state.compressor->decompress(tmp.data(),
-                        page_header.compressed_size, page_size, &arena);
-        }
-        else {
-          state.files[fdidx].pread(it.offset, arena.data(), page_size);
-          it.offset += page_size;
-        }
-
-        Page *page;
+      }
+      else {
+        PJournalEntryPageHeader header;
+        state.files[fdidx].pread(it.offset, &header, sizeof(header));
+        it.offset += sizeof(header);
+        page_header.address = header.address;
+        page_header.compressed_size = header.compressed_size;
+      }
 
-        // now write the page to disk
-        if (page_header.address == file_size) {
-          file_size += page_size;
+      ChangesetPage page = {fdidx, it.offset, page_header.compressed_size,
+                            page_header.delta_size, page_header.redo_size};
+      ChangesetPageList &list = pages[page_header.address];
+
+      // a full image replaces all older images and deltas
+      if (page.delta_size == 0 && page.redo_size == 0)
+        list.clear();
+      list.push_back(page);
+
+      if (page.redo_size > 0)
+        it.offset += page.redo_size;
+      else if (page.delta_size > 0)
+        it.offset += page.delta_size;
+      else if (page.compressed_size > 0)
+        it.offset += page.compressed_size;
+      else
+        it.offset += page_size;
+    }
+  }
 
-          page = new Page(state.env->device.get());
-          page->alloc(0);
-        }
-        else if (page_header.address > file_size) {
-          file_size = (size_t)page_header.address + page_size;
-          state.env->device->truncate(file_size);
+  return max_lsn;
+}
 
-          page = new Page(state.env->device.get());
-          page->fetch(page_header.address);
-        }
-        else {
-          if (page_header.address == 0)
-            page = state.env->header->header_page;
-          else
-            page = new Page(state.env->device.get());
-          page->fetch(page_header.address);
-        }
-        assert(page->address() == page_header.address);
+// Applies a full image or a delta of a changeset to |page|. |compressor|
+// (can be null), |arena| and |tmp| are owned by the calling thread
+static inline void
+apply_changeset_page(JournalState &state, Page *page, ChangesetPage &cp,
+                Compressor *compressor, ByteArray &arena, ByteArray &tmp)
+{
+  uint32_t page_size = state.env->config.page_size_bytes;
+  File &file = state.files[cp.fdidx];
+
+  if (cp.delta_size > 0) {
+    tmp.resize(cp.delta_size);
+    file.pread(cp.offset, tmp.data(), cp.delta_size);
+    apply_page_delta((uint8_t *)page->data(), page_size, tmp.data(),
+                    cp.delta_size);
+  }
+  else if (cp.compressed_size > 0) {
+    tmp.resize(page_size);
+    file.pread(cp.offset, tmp.data(), cp.compressed_size);
+    compressor->decompress(tmp.data(), cp.compressed_size, page_size,
+                    &arena);
+    ::memcpy(page->data(), arena.data(), page_size);
+  }
+  else {
+    file.pread(cp.offset, page->data(), page_size);
+  }
+}
 
-        // overwrite the page data
-        ::memcpy(page->data(), arena.data(), page_size);
+// Writes the newest image of a page to the database file. |compressor|
+// (can be null), |arena| and |tmp| are owned by the calling thread
+static inline void
+restore_changeset_page(JournalState &state, uint64_t address,
+                ChangesetPageList &list, Compressor *compressor,
+                ByteArray &arena, ByteArray &tmp)
+{
+  Page *page;
 
-        // flush the modified page to disk
-        page->set_dirty(true);
-        page->flush();
+  if (address == 0)
+    page = state.env->header->header_page;
+  else
+    page = new Page(state.env->device.get());
 
-        if (page_header.address != 0)
-          delete page;
-      }
-    }
+  try {
+    // deltas are applied to the page which is currently stored
+    page->fetch(address);
+
+    for (ChangesetPageList::iterator it = list.begin();
+                    it != list.end(); it++)
+      apply_changeset_page(state, page, *it, compressor, arena, tmp);
+
+    // flush the modified page to disk; the journal does not know whether
+    // the page has a persistent header, therefore it is not compressed
+    // (uncompressed images are always valid)
+    page->set_dirty(true);
+    page->flush(false);
   }
   catch (Exception &) {
-    ups_trace(("Exception when applying changeset"));
-    // propagate error
+    if (address != 0)
+      delete page;
     throw;
   }
 
-  return max_lsn;
+  if (address != 0)
+    delete page;
 }
 
+// Restores a range of pages; runs in its own thread
+struct ChangesetRestorer {
+  ChangesetRestorer(JournalState &state_,
+                  ChangesetPageMap::iterator begin_,
+                  ChangesetPageMap::iterator end_, ups_status_t *status_)
+    : state(state_), begin(begin_), end(end_), status(status_) {
+  }
+
+  void operator()() {
+    try {
+      // the compressor is not thread-safe, therefore each thread has
+      // its own instance
+      ScopedPtr<Compressor> compressor;
+      if (state.compressor.get())
+        compressor.reset(CompressorFactory::create(
+                                state.env->config.journal_compressor));
+      ByteArray arena(state.env->config.page_size_bytes);
+      ByteArray tmp;
+
+      for (ChangesetPageMap::iterator it = begin; it != end; it++)
+        restore_changeset_page(state, it->first, it->second,
+                        compressor.get(), arena, tmp);
+    }
+    catch (Exception &ex) {
+      *status = ex.code;
+    }
+  }
+
+  JournalState &state;
+  ChangesetPageMap::iterator begin;
+  ChangesetPageMap::iterator end;
+  ups_status_t *status;
+};
+
 // Recovers (re-applies) the physical changelog; returns the lsn of the
 // Changelog
+//
+// Only the newest image of each page is written. The pages are independent
+// of each other, therefore they are restored by several threads in
+// parallel. Leaves with logical redo records require their Database; they
+// are not restored but returned in |leaves| (see recover_leaves())
 static inline uint64_t
-recover_changeset(JournalState &state)
+recover_changeset(JournalState &state, ChangesetPageMap &leaves)
 {
   // scan through both files, look for the file with the oldest changeset.
   uint64_t lsn1 = scan_for_oldest_changeset(state, &state.files[0]);
@@ -459,16 +903,173 @@ recover_changeset(JournalState &state)
   if (lsn1 == 0 && lsn2 == 0)
     return 0;
 
-  // now redo all changesets chronologically
+  // now collect all changesets chronologically
   state.current_fd = lsn1 < lsn2 ? 0 : 1;
 
-  uint64_t max_lsn1 = redo_all_changesets(state, state.current_fd);
-  uint64_t max_lsn2 = redo_all_changesets(state, state.current_fd == 0 ? 1 : 0);
+  ChangesetPageMap pages;
+  uint64_t last_blob_page = 0;
+  uint64_t max_lsn1, max_lsn2;
+  try {
+    max_lsn1 = collect_changeset_pages(state, state.current_fd, pages,
+                    &last_blob_page);
+    max_lsn2 = collect_changeset_pages(state, state.current_fd == 0 ? 1 : 0,
+                    pages, &last_blob_page);
+  }
+  catch (Exception &) {
+    ups_trace(("Exception when reading changeset"));
+    // propagate error
+    throw;
+  }
+
+  state.env->page_manager->set_last_blob_page_id(last_blob_page);
+  state.count_recovered_pages = pages.size();
+
+  // the changesets are empty (or torn); there is nothing to restore
+  if (pages.empty())
+    return std::max(max_lsn1, max_lsn2);
+
+  // grow the file once, before the pages are written concurrently
+  uint32_t page_size = state.env->config.page_size_bytes;
+  uint64_t file_size = pages.rbegin()->first + page_size;
+  if (file_size > state.env->device->file_size())
+    state.env->device->truncate(file_size);
+
+  ChangesetPageMap::iterator it = pages.begin();
+  while (it != pages.end()) {
+    bool has_redo = false;
+    for (ChangesetPageList::iterator l = it->second.begin();
+                    !has_redo && l != it->second.end(); l++)
+      has_redo = l->redo_size > 0;
+    if (has_redo) {
+      leaves[it->first].swap(it->second);
+      pages.erase(it++);
+    }
+    else
+      ++it;
+  }
+  if (pages.empty())
+    return std::max(max_lsn1, max_lsn2);
+
+  // the header page is shared with the Environment; it is restored
+  // by this thread
+  ups_status_t st = 0;
+  ChangesetPageMap::iterator begin = pages.begin();
+  if (begin->first == 0) {
+    ChangesetPageMap::iterator end = begin;
+    ChangesetRestorer(state, begin, ++end, &st)();
+    begin = end;
+  }
+
+  // split the remaining pages in contiguous ranges, one per thread
+  // (restoring a page mostly waits for I/O, therefore the number of threads
+  // does not depend on the number of cores)
+  size_t num_pages = std::distance(begin, pages.end());
+  size_t num_threads = std::max((size_t)1,
+                  std::min((size_t)kMaxRecoveryThreads,
+                          num_pages / kMinPagesPerRecoveryThread));
+
+  std::vector<ups_status_t> status(num_threads);
+  std::vector<Thread *> threads;
+  for (size_t i = 0; i < num_threads; i++) {
+    ChangesetPageMap::iterator end = begin;
+    if (i + 1 < num_threads)
+      std::advance(end, num_pages / num_threads);
+    else
+      end = pages.end();
+
+    ChangesetRestorer restorer(state, begin, end, &status[i]);
+    if (i + 1 < num_threads)
+      threads.push_back(new Thread(restorer));
+    else
+      restorer(); // the last range is restored by this thread
+    begin = end;
+  }
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  for (size_t i = 0; st == 0 && i < status.size(); i++)
+    st = status[i];
+  if (unlikely(st)) {
+    ups_trace(("Exception when applying changeset"));
+    throw Exception(st);
+  }
 
   // return the lsn of the newest changeset
   return std::max(max_lsn1, max_lsn2);
 }
 
+// Restores the leaves which were logged with logical redo records (see
+// recover_changeset()). The records are replayed with the BtreeNodeProxy of
+// the leaf, therefore the Databases are opened; they are closed when all
+// leaves were restored
+static inline void
+recover_leaves(JournalState &state, ChangesetPageMap &leaves)
+{
+  uint32_t page_size = state.env->config.page_size_bytes;
+  ByteArray arena(page_size);
+  ByteArray tmp;
+
+  for (ChangesetPageMap::iterator it = leaves.begin();
+                  it != leaves.end(); it++) {
+    Context context(state.env, 0, 0);
+    // deltas are applied to the page which is currently stored; the page
+    // is fetched through the cache because opening a Database fetches its
+    // root page
+    Page *page = state.env->page_manager->fetch(&context, it->first, 0);
+
+    for (ChangesetPageList::iterator l = it->second.begin();
+                    l != it->second.end(); l++) {
+      // the BtreeNodeProxy does not survive changes of the raw data
+      delete page->node_proxy();
+      page->set_node_proxy(0);
+
+      if (l->redo_size == 0) {
+        apply_changeset_page(state, page, *l, state.compressor.get(),
+                        arena, tmp);
+        continue;
+      }
+
+      PJournalEntryLeafRedo entry;
+      if (unlikely(l->redo_size < Page::kSizeofPersistentHeader
+                                    + sizeof(entry)))
+        throw Exception(UPS_INTEGRITY_VIOLATED);
+      tmp.resize(l->redo_size);
+      state.files[l->fdidx].pread(l->offset, tmp.data(), l->redo_size);
+      ::memcpy(page->data(), tmp.data(), Page::kSizeofPersistentHeader);
+
+      // all records of a changeset belong to the same Database. If it was
+      // erased in the meantime then its pages were freed
+      ::memcpy(&entry, tmp.data() + Page::kSizeofPersistentHeader,
+                      sizeof(entry));
+      LocalDb *db;
+      try {
+        db = (LocalDb *)get_db(state, entry.dbname);
+      }
+      catch (Exception &ex) {
+        if (ex.code != UPS_DATABASE_NOT_FOUND)
+          throw;
+        break;
+      }
+      page->set_db(db);
+      apply_leaf_redo(db, page,
+                      tmp.data() + Page::kSizeofPersistentHeader,
+                      l->redo_size - Page::kSizeofPersistentHeader);
+    }
+
+    delete page->node_proxy();
+    page->set_node_proxy(0);
+
+    // like restore_changeset_page(), the page is not compressed
+    page->set_dirty(true);
+    page->flush(false);
+  }
+
+  close_all_databases(state);
+}
+
 // Recovers the logical journal
 static inline void
 recover_journal(JournalState &state, Context *context,
@@ -626,10 +1227,15 @@ recover_journal(JournalState &state, Context *context,
           st = 0;
         break;
       }
-      case Journal::kEntryTypeChangeset: {
+      case Journal::kEntryTypeChangeset:
+      case Journal::kEntryTypeDeltaChangeset: {
         // skip this; the changeset was already applied
         break;
       }
+      case Journal::kEntryTypeCheckpoint: {
+        // nothing to do; only marks the beginning of a file
+        break;
+      }
       default:
         ups_log(("invalid journal entry type or journal is corrupt"));
         st = UPS_IO_ERROR;
@@ -637,6 +1243,11 @@ recover_journal(JournalState &state, Context *context,
 
       if (st)
         goto bail;
+
+      if (entry.type != Journal::kEntryTypeChangeset
+            && entry.type != Journal::kEntryTypeDeltaChangeset
+            && entry.type != Journal::kEntryTypeCheckpoint)
+        state.count_recovered_operations++;
   } while (1);
 
 bail:
@@ -662,10 +1273,23 @@ JournalState::JournalState(LocalEnv *env_)
   : env(env_), current_fd(0), num_transactions(0),
     threshold(env_->config.journal_switch_threshold),
     disable_logging(false), count_bytes_flushed(0),
-    count_bytes_before_compression(0), count_bytes_after_compression(0)
+    count_bytes_before_compression(0), count_bytes_after_compression(0),
+    unsynced_commit_lsn(0), written_lsn(0), synced_lsn(0), unsynced_files(0),
+    is_syncing(false), count_commit_syncs(0), deferred_lsn(0),
+    sync_interval_ms(env_->config.journal_sync_interval_ms),
+    stop_syncer(false), syncer_error(0), count_delta_bytes_saved(0),
+    recovery_usec(0), count_recovered_bytes(0), count_recovered_pages(0),
+    count_recovered_operations(0),
+    checkpoint_interval_bytes(env_->config.checkpoint_interval_bytes),
+    checkpoint_interval_ms(env_->config.checkpoint_interval_ms),
+    file_start_time(boost::posix_time::microsec_clock::universal_time()),
+    count_checkpoints(0)
 {
   if (threshold == 0)
     threshold = kSwitchTxnThreshold;
+
+  file_bytes[0] = file_bytes[1] = 0;
+  checkpoint_pending[0] = checkpoint_pending[1] = false;
 }
 
 Journal::Journal(LocalEnv *env)
@@ -676,6 +1300,11 @@ Journal::Journal(LocalEnv *env)
     state.compressor.reset(CompressorFactory::create(algo));
 }
 
+Journal::~Journal()
+{
+  stop_syncer();
+}
+
 void
 Journal::create()
 {
@@ -683,6 +1312,8 @@ Journal::create()
   for (int i = 0; i < 2; i++) {
     std::string path = log_file_path(state, i);
     state.files[i].create(path.c_str(), 0644);
+    if (ISSET(state.env->config.flags, UPS_ENABLE_DIRECT_IO))
+      state.files[i].enable_direct_io();
   }
 }
 
@@ -695,6 +1326,10 @@ Journal::open()
     state.files[0].open(path.c_str(), false);
     path = log_file_path(state, 1);
     state.files[1].open(path.c_str(), 0);
+    if (ISSET(state.env->config.flags, UPS_ENABLE_DIRECT_IO)) {
+      state.files[0].enable_direct_io();
+      state.files[1].enable_direct_io();
+    }
   }
   catch (Exception &ex) {
     state.files[1].close();
@@ -744,9 +1379,140 @@ Journal::append_txn_commit(LocalTxn *txn, uint64_t lsn)
 
   append_entry(state, txn->log_descriptor, (uint8_t *)&entry, sizeof(entry));
 
-  // flush after commit
-  flush_buffer(state, state.current_fd,
-                  ISSET(state.env->flags(), UPS_ENABLE_FSYNC));
+  // flush after commit; the file is synced later (see sync() and
+  // sync_deferred()), after the committing thread released the
+  // Environment's lock
+  flush_buffer(state, state.current_fd);
+
+  state.unsynced_commit_lsn = lsn;
+
+  ScopedLock lock(state.sync_mutex);
+  state.written_lsn = lsn;
+  state.unsynced_files |= 1u << state.current_fd;
+}
+
+void
+Journal::sync(uint64_t lsn)
+{
+  ScopedLock lock(state.sync_mutex);
+
+  while (state.synced_lsn < lsn) {
+    // another thread is syncing; wait till it's finished. If that sync
+    // did not include our commit then the loop picks a new leader
+    if (state.is_syncing) {
+      state.sync_cond.wait(lock);
+      continue;
+    }
+
+    // become the leader, and sync all commits which were written so far
+    state.is_syncing = true;
+    uint64_t written_lsn = state.written_lsn;
+    uint32_t files = state.unsynced_files;
+    state.unsynced_files = 0;
+    lock.unlock();
+
+    ups_status_t st = 0;
+    try {
+      for (int i = 0; i < 2; i++)
+        if (files & (1u << i))
+          state.files[i].flush();
+    }
+    catch (Exception &ex) {
+      st = ex.code;
+    }
+
+    lock.lock();
+    state.is_syncing = false;
+    if (likely(st == 0)) {
+      state.synced_lsn = written_lsn;
+      state.count_commit_syncs++;
+    }
+    else
+      state.unsynced_files |= files;
+    state.sync_cond.notify_all();
+
+    if (unlikely(st))
+      throw Exception(st);
+  }
+}
+
+void
+Journal::sync_deferred(uint64_t lsn)
+{
+  ScopedLock lock(state.sync_mutex);
+
+  // report the error of a failed background sync
+  if (unlikely(state.syncer_error != 0)) {
+    ups_status_t st = state.syncer_error;
+    state.syncer_error = 0;
+    throw Exception(st);
+  }
+
+  if (state.synced_lsn >= lsn || state.deferred_lsn >= lsn)
+    return;
+
+  // wake up the background thread if it is idle
+  bool is_idle = state.deferred_lsn <= state.synced_lsn;
+  state.deferred_lsn = lsn;
+
+  if (!state.syncer)
+    state.syncer.reset(new Thread(boost::bind(&Journal::run_syncer, this)));
+  else if (is_idle)
+    state.syncer_cond.notify_one();
+}
+
+void
+Journal::run_syncer()
+{
+  ScopedLock lock(state.sync_mutex);
+
+  while (!state.stop_syncer) {
+    if (state.deferred_lsn <= state.synced_lsn) {
+      state.syncer_cond.wait(lock);
+      continue;
+    }
+
+    // wait for more commits, then sync all of them at once
+    state.syncer_cond.timed_wait(lock,
+                  boost::posix_time::milliseconds(state.sync_interval_ms));
+    if (state.stop_syncer)
+      break;
+
+    uint64_t lsn = state.deferred_lsn;
+    lock.unlock();
+    ups_status_t st = 0;
+    try {
+      sync(lsn);
+    }
+    catch (Exception &ex) {
+      st = ex.code;
+    }
+    lock.lock();
+
+    // the commits remain unsynced; they are retried with the next
+    // deferred commit
+    if (unlikely(st != 0)) {
+      state.syncer_error = st;
+      state.deferred_lsn = 0;
+    }
+  }
+}
+
+void
+Journal::stop_syncer()
+{
+  if (!state.syncer)
+    return;
+
+  {
+    ScopedLock lock(state.sync_mutex);
+    state.stop_syncer = true;
+    state.syncer_cond.notify_one();
+  }
+
+  state.syncer->join();
+  state.syncer.reset();
+  state.stop_syncer = false;
 }
 
 void
@@ -771,7 +1537,7 @@ Journal::append_insert(Db *db, LocalTxn *txn,
   int idx;
   if (ISSET(txn->flags, UPS_TXN_TEMPORARY)) {
     entry.txn_id = 0;
-    idx = switch_files_maybe(state);
+    idx = txn->log_descriptor = switch_files_maybe(state);
     state.num_transactions++;
   }
   else {
@@ -874,7 +1640,7 @@ Journal::append_erase(Db *db, LocalTxn *txn, ups_key_t *key,
   int idx;
   if (ISSET(txn->flags, UPS_TXN_TEMPORARY)) {
     entry.txn_id = 0;
-    idx = switch_files_maybe(state);
+    idx = txn->log_descriptor = switch_files_maybe(state);
     state.num_transactions++;
   }
   else {
@@ -894,7 +1660,8 @@ Journal::append_erase(Db *db, LocalTxn *txn, ups_key_t *key,
 
 int
 Journal::append_changeset(std::vector<Page *> &pages,
-                uint64_t last_blob_page, uint64_t lsn)
+                uint64_t last_blob_page, uint64_t lsn,
+                const Changeset::LeafRedoMap *redo)
 {
   assert(pages.size() > 0);
 
@@ -907,7 +1674,10 @@ Journal::append_changeset(std::vector<Page *> &pages,
   entry.lsn = lsn;
   entry.dbname = 0;
   entry.txn_id = 0;
-  entry.type = Journal::kEntryTypeChangeset;
+  bool is_delta = ISSET(state.env->config.flags, UPS_ENABLE_DELTA_JOURNAL);
+  entry.type = is_delta
+                  ? Journal::kEntryTypeDeltaChangeset
+                  : Journal::kEntryTypeChangeset;
   // followup_size is incomplete - the actual page sizes are added later
   entry.followup_size = sizeof(PJournalEntryChangeset);
   changeset.num_pages = pages.size();
@@ -926,7 +1696,19 @@ Journal::append_changeset(std::vector<Page *> &pages,
   for (std::vector<Page *>::iterator it = pages.begin();
                   it != pages.end();
                   ++it) {
-    entry.followup_size += append_changeset_page(state, *it, page_size);
+    if (is_delta) {
+      const Changeset::LeafRedo *leaf_redo = 0;
+      if (redo) {
+        Changeset::LeafRedoMap::const_iterator r
+                = redo->find((*it)->address());
+        if (r != redo->end())
+          leaf_redo = &r->second;
+      }
+      entry.followup_size += append_delta_changeset_page(state, *it,
+                      page_size, leaf_redo);
+    }
+    else
+      entry.followup_size += append_changeset_page(state, *it, page_size);
   }
 
   UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
@@ -948,6 +1730,12 @@ Journal::append_changeset(std::vector<Page *> &pages,
 void
 Journal::close(bool noclear)
 {
+  // stop the background thread, and sync the deferred commits which it
+  // did not yet sync
+  stop_syncer();
+  if (state.deferred_lsn > state.synced_lsn)
+    sync(state.deferred_lsn);
+
   // the noclear flag is set during testing, for checking whether the files
   // contain the correct data. Flush the buffers, otherwise the tests will
   // fail because data is missing
@@ -967,9 +1755,15 @@ void
 Journal::recover(LocalTxnManager *txn_manager)
 {
   Context context(state.env, 0, 0);
+  boost::posix_time::ptime start
+          = boost::posix_time::microsec_clock::universal_time();
+
+  state.count_recovered_bytes = state.files[0].file_size()
+          + state.files[1].file_size();
 
   // first redo the changesets
-  uint64_t start_lsn = recover_changeset(state);
+  ChangesetPageMap leaves;
+  uint64_t start_lsn = recover_changeset(state, leaves);
 
   // load the state of the PageManager; the PageManager state is loaded AFTER
   // physical recovery because its page might have been restored in
@@ -978,12 +1772,43 @@ Journal::recover(LocalTxnManager *txn_manager)
   if (page_manager_blobid != 0)
     state.env->page_manager->initialize(page_manager_blobid);
 
+  // the leaves with logical redo records are restored with the help of
+  // their Database, which is opened only now
+  if (!leaves.empty())
+    recover_leaves(state, leaves);
+
   // then start the normal recovery
   if (ISSET(state.env->flags(), UPS_ENABLE_TRANSACTIONS))
     recover_journal(state, &context, txn_manager, start_lsn);
 
   // clear the journal files
   clear();
+
+  state.recovery_usec = (boost::posix_time::microsec_clock::universal_time()
+          - start).total_microseconds();
+}
+
+bool
+Journal::is_checkpoint_blocked()
+{
+  if (unlikely(state.disable_logging))
+    return false;
+  if (likely(!is_checkpoint_interval_exceeded(state)))
+    return false;
+
+  int other = state.current_fd ? 0 : 1;
+  {
+    ScopedLock lock(state.sync_mutex);
+    if (state.checkpoint_pending[other])
+      return false;
+  }
+
+  // the Txns are sorted; if the oldest one was not written to the other
+  // file then none was
+  LocalTxn *oldest = (LocalTxn *)state.env->txn_manager->oldest_txn();
+  return oldest != 0
+            && oldest->log_descriptor == other
+            && (oldest->is_committed() || oldest->is_aborted());
 }
 
 void
@@ -993,6 +1818,22 @@ Journal::clear()
     clear_file(state, i);
 }
 
+void
+Journal::full_checkpoint()
+{
+  // the buffered entries belong to operations which are already persistent
+  state.buffer.clear();
+  clear();
+
+  // recovery must not find the old entries after a crash
+  for (int i = 0; i < 2; i++)
+    state.files[i].flush();
+
+  state.num_transactions = 0;
+  state.file_start_time = boost::posix_time::microsec_clock::universal_time();
+  state.count_checkpoints++;
+}
+
 void
 Journal::test_flush_buffers()
 {
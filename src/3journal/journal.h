@@ -45,6 +45,45 @@
  * Otherwise the whole changeset is appended to the journal, and afterwards
  * the database file is modified.
  *
+ * With UPS_ENABLE_DELTA_JOURNAL, a page is only logged as a full image the
+ * first time it is written to a journal file. Afterwards it is logged as a
+ * list of byte ranges which differ from its previously logged image.
+ * Recovery reads the changesets of both files in chronological order and
+ * keeps the newest full image of each page, followed by its newer deltas;
+ * therefore the full image is always restored before its deltas. A delta
+ * is never based on an image in the other file, because that file is
+ * cleared when the files are switched.
+ *
+ * Inserting or erasing a key in a sorted leaf shifts all following slots,
+ * and the byte ranges are almost as large as the page. Therefore a leaf
+ * which was only modified by inserts and erases (without blobs, duplicate
+ * tables or splits) is logged with logical redo records instead: its
+ * persistent header, followed by the inserted keys and records and the
+ * erased slots. The Changeset collects these records while the operations
+ * run. Before they are written, they are replayed on a copy of the
+ * previously logged image; if the result differs from the page then the
+ * byte ranges are logged. Recovery replays the records with the
+ * BtreeNodeProxy of the leaf, after the PageManager state was loaded,
+ * because this requires the leaf's Database.
+ *
+ * Since only the newest image of each page is written, the pages are
+ * independent of each other and are restored by several threads in
+ * parallel. The logical journal is then re-applied by a single thread,
+ * because all Databases share the Txn manager, the cache and the
+ * PageManager.
+ *
+ * The files are switched at a checkpoint: when the current file exceeds
+ * UPS_PARAM_CHECKPOINT_INTERVAL bytes, is older than
+ * UPS_PARAM_CHECKPOINT_INTERVAL_MS, or has more than
+ * UPS_PARAM_JOURNAL_SWITCH_THRESHOLD transactions. The checkpoints are
+ * "fuzzy": the pages of the changesets in the current file are still
+ * written by the PageManager's worker thread, which is not blocked. A
+ * checkpoint request is queued behind them; when the worker reaches it
+ * then all changesets of this file are in the database file. Clearing
+ * the older file is postponed until this has happened, and until all
+ * committed Txns in the older file were merged. Each file starts with a
+ * kEntryTypeCheckpoint entry.
+ *
  * For recovery to work, each page stores the lsn of its last modification.
  *
  * When recovering, the Journal first extracts the newest/latest entry.
@@ -85,6 +124,7 @@
 #include "1errorinducer/errorinducer.h"
 #include "2page/page_collection.h"
 #include "2compressor/compressor.h"
+#include "3changeset/changeset.h"
 #include "3journal/journal_entries.h"
 #include "3journal/journal_state.h"
 
@@ -128,7 +168,15 @@ struct Journal
     kEntryTypeErase      = 5,
 
     // marks a whole changeset operation (writes modified pages)
-    kEntryTypeChangeset  = 6
+    kEntryTypeChangeset  = 6,
+
+    // same as kEntryTypeChangeset, but pages can be stored as deltas
+    // (see UPS_ENABLE_DELTA_JOURNAL)
+    kEntryTypeDeltaChangeset = 7,
+
+    // marks a checkpoint; the first entry of a file after switching.
+    // Its lsn is the newest lsn which was assigned before the checkpoint
+    kEntryTypeCheckpoint = 8
   };
 
   //
@@ -152,6 +200,9 @@ struct Journal
   // Constructor
   Journal(LocalEnv *env);
 
+  // Destructor; terminates the background thread
+  ~Journal();
+
   // Creates a new journal
   void create();
 
@@ -179,6 +230,35 @@ struct Journal
   // Appends a journal entry for ups_txn_commit/kEntryTypeTxnCommit
   void append_txn_commit(LocalTxn *txn, uint64_t lsn);
 
+  // Returns the lsn of the last commit if it was not yet synced to disk,
+  // and resets it; otherwise returns 0.
+  // The caller has to hold the Environment's lock
+  uint64_t unsynced_commit() {
+    uint64_t lsn = state.unsynced_commit_lsn;
+    state.unsynced_commit_lsn = 0;
+    return lsn;
+  }
+
+  // Blocks till all commits up to |lsn| are durable (group commit).
+  // The first waiting thread becomes the "leader" and syncs everything
+  // that was written so far; all other threads wait till the leader is
+  // finished. Called WITHOUT holding the Environment's lock, therefore
+  // other threads can commit (and wait for the same sync) in the meantime.
+  void sync(uint64_t lsn);
+
+  // Returns immediately; the commits up to |lsn| are synced by a background
+  // thread within UPS_PARAM_JOURNAL_SYNC_INTERVAL milliseconds
+  // (UPS_TXN_COMMIT_DEFERRED). Throws the error of a failed background sync.
+  // Called WITHOUT holding the Environment's lock
+  void sync_deferred(uint64_t lsn);
+
+  // The background thread for deferred commits; syncs the journal
+  // periodically till |state.stop_syncer| is set
+  void run_syncer();
+
+  // Terminates the background thread (if it was started)
+  void stop_syncer();
+
   // Appends a journal entry for ups_insert/kEntryTypeInsert
   void append_insert(Db *db, LocalTxn *txn,
                   ups_key_t *key, ups_record_t *record, uint32_t flags,
@@ -190,14 +270,28 @@ struct Journal
                   uint64_t lsn);
 
   // Appends a journal entry for a whole changeset/kEntryTypeChangeset
+  // (or kEntryTypeDeltaChangeset, with UPS_ENABLE_DELTA_JOURNAL; then
+  // the leaves in |redo| can be logged with their logical redo records).
   // Returns the current file descriptor, which is the parameter for
   // on_changeset_flush()
   int append_changeset(std::vector<Page *> &pages, uint64_t last_blob_page,
-                  uint64_t lsn);
+                  uint64_t lsn, const Changeset::LeafRedoMap *redo = 0);
+
+  // Returns true if a checkpoint is overdue (UPS_PARAM_CHECKPOINT_INTERVAL,
+  // UPS_PARAM_CHECKPOINT_INTERVAL_MS), but the other file cannot be cleared
+  // because it still has committed Txns which were not yet merged.
+  // The caller then merges them, otherwise the journal grows without bounds
+  bool is_checkpoint_blocked();
 
   // Empties the journal, removes all entries
   void clear();
 
+  // A full (not fuzzy) checkpoint: empties the journal and syncs the
+  // truncated files. Only valid if all pages were written and synced to
+  // the database file and all committed Txns were merged (i.e. after
+  // ups_db_bulk_load), otherwise recovery would lose data
+  void full_checkpoint();
+
   // Closes the journal, frees all allocated resources
   void close(bool noclear = false);
 
@@ -212,6 +306,14 @@ struct Journal
             = state.count_bytes_before_compression;
     metrics->journal_bytes_after_compression
             = state.count_bytes_after_compression;
+    metrics->journal_delta_bytes_saved = state.count_delta_bytes_saved;
+    metrics->journal_recovery_usec = state.recovery_usec;
+    metrics->journal_recovered_bytes = state.count_recovered_bytes;
+    metrics->journal_recovered_pages = state.count_recovered_pages;
+    metrics->journal_recovered_operations = state.count_recovered_operations;
+    metrics->journal_checkpoints = state.count_checkpoints;
+    ScopedLock lock(state.sync_mutex);
+    metrics->journal_commit_syncs = state.count_commit_syncs;
   }
 
   // Flushes all buffers to disk. Used for testing.
@@ -201,6 +201,104 @@ UPS_PACK_0 struct UPS_PACK_1 PJournalEntryPageHeader {
 
 #include "1base/packstop.h"
 
+
+#include "1base/packstart.h"
+
+//
+// a Journal entry for a single page of a delta changeset
+// (kEntryTypeDeltaChangeset)
+//
+UPS_PACK_0 struct UPS_PACK_1 PJournalEntryDeltaPageHeader {
+  // Constructor - sets all fields to 0
+  PJournalEntryDeltaPageHeader(uint64_t _address = 0)
+    : address(_address), compressed_size(0), delta_size(0), redo_size(0) {
+  }
+
+  // the page address
+  uint64_t address;
+
+  // the compressed size, if compression is enabled
+  uint32_t compressed_size;
+
+  // if not zero: the page is stored as a list of modified ranges
+  // (PJournalEntryDeltaRange, each followed by the modified bytes) with
+  // a total size of |delta_size| bytes. Otherwise the full page follows
+  uint32_t delta_size;
+
+  // if not zero: the leaf is stored as the persistent page header, followed
+  // by logical redo records (PJournalEntryLeafRedo) with a total size of
+  // |redo_size| bytes
+  uint32_t redo_size;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
+
+#include "1base/packstart.h"
+
+//
+// a modified range of a page in a delta changeset; followed by |size|
+// bytes of data
+//
+UPS_PACK_0 struct UPS_PACK_1 PJournalEntryDeltaRange {
+  // the offset of the range in the page
+  uint32_t offset;
+
+  // the size of the range
+  uint32_t size;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
+
+#include "1base/packstart.h"
+
+//
+// a logical redo record of a leaf in a delta changeset: a key was inserted
+// into the leaf, or erased from it. Followed by |key_size| bytes of key
+// data and |record_size| bytes of record data
+//
+UPS_PACK_0 struct UPS_PACK_1 PJournalEntryLeafRedo {
+  enum {
+    // BtreeNodeProxy::insert() and set_record()
+    kInsert = 1,
+
+    // BtreeNodeProxy::erase_record() and erase()
+    kErase = 2
+  };
+
+  // Constructor - sets all fields to 0
+  PJournalEntryLeafRedo()
+    : type(0), dbname(0), flags(0), record_flags(0), slot(0), key_size(0),
+      record_size(0) {
+  }
+
+  // the operation (kInsert, kErase)
+  uint8_t type;
+
+  // the name of the database which owns the leaf
+  uint16_t dbname;
+
+  // kInsert: the flags of BtreeNodeProxy::insert();
+  // kErase: the duplicate index of BtreeNodeProxy::erase_record()
+  uint32_t flags;
+
+  // kInsert: the flags of BtreeNodeProxy::set_record();
+  // kErase: 1 if erase_record() erased all duplicates, otherwise 0
+  uint32_t record_flags;
+
+  // kErase: the slot of the erased key
+  uint32_t slot;
+
+  // the size of the key data
+  uint32_t key_size;
+
+  // the size of the record data
+  uint32_t record_size;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
 } // namespace upscaledb
 
 #endif /* UPS_JOURNAL_ENTRIES_H */
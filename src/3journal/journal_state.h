@@ -21,12 +21,16 @@
 
 #include "0root/root.h"
 
+#include <map>
 #include <vector>
 #include <string>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include "ups/types.h" // for metrics
 
 #include "1base/dynamic_array.h"
+#include "1base/mutex.h"
 #include "1base/scoped_ptr.h"
 #include "1os/file.h"
 #include "2page/page_collection.h"
@@ -83,6 +87,104 @@ struct JournalState {
 
   // The compressor; can be null
   ScopedPtr<Compressor> compressor;
+
+  // The lsn of the last commit which was written, but not yet synced to
+  // disk; see Journal::unsynced_commit()
+  uint64_t unsynced_commit_lsn;
+
+  // Group commit: protects the following members, which are also accessed
+  // by committing threads that no longer hold the Environment's lock
+  Mutex sync_mutex;
+
+  // Wakes up the threads which wait for the current sync
+  Condition sync_cond;
+
+  // The lsn of the newest commit which was written to a file
+  uint64_t written_lsn;
+
+  // The lsn of the newest commit which is durable
+  uint64_t synced_lsn;
+
+  // A bitmap of the files (1 << fd) which were written since the last sync
+  uint32_t unsynced_files;
+
+  // true while a thread is syncing the files
+  bool is_syncing;
+
+  // Counting the syncs of the group commit (for ups_env_get_metrics)
+  uint64_t count_commit_syncs;
+
+  // The lsn of the newest commit with UPS_TXN_COMMIT_DEFERRED; synced by
+  // the background thread
+  uint64_t deferred_lsn;
+
+  // The maximum delay of a deferred commit (in milliseconds)
+  uint32_t sync_interval_ms;
+
+  // Wakes up the background thread
+  Condition syncer_cond;
+
+  // The background thread; started with the first deferred commit
+  ScopedPtr<Thread> syncer;
+
+  // Set to true if the background thread has to terminate
+  bool stop_syncer;
+
+  // The error of a failed background sync; returned by the next deferred
+  // commit
+  ups_status_t syncer_error;
+
+  // With UPS_ENABLE_DELTA_JOURNAL: the most recently logged image of a
+  // page, and the file with the full image which the deltas are based on
+  struct PageImage {
+    int fd;
+    std::vector<uint8_t> data;
+  };
+
+  // The logged page images, indexed by page address
+  typedef std::map<uint64_t, PageImage> PageImageMap;
+  PageImageMap page_images;
+
+  // A buffer for encoding page deltas
+  ByteArray delta_arena;
+
+  // A page buffer for verifying the logical redo records of a leaf
+  ByteArray redo_arena;
+
+  // Counting the bytes saved by page deltas (for ups_env_get_metrics)
+  uint64_t count_delta_bytes_saved;
+
+  // The duration of the recovery, in microseconds (for ups_env_get_metrics)
+  uint64_t recovery_usec;
+
+  // Counting the journal bytes read during recovery (for ups_env_get_metrics)
+  uint64_t count_recovered_bytes;
+
+  // Counting the pages restored from changesets (for ups_env_get_metrics)
+  uint64_t count_recovered_pages;
+
+  // Counting the re-applied journal entries (for ups_env_get_metrics)
+  uint64_t count_recovered_operations;
+
+  // Write a checkpoint if the current file exceeds this size
+  uint64_t checkpoint_interval_bytes;
+
+  // Write a checkpoint if the current file is older than this interval (in
+  // milliseconds)
+  uint32_t checkpoint_interval_ms;
+
+  // The bytes written to each file since it was cleared
+  uint64_t file_bytes[2];
+
+  // The time when the current file was started
+  boost::posix_time::ptime file_start_time;
+
+  // True while the changesets of a file are not yet written to the database
+  // file; protected by |sync_mutex|
+  bool checkpoint_pending[2];
+
+  // Counting the checkpoints (for ups_env_get_metrics)
+  uint64_t count_checkpoints;
 };
 
 } // namespace upscaledb
@@ -21,11 +21,12 @@
 #include "0root/root.h"
 
 #include <string.h>
+#include <algorithm>
 
-#include "3rdparty/murmurhash3/MurmurHash3.h"
 // Always verify that a file of level N does not include headers > N!
 #include "1base/signal.h"
 #include "1base/dynamic_array.h"
+#include "2checksum/checksum.h"
 #include "2page/page.h"
 #include "2device/device.h"
 #include "3page_manager/page_manager.h"
@@ -44,7 +45,11 @@ alloc_unlocked(PageManagerState *state, Context *context, uint32_t page_type,
                 uint32_t flags);
 static inline Page *
 fetch_unlocked(PageManagerState *state, Context *context,
-                uint64_t address, uint32_t flags);
+                uint64_t address, uint32_t flags, bool *would_block = 0);
+
+static inline Page *
+store_fetched_page(PageManagerState *state, Context *context, Page *page,
+                uint32_t flags);
 
 template <typename T>
 struct Deleter
@@ -99,12 +104,12 @@ async_flush_pages(AsyncFlushMessage *message)
 }
 
 static inline void
-verify_crc32(Page *page)
+verify_crc32(PageManagerState *state, Page *page)
 {
-  uint32_t crc32;
-  MurmurHash3_x86_32(page->payload(),
+  uint32_t crc32 = Checksum::calculate(state->config.checksum_algorithm,
+                  page->payload(),
                   page->persisted_data.size - (sizeof(PPageHeader) - 1),
-                  (uint32_t)page->address(), &crc32);
+                  (uint32_t)page->address());
   if (crc32 != page->crc32()) {
     ups_trace(("crc32 mismatch in page %lu: 0x%lx != 0x%lx",
                     page->address(), crc32, page->crc32()));
@@ -113,13 +118,28 @@ verify_crc32(Page *page)
 }
 
 static inline Page *
-add_to_changeset(Changeset *changeset, Page *page)
+add_to_changeset(Changeset *changeset, Page *page, bool shared = false)
 {
-  changeset->put(page);
+  changeset->put(page, shared);
   assert(page->mutex().try_lock() == false);
   return page;
 }
 
+// Same as above, but does not block if the page is locked by another
+// thread. Then |*would_block| is set to true and null is returned.
+static inline Page *
+try_add_to_changeset(Changeset *changeset, Page *page, bool *would_block,
+                bool shared = false)
+{
+  if (!would_block)
+    return add_to_changeset(changeset, page, shared);
+  if (!changeset->try_put(page, shared)) {
+    *would_block = true;
+    return 0;
+  }
+  return page;
+}
+
 static inline uint64_t
 store_state_impl(PageManagerState *state, Context *context)
 {
@@ -227,7 +247,7 @@ maybe_store_state(PageManagerState *state, Context *context, bool force)
 
 static inline Page *
 fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
-                uint32_t flags)
+                uint32_t flags, bool *would_block)
 {
   /* fetch the page from the cache */
   Page *page;
@@ -240,15 +260,29 @@ fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
     page = state->cache.get(address);
 
   if (page) {
-    page->set_without_header(ISSET(flags, PageManager::kNoHeader));
-    return add_to_changeset(&context->changeset, page);
+    page = try_add_to_changeset(&context->changeset, page, would_block,
+                    ISSET(flags, PageManager::kSharedLatch));
+    if (page)
+      page->set_without_header(ISSET(flags, PageManager::kNoHeader));
+    return page;
   }
 
   if (ISSET(flags, PageManager::kOnlyFromCache)
           || ISSET(state->config.flags, UPS_IN_MEMORY))
     return 0;
 
+  // Another thread is reading this page without holding the lock; wait
+  // till it was added to the Cache. If the caller cannot wait then the
+  // page is read again, and the other thread will discard its copy.
+  if (unlikely(!state->pending_reads.empty()) && would_block
+        && std::find(state->pending_reads.begin(), state->pending_reads.end(),
+                    address) != state->pending_reads.end()) {
+    *would_block = true;
+    return 0;
+  }
+
   page = new Page(state->device, context->db);
+  page->set_without_header(ISSET(flags, PageManager::kNoHeader));
   try {
     page->fetch(address);
   }
@@ -257,6 +291,15 @@ fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
     throw ex;
   }
 
+  return store_fetched_page(state, context, page, flags);
+}
+
+// Stores a page which was read from the device in the Cache and adds it
+// to the Changeset
+static inline Page *
+store_fetched_page(PageManagerState *state, Context *context, Page *page,
+                uint32_t flags)
+{
   assert(page->data());
 
   /* store the page in the list */
@@ -271,10 +314,11 @@ fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
   page->set_without_header(ISSET(flags, PageManager::kNoHeader));
   if (!page->is_without_header()
           && ISSET(state->config.flags, UPS_ENABLE_CRC32))
-    verify_crc32(page);
+    verify_crc32(state, page);
 
   state->page_count_fetched++;
-  return add_to_changeset(&context->changeset, page);
+  return add_to_changeset(&context->changeset, page,
+                  ISSET(flags, PageManager::kSharedLatch));
 }
 
 static inline Page *
@@ -399,7 +443,7 @@ PageManager::initialize(uint64_t pageid)
   state->state_page = new Page(state->device);
   state->state_page->fetch(pageid);
   if (ISSET(state->config.flags, UPS_ENABLE_CRC32))
-    verify_crc32(state->state_page);
+    verify_crc32(state.get(), state->state_page);
 
   Page *page = state->state_page;
 
@@ -427,11 +471,184 @@ PageManager::initialize(uint64_t pageid)
   }
 }
 
+// Latches a cached page for fetch() without locking the PageManager; fails
+// if the page is in use by another thread
+struct FastFetchVisitor
+{
+  FastFetchVisitor(Context *context_, uint32_t flags_)
+    : context(context_), flags(flags_) {
+  }
+
+  bool operator()(Page *page) {
+    bool would_block = false;
+    if (!try_add_to_changeset(&context->changeset, page, &would_block,
+                            ISSET(flags, PageManager::kSharedLatch)))
+      return false;
+    bool without_header = ISSET(flags, PageManager::kNoHeader);
+    if (page->is_without_header() != without_header)
+      page->set_without_header(without_header);
+    return true;
+  }
+
+  Context *context;
+  uint32_t flags;
+};
+
+// Reads a page which is not cached from the device without holding the
+// PageManager's lock. Returns null if the page is cached, in use by another
+// thread, or if the regular code path has to be used instead (i.e. because
+// the page is memory mapped, and reading it is cheap).
+static Page *
+fetch_outside_lock(PageManagerState *state, Context *context,
+                uint64_t address, uint32_t flags)
+{
+  if (ISSET(flags, PageManager::kOnlyFromCache)
+          || ISSET(state->config.flags, UPS_IN_MEMORY)
+          || state->device->is_mapped(address, state->config.page_size_bytes))
+    return 0;
+
+  {
+    ScopedSpinlock lock(state->mutex);
+    if ((state->state_page && address == state->state_page->address())
+          || state->cache.contains(address)
+          || std::find(state->pending_reads.begin(),
+                  state->pending_reads.end(), address)
+              != state->pending_reads.end())
+      return 0;
+    state->pending_reads.push_back(address);
+  }
+
+  Page *page = new Page(state->device, context->db);
+  page->set_without_header(ISSET(flags, PageManager::kNoHeader));
+  try {
+    page->fetch(address);
+  }
+  catch (Exception &) {
+    delete page;
+    page = 0;
+  }
+
+  ScopedSpinlock lock(state->mutex);
+  state->pending_reads.erase(std::find(state->pending_reads.begin(),
+                          state->pending_reads.end(), address));
+
+  // fall back to the regular code path if the read failed (it will throw
+  // again) or if another thread stored the page in the meantime
+  if (!page)
+    return 0;
+  if (state->cache.contains(address)) {
+    delete page;
+    return 0;
+  }
+  return store_fetched_page(state, context, page, flags);
+}
+
 Page *
 PageManager::fetch(Context *context, uint64_t address, uint32_t flags)
 {
+  // Fast path for cached pages: only the shard of the Cache is locked, and
+  // concurrent readers do not block each other. The header page is not
+  // stored in the Cache.
+  if (likely(address != 0)) {
+    FastFetchVisitor visitor(context, flags);
+    Page *page = state->cache.get_if(address, visitor);
+    if (page)
+      return page;
+  }
+
+  // Cache misses read the page from the device without holding the lock,
+  // therefore concurrent misses do not serialize on the I/O
+  if (likely(address != 0)) {
+    Page *page = fetch_outside_lock(state.get(), context, address, flags);
+    if (page)
+      return page;
+  }
+
+  // If the page is in use by another thread then release the lock before
+  // waiting; the other thread might require the PageManager to make
+  // progress.
+  for (int k = 0; ; k++) {
+    {
+      ScopedSpinlock lock(state->mutex);
+      bool would_block = false;
+      Page *page = fetch_unlocked(state.get(), context, address, flags,
+                      &would_block);
+      if (likely(!would_block))
+        return page;
+    }
+    Spinlock::spin(k);
+  }
+}
+
+void
+PageManager::prefetch(Context *context, const std::vector<uint64_t> &addresses)
+{
+  if (ISSET(state->config.flags, UPS_IN_MEMORY)
+          || !state->device->supports_batched_reads())
+    return;
+
+  std::vector<uint64_t> missing;
+  {
+    ScopedSpinlock lock(state->mutex);
+    for (std::vector<uint64_t>::const_iterator it = addresses.begin();
+                    it != addresses.end(); it++) {
+      uint64_t address = *it;
+      if (address == 0
+            || state->device->is_mapped(address,
+                                  state->config.page_size_bytes)
+            || (state->state_page
+                  && address == state->state_page->address())
+            || state->cache.contains(address)
+            || std::find(state->pending_reads.begin(),
+                    state->pending_reads.end(), address)
+                != state->pending_reads.end())
+        continue;
+      state->pending_reads.push_back(address);
+      missing.push_back(address);
+    }
+  }
+
+  if (missing.empty())
+    return;
+
+  // read the pages without holding the lock
+  std::vector<Page *> pages(missing.size());
+  for (size_t i = 0; i < missing.size(); i++)
+    pages[i] = new Page(state->device, context->db);
+  bool failed = false;
+  try {
+    Page::fetch_all(state->device, pages, missing);
+  }
+  catch (Exception &) {
+    failed = true;
+  }
+
   ScopedSpinlock lock(state->mutex);
-  return fetch_unlocked(state.get(), context, address, flags);
+  for (size_t i = 0; i < missing.size(); i++) {
+    state->pending_reads.erase(std::find(state->pending_reads.begin(),
+                            state->pending_reads.end(), missing[i]));
+
+    // discard the page if the read failed or the page is corrupt (fetch()
+    // will read it again and fail), or if another thread stored the page
+    // in the meantime
+    Page *page = pages[i];
+    if (failed || state->cache.contains(missing[i])) {
+      delete page;
+      continue;
+    }
+    if (ISSET(state->config.flags, UPS_ENABLE_CRC32)) {
+      try {
+        verify_crc32(state.get(), page);
+      }
+      catch (Exception &) {
+        delete page;
+        continue;
+      }
+    }
+
+    state->cache.put(page);
+    state->page_count_fetched++;
+  }
 }
 
 Page *
@@ -497,6 +714,10 @@ PageManager::fill_metrics(ups_env_metrics_t *metrics) const
 {
   metrics->page_count_fetched = state->page_count_fetched;
   metrics->page_count_flushed = Page::ms_page_count_flushed;
+  metrics->page_bytes_before_compression
+          = Page::ms_page_bytes_before_compression;
+  metrics->page_bytes_after_compression
+          = Page::ms_page_bytes_after_compression;
   metrics->page_count_type_index = state->page_count_index;
   metrics->page_count_type_blob = state->page_count_blob;
   metrics->page_count_type_page_manager = state->page_count_page_manager;
@@ -743,7 +964,7 @@ PageManager::close(Context *context)
 #ifdef WIN32
   // Win32: it's not possible to truncate the file while there's an active
   // mapping, therefore only reclaim if memory mapped I/O is disabled
-  if (NOTSET(state->config.flags, UPS_DISABLE_MMAP))
+  if (!state->config.is_mmap_disabled())
     try_reclaim = false;
 #endif
 
@@ -755,6 +976,10 @@ PageManager::close(Context *context)
         && NOTSET(state->config.flags, UPS_READ_ONLY))
     maybe_store_state(state.get(), context, true);
 
+  // storing the state can allocate a page, and the device then allocates
+  // excess storage at the end of the file again
+  state->device->reclaim_space();
+
   // clear the Changeset because flush() will delete all Page pointers
   context->changeset.clear();
 
@@ -775,13 +1000,24 @@ PageManager::reset(Context *context)
 Page *
 PageManager::last_blob_page(Context *context)
 {
-  ScopedSpinlock lock(state->mutex);
-
-  if (state->last_blob_page)
-    return add_to_changeset(&context->changeset, state->last_blob_page);
-  if (state->last_blob_page_id)
-    return fetch_unlocked(state.get(), context, state->last_blob_page_id, 0);
-  return 0;
+  // same as fetch(): do not block while holding the lock
+  for (int k = 0; ; k++) {
+    {
+      ScopedSpinlock lock(state->mutex);
+      bool would_block = false;
+      Page *page = 0;
+
+      if (state->last_blob_page)
+        page = try_add_to_changeset(&context->changeset,
+                        state->last_blob_page, &would_block);
+      else if (state->last_blob_page_id)
+        page = fetch_unlocked(state.get(), context, state->last_blob_page_id,
+                        0, &would_block);
+      if (likely(!would_block))
+        return page;
+    }
+    Spinlock::spin(k);
+  }
 }
 
 void 
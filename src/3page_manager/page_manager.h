@@ -34,6 +34,7 @@
 #include "0root/root.h"
 
 #include <map>
+#include <vector>
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/scoped_ptr.h"
@@ -68,7 +69,10 @@ struct PageManager
     kReadOnly = 2,
 
     // Flag for fetch(): page is part of a multi-page blob, has no header
-    kNoHeader = 4
+    kNoHeader = 4,
+
+    // Flag for fetch(): latches the page in shared mode (lock coupling)
+    kSharedLatch = 8
   };
 
   // Constructor
@@ -88,6 +92,11 @@ struct PageManager
   // The page is locked and stored in |context->changeset|.
   Page *fetch(Context *context, uint64_t address, uint32_t flags = 0);
 
+  // Reads the pages at |addresses| with a single batch and stores them in
+  // the Cache, if the Device supports batched reads. Pages which are cached
+  // or mapped are skipped. The pages are not added to the Changeset.
+  void prefetch(Context *context, const std::vector<uint64_t> &addresses);
+
   // Allocates a new page. |page_type| is one of Page::kType* in page.h.
   // |flags| are either 0 or kClearWithZero
   // The page is locked and stored in |context->changeset|.
@@ -117,6 +117,10 @@ struct PageManagerState {
   // tracks number of cache misses
   uint64_t cache_misses;
 
+  // Addresses of pages which are currently read from the device by
+  // PageManager::fetch() without holding |mutex|
+  std::vector<uint64_t> pending_reads;
+
   // For sending information to the worker thread; cached to avoid memory
   // allocations
   AsyncFlushMessage *message;
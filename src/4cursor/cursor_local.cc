@@ -75,13 +75,18 @@ append_txn_duplicates(LocalCursor *cursor, Context *context)
   if (!node)
     return;
 
+  LocalTxn *txn = (LocalTxn *)cursor->txn;
+
   // now start integrating the items from the transactions
   for (op = node->oldest_op; op; op = op->next_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
     // collect all ops that are valid (even those that are
     // from conflicting transactions)
     if (unlikely(optxn->is_aborted()))
       continue;
+    // but skip those which are not part of a read-only Txn's snapshot
+    if (txn && unlikely(txn->is_hidden_in_snapshot(optxn)))
+      continue;
 
     // a normal (overwriting) insert will overwrite ALL duplicates,
     // but an overwrite of a duplicate will only overwrite
@@ -1103,6 +1108,7 @@ uint32_t
 LocalCursor::get_duplicate_count(uint32_t flags)
 {
   Context context(lenv(this), (LocalTxn *)txn, ldb(this));
+  ldb(this)->share_changeset(&context);
 
   if (unlikely(is_nil()))
     throw Exception(UPS_CURSOR_IS_NIL);
@@ -1125,6 +1131,7 @@ uint32_t
 LocalCursor::get_record_size()
 {
   Context context(lenv(this), (LocalTxn *)txn, ldb(this));
+  ldb(this)->share_changeset(&context);
 
   if (unlikely(is_nil()))
     throw Exception(UPS_CURSOR_IS_NIL);
@@ -24,6 +24,8 @@
 #include "ups/upscaledb_int.h"
 #include "ups/upscaledb_uqi.h"
 
+#include <boost/thread/tss.hpp>
+
 // Always verify that a file of level N does not include headers > N!
 #include "1base/dynamic_array.h"
 #include "2config/db_config.h"
@@ -85,6 +87,13 @@ struct Db
   // Checks the database integrity (ups_db_check_integrity)
   virtual ups_status_t check_integrity(uint32_t flags) = 0;
 
+  // Trains a record compression dictionary (ups_db_train_dictionary)
+  virtual ups_status_t train_dictionary(uint32_t dictionary_size) = 0;
+
+  // Loads sorted keys and records into an empty database (ups_db_bulk_load)
+  virtual ups_status_t bulk_load(ups_bulk_load_func_t func, void *context,
+                  uint32_t fill_factor) = 0;
+
   // Returns the number of keys (ups_db_count)
   virtual uint64_t count(Txn *txn, bool distinct) = 0;
 
@@ -124,19 +133,32 @@ struct Db
   void remove_cursor(Cursor *cursor);
 
   // Returns the memory buffer for the key data: the per-database buffer
-  // if |txn| is null or temporary, otherwise the buffer from the |txn|
+  // if |txn| is null or temporary, otherwise the buffer from the |txn|.
+  // With UPS_ENABLE_CONCURRENT_READS, each thread has its own buffer.
   ByteArray &key_arena(Txn *txn) {
-    return (txn == 0 || ISSET(txn->flags, UPS_TXN_TEMPORARY))
-               ? _key_arena
-               : txn->key_arena;
+    if (txn == 0 || ISSET(txn->flags, UPS_TXN_TEMPORARY))
+      return ISSET(flags(), UPS_ENABLE_CONCURRENT_READS)
+               ? thread_arena(_thread_key_arena)
+               : _key_arena;
+    return txn->key_arena;
   }
 
   // Returns the memory buffer for the record data: the per-database buffer
-  // if |txn| is null or temporary, otherwise the buffer from the |txn|
+  // if |txn| is null or temporary, otherwise the buffer from the |txn|.
+  // With UPS_ENABLE_CONCURRENT_READS, each thread has its own buffer.
   ByteArray &record_arena(Txn *txn) {
-    return (txn == 0 || ISSET(txn->flags, UPS_TXN_TEMPORARY))
-               ? _record_arena
-               : txn->record_arena;
+    if (txn == 0 || ISSET(txn->flags, UPS_TXN_TEMPORARY))
+      return ISSET(flags(), UPS_ENABLE_CONCURRENT_READS)
+               ? thread_arena(_thread_record_arena)
+               : _record_arena;
+    return txn->record_arena;
+  }
+
+  // Returns the calling thread's buffer; allocates it if necessary
+  static ByteArray &thread_arena(boost::thread_specific_ptr<ByteArray> &tsp) {
+    if (unlikely(tsp.get() == 0))
+      tsp.reset(new ByteArray);
+    return *tsp.get();
   }
 
   // the current Environment
@@ -158,6 +180,95 @@ struct Db
   // This is where record->data points to when returning a
   // record to the user; used if Txns are disabled
   ByteArray _record_arena;
+
+  // The per-thread key buffers (UPS_ENABLE_CONCURRENT_READS)
+  boost::thread_specific_ptr<ByteArray> _thread_key_arena;
+
+  // The per-thread record buffers (UPS_ENABLE_CONCURRENT_READS)
+  boost::thread_specific_ptr<ByteArray> _thread_record_arena;
+
+  // Locked in shared mode by readers and exclusively by writers if
+  // UPS_ENABLE_CONCURRENT_READS is set
+  ReadWriteMutex mutex;
+};
+
+//
+// Locks a Database for the duration of an operation. By default, the whole
+// Environment is locked. With UPS_ENABLE_CONCURRENT_READS, readers lock the
+// Environment and the Database in shared mode. Writers lock the Database
+// exclusively and then serialize with the writers of other Databases.
+//
+// Inserts (kUpdate) first lock the Database in shared mode, too; they are
+// serialized by the page latches of the Btree (see BtreeIndex::kLatchCoupling).
+// If the insert has to modify more than a single leaf, or if the Database
+// has open Cursors, then the caller calls upgrade() and restarts the
+// operation with an exclusive lock.
+//
+// Transactions and compressed keys use state which is shared by all
+// readers. If Transactions are enabled then the whole Environment is locked;
+// Databases with compressed keys are locked exclusively.
+//
+struct ScopedDbLock
+{
+  enum {
+    kShared,
+    kExclusive,
+    kUpdate
+  };
+
+  ScopedDbLock(Db *db_, int mode, bool enabled = true)
+    : db(db_), coupled(false) {
+    if (!enabled)
+      return;
+
+    Env *env = db->env;
+    if (NOTSET(env->flags(), UPS_ENABLE_CONCURRENT_READS)
+          || ISSET(env->flags(), UPS_ENABLE_TRANSACTIONS)) {
+      env_write_lock = ScopedWriteLock(env->mutex);
+      return;
+    }
+
+    if (db->config.key_compressor != 0)
+      mode = kExclusive;
+
+    env_read_lock = ScopedReadLock(env->mutex);
+    if (mode == kShared || mode == kUpdate) {
+      db_read_lock = ScopedReadLock(db->mutex);
+      coupled = (mode == kUpdate);
+    }
+    else {
+      db_write_lock = ScopedWriteLock(db->mutex);
+      writer_lock = ScopedLock(db->env->writer_mutex);
+    }
+  }
+
+  // Returns true if a kUpdate operation only holds a shared lock, and
+  // has to use lock coupling
+  bool is_coupled() const {
+    return coupled;
+  }
+
+  // Replaces the shared lock of a kUpdate operation with an exclusive lock
+  void upgrade() {
+    assert(coupled == true);
+    db_read_lock.unlock();
+    db_write_lock = ScopedWriteLock(db->mutex);
+    writer_lock = ScopedLock(db->env->writer_mutex);
+    coupled = false;
+  }
+
+  // the locked Database
+  Db *db;
+
+  // true if this is a kUpdate operation with a shared lock
+  bool coupled;
+
+  // the locks are released in reverse order
+  ScopedWriteLock env_write_lock;
+  ScopedReadLock env_read_lock;
+  ScopedReadLock db_read_lock;
+  ScopedWriteLock db_write_lock;
+  ScopedLock writer_lock;
 };
 
 } // namespace upscaledb
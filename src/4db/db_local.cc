@@ -107,6 +107,41 @@ finalize(LocalEnv *env, Context *context, ups_status_t status, Txn *local_txn)
   return 0;
 }
 
+// Returns true if inserting |key| and |record| only modifies a single
+// leaf, and never allocates blobs. Then the insert can run concurrently to
+// other inserts (see BtreeIndex::kLatchCoupling).
+static inline bool
+is_leaf_only_insert(LocalDb *db, const ups_key_t *key,
+                const ups_record_t *record, uint32_t flags)
+{
+  // the insert uncouples the cursors of the modified leaf, and concurrent
+  // cursor moves read the leaf without a latch. Cursors are only created
+  // and closed with an exclusive lock, therefore the list is stable here
+  if (db->cursor_list != 0)
+    return false;
+  // overwriting an existing record can free a blob
+  if (ISSETANY(flags, UPS_OVERWRITE | UPS_DUPLICATE))
+    return false;
+  if (ISSETANY(db->flags(), UPS_ENABLE_DUPLICATE_KEYS
+                                | UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64
+                                | UPS_ENABLE_TRANSACTIONS
+                                | UPS_ENABLE_RECOVERY))
+    return false;
+  // records with more than 8 bytes are stored in a blob, unless they are
+  // forced inline
+  if (record->size > sizeof(uint64_t)
+        && NOTSET(db->config.flags, UPS_FORCE_RECORDS_INLINE))
+    return false;
+  // long keys are stored in a blob; 64 bytes is the smallest threshold
+  // for extended keys
+  if (db->config.key_size == UPS_KEY_SIZE_UNLIMITED
+        && (key->size > 64
+              || (Globals::ms_extended_threshold
+                    && key->size > Globals::ms_extended_threshold)))
+    return false;
+  return db->config.key_compressor == 0;
+}
+
 // Returns true if this database is modified by an active transaction
 static inline bool
 is_modified_by_active_transaction(TxnIndex *txn_index)
@@ -144,9 +179,11 @@ is_key_erased(Context *context, TxnIndex *txn_index, ups_key_t *key)
   for (TxnOperation *op = node->newest_op;
                   op != 0;
                   op = op->previous_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
     if (optxn->is_aborted())
       continue;
+    if (context->txn && unlikely(context->txn->is_hidden_in_snapshot(optxn)))
+      continue;
     if (optxn->is_committed() || context->txn == optxn) {
       if (ISSET(op->flags, TxnOperation::kIsFlushed))
         continue;
@@ -332,9 +369,13 @@ retry:
     op = node->newest_op;
 
   for (; op != 0; op = op->previous_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
     if (optxn->is_aborted())
       continue;
+    // a read-only Txn ignores the transactions which were not yet
+    // committed when its snapshot was taken; there are no conflicts
+    if (context->txn && unlikely(context->txn->is_hidden_in_snapshot(optxn)))
+      continue;
 
     if (optxn->is_committed() || context->txn == optxn) {
       if (unlikely(ISSET(op->flags, TxnOperation::kIsFlushed)))
@@ -573,7 +614,6 @@ erase_txn(LocalDb *db, Context *context, ups_key_t *key, uint32_t flags,
     if (unlikely(st)) {
       if (node_created) {
         db->txn_index->remove(node);
-        delete node;
       }
       return st;
     }
@@ -784,10 +824,15 @@ LocalDb::open(Context *context, PBtreeHeader *btree_header)
     compare_function = f;
   }
 
-  // is record compression enabled?
+  // is record compression enabled? then also load the dictionary
   if (config.record_compressor) {
     record_compressor.reset(CompressorFactory::create(
                                     config.record_compressor));
+
+    ByteArray dictionary;
+    uint32_t size = lenv(this)->read_dictionary(context, name(), &dictionary);
+    if (size > 0)
+      record_compressor->set_dictionary(dictionary.data(), size);
   }
 
   // fetch the current record number
@@ -899,12 +944,149 @@ LocalDb::check_integrity(uint32_t flags)
   return 0;
 }
 
+ups_status_t
+LocalDb::train_dictionary(uint32_t dictionary_size)
+{
+  if (config.record_compressor != UPS_COMPRESSOR_ZSTD) {
+    ups_trace(("dictionaries require UPS_COMPRESSOR_ZSTD"));
+    return UPS_INV_PARAMETER;
+  }
+
+  Context context(lenv(this), 0, this);
+
+  ByteArray dictionary;
+  if (lenv(this)->read_dictionary(&context, name(), &dictionary) > 0) {
+    ups_trace(("database already has a dictionary"));
+    return UPS_ALREADY_INITIALIZED;
+  }
+
+  // sample the existing records; zstd recommends about 100 times the
+  // dictionary size as training input
+  ByteArray samples;
+  std::vector<size_t> sizes;
+  size_t max_samples = (size_t)dictionary_size * 100;
+
+  ups_key_t key = {0};
+  ups_record_t record = {0};
+  ScopedPtr<LocalCursor> c(new LocalCursor(this, 0));
+  ups_status_t st = c->move(&context, &key, &record, UPS_CURSOR_FIRST);
+  while (st == 0 && samples.size() < max_samples) {
+    if (record.size > 0) {
+      samples.append((uint8_t *)record.data, record.size);
+      sizes.push_back(record.size);
+    }
+    st = c->move(&context, &key, &record, UPS_CURSOR_NEXT);
+  }
+  if (unlikely(st != 0 && st != UPS_KEY_NOT_FOUND))
+    return st;
+  c.reset();
+
+  if (sizes.size() < 10) {
+    ups_trace(("not enough records for training a dictionary"));
+    return UPS_INV_PARAMETER;
+  }
+
+  dictionary.resize(dictionary_size);
+  uint32_t size = record_compressor->train_dictionary(samples.data(),
+                  sizes.data(), (uint32_t)sizes.size(), dictionary.data(),
+                  dictionary_size);
+
+  lenv(this)->write_dictionary(&context, name(), dictionary.data(), size);
+  record_compressor->set_dictionary(dictionary.data(), size);
+  return 0;
+}
+
+// The input of a bulk load; forwards to the caller's function and
+// validates the keys and records
+struct BulkLoadInput {
+  LocalDb *db;
+  ups_bulk_load_func_t func;
+  void *context;
+};
+
+static ups_status_t UPS_CALLCONV
+next_bulk_load_pair(void *context, ups_key_t *key, ups_record_t *record)
+{
+  BulkLoadInput *input = (BulkLoadInput *)context;
+  ups_status_t st = input->func(input->context, key, record);
+  if (st)
+    return st;
+
+  if (unlikely((key->size && !key->data) || (record->size && !record->data))) {
+    ups_trace(("key or record has a size, but no data"));
+    return UPS_INV_PARAMETER;
+  }
+
+  DbConfig &config = input->db->config;
+  if (unlikely(config.key_size != UPS_KEY_SIZE_UNLIMITED
+                          && key->size != config.key_size)) {
+    ups_trace(("invalid key size (%u instead of %u)",
+          key->size, config.key_size));
+    return UPS_INV_KEY_SIZE;
+  }
+  if (unlikely(config.record_size != UPS_RECORD_SIZE_UNLIMITED
+                          && record->size != config.record_size)) {
+    ups_trace(("invalid record size (%u instead of %u)",
+          record->size, config.record_size));
+    return UPS_INV_RECORD_SIZE;
+  }
+  return 0;
+}
+
+ups_status_t
+LocalDb::bulk_load(ups_bulk_load_func_t func, void *func_context,
+                uint32_t fill_factor)
+{
+  LocalEnv *env = lenv(this);
+  Context context(env, 0, this);
+
+  // committed Txns are merged first; they could still insert keys
+  if (env->txn_manager.get()) {
+    env->txn_manager->flush_committed_txns(&context);
+    if (unlikely(env->txn_manager->oldest_txn() != 0)) {
+      ups_trace(("cannot bulk load while a Txn is active"));
+      return UPS_TXN_STILL_OPEN;
+    }
+  }
+
+  {
+    ScopedPtr<LocalCursor> c(new LocalCursor(this, 0));
+    ups_status_t st = c->move(&context, 0, 0, UPS_CURSOR_FIRST);
+    if (st != UPS_KEY_NOT_FOUND) {
+      if (st == 0) {
+        ups_trace(("cannot bulk load a database which is not empty"));
+        st = UPS_INV_PARAMETER;
+      }
+      return st;
+    }
+  }
+
+  BulkLoadInput input = {this, func, func_context};
+  ups_status_t st = btree_index->bulk_load(&context, next_bulk_load_pair,
+                  &input, fill_factor);
+  histogram.reset();
+  context.changeset.clear();
+  if (unlikely(st))
+    return st;
+
+  // the single durable checkpoint: all pages are written and synced, and
+  // the journal is no longer required for recovery
+  if (NOTSET(env->flags(), UPS_IN_MEMORY)) {
+    env->page_manager->flush_all_pages();
+    env->device->flush();
+    if (env->journal.get())
+      env->journal->full_checkpoint();
+  }
+  return 0;
+}
+
 uint64_t
 LocalDb::count(Txn *htxn, bool distinct)
 {
   LocalTxn *txn = dynamic_cast<LocalTxn *>(htxn);
 
   Context context(lenv(this), txn, this);
+  share_changeset(&context);
 
   // purge cache if necessary
   lenv(this)->page_manager->purge_cache(&context);
@@ -1005,7 +1187,6 @@ insert_txn(LocalDb *db, Context *context, ups_key_t *key, ups_record_t *record,
   if (unlikely(st)) {
     if (node_created) {
       db->txn_index->remove(node);
-      delete node;
     }
     return st;
   }
@@ -1087,6 +1268,17 @@ ups_status_t
 LocalDb::insert(Cursor *hcursor, Txn *txn, ups_key_t *key,
                 ups_record_t *record, uint32_t flags)
 {
+  if (unlikely(txn && ISSET(txn->flags, UPS_TXN_READ_ONLY))) {
+    ups_trace(("cannot insert in a read-only transaction"));
+    return UPS_WRITE_PROTECTED;
+  }
+
+  // the caller only holds a shared lock; restart with an exclusive lock
+  // if the insert does not qualify for lock coupling
+  if (ISSET(flags, BtreeIndex::kLatchCoupling)
+        && (hcursor || !is_leaf_only_insert(this, key, record, flags)))
+    return UPS_LIMITS_REACHED;
+
   if (config.flags & (UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64)) {
     if (unlikely(key->size == 0 && key->data != 0)) {
       ups_trace(("for record number keys set key size to 0, "
@@ -1155,6 +1347,11 @@ LocalDb::erase(Cursor *hcursor, Txn *txn, ups_key_t *key, uint32_t flags)
 {
   LocalCursor *cursor = (LocalCursor *)hcursor;
 
+  if (unlikely(txn && ISSET(txn->flags, UPS_TXN_READ_ONLY))) {
+    ups_trace(("cannot erase in a read-only transaction"));
+    return UPS_WRITE_PROTECTED;
+  }
+
   if (unlikely(cursor && cursor->is_nil()))
     return UPS_CURSOR_IS_NIL;
 
@@ -1208,6 +1405,7 @@ LocalDb::find(Cursor *hcursor, Txn *txn, ups_key_t *key,
   }
 
   Context context(lenv(this), (LocalTxn *)txn, this);
+  share_changeset(&context);
 
   // purge cache if necessary
   lenv(this)->page_manager->purge_cache(&context);
@@ -1357,6 +1555,7 @@ LocalDb::cursor_move(Cursor *hcursor, ups_key_t *key,
   LocalCursor *cursor = (LocalCursor *)hcursor;
 
   Context context(lenv(this), (LocalTxn *)cursor->txn, this);
+  share_changeset(&context);
 
   // purge cache if necessary
   lenv(this)->page_manager->purge_cache(&context);
@@ -1460,6 +1659,7 @@ LocalDb::select_range(SelectStatement *stmt, LocalCursor *begin,
     return UPS_PARSER_ERROR;
 
   Context context(lenv(this), 0, this);
+  share_changeset(&context);
 
   Result *result = new Result;
 
@@ -1607,6 +1807,14 @@ bail:
   return st == UPS_KEY_NOT_FOUND ? 0 : st;
 }
 
+void
+LocalDb::share_changeset(Context *context)
+{
+  if (ISSET(flags(), UPS_ENABLE_CONCURRENT_READS)
+        && NOTSET(flags(), UPS_ENABLE_TRANSACTIONS))
+    context->changeset.set_shared();
+}
+
 ups_status_t
 LocalDb::flush_txn_operation(Context *context, LocalTxn *txn, TxnOperation *op)
 {
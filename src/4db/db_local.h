@@ -77,6 +77,13 @@ struct LocalDb : public Db {
   // Checks database integrity (ups_db_check_integrity)
   virtual ups_status_t check_integrity(uint32_t flags);
 
+  // Trains a record compression dictionary (ups_db_train_dictionary)
+  virtual ups_status_t train_dictionary(uint32_t dictionary_size);
+
+  // Loads sorted keys and records into an empty database (ups_db_bulk_load)
+  virtual ups_status_t bulk_load(ups_bulk_load_func_t func, void *context,
+                  uint32_t fill_factor);
+
   // Returns the number of keys
   virtual uint64_t count(Txn *txn, bool distinct);
 
@@ -113,6 +120,10 @@ struct LocalDb : public Db {
   ups_status_t select_range(SelectStatement *stmt, LocalCursor *begin,
                   LocalCursor *end, Result **result);
 
+  // Read-only operations lock their pages in shared mode if several
+  // threads can read concurrently (UPS_ENABLE_CONCURRENT_READS)
+  void share_changeset(Context *context);
+
   // Flushes a TxnOperation to the btree
   ups_status_t flush_txn_operation(Context *context, LocalTxn *txn,
                   TxnOperation *op);
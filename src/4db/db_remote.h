@@ -55,6 +55,17 @@ struct RemoteDb : public Db
   // Checks database integrity (ups_db_check_integrity)
   virtual ups_status_t check_integrity(uint32_t flags);
 
+  // Trains a record compression dictionary (ups_db_train_dictionary)
+  virtual ups_status_t train_dictionary(uint32_t dictionary_size) {
+    return UPS_NOT_IMPLEMENTED;
+  }
+
+  // Loads sorted keys and records into an empty database (ups_db_bulk_load)
+  virtual ups_status_t bulk_load(ups_bulk_load_func_t func, void *context,
+                  uint32_t fill_factor) {
+    return UPS_NOT_IMPLEMENTED;
+  }
+
   // Returns the number of keys
   virtual uint64_t count(Txn *txn, bool distinct);
 
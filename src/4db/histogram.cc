@@ -108,5 +108,12 @@ Histogram::reset_if_equal(ups_key_t *key)
     ::memset(&upper, 0, sizeof(upper));
 }
 
+void
+Histogram::reset()
+{
+  ::memset(&lower, 0, sizeof(lower));
+  ::memset(&upper, 0, sizeof(upper));
+}
+
 } // namespace upscaledb
 
@@ -72,6 +72,10 @@ struct Histogram {
   // keys
   void reset_if_equal(ups_key_t *key);
 
+  // resets both stored keys; used when the database was replaced (i.e.
+  // by a bulk load)
+  void reset();
+
   // the database (used to fetch and compare keys)
   LocalDb *db;
 
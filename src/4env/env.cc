@@ -95,16 +95,29 @@ Env::close(uint32_t flags)
 {
   ups_status_t st = 0;
 
-  ScopedLock lock(mutex);
+  // the background thread which merges committed transactions acquires
+  // the lock, therefore it is terminated first
+  if (txn_manager.get())
+    txn_manager->stop_merger();
+
+  ScopedWriteLock lock(mutex);
 
   /* auto-abort (or commit) all pending transactions */
   if (txn_manager.get()) {
     Txn *t;
 
     while ((t = txn_manager->oldest_txn())) {
-      if (!t->is_aborted() && !t->is_committed()) {
-        if (ISSET(flags, UPS_TXN_AUTO_COMMIT))
+      // committed transactions are not merged as long as an older
+      // read-only Txn is active; therefore end the first active one
+      while (t && (t->is_aborted() || t->is_committed()))
+        t = t->next();
+      if (t) {
+        if (ISSET(flags, UPS_TXN_AUTO_COMMIT)) {
           st = txn_manager->commit(t);
+          uint64_t lsn = st == 0 ? txn_unsynced_commit() : 0;
+          if (lsn)
+            st = txn_sync(lsn, 0);
+        }
         else /* if (flags & UPS_TXN_AUTO_ABORT) */
           st = txn_manager->abort(t);
         if (unlikely(st))
@@ -113,6 +113,20 @@ struct Env
   // Commits a transaction (ups_txn_commit)
   virtual ups_status_t txn_commit(Txn *txn, uint32_t flags) = 0;
 
+  // Returns the lsn of the last commit if it still has to be synced to
+  // disk (see txn_sync()); otherwise returns 0. Requires |mutex|
+  virtual uint64_t txn_unsynced_commit() {
+    return 0;
+  }
+
+  // Makes the commits up to |lsn| durable, as requested by the |flags| of
+  // ups_txn_commit (UPS_TXN_COMMIT_SYNC etc). Called by ups_txn_commit()
+  // after |mutex| was released, therefore concurrent commits share a
+  // single sync
+  virtual ups_status_t txn_sync(uint64_t lsn, uint32_t flags) {
+    return 0;
+  }
+
   // Commits a transaction (ups_txn_abort)
   virtual ups_status_t txn_abort(Txn *txn, uint32_t flags) = 0;
 
@@ -135,8 +149,14 @@ struct Env
   // Closes the Environment (ups_env_close)
   ups_status_t close(uint32_t flags);
 
-  // A mutex to serialize access to this Environment
-  Mutex mutex;
+  // A mutex to serialize access to this Environment. If
+  // UPS_ENABLE_CONCURRENT_READS is set then database operations only lock
+  // it in shared mode, and lock their Database instead
+  ReadWriteMutex mutex;
+
+  // With UPS_ENABLE_CONCURRENT_READS: serializes the writers of different
+  // Databases, because they share the Environment's state
+  Mutex writer_mutex;
 
   // The Environment's configuration
   EnvConfig config;
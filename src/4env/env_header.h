@@ -49,8 +49,11 @@ typedef UPS_PACK_0 struct UPS_PACK_1
   // version information - major, minor, rev, file
   uint8_t version[4];
 
+  // the page compression algorithm; 0 if pages are not compressed
+  uint8_t page_compression;
+
   // reserved
-  uint64_t _reserved1;
+  uint8_t _reserved1[7];
 
   // size of the page
   uint32_t page_size;
@@ -61,8 +64,8 @@ typedef UPS_PACK_0 struct UPS_PACK_1
   // for storing journal compression algorithm
   uint8_t journal_compression;
 
-  // reserved
-  uint8_t _reserved2;
+  // the checksum algorithm (see Checksum); files of version 5 store 0
+  uint8_t checksum_algorithm;
 
   // blob id of the PageManager's state
   uint64_t page_manager_blobid;
@@ -79,6 +82,12 @@ typedef UPS_PACK_0 struct UPS_PACK_1
 
 struct EnvHeader
 {
+  enum {
+    // The oldest file version which can still be opened (see
+    // UPS_FILE_VERSION)
+    kOldestFileVersion = 5
+  };
+
   // Constructor
   EnvHeader(Page *page)
     : header_page(page) {
@@ -159,6 +168,26 @@ struct EnvHeader
     header()->journal_compression = algorithm << 4;
   }
 
+  // Returns the checksum algorithm
+  int checksum_algorithm() {
+    return header()->checksum_algorithm;
+  }
+
+  // Sets the checksum algorithm
+  void set_checksum_algorithm(int algorithm) {
+    header()->checksum_algorithm = (uint8_t)algorithm;
+  }
+
+  // Returns the page compression algorithm
+  int page_compression() {
+    return header()->page_compression;
+  }
+
+  // Sets the page compression algorithm
+  void set_page_compression(int algorithm) {
+    header()->page_compression = (uint8_t)algorithm;
+  }
+
   // Returns a pointer to the header data
   PEnvironmentHeader *header() {
     return (PEnvironmentHeader *)(header_page->payload());
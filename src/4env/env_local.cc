@@ -20,6 +20,7 @@
 
 // Always verify that a file of level N does not include headers > N!
 #include "1os/os.h"
+#include "2checksum/checksum.h"
 #include "2compressor/compressor_factory.h"
 #include "2device/device_factory.h"
 #include "3btree/btree_index.h"
@@ -115,6 +116,105 @@ mark_header_page_dirty(LocalEnv *env, Context *context)
     context->changeset.put(page);
 }
 
+// The record compression dictionaries are managed in a directory blob with
+// one blob id per PBtreeHeader slot. The id of this directory is stored in
+// the header page, directly after the PBtreeHeader array (which always
+// leaves at least 128 bytes of free space). The id is not aligned and
+// therefore copied with memcpy
+static inline uint64_t
+dictionary_directory_id(EnvHeader *header)
+{
+  uint64_t id;
+  ::memcpy(&id, (uint8_t *)btree_header(header, header->max_databases()),
+                  sizeof(id));
+  return id;
+}
+
+static inline void
+set_dictionary_directory_id(EnvHeader *header, uint64_t id)
+{
+  ::memcpy((uint8_t *)btree_header(header, header->max_databases()), &id,
+                  sizeof(id));
+}
+
+// Returns the PBtreeHeader slot of the database |dbname|, or -1
+static inline int
+btree_slot(EnvHeader *header, uint16_t dbname)
+{
+  for (int i = 0; i < header->max_databases(); i++) {
+    if (btree_header(header, i)->dbname == dbname)
+      return i;
+  }
+  return -1;
+}
+
+static inline void
+read_dictionary_directory(LocalEnv *env, Context *context,
+                std::vector<uint64_t> *directory)
+{
+  directory->assign(env->header->max_databases(), 0);
+
+  uint64_t blob_id = dictionary_directory_id(env->header.get());
+  if (blob_id) {
+    ByteArray arena;
+    ups_record_t record = {0};
+    env->blob_manager->read(context, blob_id, &record, UPS_FORCE_DEEP_COPY,
+                    &arena);
+    ::memcpy(directory->data(), record.data,
+                    std::min(record.size,
+                        (uint32_t)(directory->size() * sizeof(uint64_t))));
+  }
+}
+
+static inline void
+write_dictionary_directory(LocalEnv *env, Context *context,
+                std::vector<uint64_t> &directory)
+{
+  uint64_t blob_id = dictionary_directory_id(env->header.get());
+  if (blob_id)
+    env->blob_manager->erase(context, blob_id);
+  set_dictionary_directory_id(env->header.get(), 0);
+
+  // do not store an empty directory
+  bool is_empty = true;
+  for (size_t i = 0; i < directory.size() && is_empty; i++)
+    is_empty = directory[i] == 0;
+
+  if (!is_empty) {
+    ups_record_t record = ups_make_record(directory.data(),
+                    (uint32_t)(directory.size() * sizeof(uint64_t)));
+    blob_id = env->blob_manager->allocate(context, &record,
+                    BlobManager::kDisableCompression);
+    set_dictionary_directory_id(env->header.get(), blob_id);
+
+    // older versions would ignore the dictionaries, therefore a file of
+    // an older version is upgraded
+    if (env->header->version(3) != UPS_FILE_VERSION)
+      env->header->set_version(UPS_VERSION_MAJ, UPS_VERSION_MIN,
+                      UPS_VERSION_REV, UPS_FILE_VERSION);
+  }
+
+  mark_header_page_dirty(env, context);
+}
+
+// Erases the record compression dictionary of the database |dbname|
+static inline void
+erase_dictionary(LocalEnv *env, Context *context, uint16_t dbname)
+{
+  int slot = btree_slot(env->header.get(), dbname);
+  if (slot < 0 || dictionary_directory_id(env->header.get()) == 0)
+    return;
+
+  std::vector<uint64_t> directory;
+  read_dictionary_directory(env, context, &directory);
+  if (directory[slot] == 0)
+    return;
+
+  env->blob_manager->erase(context, directory[slot]);
+  directory[slot] = 0;
+  write_dictionary_directory(env, context, directory);
+}
+
 ups_status_t
 LocalEnv::create()
 {
@@ -144,6 +244,8 @@ LocalEnv::create()
           UPS_FILE_VERSION);
   header->set_page_size(config.page_size_bytes);
   header->set_max_databases(config.max_databases);
+  header->set_checksum_algorithm(config.checksum_algorithm);
+  header->set_page_compression(config.page_compressor);
 
   /* load page manager after setting up the blobmanager and the device! */
   page_manager.reset(new PageManager(this));
@@ -236,13 +338,41 @@ LocalEnv::open()
     }
 
     // Check the database version; everything with a different file version
-    // is incompatible.
-    if (header->version(3) != UPS_FILE_VERSION) {
+    // is incompatible. Files of version 5 are still supported: the
+    // checksum algorithm and the page compression are 0 (MurmurHash3, no
+    // compression), and they do not have compression dictionaries.
+    if (header->version(3) != UPS_FILE_VERSION
+          && header->version(3) != EnvHeader::kOldestFileVersion) {
       ups_log(("invalid file version"));
       st = UPS_INV_FILE_VERSION;
       goto fail_with_fake_cleansing;
     }
 
+    // the checksum algorithm is required before the first page is read
+    config.checksum_algorithm = header->checksum_algorithm();
+    if (unlikely(!Checksum::is_available(config.checksum_algorithm))) {
+      ups_log(("unknown checksum algorithm %d", config.checksum_algorithm));
+      st = UPS_INV_FILE_HEADER;
+      goto fail_with_fake_cleansing;
+    }
+
+    // compressed pages are decompressed when they are fetched; they must
+    // not be accessed through the memory mapped file (see
+    // EnvConfig::is_mmap_disabled). The file is already mapped, therefore
+    // it is reopened
+    config.page_compressor = header->page_compression();
+    if (config.page_compressor
+          && !CompressorFactory::is_available(config.page_compressor)) {
+      ups_log(("unknown page compression algorithm %d",
+                              config.page_compressor));
+      st = UPS_INV_FILE_HEADER;
+      goto fail_with_fake_cleansing;
+    }
+    if (config.page_compressor && NOTSET(config.flags, UPS_DISABLE_MMAP)) {
+      device->close();
+      device->open();
+    }
+
     st = 0;
 
 fail_with_fake_cleansing:
@@ -341,9 +471,24 @@ LocalEnv::get_parameters(ups_parameter_t *param)
       case UPS_PARAM_JOURNAL_SWITCH_THRESHOLD:
         p->value = config.journal_switch_threshold;
         break;
+      case UPS_PARAM_JOURNAL_SYNC_INTERVAL:
+        p->value = config.journal_sync_interval_ms;
+        break;
+      case UPS_PARAM_MERGE_BACKLOG_LIMIT:
+        p->value = config.merge_backlog_limit;
+        break;
+      case UPS_PARAM_CHECKPOINT_INTERVAL:
+        p->value = config.checkpoint_interval_bytes;
+        break;
+      case UPS_PARAM_CHECKPOINT_INTERVAL_MS:
+        p->value = config.checkpoint_interval_ms;
+        break;
       case UPS_PARAM_JOURNAL_COMPRESSION:
         p->value = config.journal_compressor;
         break;
+      case UPS_PARAM_PAGE_COMPRESSION:
+        p->value = config.page_compressor;
+        break;
       case UPS_PARAM_POSIX_FADVISE:
         p->value = config.posix_advice;
         break;
@@ -533,11 +678,28 @@ LocalEnv::do_create_db(DbConfig &dbconfig, const ups_parameter_t *param)
     }
   }
 
-  // all heavy-weight compressors are only allowed for
-  // variable-length binary keys
+  // uint64 compression is only allowed for uint64-keys
+  if (dbconfig.key_compressor == UPS_COMPRESSOR_UINT64_VARBYTE
+      || dbconfig.key_compressor == UPS_COMPRESSOR_UINT64_FOR) {
+    if (unlikely(dbconfig.key_type != UPS_TYPE_UINT64)) {
+      ups_trace(("Uint64 compression only allowed for uint64 keys "
+                 "(UPS_TYPE_UINT64)"));
+      throw Exception(UPS_INV_PARAMETER);
+    }
+    if (unlikely(config.page_size_bytes != 16 * 1024)) {
+      ups_trace(("Uint64 compression only allowed for page size of 16k"));
+      throw Exception(UPS_INV_PARAMETER);
+    }
+  }
+
+  // all heavy-weight compressors and the prefix compression are only
+  // allowed for variable-length binary keys
   if (dbconfig.key_compressor == UPS_COMPRESSOR_LZF
         || dbconfig.key_compressor == UPS_COMPRESSOR_SNAPPY
-        || dbconfig.key_compressor == UPS_COMPRESSOR_ZLIB) {
+        || dbconfig.key_compressor == UPS_COMPRESSOR_ZLIB
+        || dbconfig.key_compressor == UPS_COMPRESSOR_LZ4
+        || dbconfig.key_compressor == UPS_COMPRESSOR_ZSTD
+        || dbconfig.key_compressor == UPS_COMPRESSOR_PREFIX) {
     if (unlikely(dbconfig.key_type != UPS_TYPE_BINARY
           || dbconfig.key_size != UPS_KEY_SIZE_UNLIMITED)) {
       ups_trace(("Key compression only allowed for unlimited binary keys "
@@ -712,6 +874,9 @@ LocalEnv::erase_db(uint16_t name, uint32_t flags)
    * database from the environment header
    */
   if (ISSET(this->flags(), UPS_IN_MEMORY)) {
+    Context context(this);
+    erase_dictionary(this, &context, name);
+
     for (uint16_t dbi = 0; dbi < header->max_databases(); dbi++) {
       PBtreeHeader *desc = btree_header(header.get(), dbi);
       if (name == desc->dbname) {
@@ -740,6 +905,9 @@ LocalEnv::erase_db(uint16_t name, uint32_t flags)
   if (unlikely(st))
     return st;
 
+  /* free the compression dictionary */
+  erase_dictionary(this, &context, name);
+
   /* now set database name to 0 and set the header page to dirty */
   for (uint16_t dbi = 0; dbi < header->max_databases(); dbi++) {
     PBtreeHeader *desc = btree_header(header.get(), dbi);
@@ -757,6 +925,53 @@ LocalEnv::erase_db(uint16_t name, uint32_t flags)
   return 0;
 }
 
+uint32_t
+LocalEnv::read_dictionary(Context *context, uint16_t dbname, ByteArray *arena)
+{
+  int slot = btree_slot(header.get(), dbname);
+  if (slot < 0 || dictionary_directory_id(header.get()) == 0)
+    return 0;
+
+  std::vector<uint64_t> directory;
+  read_dictionary_directory(this, context, &directory);
+  if (directory[slot] == 0)
+    return 0;
+
+  ups_record_t record = {0};
+  blob_manager->read(context, directory[slot], &record, UPS_FORCE_DEEP_COPY,
+                  arena);
+  return record.size;
+}
+
+void
+LocalEnv::write_dictionary(Context *context, uint16_t dbname,
+                const uint8_t *data, uint32_t size)
+{
+  int slot = btree_slot(header.get(), dbname);
+  if (unlikely(slot < 0))
+    throw Exception(UPS_DATABASE_NOT_FOUND);
+
+  std::vector<uint64_t> directory;
+  read_dictionary_directory(this, context, &directory);
+  if (directory[slot])
+    blob_manager->erase(context, directory[slot]);
+
+  ups_record_t record = ups_make_record((void *)data, size);
+  directory[slot] = blob_manager->allocate(context, &record,
+                  BlobManager::kDisableCompression);
+  write_dictionary_directory(this, context, directory);
+
+  /* the dictionary must be persistent before the first record is
+   * compressed with it */
+  if (journal) {
+    context->changeset.flush(lsn_manager.next());
+  }
+  else if (NOTSET(this->flags(), UPS_IN_MEMORY)) {
+    page_manager->flush_all_pages();
+    device->flush();
+  }
+}
+
 Txn *
 LocalEnv::txn_begin(const char *name, uint32_t flags)
 {
@@ -771,6 +986,29 @@ LocalEnv::txn_commit(Txn *txn, uint32_t)
   return txn_manager->commit(txn);
 }
 
+uint64_t
+LocalEnv::txn_unsynced_commit()
+{
+  return journal.get() ? journal->unsynced_commit() : 0;
+}
+
+ups_status_t
+LocalEnv::txn_sync(uint64_t lsn, uint32_t flags)
+{
+  try {
+    if (ISSET(flags, UPS_TXN_COMMIT_DEFERRED))
+      journal->sync_deferred(lsn);
+    else if (ISSET(flags, UPS_TXN_COMMIT_SYNC)
+            || (ISSET(config.flags, UPS_ENABLE_FSYNC)
+                && NOTSET(flags, UPS_TXN_COMMIT_NOSYNC)))
+      journal->sync(lsn);
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+  return 0;
+}
+
 ups_status_t
 LocalEnv::txn_abort(Txn *txn, uint32_t)
 {
@@ -823,6 +1061,9 @@ LocalEnv::fill_metrics(ups_env_metrics_t *metrics)
   // the Journal (if available)
   if (journal)
     journal->fill_metrics(metrics);
+  // the background merge of committed Transactions
+  if (txn_manager)
+    ((LocalTxnManager *)txn_manager.get())->fill_metrics(metrics);
   // the (first) database
   if (!_database_map.empty()) {
     LocalDb *db = (LocalDb *)_database_map.begin()->second;
@@ -80,6 +80,13 @@ struct LocalEnv : public Env
   // Commits a transaction (ups_txn_commit)
   virtual ups_status_t txn_commit(Txn *txn, uint32_t flags);
 
+  // Returns the lsn of the last commit if it still has to be synced
+  virtual uint64_t txn_unsynced_commit();
+
+  // Syncs the journal up to |lsn| (group commit), or defers the sync to
+  // the Journal's background thread
+  virtual ups_status_t txn_sync(uint64_t lsn, uint32_t flags);
+
   // Commits a transaction (ups_txn_abort)
   virtual ups_status_t txn_abort(Txn *txn, uint32_t flags);
 
@@ -93,6 +100,16 @@ struct LocalEnv : public Env
   // Fills in the current metrics
   virtual void fill_metrics(ups_env_metrics_t *metrics);
 
+  // Reads the record compression dictionary of the database |dbname| into
+  // |arena|; returns the size of the dictionary, or 0 if there is none
+  uint32_t read_dictionary(Context *context, uint16_t dbname,
+                  ByteArray *arena);
+
+  // Stores the record compression dictionary of the database |dbname|
+  // and flushes it to disk
+  void write_dictionary(Context *context, uint16_t dbname,
+                  const uint8_t *data, uint32_t size);
+
   // Performs a UQI select
   virtual ups_status_t select_range(const char *query, Cursor *begin,
                           const Cursor *end, Result **result);
@@ -172,6 +172,12 @@ struct TxnManager {
   // Flushes committed (queued) transactions
   virtual void flush_committed_txns(Context *context = 0) = 0;
 
+  // Terminates the background thread which merges committed transactions
+  // (if there is one). Called WITHOUT holding the Environment's lock,
+  // because the thread acquires it
+  virtual void stop_merger() {
+  }
+
   // Adds a new transaction to this Environment
   void append_txn_at_tail(Txn *txn) {
     list.append(txn);
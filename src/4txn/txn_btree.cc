@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include "0root/root.h"
+
+#include <string.h>
+
+// Always verify that a file of level N does not include headers > N!
+#include "3btree/btree_index.h"
+#include "4db/db_local.h"
+#include "4txn/txn_btree.h"
+#include "4txn/txn_local.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+// Returns the slot of |child| in its parent
+static inline int
+slot_in_parent(TxnBtreeNode *child)
+{
+  TxnBtreeNode *parent = child->parent;
+  for (int i = 0; i < parent->count; i++)
+    if (parent->children[i] == child)
+      return i;
+  assert(!"shouldn't be here");
+  return -1;
+}
+
+// Returns the slot of |node| in its leaf
+static inline int
+slot_in_leaf(TxnNode *node)
+{
+  TxnBtreeNode *leaf = node->leaf;
+  for (int i = 0; i < leaf->count; i++)
+    if (leaf->keys[i] == node)
+      return i;
+  assert(!"shouldn't be here");
+  return -1;
+}
+
+// Releases a node and all its children
+static void
+release_recursive(TxnBtreeNode *node)
+{
+  if (!node->is_leaf)
+    for (int i = 0; i < node->count; i++)
+      release_recursive(node->children[i]);
+  delete node;
+}
+
+TxnBtree::TxnBtree(LocalDb *db_)
+  : db(db_), key_type(db_->config.key_type), is_prefix_exact(false), root(0)
+{
+  switch (key_type) {
+    case UPS_TYPE_UINT8:
+    case UPS_TYPE_UINT16:
+    case UPS_TYPE_UINT32:
+    case UPS_TYPE_UINT64:
+      is_prefix_exact = true;
+      break;
+    case UPS_TYPE_BINARY:
+      // fixed-length keys are compared with memcmp(3)
+      is_prefix_exact = db->config.key_size != UPS_KEY_SIZE_UNLIMITED
+                            && db->config.key_size <= sizeof(uint64_t);
+      break;
+    default:
+      break;
+  }
+}
+
+TxnBtree::~TxnBtree()
+{
+  if (root)
+    release_recursive(root);
+}
+
+uint64_t
+TxnBtree::prefix(const ups_key_t *key) const
+{
+  switch (key_type) {
+    case UPS_TYPE_UINT8:
+      return *(uint8_t *)key->data;
+    case UPS_TYPE_UINT16:
+      return *(uint16_t *)key->data;
+    case UPS_TYPE_UINT32:
+      return *(uint32_t *)key->data;
+    case UPS_TYPE_UINT64:
+      return *(uint64_t *)key->data;
+    case UPS_TYPE_BINARY: {
+      // the first 8 bytes in big-endian order, padded with zeroes. A shorter
+      // key is smaller than a longer key with the same bytes, therefore the
+      // padding does not break the order
+      uint64_t p = 0;
+      uint32_t size = key->size < 8 ? key->size : 8;
+      const uint8_t *data = (const uint8_t *)key->data;
+      for (uint32_t i = 0; i < size; i++)
+        p |= (uint64_t)data[i] << (56 - 8 * i);
+      return p;
+    }
+    default:
+      // floating point keys and custom compare functions: the keys are
+      // always compared
+      return 0;
+  }
+}
+
+int
+TxnBtree::compare(ups_key_t *key, uint64_t kp, TxnBtreeNode *node,
+                int slot) const
+{
+  uint64_t p = node->prefixes[slot];
+  if (kp != p)
+    return kp < p ? -1 : +1;
+  if (is_prefix_exact)
+    return 0;
+  return db->btree_index->compare_keys(key, node->keys[slot]->key());
+}
+
+TxnBtreeNode *
+TxnBtree::find_leaf(ups_key_t *key, uint64_t kp) const
+{
+  TxnBtreeNode *node = root;
+
+  // in each internal node, pick the last child whose separator is <= key
+  while (!node->is_leaf) {
+    int l = 1;
+    int r = node->count;
+    while (l < r) {
+      int m = (l + r) / 2;
+      if (compare(key, kp, node, m) < 0)
+        r = m;
+      else
+        l = m + 1;
+    }
+    node = node->children[l - 1];
+  }
+
+  return node;
+}
+
+int
+TxnBtree::lower_bound(TxnBtreeNode *leaf, ups_key_t *key, uint64_t kp,
+                int *cmp) const
+{
+  int l = 0;
+  int r = leaf->count;
+  *cmp = -1;
+
+  while (l < r) {
+    int m = (l + r) / 2;
+    int c = compare(key, kp, leaf, m);
+    if (c == 0) {
+      *cmp = 0;
+      return m;
+    }
+    if (c < 0)
+      r = m;
+    else
+      l = m + 1;
+  }
+
+  return l;
+}
+
+TxnNode *
+TxnBtree::search(ups_key_t *key)
+{
+  if (unlikely(!root))
+    return 0;
+
+  uint64_t kp = prefix(key);
+  TxnBtreeNode *leaf = find_leaf(key, kp);
+  int cmp;
+  int slot = lower_bound(leaf, key, kp, &cmp);
+  return cmp == 0 ? leaf->keys[slot] : 0;
+}
+
+TxnNode *
+TxnBtree::nsearch(ups_key_t *key)
+{
+  if (unlikely(!root))
+    return 0;
+
+  uint64_t kp = prefix(key);
+  TxnBtreeNode *leaf = find_leaf(key, kp);
+  int cmp;
+  int slot = lower_bound(leaf, key, kp, &cmp);
+  if (slot < leaf->count)
+    return leaf->keys[slot];
+  return leaf->next ? leaf->next->keys[0] : 0;
+}
+
+TxnNode *
+TxnBtree::psearch(ups_key_t *key)
+{
+  if (unlikely(!root))
+    return 0;
+
+  uint64_t kp = prefix(key);
+  TxnBtreeNode *leaf = find_leaf(key, kp);
+  int cmp;
+  int slot = lower_bound(leaf, key, kp, &cmp);
+  if (cmp == 0)
+    return leaf->keys[slot];
+  if (slot > 0)
+    return leaf->keys[slot - 1];
+  leaf = leaf->previous;
+  return leaf ? leaf->keys[leaf->count - 1] : 0;
+}
+
+TxnBtreeNode *
+TxnBtree::split(TxnBtreeNode *node)
+{
+  TxnBtreeNode *right = new TxnBtreeNode(node->is_leaf);
+  int mid = node->count / 2;
+
+  right->count = node->count - mid;
+  ::memcpy(&right->prefixes[0], &node->prefixes[mid],
+                  sizeof(uint64_t) * right->count);
+  ::memcpy(&right->keys[0], &node->keys[mid],
+                  sizeof(TxnNode *) * right->count);
+  node->count = mid;
+
+  if (node->is_leaf) {
+    for (int i = 0; i < right->count; i++)
+      right->keys[i]->leaf = right;
+    right->previous = node;
+    right->next = node->next;
+    if (node->next)
+      node->next->previous = right;
+    node->next = right;
+  }
+  else {
+    ::memcpy(&right->children[0], &node->children[mid],
+                  sizeof(TxnBtreeNode *) * right->count);
+    for (int i = 0; i < right->count; i++)
+      right->children[i]->parent = right;
+  }
+
+  // the smallest key of |right| is its separator in the parent
+  if (!node->parent) {
+    root = new TxnBtreeNode(false);
+    root->count = 1;
+    root->children[0] = node;
+    root->keys[0] = 0;
+    root->prefixes[0] = 0;
+    node->parent = root;
+  }
+  insert_child(node->parent, slot_in_parent(node) + 1, right,
+                  right->keys[0], right->prefixes[0]);
+  return right;
+}
+
+void
+TxnBtree::insert_child(TxnBtreeNode *parent, int slot, TxnBtreeNode *child,
+                TxnNode *key, uint64_t prefix)
+{
+  if (parent->count == TxnBtreeNode::kCapacity) {
+    TxnBtreeNode *right = split(parent);
+    if (slot > parent->count) {
+      slot -= parent->count;
+      parent = right;
+    }
+  }
+
+  int tail = parent->count - slot;
+  ::memmove(&parent->prefixes[slot + 1], &parent->prefixes[slot],
+                  sizeof(uint64_t) * tail);
+  ::memmove(&parent->keys[slot + 1], &parent->keys[slot],
+                  sizeof(TxnNode *) * tail);
+  ::memmove(&parent->children[slot + 1], &parent->children[slot],
+                  sizeof(TxnBtreeNode *) * tail);
+  parent->prefixes[slot] = prefix;
+  parent->keys[slot] = key;
+  parent->children[slot] = child;
+  parent->count++;
+  child->parent = parent;
+}
+
+void
+TxnBtree::insert(TxnNode *node)
+{
+  ups_key_t *key = node->key();
+  uint64_t kp = prefix(key);
+
+  if (unlikely(!root))
+    root = new TxnBtreeNode(true);
+
+  TxnBtreeNode *leaf = find_leaf(key, kp);
+  int cmp;
+  int slot = lower_bound(leaf, key, kp, &cmp);
+  assert(cmp != 0);
+
+  if (leaf->count == TxnBtreeNode::kCapacity) {
+    TxnBtreeNode *right = split(leaf);
+    if (slot > leaf->count) {
+      slot -= leaf->count;
+      leaf = right;
+    }
+  }
+
+  int tail = leaf->count - slot;
+  ::memmove(&leaf->prefixes[slot + 1], &leaf->prefixes[slot],
+                  sizeof(uint64_t) * tail);
+  ::memmove(&leaf->keys[slot + 1], &leaf->keys[slot],
+                  sizeof(TxnNode *) * tail);
+  leaf->prefixes[slot] = kp;
+  leaf->keys[slot] = node;
+  leaf->count++;
+  node->leaf = leaf;
+}
+
+void
+TxnBtree::remove_node(TxnBtreeNode *node)
+{
+  assert(node->count == 0);
+
+  if (node->is_leaf) {
+    if (node->previous)
+      node->previous->next = node->next;
+    if (node->next)
+      node->next->previous = node->previous;
+  }
+
+  TxnBtreeNode *parent = node->parent;
+  if (!parent) {
+    delete node;
+    root = 0;
+    return;
+  }
+
+  int slot = slot_in_parent(node);
+  delete node;
+
+  int tail = parent->count - slot - 1;
+  ::memmove(&parent->prefixes[slot], &parent->prefixes[slot + 1],
+                  sizeof(uint64_t) * tail);
+  ::memmove(&parent->keys[slot], &parent->keys[slot + 1],
+                  sizeof(TxnNode *) * tail);
+  ::memmove(&parent->children[slot], &parent->children[slot + 1],
+                  sizeof(TxnBtreeNode *) * tail);
+  parent->count--;
+
+  if (parent->count == 0)
+    remove_node(parent);
+}
+
+void
+TxnBtree::remove(TxnNode *node)
+{
+  TxnBtreeNode *leaf = node->leaf;
+  int slot = slot_in_leaf(node);
+
+  // a separator always refers to the smallest TxnNode of its subtree;
+  // if |node| is a separator then it is replaced by its successor, which
+  // is now the smallest TxnNode of the subtree
+  if (slot == 0) {
+    TxnNode *successor = next(node);
+    uint64_t p = successor ? prefix(successor->key()) : 0;
+    for (TxnBtreeNode *n = leaf; n->parent != 0; n = n->parent) {
+      int s = slot_in_parent(n);
+      if (s > 0) {
+        if (n->parent->keys[s] == node) {
+          n->parent->keys[s] = successor;
+          n->parent->prefixes[s] = p;
+        }
+        break;
+      }
+    }
+  }
+
+  int tail = leaf->count - slot - 1;
+  ::memmove(&leaf->prefixes[slot], &leaf->prefixes[slot + 1],
+                  sizeof(uint64_t) * tail);
+  ::memmove(&leaf->keys[slot], &leaf->keys[slot + 1],
+                  sizeof(TxnNode *) * tail);
+  leaf->count--;
+  node->leaf = 0;
+
+  if (leaf->count == 0)
+    remove_node(leaf);
+
+  // shrink the tree if the root has a single child
+  while (root && !root->is_leaf && root->count == 1) {
+    TxnBtreeNode *child = root->children[0];
+    delete root;
+    root = child;
+    root->parent = 0;
+  }
+}
+
+TxnNode *
+TxnBtree::first() const
+{
+  TxnBtreeNode *node = root;
+  if (!node)
+    return 0;
+  while (!node->is_leaf)
+    node = node->children[0];
+  return node->keys[0];
+}
+
+TxnNode *
+TxnBtree::last() const
+{
+  TxnBtreeNode *node = root;
+  if (!node)
+    return 0;
+  while (!node->is_leaf)
+    node = node->children[node->count - 1];
+  return node->keys[node->count - 1];
+}
+
+TxnNode *
+TxnBtree::next(TxnNode *node) const
+{
+  TxnBtreeNode *leaf = node->leaf;
+  int slot = slot_in_leaf(node);
+  if (slot + 1 < leaf->count)
+    return leaf->keys[slot + 1];
+  return leaf->next ? leaf->next->keys[0] : 0;
+}
+
+TxnNode *
+TxnBtree::previous(TxnNode *node) const
+{
+  TxnBtreeNode *leaf = node->leaf;
+  int slot = slot_in_leaf(node);
+  if (slot > 0)
+    return leaf->keys[slot - 1];
+  leaf = leaf->previous;
+  return leaf ? leaf->keys[leaf->count - 1] : 0;
+}
+
+} // namespace upscaledb
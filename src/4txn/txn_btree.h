@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * An in-memory B+tree for the TxnIndex; an alternative to the red-black
+ * tree in rb.h.
+ *
+ * The red-black tree visits one TxnNode per level, and each of them is
+ * a cache miss (plus another two for the key of the node). The TxnBtree
+ * stores up to |kCapacity| entries per node. Each entry has a 64bit prefix
+ * of its key, and the prefixes preserve the order of the keys. Therefore
+ * most comparisons are resolved in a contiguous array of integers, and
+ * the actual key is only compared if the prefixes are equal. For numeric
+ * keys (and short fixed-length binary keys) the prefix is the key, and
+ * keys are never compared with the database's compare function.
+ *
+ * The leaves are linked, and each TxnNode stores a pointer to its leaf;
+ * therefore the siblings of a TxnNode are found without a lookup.
+ * Empty nodes are removed immediately, but nodes are not merged. The
+ * TxnIndex is emptied whenever the transactions are flushed.
+ *
+ * @exception_safe: basic
+ * @thread_safe: no
+ */
+
+#ifndef UPS_TXN_BTREE_H
+#define UPS_TXN_BTREE_H
+
+#include "0root/root.h"
+
+#include "ups/upscaledb.h"
+
+// Always verify that a file of level N does not include headers > N!
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct LocalDb;
+struct TxnNode;
+
+//
+// A node of the TxnBtree (not to be confused with TxnNode, which is
+// stored in the leaves)
+//
+struct TxnBtreeNode {
+  enum {
+    // the maximum number of entries (or children)
+    kCapacity = 32
+  };
+
+  // Constructor
+  TxnBtreeNode(bool is_leaf_)
+    : parent(0), previous(0), next(0), is_leaf(is_leaf_), count(0) {
+  }
+
+  // the parent node; null for the root
+  TxnBtreeNode *parent;
+
+  // the siblings; only used for leaves
+  TxnBtreeNode *previous;
+  TxnBtreeNode *next;
+
+  // true if this is a leaf
+  bool is_leaf;
+
+  // the number of entries (leaves) or children (internal nodes)
+  int count;
+
+  // the order-preserving prefixes of |keys|
+  uint64_t prefixes[kCapacity];
+
+  // leaves: the TxnNodes; internal nodes: the smallest TxnNode of
+  // each child (the separators; keys[0] is not used)
+  TxnNode *keys[kCapacity];
+
+  // the children; only used for internal nodes
+  TxnBtreeNode *children[kCapacity];
+};
+
+struct TxnBtree {
+  // Constructor
+  TxnBtree(LocalDb *db);
+
+  // Destructor; releases the tree structure, but not the TxnNodes
+  ~TxnBtree();
+
+  // Returns the node of |key|, or null
+  TxnNode *search(ups_key_t *key);
+
+  // Returns the smallest node which is >= |key|, or null
+  TxnNode *nsearch(ups_key_t *key);
+
+  // Returns the greatest node which is <= |key|, or null
+  TxnNode *psearch(ups_key_t *key);
+
+  // Inserts a new node; its key must not yet exist
+  void insert(TxnNode *node);
+
+  // Removes a node
+  void remove(TxnNode *node);
+
+  // Returns the smallest node, or null if the tree is empty
+  TxnNode *first() const;
+
+  // Returns the greatest node, or null if the tree is empty
+  TxnNode *last() const;
+
+  // Returns the next larger sibling of |node|, or null
+  TxnNode *next(TxnNode *node) const;
+
+  // Returns the next smaller sibling of |node|, or null
+  TxnNode *previous(TxnNode *node) const;
+
+  // Returns the order-preserving prefix of a key
+  uint64_t prefix(const ups_key_t *key) const;
+
+  // Compares |key| (with prefix |kp|) to the entry |slot| of |node|
+  int compare(ups_key_t *key, uint64_t kp, TxnBtreeNode *node, int slot) const;
+
+  // Returns the leaf which contains |key| (if it exists)
+  TxnBtreeNode *find_leaf(ups_key_t *key, uint64_t kp) const;
+
+  // Returns the first slot of |leaf| which is >= |key|; |cmp| receives
+  // the result of the comparison with this slot
+  int lower_bound(TxnBtreeNode *leaf, ups_key_t *key, uint64_t kp,
+                  int *cmp) const;
+
+  // Splits a full node; returns the new (right) node
+  TxnBtreeNode *split(TxnBtreeNode *node);
+
+  // Inserts |child| at |slot| of the internal node |parent|; |key| is the
+  // smallest TxnNode of |child|
+  void insert_child(TxnBtreeNode *parent, int slot, TxnBtreeNode *child,
+                  TxnNode *key, uint64_t prefix);
+
+  // Removes an empty node from its parent and releases it
+  void remove_node(TxnBtreeNode *node);
+
+  // The Database; required for comparing keys
+  LocalDb *db;
+
+  // The key type; UPS_TYPE_UINT8 etc
+  int key_type;
+
+  // True if the prefix of a key is identical to the key
+  bool is_prefix_exact;
+
+  // The root node; null if the tree is empty
+  TxnBtreeNode *root;
+};
+
+} // namespace upscaledb
+
+#endif // UPS_TXN_BTREE_H
@@ -71,14 +71,20 @@ move_top_in_node(TxnCursor *cursor, TxnNode *node, bool ignore_conflicts,
                 uint32_t flags)
 {
   TxnCursorState &state_ = cursor->state_;
+  LocalTxn *txn = (LocalTxn *)state_.parent->txn;
 
   for (TxnOperation *op = node->newest_op;
                   op != 0;
                   op = op->previous_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
+    // a read-only Txn skips the ops which are not part of its snapshot;
+    // they never cause a conflict
+    if (txn && unlikely(txn->is_hidden_in_snapshot(optxn)))
+      continue;
+
     // only look at ops from the current transaction and from
     // committed transactions
-    if (optxn == state_.parent->txn || optxn->is_committed()) {
+    if (optxn == txn || optxn->is_committed()) {
       // a normal (overwriting) insert will return this key
       if (ISSET(op->flags, TxnOperation::kInsert)
           || ISSET(op->flags, TxnOperation::kInsertOverwrite)) {
@@ -168,19 +174,29 @@ TxnCursor::move(uint32_t flags)
   if (ISSET(flags, UPS_CURSOR_FIRST)) {
     set_to_nil();
 
-    node = db(state_)->txn_index->first();
-    if (unlikely(!node))
-      return UPS_KEY_NOT_FOUND;
-    return move_top_in_node(this, node, false, flags);
+    // skip the nodes which are not visible in a read-only Txn's snapshot
+    for (node = db(state_)->txn_index->first();
+                    node != 0;
+                    node = node->next_sibling()) {
+      st = move_top_in_node(this, node, false, flags);
+      if (st != UPS_KEY_NOT_FOUND)
+        return st;
+    }
+    return UPS_KEY_NOT_FOUND;
   }
 
   if (ISSET(flags, UPS_CURSOR_LAST)) {
     set_to_nil();
 
-    node = db(state_)->txn_index->last();
-    if (unlikely(!node))
-      return UPS_KEY_NOT_FOUND;
-    return move_top_in_node(this, node, false, flags);
+    // skip the nodes which are not visible in a read-only Txn's snapshot
+    for (node = db(state_)->txn_index->last();
+                    node != 0;
+                    node = node->previous_sibling()) {
+      st = move_top_in_node(this, node, false, flags);
+      if (st != UPS_KEY_NOT_FOUND)
+        return st;
+    }
+    return UPS_KEY_NOT_FOUND;
   }
 
   if (ISSET(flags, UPS_CURSOR_NEXT)) {
@@ -241,11 +257,12 @@ TxnCursor::find(ups_key_t *key, uint32_t flags)
   while (1) {
     // and then move to the newest insert*-op
     ups_status_t st = move_top_in_node(this, node, false, 0);
-    if (unlikely(st != UPS_KEY_ERASED_IN_TXN))
+    if (unlikely(st != UPS_KEY_ERASED_IN_TXN && st != UPS_KEY_NOT_FOUND))
       return st;
 
-    // if the key was erased and approx. matching is enabled, then move
-    // next/prev till we found a valid key.
+    // if the key was erased (or is not visible in a read-only Txn's
+    // snapshot) and approx. matching is enabled, then move next/prev till
+    // we found a valid key.
     if (ISSET(flags, UPS_FIND_GT_MATCH))
       node = node->next_sibling();
     else if (ISSET(flags, UPS_FIND_LT_MATCH))
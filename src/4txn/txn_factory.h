@@ -28,7 +28,6 @@
 #include "ups/types.h"
 
 // Always verify that a file of level N does not include headers > N!
-#include "1mem/mem.h"
 #include "4txn/txn.h"
 
 #ifndef UPS_ROOT_H
@@ -43,14 +42,15 @@ struct TxnFactory {
             TxnNode *node, uint32_t flags, uint32_t orig_flags,
             uint64_t lsn, ups_key_t *key, ups_record_t *record) {
     TxnOperation *op;
-    op = Memory::allocate<TxnOperation>(sizeof(*op)
+    op = (TxnOperation *)txn->arena.allocate(sizeof(*op)
                                             + (record ? record->size : 0)
                                             + (key ? key->size : 0));
     op->initialize(txn, node, flags, orig_flags, lsn, key, record);
     return op;
   }
 
-  // Destroys a TxnOperation
+  // Destroys a TxnOperation; its memory is released when the Txn's
+  // Arena is cleared
   static void destroy_operation(TxnOperation *op) {
     op->destroy();
   }
@@ -18,7 +18,13 @@
 
 #include "0root/root.h"
 
+#include <limits>
+#include <new>
+
+#include <boost/bind.hpp>
+
 // Always verify that a file of level N does not include headers > N!
+#include "1globals/globals.h"
 #include "3btree/btree_index.h"
 #include "3journal/journal.h"
 #include "4db/db_local.h"
@@ -64,13 +70,26 @@ compare(void *vlhs, void *vrhs)
 rb_proto(static, rbt_, TxnIndex, TxnNode)
 rb_gen(static, rbt_, TxnIndex, TxnNode, node, compare)
 
+// Returns true if |txn| committed after the snapshot of an active read-only
+// Txn was taken; then it must not yet be merged into the Btree
+static inline bool
+is_pinned_by_snapshot(LocalTxn *txn, uint64_t snapshot_lsn)
+{
+  return snapshot_lsn != 0
+          && txn->is_committed()
+          && txn->commit_lsn > snapshot_lsn;
+}
+
 static inline int
 count_flushable_transactions(LocalTxnManager *tm)
 {
   int to_flush = 0;
+  uint64_t snapshot_lsn = tm->oldest_snapshot_lsn();
 
   LocalTxn *oldest = (LocalTxn *)tm->oldest_txn();
   for (; oldest; oldest = (LocalTxn *)oldest->next()) {
+    if (unlikely(is_pinned_by_snapshot(oldest, snapshot_lsn)))
+      return to_flush;
     // a transaction can be flushed if it's committed or aborted, and if there
     // are no cursors coupled to it
     if (oldest->is_committed() || oldest->is_aborted()) {
@@ -87,17 +106,25 @@ count_flushable_transactions(LocalTxnManager *tm)
   return to_flush;
 }
 
-static inline void
-flush_committed_txns_impl(LocalTxnManager *tm, Context *context)
+// Flushes the committed transactions, but at most |max_txns|; returns the
+// number of transactions which were removed
+static inline int
+flush_committed_txns_impl(LocalTxnManager *tm, Context *context,
+                int max_txns = std::numeric_limits<int>::max())
 {
   LocalTxn *oldest;
   uint64_t highest_lsn = 0;
+  uint64_t snapshot_lsn = tm->oldest_snapshot_lsn();
+  int count = 0;
 
   assert(context->changeset.is_empty());
 
   // always get the oldest transaction; if it was committed: flush
   // it; if it was aborted: discard it; otherwise return
-  while ((oldest = (LocalTxn *)tm->oldest_txn())) {
+  while (count < max_txns && (oldest = (LocalTxn *)tm->oldest_txn())) {
+    // a read-only Txn must not see this transaction
+    if (unlikely(is_pinned_by_snapshot(oldest, snapshot_lsn)))
+      break;
     if (oldest->is_committed()) {
       uint64_t lsn = tm->flush_txn_to_changeset(context, (LocalTxn *)oldest);
       if (lsn > highest_lsn)
@@ -114,6 +141,7 @@ flush_committed_txns_impl(LocalTxnManager *tm, Context *context)
 
     // and release the memory
     delete oldest;
+    count++;
   }
 
   // now flush the changeset and write the modified pages to disk
@@ -122,6 +150,44 @@ flush_committed_txns_impl(LocalTxnManager *tm, Context *context)
   else
     context->changeset.clear();
   assert(context->changeset.is_empty());
+  return count;
+}
+
+// Called after a transaction was committed or aborted. Merges the committed
+// transactions into the Btree if there are enough of them. With
+// UPS_ENABLE_BACKGROUND_MERGE this is done by the background thread; the
+// committing thread only merges if the backlog grew too large.
+// An overdue checkpoint always merges, even with UPS_DONT_FLUSH_TRANSACTIONS.
+static inline void
+merge_committed_txns(LocalTxnManager *tm, Context *context)
+{
+  LocalEnv *env = tm->lenv();
+  if (unlikely(env->journal.get() && env->journal->is_checkpoint_blocked())) {
+    flush_committed_txns_impl(tm, context);
+    return;
+  }
+
+  if (unlikely(ISSET(env->flags(), UPS_DONT_FLUSH_TRANSACTIONS)))
+    return;
+
+  if (unlikely(ISSET(env->flags(), UPS_FLUSH_TRANSACTIONS_IMMEDIATELY))) {
+    flush_committed_txns_impl(tm, context);
+    return;
+  }
+
+  if (NOTSET(env->flags(), UPS_ENABLE_BACKGROUND_MERGE)) {
+    if (count_flushable_transactions(tm) >= Globals::ms_flush_threshold)
+      flush_committed_txns_impl(tm, context);
+    return;
+  }
+
+  int count = count_flushable_transactions(tm);
+  if (unlikely(count >= (int)env->config.merge_backlog_limit)) {
+    flush_committed_txns_impl(tm, context);
+    tm->count_backpressure_merges++;
+  }
+  else if (count >= Globals::ms_flush_threshold)
+    tm->request_merge();
 }
 
 void
@@ -166,13 +232,11 @@ TxnOperation::destroy()
 
   // remove this op from the node
   if (node->oldest_op == this) {
-    // if the node is empty: remove the node from the tree
-    // TODO should this be done in here??
-    if (next_in_node == 0) {
-      node->db->txn_index->remove(node);
+    // if the node is empty: remove the node from the tree (see below)
+    if (next_in_node == 0)
       delete_node = true;
-    }
-    node->oldest_op = next_in_node;
+    else
+      node->oldest_op = next_in_node;
   }
 
   // remove this operation from the two linked lists
@@ -186,26 +250,32 @@ TxnOperation::destroy()
   if (previous_in_txn)
     previous_in_txn->next_in_txn = next_in_txn;
 
+  // the node is released with its last operation; it still uses the key
+  // of this operation, which remains valid till the Txn's Arena is cleared
   if (delete_node)
-    delete node;
-
-  Memory::release(this);
+    node->db->txn_index->remove(node);
 }
 
 TxnNode *
 TxnNode::next_sibling()
 {
-  return rbt_next(db->txn_index.get(), this);
+  TxnIndex *index = db->txn_index.get();
+  if (index->btree)
+    return index->btree->next(this);
+  return rbt_next(index, this);
 }
 
 TxnNode *
 TxnNode::previous_sibling()
 {
-  return rbt_prev(db->txn_index.get(), this);
+  TxnIndex *index = db->txn_index.get();
+  if (index->btree)
+    return index->btree->previous(this);
+  return rbt_prev(index, this);
 }
 
 TxnNode::TxnNode(LocalDb *db_, ups_key_t *key)
-  : db(db_), oldest_op(0), newest_op(0), _key(key)
+  : leaf(0), db(db_), oldest_op(0), newest_op(0), _key(key)
 {
 }
 
@@ -255,9 +325,12 @@ TxnIndex::store(ups_key_t *key, bool *node_created)
   *node_created = false;
   TxnNode *node = get(key, 0);
   if (!node) {
-    node = new TxnNode(db, key);
+    node = new (node_cache.allocate()) TxnNode(db, key);
     *node_created = true;
-    rbt_insert(this, node);
+    if (btree)
+      btree->insert(node);
+    else
+      rbt_insert(this, node);
   }
 
   return node;
@@ -266,7 +339,11 @@ TxnIndex::store(ups_key_t *key, bool *node_created)
 void
 TxnIndex::remove(TxnNode *node)
 {
-  rbt_remove(this, node);
+  if (btree)
+    btree->remove(node);
+  else
+    rbt_remove(this, node);
+  node_cache.destroy(node);
 }
 
 static inline void
@@ -317,7 +394,8 @@ flush_transaction_to_journal(LocalTxn *txn)
 }
 
 LocalTxn::LocalTxn(LocalEnv *env, const char *name, uint32_t flags)
-  : Txn(env, name, flags), log_descriptor(0), oldest_op(0), newest_op(0)
+  : Txn(env, name, flags), log_descriptor(-1), commit_lsn(0), oldest_op(0),
+    newest_op(0)
 {
   LocalTxnManager *ltm = (LocalTxnManager *)env->txn_manager.get();
   id = ltm->incremented_txn_id();
@@ -371,22 +449,25 @@ LocalTxn::free_operations()
 
   oldest_op = 0;
   newest_op = 0;
+
+  // now release the memory of all operations at once
+  arena.clear();
 }
 
 TxnIndex::TxnIndex(LocalDb *db)
   : db(db)
 {
   rbt_new(this);
+  if (Globals::ms_is_txn_btree_enabled)
+    btree.reset(new TxnBtree(db));
 }
 
 TxnIndex::~TxnIndex()
 {
   TxnNode *node;
 
-  while ((node = rbt_last(this))) {
+  while ((node = last()))
     remove(node);
-    delete node;
-  }
 
   // re-initialize the tree
   rbt_new(this);
@@ -398,6 +479,9 @@ TxnIndex::get(ups_key_t *key, uint32_t flags)
   TxnNode *node = 0;
   int match = 0;
 
+  if (btree)
+    return get_btree(key, flags);
+
   // create a temporary node that we can search for
   TxnNode tmp(db, key);
 
@@ -446,26 +530,80 @@ TxnIndex::get(ups_key_t *key, uint32_t flags)
   return node;
 }
 
+TxnNode *
+TxnIndex::get_btree(ups_key_t *key, uint32_t flags)
+{
+  TxnNode *node = 0;
+  int match = 0;
+
+  if (ISSET(flags, UPS_FIND_GEQ_MATCH)) {
+    node = btree->nsearch(key);
+    if (node)
+      match = db->btree_index->compare_keys(key, node->key());
+  }
+  else if (ISSET(flags, UPS_FIND_LEQ_MATCH)) {
+    node = btree->psearch(key);
+    if (node)
+      match = db->btree_index->compare_keys(key, node->key());
+  }
+  else if (ISSET(flags, UPS_FIND_GT_MATCH)) {
+    node = btree->search(key);
+    if (node)
+      node = btree->next(node);
+    else
+      node = btree->nsearch(key);
+    match = 1;
+  }
+  else if (ISSET(flags, UPS_FIND_LT_MATCH)) {
+    node = btree->search(key);
+    if (node)
+      node = btree->previous(node);
+    else
+      node = btree->psearch(key);
+    match = -1;
+  }
+  else
+    return btree->search(key);
+
+  // Nothing found?
+  if (!node)
+    return 0;
+
+  // approx. matching: set the key flag
+  if (match < 0)
+    ups_key_set_intflags(key, (ups_key_get_intflags(key)
+            & ~BtreeKey::kApproximate) | BtreeKey::kLower);
+  else if (match > 0)
+    ups_key_set_intflags(key, (ups_key_get_intflags(key)
+            & ~BtreeKey::kApproximate) | BtreeKey::kGreater);
+
+  return node;
+}
+
 TxnNode *
 TxnIndex::first()
 {
+  if (btree)
+    return btree->first();
   return rbt_first(this);
 }
 
 TxnNode *
 TxnIndex::last()
 {
+  if (btree)
+    return btree->last();
   return rbt_last(this);
 }
 
 void
 TxnIndex::enumerate(Context *context, TxnIndex::Visitor *visitor)
 {
-  TxnNode *node = rbt_first(this);
+  TxnNode *node = first();
 
   while (node) {
     visitor->visit(context, node);
-    node = rbt_next(this, node);
+    node = node->next_sibling();
   }
 }
 
@@ -496,6 +634,8 @@ struct KeyCounter : TxnIndex::Visitor {
       LocalTxn *optxn = op->txn;
       if (optxn->is_aborted())
         continue;
+      if (txn && unlikely(txn->is_hidden_in_snapshot(optxn)))
+        continue;
 
       if (optxn->is_committed() || txn == optxn) {
         if (ISSET(op->flags, TxnOperation::kIsFlushed))
@@ -566,6 +706,9 @@ TxnIndex::count(Context *context, LocalTxn *txn, bool distinct)
 void
 LocalTxnManager::begin(Txn *txn)
 {
+  if (ISSET(txn->flags, UPS_TXN_READ_ONLY))
+    active_snapshots++;
+
   append_txn_at_tail(txn);
 }
 
@@ -578,25 +721,30 @@ LocalTxnManager::commit(Txn *htxn)
   try {
     txn->commit();
 
+    if (unlikely(txn->is_snapshot()))
+      active_snapshots--;
+    // the active read-only transactions must not see this transaction
+    else if (unlikely(active_snapshots > 0))
+      txn->commit_lsn = lenv()->lsn_manager.next();
+
     // if this transaction can NOT be flushed immediately then write its
     // operations to the journal; otherwise skip this step
     flush_transaction_to_journal(txn);
 
     // flush committed transactions
-    if (likely(NOTSET(lenv()->flags(), UPS_DONT_FLUSH_TRANSACTIONS))) {
-      if (unlikely(ISSET(lenv()->flags(), UPS_FLUSH_TRANSACTIONS_IMMEDIATELY)
-                || count_flushable_transactions(this)
-                        >= Globals::ms_flush_threshold)) {
-        flush_committed_txns_impl(this, &context);
-        return 0;
-      }
-    }
+    merge_committed_txns(this, &context);
   }
   catch (Exception &ex) {
     return ex.code;
   }
 
-  return 0;
+  // report the error of a failed background merge
+  if (likely(merger.get() == 0))
+    return 0;
+  ScopedLock lock(merger_mutex);
+  ups_status_t st = merger_error;
+  merger_error = 0;
+  return st;
 }
 
 ups_status_t
@@ -608,15 +756,11 @@ LocalTxnManager::abort(Txn *htxn)
   try {
     txn->abort();
 
+    if (unlikely(txn->is_snapshot()))
+      active_snapshots--;
+
     // flush committed transactions
-    if (likely(NOTSET(lenv()->flags(), UPS_DONT_FLUSH_TRANSACTIONS))) {
-      if (unlikely(ISSET(lenv()->flags(), UPS_FLUSH_TRANSACTIONS_IMMEDIATELY)
-                || count_flushable_transactions(this)
-                        >= Globals::ms_flush_threshold)) {
-        flush_committed_txns_impl(this, &context);
-        return 0;
-      }
-    }
+    merge_committed_txns(this, &context);
   }
   catch (Exception &ex) {
     return ex.code;
@@ -635,6 +779,101 @@ LocalTxnManager::flush_committed_txns(Context *context /* = 0 */)
     flush_committed_txns_impl(this, context);
 }
 
+uint64_t
+LocalTxnManager::oldest_snapshot_lsn()
+{
+  if (likely(active_snapshots == 0))
+    return 0;
+
+  // the transactions are sorted by their "begin" lsn
+  for (LocalTxn *txn = (LocalTxn *)oldest_txn();
+                  txn != 0;
+                  txn = (LocalTxn *)txn->next()) {
+    if (txn->is_snapshot() && !txn->is_committed() && !txn->is_aborted())
+      return txn->lsn;
+  }
+
+  assert(!"shouldn't be here");
+  return 0;
+}
+
+LocalTxnManager::~LocalTxnManager()
+{
+  stop_merger();
+}
+
+void
+LocalTxnManager::request_merge()
+{
+  ScopedLock lock(merger_mutex);
+  // the Environment is closed; it merges the transactions itself
+  if (unlikely(merger_shutdown))
+    return;
+
+  merge_requested = true;
+
+  if (!merger)
+    merger.reset(new Thread(boost::bind(&LocalTxnManager::run_merger, this)));
+  else
+    merger_cond.notify_one();
+}
+
+void
+LocalTxnManager::run_merger()
+{
+  ScopedLock lock(merger_mutex);
+
+  while (!merger_shutdown) {
+    if (!merge_requested) {
+      merger_cond.wait(lock);
+      continue;
+    }
+
+    merge_requested = false;
+    lock.unlock();
+
+    // merge small batches, and release the Environment's lock in between;
+    // otherwise the foreground operations would have to wait till the
+    // whole backlog was merged
+    ups_status_t st = 0;
+    int count = 0;
+    do {
+      ScopedWriteLock env_lock(env->mutex);
+      if (count_flushable_transactions(this) == 0)
+        break;
+      try {
+        Context context(lenv(), 0, 0);
+        count = flush_committed_txns_impl(this, &context,
+                        std::max(Globals::ms_flush_threshold, 1));
+        count_background_merges += count;
+      }
+      catch (Exception &ex) {
+        st = ex.code;
+        break;
+      }
+    } while (count > 0);
+
+    lock.lock();
+    if (unlikely(st != 0))
+      merger_error = st;
+  }
+}
+
+void
+LocalTxnManager::stop_merger()
+{
+  {
+    ScopedLock lock(merger_mutex);
+    merger_shutdown = true;
+    merger_cond.notify_one();
+  }
+
+  if (merger) {
+    merger->join();
+    merger.reset();
+  }
+}
+
 uint64_t
 LocalTxnManager::flush_txn_to_changeset(Context *context, LocalTxn *txn)
 {
@@ -21,9 +21,15 @@
 
 #include "0root/root.h"
 
+#include "ups/upscaledb_int.h" // for metrics
+
 // Always verify that a file of level N does not include headers > N!
+#include "1base/mutex.h"
+#include "1base/scoped_ptr.h"
+#include "1mem/arena.h"
 #include "1rb/rb.h"
 #include "4txn/txn.h"
+#include "4txn/txn_btree.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -71,12 +77,12 @@ struct TxnOperation {
   }
 
   // Initialization
-  // TODO use placement new??
   void initialize(LocalTxn *txn, TxnNode *node,
                   uint32_t flags, uint32_t orig_flags, uint64_t lsn,
                   ups_key_t *key, ups_record_t *record);
 
-  // Destructor
+  // Removes the operation from its node (and from the TxnIndex, if the
+  // node is now empty); the memory is owned by the Txn's Arena
   void destroy();
 
   // the Txn of this operation
@@ -171,6 +177,10 @@ struct TxnNode {
   // red-black tree stub, required for rb.h
   rb_node(TxnNode) node;
 
+  // the leaf of the TxnBtree which stores this node (if the TxnIndex
+  // uses a TxnBtree)
+  TxnBtreeNode *leaf;
+
   // the database - need this to get the compare function
   LocalDb *db;
 
@@ -188,7 +198,8 @@ struct TxnNode {
 
 //
 // Each Database has a binary tree which stores the current Txn
-// operations; this tree is implemented in TxnIndex
+// operations; this tree is implemented in TxnIndex. It is either a
+// red-black tree (rb.h) or a TxnBtree (see Globals::ms_is_txn_btree_enabled)
 //
 struct TxnIndex {
   // Traverses a TxnIndex; for each node, a callback is executed
@@ -206,7 +217,7 @@ struct TxnIndex {
   // exist. Returns the new (or existing) node.
   TxnNode *store(ups_key_t *key, bool *node_created);
 
-  // Removes a TxnNode from the index
+  // Removes a TxnNode from the index and releases its memory
   void remove(TxnNode *node);
 
   // Visits every node in the TxnTree
@@ -217,6 +228,9 @@ struct TxnIndex {
   // |flags| can be UPS_FIND_GEQ_MATCH, UPS_FIND_LEQ_MATCH etc
   TxnNode *get(ups_key_t *key, uint32_t flags);
 
+  // Implementation of get() for the TxnBtree
+  TxnNode *get_btree(ups_key_t *key, uint32_t flags);
+
   // Returns the first (= "smallest") node of the tree, or NULL if the
   // tree is empty
   TxnNode *first();
@@ -235,6 +249,13 @@ struct TxnIndex {
   // stuff for rb.h
   TxnNode *rbt_root;
   TxnNode rbt_nil;
+
+  // the B+tree; if null then the red-black tree is used
+  ScopedPtr<TxnBtree> btree;
+
+  // Allocates the TxnNode structures; all accesses are serialized by the
+  // Environment's lock
+  SlabCache<TxnNode> node_cache;
 };
 
 
@@ -261,17 +282,41 @@ struct LocalTxn : Txn {
   // (before it's deleted by the Environment).
   void free_operations();
 
-  // index of the log file descriptor for this transaction [0..1]
+  // Returns true if this Txn reads a snapshot of the committed data
+  // (UPS_TXN_READ_ONLY); the snapshot is taken when the Txn begins
+  bool is_snapshot() const {
+    return ISSET(flags, UPS_TXN_READ_ONLY);
+  }
+
+  // Returns true if the operations of |optxn| are invisible in the
+  // snapshot of this Txn, because |optxn| did not yet commit when the
+  // snapshot was taken
+  bool is_hidden_in_snapshot(const LocalTxn *optxn) const {
+    return is_snapshot()
+            && (!optxn->is_committed() || optxn->commit_lsn > lsn);
+  }
+
+  // index of the log file descriptor for this transaction [0..1], or -1
+  // if the transaction was not yet written to the journal
   int log_descriptor;
 
-  // the lsn of the "txn begin" operation
+  // the lsn of the "txn begin" operation; for read-only Txns, this is
+  // also the lsn of the snapshot
   uint64_t lsn;
 
+  // the lsn of the commit; only assigned if read-only Txns were active
+  // at that time, otherwise 0 (and then visible in every snapshot)
+  uint64_t commit_lsn;
+
   // the linked list of operations - head is oldest operation
   TxnOperation *oldest_op;
 
   // the linked list of operations - tail is newest operation
   TxnOperation *newest_op;
+
+  // The memory of the TxnOperation structures; released as a whole
+  // when the Txn is flushed or aborted
+  Arena arena;
 };
 
 
@@ -281,9 +326,14 @@ struct LocalTxn : Txn {
 struct LocalTxnManager : TxnManager {
   // Constructor
   LocalTxnManager(Env *env)
-    : TxnManager(env), _txn_id(0) {
+    : TxnManager(env), _txn_id(0), active_snapshots(0),
+      merge_requested(false), merger_shutdown(false), merger_error(0),
+      count_background_merges(0), count_backpressure_merges(0) {
   }
 
+  // Destructor; terminates the background thread
+  virtual ~LocalTxnManager();
+
   // Begins a new Txn
   virtual void begin(Txn *txn);
 
@@ -298,6 +348,25 @@ struct LocalTxnManager : TxnManager {
   // Flushes committed (queued) transactions
   virtual void flush_committed_txns(Context *context = 0);
 
+  // Terminates the background thread (if it was started); afterwards,
+  // merge requests are ignored
+  virtual void stop_merger();
+
+  // With UPS_ENABLE_BACKGROUND_MERGE: wakes up the background thread,
+  // which then merges the committed transactions into the Btree.
+  // Starts the thread if it is not yet running
+  void request_merge();
+
+  // The background thread; merges committed transactions (in batches of
+  // Globals::ms_flush_threshold) till |merger_shutdown| is set
+  void run_merger();
+
+  // Fills in the metrics of the background thread
+  void fill_metrics(ups_env_metrics_t *metrics) const {
+    metrics->txn_background_merges = count_background_merges;
+    metrics->txn_backpressure_merges = count_backpressure_merges;
+  }
+
   // Increments the global transaction ID and returns the new value. 
   uint64_t incremented_txn_id() {
     return ++_txn_id;
@@ -317,8 +386,45 @@ struct LocalTxnManager : TxnManager {
     return (LocalEnv *)env;
   }
 
+  // Returns the lsn of the oldest active read-only Txn, or 0 if there
+  // is none. Transactions which committed after this lsn must not be
+  // merged into the Btree, otherwise the snapshot would see them
+  uint64_t oldest_snapshot_lsn();
+
   // The current transaction ID
   uint64_t _txn_id;
+
+  // The number of active read-only (snapshot) transactions
+  int active_snapshots;
+
+  // Protects the following members, which are shared with the background
+  // thread; |merger_mutex| is never held while waiting for the
+  // Environment's lock
+  Mutex merger_mutex;
+
+  // Wakes up the background thread
+  Condition merger_cond;
+
+  // The background thread; started with the first merge request
+  ScopedPtr<Thread> merger;
+
+  // Set to true if the background thread has work to do
+  bool merge_requested;
+
+  // Set to true if the background thread has to terminate, or must not
+  // be started because the Environment is closed
+  bool merger_shutdown;
+
+  // The error of a failed background merge; returned by the next commit
+  ups_status_t merger_error;
+
+  // The number of transactions which were merged by the background thread
+  // (for ups_env_get_metrics)
+  uint64_t count_background_merges;
+
+  // The number of commits which merged the backlog themselves because it
+  // exceeded UPS_PARAM_MERGE_BACKLOG_LIMIT (for ups_env_get_metrics)
+  uint64_t count_backpressure_merges;
 };
 
 } // namespace upscaledb
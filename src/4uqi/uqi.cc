@@ -22,7 +22,9 @@
 
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
+#include "4db/db.h"
 #include "4env/env.h"
+#include "4uqi/parser.h"
 #include "4uqi/plugins.h"
 #include "4uqi/result.h"
 #include "4uqi/scanvisitor.h"
@@ -138,9 +140,35 @@ uqi_select_range(ups_env_t *henv, const char *query, ups_cursor_t *begin,
   }
 
   Env *env = (Env *)henv;
-  ScopedLock lock(env->mutex);
 
   try {
+    // Queries of an opened Database can run concurrently to other readers.
+    // Otherwise the Database is opened (and closed) by the query, which
+    // requires exclusive access to the Environment. Databases with
+    // compressed keys are also locked exclusively (see ScopedDbLock).
+    Db *db = 0;
+    ScopedReadLock shared_lock;
+    if (ISSET(env->flags(), UPS_ENABLE_CONCURRENT_READS)
+          && NOTSET(env->flags(), UPS_ENABLE_TRANSACTIONS)) {
+      shared_lock = ScopedReadLock(env->mutex);
+      SelectStatement stmt;
+      if (Parser::parse_select(query, stmt) == 0) {
+        Env::DatabaseMap::iterator it = env->_database_map.find(stmt.dbid);
+        if (it != env->_database_map.end()
+              && it->second->config.key_compressor == 0)
+          db = it->second;
+      }
+      if (!db)
+        shared_lock.unlock();
+    }
+
+    ScopedWriteLock exclusive_lock;
+    ScopedReadLock db_lock;
+    if (db)
+      db_lock = ScopedReadLock(db->mutex);
+    else
+      exclusive_lock = ScopedWriteLock(env->mutex);
+
     return env->select_range(query,
                         (upscaledb::Cursor *)begin,
                         (upscaledb::Cursor *)end,
@@ -134,9 +134,9 @@ ups_txn_begin(ups_txn_t **htxn, ups_env_t *henv, const char *name,
   Env *env = (Env *)henv;
 
   try {
-    ScopedLock lock;
+    ScopedWriteLock lock;
     if (NOTSET(flags, UPS_DONT_LOCK))
-      lock = ScopedLock(env->mutex);
+      lock = ScopedWriteLock(env->mutex);
 
     if (unlikely(NOTSET(env->config.flags, UPS_ENABLE_TRANSACTIONS))) {
       ups_trace(("transactions are disabled (see UPS_ENABLE_TRANSACTIONS)"));
@@ -173,11 +173,30 @@ ups_txn_commit(ups_txn_t *htxn, uint32_t flags)
     return UPS_INV_PARAMETER;
   }
 
+  uint32_t durability = flags & (UPS_TXN_COMMIT_SYNC
+                                    | UPS_TXN_COMMIT_DEFERRED
+                                    | UPS_TXN_COMMIT_NOSYNC);
+  if (unlikely(durability & (durability - 1))) {
+    ups_trace(("only one of UPS_TXN_COMMIT_SYNC, UPS_TXN_COMMIT_DEFERRED "
+               "and UPS_TXN_COMMIT_NOSYNC can be specified"));
+    return UPS_INV_PARAMETER;
+  }
+
   Env *env = txn->env;
 
   try {
-    ScopedLock lock(env->mutex);
-    return env->txn_commit(txn, flags);
+    ScopedWriteLock lock(env->mutex);
+    ups_status_t st = env->txn_commit(txn, flags);
+    if (unlikely(st))
+      return st;
+
+    // The journal is synced after the lock was released; concurrent
+    // commits are then synced together
+    uint64_t lsn = env->txn_unsynced_commit();
+    if (likely(lsn == 0))
+      return 0;
+    lock.unlock();
+    return env->txn_sync(lsn, durability);
   }
   catch (Exception &ex) {
     return ex.code;
@@ -195,7 +214,7 @@ ups_txn_abort(ups_txn_t *htxn, uint32_t flags)
   Txn *txn = (Txn *)htxn;
   Env *env = txn->env;
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
     return env->txn_abort(txn, flags);
   }
   catch (Exception &ex) {
@@ -333,6 +352,26 @@ ups_env_create(ups_env_t **henv, const char *filename,
         }
         config.journal_compressor = (int)param->value;
         break;
+      case UPS_PARAM_PAGE_COMPRESSION:
+        if (ISSET(flags, UPS_IN_MEMORY)) {
+          ups_trace(("page compression not allowed in combination with "
+                  "UPS_IN_MEMORY"));
+          return UPS_INV_PARAMETER;
+        }
+        if (param->value != UPS_COMPRESSOR_ZLIB
+              && param->value != UPS_COMPRESSOR_SNAPPY
+              && param->value != UPS_COMPRESSOR_LZF
+              && param->value != UPS_COMPRESSOR_LZ4
+              && param->value != UPS_COMPRESSOR_ZSTD) {
+          ups_trace(("unsupported algorithm for page compression"));
+          return UPS_INV_PARAMETER;
+        }
+        if (!CompressorFactory::is_available((int)param->value)) {
+          ups_trace(("unknown algorithm for page compression"));
+          return UPS_INV_PARAMETER;
+        }
+        config.page_compressor = (int)param->value;
+        break;
       case UPS_PARAM_CACHESIZE:
         if (ISSET(flags, UPS_IN_MEMORY) && param->value != 0) {
           ups_trace(("combination of UPS_IN_MEMORY and cache size != 0 "
@@ -363,6 +402,18 @@ ups_env_create(ups_env_t **henv, const char *filename,
       case UPS_PARAM_JOURNAL_SWITCH_THRESHOLD:
         config.journal_switch_threshold = (uint32_t)param->value;
         break;
+      case UPS_PARAM_JOURNAL_SYNC_INTERVAL:
+        config.journal_sync_interval_ms = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_MERGE_BACKLOG_LIMIT:
+        config.merge_backlog_limit = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_CHECKPOINT_INTERVAL:
+        config.checkpoint_interval_bytes = param->value;
+        break;
+      case UPS_PARAM_CHECKPOINT_INTERVAL_MS:
+        config.checkpoint_interval_ms = (uint32_t)param->value;
+        break;
       case UPS_PARAM_LOG_DIRECTORY:
         config.log_filename = (const char *)param->value;
         break;
@@ -400,6 +451,12 @@ ups_env_create(ups_env_t **henv, const char *filename,
     return UPS_INV_PARAMETER;
   }
 
+  if (config.page_compressor && config.is_encryption_enabled) {
+    ups_trace(("page compression not allowed in combination with "
+            "aes encryption"));
+    return UPS_INV_PARAMETER;
+  }
+
   config.flags = flags;
 
   /*
@@ -420,6 +477,8 @@ ups_env_create(ups_env_t **henv, const char *filename,
 #ifndef UPS_ENABLE_REMOTE
     return UPS_NOT_IMPLEMENTED;
 #else // UPS_ENABLE_REMOTE
+    // requests of a remote Environment share a single connection
+    config.flags &= ~UPS_ENABLE_CONCURRENT_READS;
     env = new RemoteEnv(config);
 #endif
   }
@@ -498,6 +557,10 @@ ups_env_open(ups_env_t **henv, const char *filename, uint32_t flags,
         ups_trace(("Journal compression parameters are only allowed in "
                     "ups_env_create"));
         return UPS_INV_PARAMETER;
+      case UPS_PARAM_PAGE_COMPRESSION:
+        ups_trace(("Page compression parameters are only allowed in "
+                    "ups_env_create"));
+        return UPS_INV_PARAMETER;
       case UPS_PARAM_CACHE_SIZE:
         /* don't allow cache limits with unlimited cache */
         if (ISSET(flags, UPS_CACHE_UNLIMITED) && param->value != 0) {
@@ -515,6 +578,18 @@ ups_env_open(ups_env_t **henv, const char *filename, uint32_t flags,
       case UPS_PARAM_JOURNAL_SWITCH_THRESHOLD:
         config.journal_switch_threshold = (uint32_t)param->value;
         break;
+      case UPS_PARAM_JOURNAL_SYNC_INTERVAL:
+        config.journal_sync_interval_ms = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_MERGE_BACKLOG_LIMIT:
+        config.merge_backlog_limit = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_CHECKPOINT_INTERVAL:
+        config.checkpoint_interval_bytes = param->value;
+        break;
+      case UPS_PARAM_CHECKPOINT_INTERVAL_MS:
+        config.checkpoint_interval_ms = (uint32_t)param->value;
+        break;
       case UPS_PARAM_LOG_DIRECTORY:
         config.log_filename = (const char *)param->value;
         break;
@@ -552,6 +627,8 @@ ups_env_open(ups_env_t **henv, const char *filename, uint32_t flags,
 #ifndef UPS_ENABLE_REMOTE
     return UPS_NOT_IMPLEMENTED;
 #else // UPS_ENABLE_REMOTE
+    // requests of a remote Environment share a single connection
+    config.flags &= ~UPS_ENABLE_CONCURRENT_READS;
     env = new RemoteEnv(config);
 #endif
   }
@@ -608,7 +685,7 @@ ups_env_create_db(ups_env_t *henv, ups_db_t **hdb, uint16_t db_name,
   config.flags = flags;
 
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
 
     if (unlikely(ISSET(env->flags(), UPS_READ_ONLY))) {
       ups_trace(("cannot create database in a read-only environment"));
@@ -650,7 +727,7 @@ ups_env_open_db(ups_env_t *henv, ups_db_t **hdb, uint16_t db_name,
   config.db_name = db_name;
 
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
 
     if (unlikely(ISSET(env->flags(), UPS_IN_MEMORY))) {
       ups_trace(("cannot open a Database in an In-Memory Environment"));
@@ -694,7 +771,7 @@ ups_env_rename_db(ups_env_t *henv, uint16_t oldname, uint16_t newname,
 
   /* rename the database */
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
     return env->rename_db(oldname, newname, flags);
   }
   catch (Exception &ex) {
@@ -717,7 +794,7 @@ ups_env_erase_db(ups_env_t *henv, uint16_t name, uint32_t flags)
 
   /* erase the database */
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
     return env->erase_db(name, flags);
   }
   catch (Exception &ex) {
@@ -744,7 +821,7 @@ ups_env_get_database_names(ups_env_t *henv, uint16_t *names, uint32_t *length)
 
   /* get all database names */
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
 
     std::vector<uint16_t> vec = env->get_database_names();
     if (unlikely(vec.size() > *length)) {
@@ -779,7 +856,7 @@ ups_env_get_parameters(ups_env_t *henv, ups_parameter_t *param)
 
   /* get the parameters */
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
     return env->get_parameters(param);
   }
   catch (Exception &ex) {
@@ -801,7 +878,7 @@ ups_env_flush(ups_env_t *henv, uint32_t flags)
   }
 
   try {
-    ScopedLock lock(env->mutex);
+    ScopedWriteLock lock(env->mutex);
     return env->flush(flags);
   }
   catch (Exception &ex) {
@@ -849,7 +926,7 @@ ups_db_get_parameters(ups_db_t *hdb, ups_parameter_t *param)
 
   /* get the parameters */
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedWriteLock lock(db->env->mutex);
     return db->get_parameters(param);
   }
   catch (Exception &ex) {
@@ -857,6 +934,88 @@ ups_db_get_parameters(ups_db_t *hdb, ups_parameter_t *param)
   }
 }
 
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_db_train_dictionary(ups_db_t *hdb, uint32_t dictionary_size,
+                uint32_t flags)
+{
+  Db *db = (Db *)hdb;
+
+  if (unlikely(!db)) {
+    ups_trace(("parameter 'db' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(flags)) {
+    ups_trace(("unknown flag 0x%u", flags));
+    return UPS_INV_PARAMETER;
+  }
+
+#ifndef HAVE_ZSTD_H
+  ups_trace(("upscaledb was built without support for zstd"));
+  return UPS_NOT_IMPLEMENTED;
+#else
+  if (dictionary_size == 0)
+    dictionary_size = 16 * 1024;
+
+  try {
+    ScopedWriteLock lock(db->env->mutex);
+
+    if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
+      ups_trace(("cannot train a dictionary in a read-only database"));
+      return UPS_WRITE_PROTECTED;
+    }
+    return db->train_dictionary(dictionary_size);
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+#endif
+}
+
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_db_bulk_load(ups_db_t *hdb, ups_bulk_load_func_t func, void *context,
+                uint32_t fill_factor, uint32_t flags)
+{
+  Db *db = (Db *)hdb;
+
+  if (unlikely(!db)) {
+    ups_trace(("parameter 'db' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!func)) {
+    ups_trace(("parameter 'func' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(fill_factor != 0 && (fill_factor < 10 || fill_factor > 100))) {
+    ups_trace(("fill factor must be between 10 and 100"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(flags)) {
+    ups_trace(("unknown flag 0x%u", flags));
+    return UPS_INV_PARAMETER;
+  }
+
+  if (fill_factor == 0)
+    fill_factor = 100;
+
+  try {
+    ScopedWriteLock lock(db->env->mutex);
+
+    if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
+      ups_trace(("cannot bulk load a read-only database"));
+      return UPS_WRITE_PROTECTED;
+    }
+    if (unlikely(ISSETANY(db->flags(),
+                    UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64))) {
+      ups_trace(("cannot bulk load a record number database"));
+      return UPS_INV_PARAMETER;
+    }
+    return db->bulk_load(func, context, fill_factor);
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+}
+
 UPS_EXPORT ups_status_t UPS_CALLCONV
 ups_register_compare(const char *name, ups_compare_func_t func)
 {
@@ -884,7 +1043,7 @@ ups_db_set_compare_func(ups_db_t *hdb, ups_compare_func_t foo)
     return UPS_INV_PARAMETER; 
   }
 
-  ScopedLock lock(ldb->env->mutex);
+  ScopedWriteLock lock(ldb->env->mutex);
 
   if (unlikely(db->config.key_type != UPS_TYPE_CUSTOM)) {
     ups_trace(("ups_set_compare_func only allowed for UPS_TYPE_CUSTOM "
@@ -919,10 +1078,8 @@ ups_db_find(ups_db_t *hdb, ups_txn_t *htxn, ups_key_t *key,
   if (unlikely(!prepare_key(key) || !prepare_record(record)))
     return UPS_INV_PARAMETER;
 
-  Env *env = db->env;
-
   try {
-    ScopedLock lock(env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared);
   
     if (unlikely(ISSETANY(db->flags(),
                             UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64)
@@ -980,12 +1137,9 @@ ups_db_insert(ups_db_t *hdb, ups_txn_t *htxn, ups_key_t *key,
   if (unlikely(!prepare_key(key) || !prepare_record(record)))
     return UPS_INV_PARAMETER;
 
-  Env *env = db->env;
-
   try {
-    ScopedLock lock;
-    if (likely(NOTSET(flags, UPS_DONT_LOCK)))
-      lock = ScopedLock(env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kUpdate,
+            NOTSET(flags, UPS_DONT_LOCK));
 
     if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
       ups_trace(("cannot insert in a read-only database"));
@@ -1005,6 +1159,16 @@ ups_db_insert(ups_db_t *hdb, ups_txn_t *htxn, ups_key_t *key,
 
     flags &= ~UPS_DONT_LOCK;
 
+    // first try to insert concurrently to other threads; restart with
+    // an exclusive lock if the Btree has to be modified
+    if (lock.is_coupled()) {
+      ups_status_t st = db->insert(0, txn, key, record,
+                      flags | BtreeIndex::kLatchCoupling);
+      if (st != UPS_LIMITS_REACHED)
+        return st;
+      lock.upgrade();
+    }
+
     return db->insert(0, txn, key, record, flags);
   }
   catch (Exception &ex) {
@@ -1029,12 +1193,9 @@ ups_db_erase(ups_db_t *hdb, ups_txn_t *htxn, ups_key_t *key, uint32_t flags)
   if (unlikely(!prepare_key(key)))
     return UPS_INV_PARAMETER;
 
-  Env *env = db->env;
-
   try {
-    ScopedLock lock;
-    if (likely(NOTSET(flags, UPS_DONT_LOCK)))
-      lock = ScopedLock(env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive,
+            NOTSET(flags, UPS_DONT_LOCK));
 
     if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
       ups_trace(("cannot erase from a read-only database"));
@@ -1065,7 +1226,7 @@ ups_db_check_integrity(ups_db_t *hdb, uint32_t flags)
   }
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedWriteLock lock(db->env->mutex);
     return db->check_integrity(flags);
   }
   catch (Exception &ex) {
@@ -1098,9 +1259,9 @@ ups_db_close(ups_db_t *hdb, uint32_t flags)
   }
 
   try {
-    ScopedLock lock;
+    ScopedWriteLock lock;
     if (likely(NOTSET(flags, UPS_DONT_LOCK)))
-      lock = ScopedLock(env->mutex);
+      lock = ScopedWriteLock(env->mutex);
 
     // auto-cleanup cursors?
     if (ISSET(flags, UPS_AUTO_CLEANUP)) {
@@ -1142,12 +1303,9 @@ ups_cursor_create(ups_cursor_t **hcursor, ups_db_t *hdb, ups_txn_t *htxn,
     return UPS_INV_PARAMETER;
   }
 
-  Env *env = db->env;
-
   try {
-    ScopedLock lock;
-    if (likely(NOTSET(flags, UPS_DONT_LOCK)))
-      lock = ScopedLock(env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive,
+            NOTSET(flags, UPS_DONT_LOCK));
 
     *cursor = db->cursor_create(txn, flags);
     db->add_cursor(*cursor);
@@ -1178,7 +1336,7 @@ ups_cursor_clone(ups_cursor_t *hsrc, ups_cursor_t **hdest)
   Db *db = src->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive);
 
     *dest = db->cursor_clone(src);
     (*dest)->previous = 0;
@@ -1217,7 +1375,7 @@ ups_cursor_overwrite(ups_cursor_t *hcursor, ups_record_t *record,
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive);
 
     if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
       ups_trace(("cannot overwrite in a read-only database"));
@@ -1253,10 +1411,8 @@ ups_cursor_move(ups_cursor_t *hcursor, ups_key_t *key,
     return UPS_INV_PARAMETER;
 
   Db *db = cursor->db;
-  Env *env = db->env;
-
   try {
-    ScopedLock lock(env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared);
     return db->cursor_move(cursor, key, record, flags);
   }
   catch (Exception &ex) {
@@ -1284,12 +1440,9 @@ ups_cursor_find(ups_cursor_t *hcursor, ups_key_t *key, ups_record_t *record,
     return UPS_INV_PARAMETER;
 
   Db *db = cursor->db;
-  Env *env = db->env;
-
   try {
-    ScopedLock lock;
-    if (likely(NOTSET(flags, UPS_DONT_LOCK)))
-      lock = ScopedLock(env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared,
+            NOTSET(flags, UPS_DONT_LOCK));
 
     flags &= ~UPS_DONT_LOCK;
 
@@ -1328,7 +1481,7 @@ ups_cursor_insert(ups_cursor_t *hcursor, ups_key_t *key, ups_record_t *record,
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive);
 
     if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
       ups_trace(("cannot insert to a read-only database"));
@@ -1376,7 +1529,7 @@ ups_cursor_erase(ups_cursor_t *hcursor, uint32_t flags)
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive);
 
     if (ISSET(db->flags(), UPS_READ_ONLY)) {
       ups_trace(("cannot erase from a read-only database"));
@@ -1408,7 +1561,7 @@ ups_cursor_get_duplicate_count(ups_cursor_t *hcursor, uint32_t *count,
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared);
     *count = cursor->get_duplicate_count(flags);
     return 0;
   }
@@ -1435,7 +1588,7 @@ ups_cursor_get_duplicate_position(ups_cursor_t *hcursor, uint32_t *position)
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared);
     *position = cursor->get_duplicate_position();
     return 0;
   }
@@ -1462,7 +1615,7 @@ ups_cursor_get_record_size(ups_cursor_t *hcursor, uint32_t *size)
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared);
     *size = cursor->get_record_size();
     return 0;
   }
@@ -1485,7 +1638,7 @@ ups_cursor_close(ups_cursor_t *hcursor)
   Db *db = cursor->db;
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive);
     cursor->close();
     if (cursor->txn)
       cursor->txn->release();
@@ -1505,7 +1658,7 @@ ups_set_context_data(ups_db_t *hdb, void *data)
   if (unlikely(!db))
     return;
 
-  ScopedLock lock(db->env->mutex);
+  ScopedWriteLock lock(db->env->mutex);
   db->context = data;
 }
 
@@ -1519,7 +1672,7 @@ ups_get_context_data(ups_db_t *hdb, ups_bool_t dont_lock)
   if (dont_lock)
     return db->context;
 
-  ScopedLock lock(db->env->mutex);
+  ScopedWriteLock lock(db->env->mutex);
   return db->context;
 }
 
@@ -1580,7 +1733,7 @@ ups_db_count(ups_db_t *hdb, ups_txn_t *htxn, uint32_t flags,
   }
 
   try {
-    ScopedLock lock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kShared);
 
     *count = db->count(txn, ISSET(flags, UPS_SKIP_DUPLICATES));
     return 0;
@@ -1701,7 +1854,7 @@ ups_db_bulk_operations(ups_db_t *hdb, ups_txn_t *txn,
 
   Db *db = (Db *)hdb;
   try {
-    ScopedLock lock = ScopedLock(db->env->mutex);
+    ScopedDbLock lock(db, ScopedDbLock::kExclusive);
     return db->bulk_operations((Txn *)txn, operations,
                     operations_length, flags);
   }
@@ -0,0 +1,45 @@
+#!/bin/sh
+
+# Compares the bulk loader (ups_import --bulk, see ups_db_bulk_load) with
+# regular inserts. ups_bench creates a database with sorted uint64 keys,
+# which is exported and then imported with and without --bulk. Prints the
+# time of each import and the size of the imported file.
+# Run without arguments, or specify the number of keys, i.e.
+#   ./bulk_load.sh 5000000
+
+BENCH=../ups_bench/ups_bench
+COUNT=${1:-1000000}
+
+rm -f test-ham.db bulk.bin bulk.db
+$BENCH --quiet --stop-ops=$COUNT --key=uint64 --recsize-fixed=32 \
+        --distribution=ascending > /dev/null
+if [ $? != 0 ]; then
+    echo "Creating the database failed"
+    exit 1
+fi
+../ups_export --output=bulk.bin test-ham.db || exit 1
+../ups_dump test-ham.db > dump1
+
+for opt in "" "--bulk"; do
+    echo "========== Importing $COUNT keys $opt"
+    rm -f bulk.db
+    start=$(date +%s%N)
+    ../ups_import $opt bulk.bin bulk.db
+    if [ $? != 0 ]; then
+        echo "Import $opt failed"
+        exit 1
+    fi
+    end=$(date +%s%N)
+    echo "elapsed time: $(( (end - start) / 1000000 )) ms"
+    echo "file size:    $(wc -c < bulk.db) bytes"
+
+    ../ups_dump bulk.db > dump2
+    diff --brief dump1 dump2
+    if [ $? = 1 ]; then
+        echo "Import $opt differs"
+        exit 1
+    fi
+done
+
+\rm dump*
+\rm -f test-ham.db bulk.bin bulk.db
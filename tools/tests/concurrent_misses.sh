@@ -0,0 +1,37 @@
+#!/bin/sh
+
+# Measures how cache misses scale with the number of threads. The cache
+# is much smaller than the file and mmap is disabled, therefore most
+# lookups read a page from the device. Each thread reads from its own
+# Database; all Databases share one Environment.
+# Run without arguments, or specify the thread counts, i.e.
+#   ./concurrent_misses.sh 1 2 4 8
+
+BENCH=../ups_bench/ups_bench
+THREADS=${*:-"1 2 4 8"}
+MAX=1
+for n in $THREADS; do
+    if [ $n -gt $MAX ]; then
+        MAX=$n
+    fi
+done
+
+echo "========== Filling $MAX databases ================================"
+$BENCH --quiet --num-threads=$MAX --stop-ops=500000 --key=uint64 \
+        --recsize-fixed=64 --cache=unlimited
+if [ $? != 0 ]; then
+    echo "Filling the databases failed"
+    exit 1
+fi
+
+for n in $THREADS; do
+    echo "========== Random misses with $n thread(s) ======================="
+    $BENCH --open --quiet --metrics=default --num-threads=$n --find-pct=100 \
+            --stop-ops=200000 --key=uint64 --recsize-fixed=64 \
+            --distribution=random --cache=262144 --no-mmap \
+            --enable-concurrent-reads
+    if [ $? != 0 ]; then
+        echo "Lookups with $n thread(s) failed"
+        exit 1
+    fi
+done
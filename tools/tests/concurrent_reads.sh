@@ -0,0 +1,34 @@
+#!/bin/sh
+
+# Measures how lookups scale with the number of threads. Each thread
+# reads from its own Database; all Databases share one Environment.
+# Run without arguments, or specify the thread counts, i.e.
+#   ./concurrent_reads.sh 1 2 4 8
+
+BENCH=../ups_bench/ups_bench
+THREADS=${*:-"1 2 4 8"}
+MAX=1
+for n in $THREADS; do
+    if [ $n -gt $MAX ]; then
+        MAX=$n
+    fi
+done
+
+echo "========== Filling $MAX databases ================================"
+$BENCH --quiet --num-threads=$MAX --stop-ops=200000 --key=uint64 \
+        --recsize-fixed=16 --cache=unlimited
+if [ $? != 0 ]; then
+    echo "Filling the databases failed"
+    exit 1
+fi
+
+for n in $THREADS; do
+    echo "========== Lookups with $n thread(s) ============================="
+    $BENCH --open --quiet --metrics=default --num-threads=$n --find-pct=100 \
+            --stop-ops=1000000 --key=uint64 --recsize-fixed=16 \
+            --cache=unlimited --enable-concurrent-reads
+    if [ $? != 0 ]; then
+        echo "Lookups with $n thread(s) failed"
+        exit 1
+    fi
+done
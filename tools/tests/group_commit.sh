@@ -0,0 +1,23 @@
+#!/bin/sh
+
+# Measures the commit rate of durable Transactions (--use-fsync) with an
+# increasing number of threads. Each thread commits after every insert;
+# concurrent commits share a single journal sync ("group commit"), see
+# txn_commits_per_sync in the output.
+# Run without arguments, or specify the thread counts, i.e.
+#   ./group_commit.sh 1 2 4 8
+
+BENCH=../ups_bench/ups_bench
+THREADS=${*:-"1 2 4 8 16"}
+
+for n in $THREADS; do
+    echo "========== Commits with $n thread(s) ============================="
+    $BENCH --quiet --metrics=all --num-threads=$n --stop-ops=20000 \
+            --key=uint64 --recsize-fixed=64 --use-transactions=1 \
+            --use-fsync --distribution=random \
+        | grep "elapsed time\|txn_commit\|journal_commit_syncs"
+    if [ $? != 0 ]; then
+        echo "Commits with $n thread(s) failed"
+        exit 1
+    fi
+done
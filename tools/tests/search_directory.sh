@@ -0,0 +1,31 @@
+#!/bin/sh
+
+# Compares random lookups with and without the search directory of the
+# internal Btree nodes. Large pages have large internal nodes, therefore
+# the benefit grows with the page size.
+# Run without arguments, or specify the page sizes, i.e.
+#   ./search_directory.sh 16384 65536
+
+BENCH=../ups_bench/ups_bench
+PAGESIZES=${*:-"16384 32768 65536"}
+
+for ps in $PAGESIZES; do
+    echo "========== Filling the database (pagesize $ps) ==================="
+    $BENCH --quiet --stop-ops=2000000 --key=uint32 --recsize-fixed=8 \
+            --pagesize=$ps --cache=unlimited
+    if [ $? != 0 ]; then
+        echo "Filling the database failed"
+        exit 1
+    fi
+
+    for opt in "" "--disable-search-directory"; do
+        echo "========== Random lookups (pagesize $ps) $opt"
+        $BENCH --open --quiet --metrics=default --find-pct=100 \
+                --stop-ops=2000000 --key=uint32 --recsize-fixed=8 \
+                --pagesize=$ps --distribution=random --cache=unlimited $opt
+        if [ $? != 0 ]; then
+            echo "Lookups with pagesize $ps failed"
+            exit 1
+        fi
+    done
+done
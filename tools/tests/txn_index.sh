@@ -0,0 +1,23 @@
+#!/bin/sh
+
+# Compares the TxnBtree and the red-black tree of the transaction index.
+# All operations are grouped into a single transaction, therefore every
+# insert and lookup has to search the transaction index.
+# Run without arguments, or specify the key types, i.e.
+#   ./txn_index.sh uint64 binary
+
+BENCH=../ups_bench/ups_bench
+KEYS=${*:-"uint32 uint64 binary"}
+
+for key in $KEYS; do
+    for opt in "" "--disable-txn-btree"; do
+        echo "========== Inserts and lookups (key $key) $opt"
+        $BENCH --quiet --metrics=default --use-transactions=all \
+                --stop-ops=500000 --key=$key --recsize-fixed=8 \
+                --distribution=random --find-pct=50 --cache=unlimited $opt
+        if [ $? != 0 ]; then
+            echo "Benchmark with key $key failed"
+            exit 1
+        fi
+    done
+done
@@ -90,10 +90,16 @@ struct Configuration
       fullcheck_frequency(1000), metrics(kMetricsDefault),
       extkey_threshold(0), duptable_threshold(0), bulk_erase(false),
       disable_recovery(false),
-      journal_compression(0), record_compression(0), key_compression(0),
+      journal_compression(0), page_compression(0), record_compression(0),
+      key_compression(0),
       read_only(false), enable_crc32(false), record_number32(false),
       record_number64(false), posix_fadvice(UPS_POSIX_FADVICE_NORMAL),
-      simulate_crashes(false), flush_txn_immediately(false) {
+      simulate_crashes(false), flush_txn_immediately(false),
+      enable_concurrent_reads(false), enable_io_uring(false),
+      enable_direct_io(false), disable_search_directory(false),
+      enable_delta_journal(false), commit_flags(0),
+      journal_sync_interval(0), enable_background_merge(false),
+      merge_backlog_limit(0), disable_txn_btree(false) {
   }
 
   const char *
@@ -126,7 +132,7 @@ struct Configuration
       "zlib",
       "snappy",
       "lzf",
-      "lzo",
+      "lz4",
       "zint32_varbyte",
       "zint32_simdcomp",
       "zint32_groupvarint",
@@ -134,11 +140,18 @@ struct Configuration
       "zint32_maskedvbyte",
       "zint32_for",
       "zint32_simdfor",
+      "zint64_varbyte",
+      "zint64_for",
+      "prefix",
+      "zstd",
     };
     std::cout << "Configuration: --seed=" << seed << " ";
     if (journal_compression)
       std::cout << "--journal-compression=" << compressors[journal_compression]
           << " ";
+    if (page_compression)
+      std::cout << "--page-compression=" << compressors[page_compression]
+          << " ";
     if (record_compression)
       std::cout << "--record-compression=" << compressors[record_compression]
           << " ";
@@ -212,7 +225,31 @@ struct Configuration
     if (simulate_crashes)
       std::cout << "--simulate-crashes ";
     if (flush_txn_immediately)
-      std::cout << "--flush-txn-immediately";
+      std::cout << "--flush-txn-immediately ";
+    if (enable_concurrent_reads)
+      std::cout << "--enable-concurrent-reads ";
+    if (enable_io_uring)
+      std::cout << "--enable-io-uring ";
+    if (enable_direct_io)
+      std::cout << "--enable-direct-io ";
+    if (disable_search_directory)
+      std::cout << "--disable-search-directory ";
+    if (enable_delta_journal)
+      std::cout << "--enable-delta-journal ";
+    if (commit_flags == UPS_TXN_COMMIT_SYNC)
+      std::cout << "--commit-durability=sync ";
+    if (commit_flags == UPS_TXN_COMMIT_DEFERRED)
+      std::cout << "--commit-durability=deferred ";
+    if (commit_flags == UPS_TXN_COMMIT_NOSYNC)
+      std::cout << "--commit-durability=nosync ";
+    if (journal_sync_interval)
+      std::cout << "--journal-sync-interval=" << journal_sync_interval << " ";
+    if (enable_background_merge)
+      std::cout << "--enable-background-merge ";
+    if (merge_backlog_limit)
+      std::cout << "--merge-backlog-limit=" << merge_backlog_limit << " ";
+    if (disable_txn_btree)
+      std::cout << "--disable-txn-btree ";
     if (!filename.empty())
       std::cout << filename;
     else {
@@ -303,6 +340,7 @@ struct Configuration
   bool bulk_erase;
   bool disable_recovery;
   int journal_compression;
+  int page_compression;
   int record_compression;
   int key_compression;
   bool read_only;
@@ -312,6 +350,16 @@ struct Configuration
   int posix_fadvice;
   bool simulate_crashes;
   bool flush_txn_immediately;
+  bool enable_concurrent_reads;
+  bool enable_io_uring;
+  bool enable_direct_io;
+  bool disable_search_directory;
+  bool enable_delta_journal;
+  uint32_t commit_flags;
+  uint32_t journal_sync_interval;
+  bool enable_background_merge;
+  uint32_t merge_backlog_limit;
+  bool disable_txn_btree;
 };
 
 #endif /* UPS_BENCH_CONFIGURATION_H */
@@ -648,8 +648,9 @@ RuntimeGenerator::get_next_command()
   if (m_config->transactions_nth) {
     if (!m_txn)
       return (Generator::kCommandBeginTxn);
-    // add +2 because txn_begin/txn_commit are also counted in m_opcount
-    if (m_opcount % (m_config->transactions_nth + 2) == 0)
+    // add +2 because txn_begin/txn_commit are also counted in m_opcount;
+    // 64bit arithmetic because --use-transactions=all is 0xffffffff
+    if (m_opcount % ((uint64_t)m_config->transactions_nth + 2) == 0)
       return (Generator::kCommandCommitTxn);
   }
 
@@ -19,6 +19,7 @@
 #include <iostream>
 #include <cstdio>
 #include <ctime>
+#include <algorithm>
 
 #include <ups/upscaledb_int.h>
 
@@ -91,6 +92,17 @@
 #define ARG_POSIX_FADVICE                       71
 #define ARG_SIMULATE_CRASHES                    72
 #define ARG_FLUSH_TXN_IMMEDIATELY               73
+#define ARG_ENABLE_CONCURRENT_READS             74
+#define ARG_ENABLE_IO_URING                     75
+#define ARG_ENABLE_DIRECT_IO                    76
+#define ARG_DISABLE_SEARCH_DIRECTORY            77
+#define ARG_ENABLE_DELTA_JOURNAL                78
+#define ARG_COMMIT_DURABILITY                   79
+#define ARG_JOURNAL_SYNC_INTERVAL               80
+#define ARG_ENABLE_BACKGROUND_MERGE             81
+#define ARG_MERGE_BACKLOG_LIMIT                 82
+#define ARG_DISABLE_TXN_BTREE                   83
+#define ARG_PAGE_COMPRESSION                    84
 
 /*
  * command line parameters
@@ -371,19 +383,29 @@ static option_t opts[] = {
     ARG_JOURNAL_COMPRESSION,
     0,
     "journal-compression",
-    "Pro: Enables journal compression ('none', 'zlib', 'snappy', 'lzf')",
+    "Pro: Enables journal compression ('none', 'zlib', 'snappy', 'lzf', "
+        "'lz4', 'zstd')",
+    GETOPTS_NEED_ARGUMENT },
+  {
+    ARG_PAGE_COMPRESSION,
+    0,
+    "page-compression",
+    "(upscaledb-only) Enables page compression ('none', 'zlib', 'snappy', "
+        "'lzf', 'lz4', 'zstd')",
     GETOPTS_NEED_ARGUMENT },
   {
     ARG_RECORD_COMPRESSION,
     0,
     "record-compression",
-    "Pro: Enables record compression ('none', 'zlib', 'snappy', 'lzf')",
+    "Pro: Enables record compression ('none', 'zlib', 'snappy', 'lzf', "
+        "'lz4', 'zstd')",
     GETOPTS_NEED_ARGUMENT },
   {
     ARG_KEY_COMPRESSION,
     0,
     "key-compression",
-    "Pro: Enables key compression ('none', 'zlib', 'snappy', 'lzf')",
+    "Pro: Enables key compression ('none', 'zlib', 'snappy', 'lzf', "
+        "'lz4', 'zstd')",
     GETOPTS_NEED_ARGUMENT },
   {
     ARG_READ_ONLY,
@@ -427,6 +449,68 @@ static option_t opts[] = {
     "flush-txn-immediately",
     "Immediately flushes transactions after they are committed",
     0 },
+  {
+    ARG_ENABLE_CONCURRENT_READS,
+    0,
+    "enable-concurrent-reads",
+    "(upscaledb-only) Threads read in parallel; use with --num-threads",
+    0 },
+  {
+    ARG_ENABLE_IO_URING,
+    0,
+    "enable-io-uring",
+    "(upscaledb-only) Performs the file I/O with io_uring (Linux only)",
+    0 },
+  {
+    ARG_ENABLE_DIRECT_IO,
+    0,
+    "enable-direct-io",
+    "(upscaledb-only) Bypasses the page cache of the OS (O_DIRECT)",
+    0 },
+  {
+    ARG_DISABLE_SEARCH_DIRECTORY,
+    0,
+    "disable-search-directory",
+    "(upscaledb-only) Disables the search directory of internal nodes",
+    0 },
+  {
+    ARG_ENABLE_DELTA_JOURNAL,
+    0,
+    "enable-delta-journal",
+    "(upscaledb-only) Logs modified byte ranges instead of full pages",
+    0 },
+  {
+    ARG_COMMIT_DURABILITY,
+    0,
+    "commit-durability",
+    "(upscaledb-only) Durability of commits ('default', 'sync', 'deferred', "
+        "'nosync')",
+    GETOPTS_NEED_ARGUMENT },
+  {
+    ARG_JOURNAL_SYNC_INTERVAL,
+    0,
+    "journal-sync-interval",
+    "(upscaledb-only) Max. delay of deferred commits (in milliseconds)",
+    GETOPTS_NEED_ARGUMENT },
+  {
+    ARG_ENABLE_BACKGROUND_MERGE,
+    0,
+    "enable-background-merge",
+    "(upscaledb-only) Merges committed transactions in a background thread",
+    0 },
+  {
+    ARG_MERGE_BACKLOG_LIMIT,
+    0,
+    "merge-backlog-limit",
+    "(upscaledb-only) Max. number of committed transactions waiting for "
+        "the background merge",
+    GETOPTS_NEED_ARGUMENT },
+  {
+    ARG_DISABLE_TXN_BTREE,
+    0,
+    "disable-txn-btree",
+    "(upscaledb-only) Uses a red-black tree for the transaction index",
+    0 },
   {0, 0}
 };
 
@@ -441,6 +525,10 @@ parse_compression_type(std::string param)
     return (UPS_COMPRESSOR_SNAPPY);
   if (param == "lzf")
     return (UPS_COMPRESSOR_LZF);
+  if (param == "lz4")
+    return (UPS_COMPRESSOR_LZ4);
+  if (param == "zstd")
+    return (UPS_COMPRESSOR_ZSTD);
   if (param == "zint32_varbyte")
     return (UPS_COMPRESSOR_UINT32_VARBYTE);
   if (param == "zint32_simdcomp")
@@ -453,10 +541,18 @@ parse_compression_type(std::string param)
     return (UPS_COMPRESSOR_UINT32_GROUPVARINT);
   if (param == "zint32_streamvbyte")
     return (UPS_COMPRESSOR_UINT32_STREAMVBYTE);
+  if (param == "zint64_varbyte")
+    return (UPS_COMPRESSOR_UINT64_VARBYTE);
+  if (param == "zint64_for")
+    return (UPS_COMPRESSOR_UINT64_FOR);
+  if (param == "prefix")
+    return (UPS_COMPRESSOR_PREFIX);
   ::printf("invalid compression specifier '%s': expecting 'none', 'zlib', "
-              "'snappy', 'lzf', 'zint32_varbyte', 'zint32_simdcomp', "
+              "'snappy', 'lzf', 'lz4', 'zstd', 'zint32_varbyte', "
+              "'zint32_simdcomp', "
               "'zint32_groupvarint', 'zint32_streamvbyte', "
-              "'zint32_for', 'zint32_simdfor'\n",
+              "'zint32_for', 'zint32_simdfor', 'zint64_varbyte', "
+              "'zint64_for', 'prefix'\n",
               param.c_str());
   ::exit(-1);
 }
@@ -780,6 +876,9 @@ parse_config(int argc, char **argv, Configuration *c)
     else if (opt == ARG_JOURNAL_COMPRESSION) {
       c->journal_compression = parse_compression_type(param);
     }
+    else if (opt == ARG_PAGE_COMPRESSION) {
+      c->page_compression = parse_compression_type(param);
+    }
     else if (opt == ARG_RECORD_COMPRESSION) {
       c->record_compression = parse_compression_type(param);
     }
@@ -821,6 +920,55 @@ parse_config(int argc, char **argv, Configuration *c)
     else if (opt == ARG_FLUSH_TXN_IMMEDIATELY) {
       c->flush_txn_immediately = true;
     }
+    else if (opt == ARG_ENABLE_CONCURRENT_READS) {
+      c->enable_concurrent_reads = true;
+    }
+    else if (opt == ARG_ENABLE_IO_URING) {
+      c->enable_io_uring = true;
+    }
+    else if (opt == ARG_ENABLE_DIRECT_IO) {
+      c->enable_direct_io = true;
+    }
+    else if (opt == ARG_DISABLE_SEARCH_DIRECTORY) {
+      c->disable_search_directory = true;
+    }
+    else if (opt == ARG_ENABLE_DELTA_JOURNAL) {
+      c->enable_delta_journal = true;
+    }
+    else if (opt == ARG_COMMIT_DURABILITY) {
+      if (param && !strcmp(param, "default"))
+        c->commit_flags = 0;
+      else if (param && !strcmp(param, "sync"))
+        c->commit_flags = UPS_TXN_COMMIT_SYNC;
+      else if (param && !strcmp(param, "deferred"))
+        c->commit_flags = UPS_TXN_COMMIT_DEFERRED;
+      else if (param && !strcmp(param, "nosync"))
+        c->commit_flags = UPS_TXN_COMMIT_NOSYNC;
+      else {
+        printf("[FAIL] invalid parameter for 'commit-durability'\n");
+        exit(-1);
+      }
+    }
+    else if (opt == ARG_JOURNAL_SYNC_INTERVAL) {
+      c->journal_sync_interval = param ? strtoul(param, 0, 0) : 0;
+      if (!c->journal_sync_interval) {
+        printf("[FAIL] invalid parameter for 'journal-sync-interval'\n");
+        exit(-1);
+      }
+    }
+    else if (opt == ARG_ENABLE_BACKGROUND_MERGE) {
+      c->enable_background_merge = true;
+    }
+    else if (opt == ARG_MERGE_BACKLOG_LIMIT) {
+      c->merge_backlog_limit = param ? strtoul(param, 0, 0) : 0;
+      if (!c->merge_backlog_limit) {
+        printf("[FAIL] invalid parameter for 'merge-backlog-limit'\n");
+        exit(-1);
+      }
+    }
+    else if (opt == ARG_DISABLE_TXN_BTREE) {
+      c->disable_txn_btree = true;
+    }
     else if (opt == ARG_READ_ONLY) {
       c->read_only = true;
     }
@@ -897,6 +1045,23 @@ print_metrics(Metrics *metrics, Configuration *conf)
                   metrics->erase_latency_total / metrics->erase_ops,
                   metrics->erase_latency_max);
   }
+  if (metrics->txn_commit_ops) {
+    printf("\t%s txn_commit_#ops                %lu (%f/sec)\n",
+                  name, (long unsigned int)metrics->txn_commit_ops,
+                  metrics->elapsed_wallclock_seconds > 0
+                      ? (double)metrics->txn_commit_ops
+                            / metrics->elapsed_wallclock_seconds
+                      : 0.);
+    printf("\t%s txn_commit_latency (min, avg, max) %f, %f, %f\n",
+                  name, metrics->txn_commit_latency_min,
+                  metrics->txn_commit_latency_total / metrics->txn_commit_ops,
+                  metrics->txn_commit_latency_max);
+    if (!strcmp(name, "upscaledb")
+          && metrics->upscaledb_metrics.journal_commit_syncs)
+      printf("\t%s txn_commits_per_sync           %f\n",
+                  name, (double)metrics->txn_commit_ops
+                        / metrics->upscaledb_metrics.journal_commit_syncs);
+  }
   if (!conf->inmemory) {
     if (!strcmp(name, "upscaledb"))
       printf("\t%s filesize                       %lu\n",
@@ -917,6 +1082,17 @@ print_metrics(Metrics *metrics, Configuration *conf)
     printf("\t%s journal_compression            %.3f\n", name, ratio);
   }
 
+  // print page compression ratio
+  if (conf->page_compression && !strcmp(name, "upscaledb")) {
+    float ratio;
+    if (metrics->upscaledb_metrics.page_bytes_before_compression == 0)
+      ratio = 1.f;
+    else
+      ratio = (float)metrics->upscaledb_metrics.page_bytes_after_compression
+                  / metrics->upscaledb_metrics.page_bytes_before_compression;
+    printf("\t%s page_compression               %.3f\n", name, ratio);
+  }
+
   // print record compression ratio
   if (conf->record_compression && !strcmp(name, "upscaledb")) {
     float ratio;
@@ -926,6 +1102,17 @@ print_metrics(Metrics *metrics, Configuration *conf)
       ratio = (float)metrics->upscaledb_metrics.record_bytes_after_compression
                   / metrics->upscaledb_metrics.record_bytes_before_compression;
     printf("\t%s record_compression             %.3f\n", name, ratio);
+
+    // bytes per microsecond are megabytes per second
+    const ups_env_metrics_t *m = &metrics->upscaledb_metrics;
+    if (m->record_compression_usec > 0)
+      printf("\t%s record_compression_mbps        %.3f\n", name,
+                (double)m->record_bytes_before_compression
+                    / m->record_compression_usec);
+    if (m->record_decompression_usec > 0)
+      printf("\t%s record_decompression_mbps      %.3f\n", name,
+                (double)m->record_bytes_decompressed
+                    / m->record_decompression_usec);
   }
 
   // print key compression ratio
@@ -966,6 +1153,10 @@ print_metrics(Metrics *metrics, Configuration *conf)
           (long unsigned int)metrics->upscaledb_metrics.cache_hits);
   printf("\tupscaledb cache_misses                %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.cache_misses);
+  for (uint32_t i = 0; i < metrics->upscaledb_metrics.cache_shards; i++)
+    printf("\tupscaledb cache_shard[%2u] hits/misses  %lu/%lu\n", i,
+          (long unsigned int)metrics->upscaledb_metrics.cache_shard_hits[i],
+          (long unsigned int)metrics->upscaledb_metrics.cache_shard_misses[i]);
   printf("\tupscaledb blob_total_allocated        %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.blob_total_allocated);
   printf("\tupscaledb blob_total_read             %lu\n",
@@ -980,11 +1171,19 @@ print_metrics(Metrics *metrics, Configuration *conf)
           (long unsigned int)metrics->upscaledb_metrics.extended_duptables);
   printf("\tupscaledb journal_bytes_flushed       %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.journal_bytes_flushed);
+  printf("\tupscaledb journal_commit_syncs        %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.journal_commit_syncs);
+  printf("\tupscaledb journal_delta_bytes_saved   %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.journal_delta_bytes_saved);
+  printf("\tupscaledb txn_background_merges       %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.txn_background_merges);
+  printf("\tupscaledb txn_backpressure_merges     %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.txn_backpressure_merges);
 }
 
 struct Callable {
   Callable(int id_, Configuration *conf_)
-    : conf(conf_), db(new UpscaleDatabase(id, conf)), id(id_),
+    : conf(conf_), db(new UpscaleDatabase(id_, conf)), id(id_),
         generator(0) {
     if (conf->filename.empty())
       generator = new RuntimeGenerator(id, conf, db, false);
@@ -1032,6 +1231,10 @@ add_metrics(Metrics *metrics, const Metrics *other)
   metrics->erase_latency_total += other->erase_latency_total;
   metrics->find_latency_total += other->find_latency_total;
   metrics->txn_commit_latency_total += other->txn_commit_latency_total;
+  metrics->txn_commit_latency_min = std::min(metrics->txn_commit_latency_min,
+                  other->txn_commit_latency_min);
+  metrics->txn_commit_latency_max = std::max(metrics->txn_commit_latency_max,
+                  other->txn_commit_latency_max);
 }
 
 template<typename DatabaseType, typename GeneratorType>
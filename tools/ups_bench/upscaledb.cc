@@ -73,7 +73,7 @@ UpscaleDatabase::do_create_env()
 {
   ups_status_t st = 0;
   uint32_t flags = 0;
-  ups_parameter_t params[6] = {{0, 0}};
+  ups_parameter_t params[10] = {{0, 0}};
 
   ScopedLock lock(ms_mutex);
 
@@ -81,6 +81,10 @@ UpscaleDatabase::do_create_env()
 
   upscaledb::Globals::ms_extended_threshold = m_config->extkey_threshold;
   upscaledb::Globals::ms_duplicate_threshold = m_config->duptable_threshold;
+  upscaledb::Globals::ms_is_search_directory_enabled =
+          !m_config->disable_search_directory;
+  upscaledb::Globals::ms_is_txn_btree_enabled =
+          !m_config->disable_txn_btree;
 
   int p = 0;
   if (ms_env == 0) {
@@ -103,12 +107,34 @@ UpscaleDatabase::do_create_env()
       params[p].value = m_config->journal_compression;
       p++;
     }
+    if (m_config->page_compression) {
+      params[p].name = UPS_PARAM_PAGE_COMPRESSION;
+      params[p].value = m_config->page_compression;
+      p++;
+    }
+    if (m_config->journal_sync_interval) {
+      params[p].name = UPS_PARAM_JOURNAL_SYNC_INTERVAL;
+      params[p].value = m_config->journal_sync_interval;
+      p++;
+    }
+    if (m_config->merge_backlog_limit) {
+      params[p].name = UPS_PARAM_MERGE_BACKLOG_LIMIT;
+      params[p].value = m_config->merge_backlog_limit;
+      p++;
+    }
 
     flags |= m_config->inmemory ? UPS_IN_MEMORY : 0; 
     flags |= m_config->no_mmap ? UPS_DISABLE_MMAP : 0; 
     flags |= m_config->cacheunlimited ? UPS_CACHE_UNLIMITED : 0;
     flags |= m_config->use_transactions ? UPS_ENABLE_TRANSACTIONS : 0;
     flags |= m_config->flush_txn_immediately ? UPS_FLUSH_TRANSACTIONS_IMMEDIATELY : 0;
+    flags |= m_config->enable_concurrent_reads ? UPS_ENABLE_CONCURRENT_READS : 0;
+    flags |= m_config->enable_io_uring ? UPS_ENABLE_IO_URING : 0;
+    flags |= m_config->enable_direct_io ? UPS_ENABLE_DIRECT_IO : 0;
+    flags |= m_config->enable_delta_journal ? UPS_ENABLE_DELTA_JOURNAL : 0;
+    flags |= m_config->enable_background_merge
+                ? UPS_ENABLE_BACKGROUND_MERGE
+                : 0;
     flags |= m_config->use_fsync ? UPS_ENABLE_FSYNC : 0;
     flags |= m_config->disable_recovery ? UPS_DISABLE_RECOVERY : 0;
     flags |= m_config->enable_crc32 ? UPS_ENABLE_CRC32 : 0;
@@ -164,6 +190,10 @@ UpscaleDatabase::do_open_env()
 
   upscaledb::Globals::ms_extended_threshold = m_config->extkey_threshold;
   upscaledb::Globals::ms_duplicate_threshold = m_config->duptable_threshold;
+  upscaledb::Globals::ms_is_search_directory_enabled =
+          !m_config->disable_search_directory;
+  upscaledb::Globals::ms_is_txn_btree_enabled =
+          !m_config->disable_txn_btree;
 
   // check if another thread was faster
   if (ms_env == 0) {
@@ -179,6 +209,16 @@ UpscaleDatabase::do_open_env()
       params[p].value = (uint64_t)"1234567890123456";
       p++;
     }
+    if (m_config->journal_sync_interval) {
+      params[p].name = UPS_PARAM_JOURNAL_SYNC_INTERVAL;
+      params[p].value = m_config->journal_sync_interval;
+      p++;
+    }
+    if (m_config->merge_backlog_limit) {
+      params[p].name = UPS_PARAM_MERGE_BACKLOG_LIMIT;
+      params[p].value = m_config->merge_backlog_limit;
+      p++;
+    }
 
     flags |= m_config->no_mmap ? UPS_DISABLE_MMAP : 0; 
     flags |= m_config->cacheunlimited ? UPS_CACHE_UNLIMITED : 0;
@@ -186,10 +226,15 @@ UpscaleDatabase::do_open_env()
                 ? (UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY)
                 : 0;
     flags |= m_config->flush_txn_immediately ? UPS_FLUSH_TRANSACTIONS_IMMEDIATELY : 0;
+    flags |= m_config->enable_concurrent_reads ? UPS_ENABLE_CONCURRENT_READS : 0;
     flags |= m_config->use_fsync ? UPS_ENABLE_FSYNC : 0;
     flags |= m_config->disable_recovery ? UPS_DISABLE_RECOVERY : 0;
     flags |= m_config->read_only ? UPS_READ_ONLY : 0;
     flags |= m_config->enable_crc32 ? UPS_ENABLE_CRC32 : 0;
+    flags |= m_config->enable_delta_journal ? UPS_ENABLE_DELTA_JOURNAL : 0;
+    flags |= m_config->enable_background_merge
+                ? UPS_ENABLE_BACKGROUND_MERGE
+                : 0;
 
     st = ups_env_open(&ms_env, "test-ham.db", flags, &params[0]);
     if (st) {
@@ -502,7 +547,7 @@ UpscaleDatabase::do_txn_commit(Txn *txn)
 {
   assert((ups_txn_t *)txn == m_txn);
 
-  ups_status_t st = ups_txn_commit((ups_txn_t *)txn, 0);
+  ups_status_t st = ups_txn_commit((ups_txn_t *)txn, m_config->commit_flags);
   if (st)
     LOG_ERROR(("ups_txn_commit failed with error %d (%s)\n",
                 st, ups_strerror(st)));
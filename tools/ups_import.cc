@@ -30,6 +30,7 @@
 #define ARG_HELP          1
 #define ARG_STDIN         2
 #define ARG_MERGE         3
+#define ARG_BULK          4
 
 
 /*
@@ -54,6 +55,12 @@ static option_t opts[] = {
     "merge",
     "merge database dump into existing file",
     0 },
+  {
+    ARG_BULK,
+    "bulk",
+    "bulk",
+    "bulk load new databases (see ups_db_bulk_load)",
+    0 },
   { 0, 0, 0, 0, 0 } /* terminating element */
 };
 
@@ -81,9 +88,11 @@ class Importer {
 
 class BinaryImporter : public Importer {
   public:
-    BinaryImporter(FILE *f, ups_env_t *env, const char *outfilename)
+    BinaryImporter(FILE *f, ups_env_t *env, const char *outfilename,
+            bool bulk)
       : Importer(f, env, outfilename), m_db(0), m_insert_flags(0),
-        m_db_counter(0), m_item_counter(0) {
+        m_db_counter(0), m_item_counter(0), m_bulk(bulk),
+        m_has_pending(false) {
       m_buffer = (char *)malloc(1024 * 1024);
     }
 
@@ -96,23 +105,8 @@ class BinaryImporter : public Importer {
     }
 
     virtual void run() {
-      while (!feof(m_f)) {
-        // read the next message from the stream
-        uint32_t size = read_size();
-        if (!size)
-          return;
-
-        m_buffer = (char *)realloc(0, size);
-        if (size != fread(m_buffer, 1, size, m_f)) {
-          fprintf(stderr, "Error reading %u bytes: %s\n", size,
-                  strerror(errno));
-          exit(-1);
-        }
-
-        // unpack serialized datum
-        HamsterTool::Datum datum;
-        datum.ParseFromArray(m_buffer, size);
-
+      HamsterTool::Datum datum;
+      while (read_datum(datum)) {
         switch (datum.type()) {
           case HamsterTool::Datum::ENVIRONMENT:
             read_environment(datum);
@@ -133,6 +127,61 @@ class BinaryImporter : public Importer {
     }
 
   private:
+    // Reads the next message from the stream; returns false at the end
+    // of the stream
+    bool read_datum(HamsterTool::Datum &datum) {
+      // a message which was read ahead by the bulk loader?
+      if (m_has_pending) {
+        datum.Swap(&m_pending);
+        m_has_pending = false;
+        return true;
+      }
+
+      if (feof(m_f))
+        return false;
+
+      uint32_t size = read_size();
+      if (!size)
+        return false;
+
+      m_buffer = (char *)realloc(0, size);
+      if (size != fread(m_buffer, 1, size, m_f)) {
+        fprintf(stderr, "Error reading %u bytes: %s\n", size,
+                strerror(errno));
+        exit(-1);
+      }
+
+      // unpack serialized datum
+      datum.ParseFromArray(m_buffer, size);
+      return true;
+    }
+
+    // The input function of ups_db_bulk_load; returns the items of the
+    // current database. The export is sorted, because it was created
+    // with a cursor
+    static ups_status_t UPS_CALLCONV
+    bulk_load_item(void *context, ups_key_t *key, ups_record_t *record) {
+      BinaryImporter *importer = (BinaryImporter *)context;
+
+      if (!importer->read_datum(importer->m_item))
+        return UPS_KEY_NOT_FOUND;
+
+      // the next database starts; keep its message for run()
+      if (importer->m_item.type() != HamsterTool::Datum::ITEM) {
+        importer->m_pending.Swap(&importer->m_item);
+        importer->m_has_pending = true;
+        return UPS_KEY_NOT_FOUND;
+      }
+
+      const HamsterTool::Item &item = importer->m_item.item();
+      key->data = (void *)item.key().data();
+      key->size = item.key().size();
+      record->data = (void *)item.record().data();
+      record->size = item.record().size();
+      importer->m_item_counter++;
+      return 0;
+    }
+
     void read_environment(HamsterTool::Datum &datum) {
       // only process if the Environment does not yet exist
       if (m_env)
@@ -194,6 +243,16 @@ class BinaryImporter : public Importer {
       st = ups_env_create_db(m_env, &m_db, db.name(), db.flags(), &params[0]);
       if (st)
         error("ups_env_create_db", st);
+
+      // the new database is empty; its keys are unique unless duplicates
+      // are enabled
+      if (m_bulk && !(db.flags() & (UPS_ENABLE_DUPLICATE_KEYS
+                                  | UPS_RECORD_NUMBER32
+                                  | UPS_RECORD_NUMBER64))) {
+        st = ups_db_bulk_load(m_db, bulk_load_item, this, 0, 0);
+        if (st)
+          error("ups_db_bulk_load", st);
+      }
     }
 
     void read_item(HamsterTool::Datum &datum) {
@@ -233,6 +292,10 @@ class BinaryImporter : public Importer {
     uint32_t m_insert_flags;
     size_t m_db_counter;
     size_t m_item_counter;
+    bool m_bulk;
+    bool m_has_pending;
+    HamsterTool::Datum m_pending;
+    HamsterTool::Datum m_item;
 };
 
 int
@@ -240,6 +303,7 @@ main(int argc, char **argv) {
   unsigned opt;
   const char *param, *dumpfilename = 0, *envfilename = 0;
   bool merge = false;
+  bool bulk = false;
   bool use_stdin = false;
 
   getopts_init(argc, argv, "ups_import");
@@ -252,6 +316,9 @@ main(int argc, char **argv) {
       case ARG_MERGE:
         merge = true;
         break;
+      case ARG_BULK:
+        bulk = true;
+        break;
       case GETOPTS_PARAMETER:
         if (!dumpfilename && !use_stdin)
           dumpfilename = param;
@@ -267,11 +334,12 @@ main(int argc, char **argv) {
       case ARG_HELP:
         print_banner("ups_import");
 
-        printf("usage: ups_import [--stdin] [--merge] <data> <environ>\n");
+        printf("usage: ups_import [--stdin] [--merge] [--bulk] <data> <environ>\n");
         printf("usage: ups_import --help\n");
         printf("       --help:       this help screen\n");
         printf("       --stdin:      read dump data from stdin\n");
         printf("       --merge:      merge data into existing environment\n");
+        printf("       --bulk:       bulk load new databases (faster)\n");
         printf("       <data>:       filename with exported data\n");
         printf("       <environ>:    upscaledb environment which will be created (or filled)\n");
         return (0);
@@ -334,7 +402,7 @@ main(int argc, char **argv) {
   }
 
   // now run the import; the importer will create the environment
-  Importer *importer = new BinaryImporter(f, env, envfilename);
+  Importer *importer = new BinaryImporter(f, env, envfilename, bulk);
   importer->run();
   delete importer;
   fclose(f);
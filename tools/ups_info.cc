@@ -85,6 +85,8 @@ get_compressor_name(int library) {
       return ("snappy");
     case UPS_COMPRESSOR_LZF:
       return ("lzf");
+    case UPS_COMPRESSOR_LZ4:
+      return ("lz4");
     case UPS_COMPRESSOR_UINT32_VARBYTE:
       return ("varbyte");
     case UPS_COMPRESSOR_UINT32_SIMDCOMP:
@@ -95,6 +97,14 @@ get_compressor_name(int library) {
       return ("streamvbyte");
     case UPS_COMPRESSOR_UINT32_FOR:
       return ("for");
+    case UPS_COMPRESSOR_UINT64_VARBYTE:
+      return ("varbyte64");
+    case UPS_COMPRESSOR_UINT64_FOR:
+      return ("for64");
+    case UPS_COMPRESSOR_PREFIX:
+      return ("prefix");
+    case UPS_COMPRESSOR_ZSTD:
+      return ("zstd");
     default:
       return ("???");
   }
@@ -128,6 +138,7 @@ print_environment(ups_env_t *env) {
     {UPS_PARAM_PAGE_SIZE, 0},
     {UPS_PARAM_MAX_DATABASES, 0},
     {UPS_PARAM_JOURNAL_COMPRESSION, 0},
+    {UPS_PARAM_PAGE_COMPRESSION, 0},
     {0, 0}
   };
 
@@ -147,6 +158,9 @@ print_environment(ups_env_t *env) {
     if (params[2].value)
       printf("  journal compression:  %s\n",
                       get_compressor_name((int)params[2].value));
+    if (params[3].value)
+      printf("  page compression:     %s\n",
+                      get_compressor_name((int)params[3].value));
   }
 }
 
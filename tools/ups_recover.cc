@@ -21,6 +21,7 @@
 #include <stdlib.h>
 
 #include <ups/upscaledb.h>
+#include <ups/upscaledb_int.h>
 
 #include "getopts.h"
 #include "common.h"
@@ -104,6 +105,28 @@ main(int argc, char **argv) {
   if (st)
     error("ups_env_open", st);
 
+  /* print the statistics of the recovery */
+  ups_env_metrics_t metrics;
+  st = ups_env_get_metrics(env, &metrics);
+  if (st)
+    error("ups_env_get_metrics", st);
+
+  double seconds = metrics.journal_recovery_usec / 1000000.0;
+  printf("Recovered `%s' in %.3f sec\n", filename, seconds);
+  printf("    journal bytes read:      %llu",
+        (unsigned long long)metrics.journal_recovered_bytes);
+  if (seconds > 0)
+    printf(" (%.2f MB/sec)",
+          metrics.journal_recovered_bytes / seconds / (1024 * 1024));
+  printf("\n");
+  printf("    pages restored:          %llu\n",
+        (unsigned long long)metrics.journal_recovered_pages);
+  printf("    operations re-applied:   %llu",
+        (unsigned long long)metrics.journal_recovered_operations);
+  if (seconds > 0)
+    printf(" (%.0f ops/sec)", metrics.journal_recovered_operations / seconds);
+  printf("\n");
+
   /* we're already done */
   st = ups_env_close(env, 0);
   if (st != UPS_SUCCESS)
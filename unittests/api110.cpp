@@ -237,3 +237,29 @@ TEST_CASE("APIv110/spinlockTest", "")
   lock.unlock();
 }
 
+#ifndef UPS_ENABLE_HELGRIND
+TEST_CASE("APIv110/readWriteSpinlockOptimisticTest", "")
+{
+  upscaledb::ReadWriteSpinlock lock;
+  uint32_t version;
+
+  // shared locks do not invalidate optimistic readers
+  REQUIRE(true == lock.try_lock_optimistic(&version));
+  lock.lock_shared();
+  REQUIRE(true == lock.try_lock_optimistic(&version));
+  lock.unlock_shared();
+  REQUIRE(true == lock.validate_optimistic(version));
+
+  // a writer invalidates them
+  lock.lock();
+  uint32_t dummy;
+  REQUIRE(false == lock.try_lock_optimistic(&dummy));
+  REQUIRE(false == lock.validate_optimistic(version));
+  lock.unlock();
+  REQUIRE(false == lock.validate_optimistic(version));
+
+  REQUIRE(true == lock.try_lock_optimistic(&version));
+  REQUIRE(true == lock.validate_optimistic(version));
+}
+#endif
+
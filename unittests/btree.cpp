@@ -18,6 +18,10 @@
 
 #include "3rdparty/catch/catch.hpp"
 
+#include <algorithm>
+#include <vector>
+
+#include "3btree/btree_keys_directory.h"
 #include "3page_manager/page_manager.h"
 #include "4env/env_local.h"
 #include "4context/context.h"
@@ -216,6 +220,57 @@ struct BtreeFixture : BaseFixture {
     REQUIRE(ISSET(node->flags(), PBtreeNode::kLeafNode));
   }
 
+  void searchDirectoryTest(bool enabled) {
+    ups_parameter_t env_params[] = {
+        { UPS_PARAM_PAGE_SIZE, 1024 * 4 },
+        { 0, 0 }
+    };
+    ups_parameter_t db_params[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { 0, 0 }
+    };
+    const uint32_t kMax = 100003; // a prime
+
+    Globals::ms_is_search_directory_enabled = enabled;
+    require_create(0, env_params, 0, db_params);
+
+    // insert the even keys in random order; the internal nodes are split
+    // several times
+    for (uint32_t i = 0; i < kMax; i++) {
+      uint32_t k = ((i * 7919) % kMax) * 2;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t rec = ups_make_record(&k, sizeof(k));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, 0));
+    }
+
+    // erase every 4th key
+    for (uint32_t i = 0; i < kMax; i += 4) {
+      uint32_t k = i * 2;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      REQUIRE(0 == ups_db_erase(db, 0, &key, 0));
+    }
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+
+    for (uint32_t i = 0; i < kMax; i++) {
+      uint32_t k = i * 2;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t rec = {0};
+      REQUIRE((i % 4 == 0 ? UPS_KEY_NOT_FOUND : 0)
+                      == ups_db_find(db, 0, &key, &rec, 0));
+
+      // approximate matching of the odd keys
+      k = i * 2 + 1;
+      key = ups_make_key(&k, sizeof(k));
+      if (i + 1 < kMax) {
+        REQUIRE(0 == ups_db_find(db, 0, &key, &rec, UPS_FIND_GT_MATCH));
+        uint32_t expected = (i + 1) % 4 == 0 ? i * 2 + 4 : i * 2 + 2;
+        REQUIRE(*(uint32_t *)key.data == expected);
+      }
+    }
+
+    Globals::ms_is_search_directory_enabled = true;
+  }
+
   void internalNodeTest() {
     Page *page;
     BtreeNodeProxy *node;
@@ -405,4 +460,43 @@ TEST_CASE("Btree/forceInternalNodeTest", "")
   f.forceInternalNodeTest();
 }
 
+TEST_CASE("Btree/searchDirectory", "")
+{
+  BtreeFixture f;
+  f.searchDirectoryTest(true);
+}
+
+TEST_CASE("Btree/noSearchDirectory", "")
+{
+  BtreeFixture f;
+  f.searchDirectoryTest(false);
+}
+
+// Compares the KeyDirectory with std::lower_bound, also if the keys were
+// modified after the directory was built
+TEST_CASE("Btree/keyDirectory", "")
+{
+  for (size_t count = 0; count < 3000; count += 97) {
+    std::vector<uint32_t> values(count + 1);
+    for (size_t i = 0; i < count; i++)
+      values[i] = (uint32_t)(i * 3 + 1);
+
+    KeyDirectory<uint32_t> directory;
+    directory.build(values.data(), count);
+    REQUIRE(directory.count <= (int)KeyDirectory<uint32_t>::kMaxSamples);
+
+    for (int stale = 0; stale < 2; stale++) {
+      for (uint32_t k = 0; k <= count * 3 + 2; k++) {
+        int expected = std::lower_bound(values.begin(),
+                            values.begin() + count, k) - values.begin();
+        REQUIRE(expected == directory.lower_bound(values.data(), count, k));
+      }
+
+      // insert a key at the beginning, without updating the directory
+      values.insert(values.begin(), 0);
+      values.pop_back();
+    }
+  }
+}
+
 } // namespace upscaledb
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "3rdparty/catch/catch.hpp"
+
+#include "3btree/btree_index_factory.h"
+
+#include "os.hpp"
+#include "fixture.hpp"
+
+namespace upscaledb {
+
+// Returns the keys and records of two vectors to ups_db_bulk_load()
+struct BulkLoadSource {
+  typedef std::vector<std::string> StringVector;
+
+  BulkLoadSource(const StringVector &keys_, const StringVector &records_)
+    : keys(keys_), records(records_), position(0), error_at(-1) {
+  }
+
+  static ups_status_t UPS_CALLCONV
+  next(void *context, ups_key_t *key, ups_record_t *record) {
+    BulkLoadSource *source = (BulkLoadSource *)context;
+    if (source->position == source->error_at)
+      return UPS_IO_ERROR;
+    if (source->position == (int)source->keys.size())
+      return UPS_KEY_NOT_FOUND;
+
+    const std::string &k = source->keys[source->position];
+    const std::string &r = source->records[source->position];
+    key->data = (void *)k.data();
+    key->size = (uint16_t)k.size();
+    record->data = (void *)r.data();
+    record->size = (uint32_t)r.size();
+    source->position++;
+    return 0;
+  }
+
+  const StringVector &keys;
+  const StringVector &records;
+  int position;
+  int error_at;
+};
+
+struct BulkLoadFixture : BaseFixture {
+  typedef std::vector<std::string> StringVector;
+
+  BulkLoadFixture(uint32_t env_flags = 0, ups_parameter_t *db_params = 0) {
+    require_create(env_flags, 0, 0, db_params);
+  }
+
+  // Creates |count| sorted binary keys; every |long_interval|th key is
+  // too long to be stored inline
+  static StringVector create_keys(int count, int long_interval = 0) {
+    StringVector svec;
+    char buffer[64];
+    for (int i = 0; i < count; i++) {
+      ::snprintf(buffer, sizeof(buffer), "key%08d", i);
+      std::string s(buffer);
+      if (long_interval && i % long_interval == 0)
+        s += std::string(300 + i % 50, 'x');
+      svec.push_back(s);
+    }
+    return svec;
+  }
+
+  // Creates sorted uint32 keys
+  static StringVector create_uint32_keys(int count) {
+    StringVector svec;
+    for (uint32_t i = 0; i < (uint32_t)count; i++) {
+      uint32_t k = i * 7 + 3;
+      svec.push_back(std::string((const char *)&k, sizeof(k)));
+    }
+    return svec;
+  }
+
+  // Creates a record for each key; some records are stored in blobs
+  static StringVector create_records(const StringVector &keys) {
+    StringVector svec;
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (i % 500 == 0)
+        svec.push_back(std::string(3000, (char)('a' + i % 26)));
+      else
+        svec.push_back(std::string((const char *)&i, sizeof(uint32_t)));
+    }
+    return svec;
+  }
+
+  ups_status_t bulkLoad(const StringVector &keys, const StringVector &records,
+                  uint32_t fill_factor = 0) {
+    BulkLoadSource source(keys, records);
+    return ups_db_bulk_load(db, BulkLoadSource::next, &source,
+                    fill_factor, 0);
+  }
+
+  void findKeys(const StringVector &keys, const StringVector &records) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      ups_key_t key = ups_make_key((void *)keys[i].data(),
+                      (uint16_t)keys[i].size());
+      ups_record_t record = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+      REQUIRE(std::string((const char *)record.data, record.size)
+                      == records[i]);
+    }
+  }
+
+  void cursorKeys(const StringVector &keys) {
+    ups_key_t key = {0};
+    ups_cursor_t *cursor;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    for (size_t i = 0; i < keys.size(); i++) {
+      REQUIRE(0 == ups_cursor_move(cursor, &key, 0, UPS_CURSOR_NEXT));
+      REQUIRE(std::string((const char *)key.data, key.size) == keys[i]);
+    }
+    REQUIRE(UPS_KEY_NOT_FOUND == ups_cursor_move(cursor, &key, 0,
+                            UPS_CURSOR_NEXT));
+
+    // and backwards
+    REQUIRE(0 == ups_cursor_move(cursor, &key, 0, UPS_CURSOR_LAST));
+    for (size_t i = keys.size(); i > 0; i--) {
+      REQUIRE(std::string((const char *)key.data, key.size) == keys[i - 1]);
+      ups_status_t st = ups_cursor_move(cursor, &key, 0, UPS_CURSOR_PREVIOUS);
+      REQUIRE(st == (i == 1 ? UPS_KEY_NOT_FOUND : 0));
+    }
+    REQUIRE(0 == ups_cursor_close(cursor));
+  }
+
+  static uint64_t file_size(const char *filename) {
+    File f;
+    f.open(filename, 0);
+    uint64_t size = f.file_size();
+    f.close();
+    return size;
+  }
+
+  uint64_t count() {
+    uint64_t c = 0;
+    REQUIRE(0 == ups_db_count(db, 0, 0, &c));
+    return c;
+  }
+
+  // Loads the keys, verifies them, then reopens the Environment and
+  // inserts more keys in between
+  void loadAndVerify(const StringVector &keys, uint32_t fill_factor,
+                  bool use_integers = false) {
+    StringVector records = create_records(keys);
+    REQUIRE(0 == bulkLoad(keys, records, fill_factor));
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    REQUIRE(count() == keys.size());
+    findKeys(keys, records);
+    cursorKeys(keys);
+
+    if (is_in_memory())
+      return;
+
+    close().require_open();
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    findKeys(keys, records);
+
+    // the loaded btree accepts new keys
+    StringVector more;
+    for (size_t i = 0; i < keys.size(); i += 10) {
+      std::string s = keys[i];
+      if (use_integers)
+        (*(uint32_t *)&s[0])++;
+      else
+        s += "+";
+      ups_key_t key = ups_make_key((void *)s.data(), (uint16_t)s.size());
+      ups_record_t record = ups_make_record((void *)s.data(),
+                      (uint32_t)s.size());
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+      more.push_back(s);
+    }
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    REQUIRE(count() == keys.size() + more.size());
+    findKeys(keys, records);
+    findKeys(more, more);
+  }
+};
+
+TEST_CASE("BulkLoad/binaryTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(50000);
+  uint32_t fill_factors[] = {0, 100, 90, 50, 10};
+  for (size_t i = 0; i < sizeof(fill_factors) / sizeof(fill_factors[0]); i++) {
+    BulkLoadFixture f;
+    f.loadAndVerify(keys, fill_factors[i]);
+  }
+}
+
+TEST_CASE("BulkLoad/extendedKeysTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(10000, 13);
+  BulkLoadFixture f;
+  f.loadAndVerify(keys, 80);
+}
+
+TEST_CASE("BulkLoad/uint32Test", "")
+{
+  ups_parameter_t p[] = {
+    { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+    { 0, 0 }
+  };
+  BulkLoadFixture::StringVector keys
+          = BulkLoadFixture::create_uint32_keys(100000);
+  BulkLoadFixture f(0, p);
+  f.loadAndVerify(keys, 0, true);
+}
+
+TEST_CASE("BulkLoad/zint32Test", "")
+{
+  ups_parameter_t p[] = {
+    { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+    { UPS_PARAM_KEY_COMPRESSION, UPS_COMPRESSOR_UINT32_VARBYTE },
+    { 0, 0 }
+  };
+  BulkLoadFixture::StringVector keys
+          = BulkLoadFixture::create_uint32_keys(100000);
+  uint32_t fill_factors[] = {100, 70};
+  for (size_t i = 0; i < sizeof(fill_factors) / sizeof(fill_factors[0]); i++) {
+    BulkLoadFixture f(0, p);
+    f.loadAndVerify(keys, fill_factors[i], true);
+  }
+}
+
+TEST_CASE("BulkLoad/prefixTest", "")
+{
+  ups_parameter_t p[] = {
+    { UPS_PARAM_KEY_COMPRESSION, UPS_COMPRESSOR_PREFIX },
+    { 0, 0 }
+  };
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(30000, 101);
+  uint32_t fill_factors[] = {100, 60};
+  for (size_t i = 0; i < sizeof(fill_factors) / sizeof(fill_factors[0]); i++) {
+    BulkLoadFixture f(0, p);
+    f.loadAndVerify(keys, fill_factors[i]);
+  }
+}
+
+TEST_CASE("BulkLoad/inMemoryTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(20000);
+  BulkLoadFixture f(UPS_IN_MEMORY);
+  f.loadAndVerify(keys, 90);
+}
+
+// Pages with a lower fill factor leave space for new keys
+TEST_CASE("BulkLoad/fillFactorTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(50000);
+  BulkLoadFixture::StringVector records(keys.size(), std::string("rec"));
+
+  uint64_t full_size;
+  {
+    BulkLoadFixture f;
+    REQUIRE(0 == f.bulkLoad(keys, records, 100));
+    full_size = f.device()->file_size();
+  }
+
+  BulkLoadFixture f;
+  REQUIRE(0 == f.bulkLoad(keys, records, 50));
+  REQUIRE(f.device()->file_size() > full_size * 3 / 2);
+}
+
+// The old root page is moved to the freelist; storing the freelist when
+// the Environment is closed must not leave unused storage in the file
+TEST_CASE("BulkLoad/fileSizeTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(200000);
+  BulkLoadFixture::StringVector records(keys.size(), std::string("rec"));
+
+  uint64_t insert_size;
+  {
+    BulkLoadFixture f;
+    for (size_t i = 0; i < keys.size(); i++) {
+      ups_key_t key = ups_make_key((void *)keys[i].data(),
+                      (uint16_t)keys[i].size());
+      ups_record_t record = ups_make_record((void *)records[i].data(),
+                      (uint32_t)records[i].size());
+      REQUIRE(0 == ups_db_insert(f.db, 0, &key, &record, 0));
+    }
+    f.close();
+    insert_size = BulkLoadFixture::file_size("test.db");
+  }
+
+  // the bulk loaded file has two more pages: the freed root page and the
+  // page which stores the freelist
+  BulkLoadFixture f;
+  uint32_t page_size = f.lenv()->config.page_size_bytes;
+  REQUIRE(0 == f.bulkLoad(keys, records));
+  f.close();
+  REQUIRE(f.file_size("test.db") <= insert_size + 2 * page_size);
+}
+
+// The journal is cleared after the load; recovery must not restore
+// older page images
+TEST_CASE("BulkLoad/recoveryTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(20000);
+  BulkLoadFixture::StringVector records
+          = BulkLoadFixture::create_records(keys);
+
+  BulkLoadFixture f(UPS_ENABLE_TRANSACTIONS);
+
+  // a committed Txn in another database is merged before the load
+  ups_db_t *db2;
+  REQUIRE(0 == ups_env_create_db(f.env, &db2, 2, 0, 0));
+  ups_key_t key = ups_make_key((void *)"abc", 4);
+  ups_record_t record = ups_make_record((void *)"abc", 4);
+  REQUIRE(0 == ups_db_insert(db2, 0, &key, &record, 0));
+
+  REQUIRE(0 == f.bulkLoad(keys, records));
+
+  ups_env_metrics_t metrics;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &metrics));
+  REQUIRE(metrics.journal_checkpoints > 0);
+
+  // and these keys are recovered from the journal
+  for (int i = 0; i < 100; i++) {
+    std::string s = keys[i * 10] + "+";
+    key = ups_make_key((void *)s.data(), (uint16_t)s.size());
+    record = ups_make_record((void *)s.data(), (uint32_t)s.size());
+    REQUIRE(0 == ups_db_insert(f.db, 0, &key, &record, 0));
+  }
+
+  f.close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG)
+   .require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+  REQUIRE(f.count() == keys.size() + 100);
+  f.findKeys(keys, records);
+
+  REQUIRE(0 == ups_env_open_db(f.env, &db2, 2, 0, 0));
+  key = ups_make_key((void *)"abc", 4);
+  REQUIRE(0 == ups_db_find(db2, 0, &key, &record, 0));
+}
+
+TEST_CASE("BulkLoad/negativeTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(5000);
+  BulkLoadFixture::StringVector records
+          = BulkLoadFixture::create_records(keys);
+
+  BulkLoadFixture f(UPS_ENABLE_TRANSACTIONS);
+  BulkLoadSource source(keys, records);
+
+  REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_load(0, BulkLoadSource::next,
+                          &source, 0, 0));
+  REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_load(f.db, 0, &source, 0, 0));
+  REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_load(f.db, BulkLoadSource::next,
+                          &source, 5, 0));
+  REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_load(f.db, BulkLoadSource::next,
+                          &source, 101, 0));
+  REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_load(f.db, BulkLoadSource::next,
+                          &source, 0, 1));
+
+  // not while a Txn is active
+  ups_txn_t *txn;
+  REQUIRE(0 == ups_txn_begin(&txn, f.env, 0, 0, 0));
+  REQUIRE(UPS_TXN_STILL_OPEN == f.bulkLoad(keys, records));
+  REQUIRE(0 == ups_txn_abort(txn, 0));
+
+  // keys are not sorted; the database remains empty
+  BulkLoadFixture::StringVector unsorted(keys);
+  std::swap(unsorted[3000], unsorted[3001]);
+  REQUIRE(UPS_INV_PARAMETER == f.bulkLoad(unsorted, records));
+  REQUIRE(f.count() == 0);
+
+  // duplicate keys
+  BulkLoadFixture::StringVector duplicates(keys);
+  duplicates[2000] = duplicates[1999];
+  REQUIRE(UPS_INV_PARAMETER == f.bulkLoad(duplicates, records));
+  REQUIRE(f.count() == 0);
+
+  // errors of the input function are returned
+  source.error_at = 4000;
+  REQUIRE(UPS_IO_ERROR == ups_db_bulk_load(f.db, BulkLoadSource::next,
+                          &source, 0, 0));
+  REQUIRE(f.count() == 0);
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+
+  // the database is not empty
+  ups_key_t key = ups_make_key((void *)"abc", 4);
+  ups_record_t record = {0};
+  REQUIRE(0 == ups_db_insert(f.db, 0, &key, &record, 0));
+  REQUIRE(UPS_INV_PARAMETER == f.bulkLoad(keys, records));
+  REQUIRE(0 == ups_db_erase(f.db, 0, &key, 0));
+
+  // finally succeeds
+  REQUIRE(0 == f.bulkLoad(keys, records));
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+  f.findKeys(keys, records);
+}
+
+TEST_CASE("BulkLoad/invalidSizeTest", "")
+{
+  ups_parameter_t p1[] = {
+    { UPS_PARAM_KEY_SIZE, 11 },
+    { 0, 0 }
+  };
+  ups_parameter_t p2[] = {
+    { UPS_PARAM_RECORD_SIZE, 8 },
+    { 0, 0 }
+  };
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(100);
+  BulkLoadFixture::StringVector records
+          = BulkLoadFixture::create_records(keys);
+
+  {
+    BulkLoadFixture f(0, p1);
+    keys[50] += "!";
+    REQUIRE(UPS_INV_KEY_SIZE == f.bulkLoad(keys, records));
+    REQUIRE(f.count() == 0);
+  }
+
+  BulkLoadFixture f(0, p2);
+  REQUIRE(UPS_INV_RECORD_SIZE == f.bulkLoad(keys, records));
+  REQUIRE(f.count() == 0);
+}
+
+TEST_CASE("BulkLoad/recordNumberTest", "")
+{
+  BulkLoadFixture::StringVector keys = BulkLoadFixture::create_keys(10);
+  BulkLoadFixture::StringVector records
+          = BulkLoadFixture::create_records(keys);
+
+  BaseFixture f;
+  f.require_create(0, 0, UPS_RECORD_NUMBER32, 0);
+  BulkLoadSource source(keys, records);
+  REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_load(f.db, BulkLoadSource::next,
+                          &source, 0, 0));
+}
+
+} // namespace upscaledb
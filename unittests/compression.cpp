@@ -16,6 +16,8 @@
  * See the file COPYING for License information.
  */
 
+#include <sys/stat.h>
+
 #include "3rdparty/catch/catch.hpp"
 
 #include "fixture.hpp"
@@ -41,6 +43,16 @@ TEST_CASE("Compression/factory", "")
 
   c.reset(CompressorFactory::create(UPS_COMPRESSOR_LZF));
   REQUIRE(c.get() != nullptr);
+
+#ifdef HAVE_LZ4_H
+  c.reset(CompressorFactory::create(UPS_COMPRESSOR_LZ4));
+  REQUIRE(c.get() != nullptr);
+#endif
+
+#ifdef HAVE_ZSTD_H
+  c.reset(CompressorFactory::create(UPS_COMPRESSOR_ZSTD));
+  REQUIRE(c.get() != nullptr);
+#endif
 }
 
 static void
@@ -76,6 +88,20 @@ TEST_CASE("Compression/lzf", "")
   simple_compressor_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/lz4", "")
+{
+#ifdef HAVE_LZ4_H
+  simple_compressor_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/zstd", "")
+{
+#ifdef HAVE_ZSTD_H
+  simple_compressor_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 static void
 complex_journal_test(int library)
 {
@@ -134,6 +160,20 @@ TEST_CASE("Compression/LzfJournal", "")
   complex_journal_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/Lz4Journal", "")
+{
+#ifdef HAVE_LZ4_H
+  complex_journal_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/ZstdJournal", "")
+{
+#ifdef HAVE_ZSTD_H
+  complex_journal_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 static void
 simple_record_test(int library)
 {
@@ -195,6 +235,20 @@ TEST_CASE("Compression/LzfRecord", "")
   simple_record_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/Lz4Record", "")
+{
+#ifdef HAVE_LZ4_H
+  simple_record_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/ZstdRecord", "")
+{
+#ifdef HAVE_ZSTD_H
+  simple_record_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 TEST_CASE("Compression/negativeOpen", "")
 {
   ups_parameter_t p[] = {
@@ -386,3 +440,400 @@ TEST_CASE("Compression/unknownCompressor", "")
   BaseFixture f;
   f.require_create(UPS_IN_MEMORY, 0, 0, params, UPS_INV_PARAMETER);
 }
+
+static void
+fill_record(std::vector<uint8_t> &rvec, int i)
+{
+  for (size_t j = 0; j < rvec.size(); j++)
+    rvec[j] = (uint8_t)((i + j / 64) & 0x0f);
+}
+
+static void
+page_compression_test(int library, uint32_t flags)
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_PAGE_COMPRESSION, (uint64_t)library },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(flags, p);
+  REQUIRE(f.lenv()->config.is_mmap_disabled());
+
+  // small records are stored in the leaf pages; every 100th record
+  // spans multiple blob pages
+  std::vector<uint8_t> rvec;
+  DbProxy db(f.db);
+  for (uint32_t i = 0; i < 5000; i++) {
+    rvec.resize(i % 100 == 0 ? 50000 : 64);
+    fill_record(rvec, i);
+    db.require_insert(i, rvec);
+  }
+
+  REQUIRE(0 == ups_env_flush(f.env, 0));
+  ups_env_metrics_t metrics;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &metrics));
+  REQUIRE(metrics.page_bytes_before_compression > 0);
+  REQUIRE(metrics.page_bytes_after_compression
+                  < metrics.page_bytes_before_compression);
+
+  // reopen (and perform recovery, if transactions are enabled)
+  if (ISSET(flags, UPS_ENABLE_TRANSACTIONS))
+    f.close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG)
+     .require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+  else
+    f.close().require_open();
+  f.require_parameter(UPS_PARAM_PAGE_COMPRESSION, library);
+
+  // the file is not memory mapped, but UPS_DISABLE_MMAP is not reported
+  // because the caller did not set it
+  REQUIRE(f.lenv()->config.is_mmap_disabled());
+  REQUIRE(!f.lenv()->device->is_mapped(0, f.lenv()->config.page_size_bytes));
+  ups_parameter_t flags_param[] = {
+      { UPS_PARAM_FLAGS, 0 },
+      { 0, 0 }
+  };
+  REQUIRE(0 == ups_env_get_parameters(f.env, flags_param));
+  REQUIRE(NOTSET(flags_param[0].value, UPS_DISABLE_MMAP));
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+
+  db = DbProxy(f.db);
+  for (uint32_t i = 0; i < 5000; i++) {
+    rvec.resize(i % 100 == 0 ? 50000 : 64);
+    fill_record(rvec, i);
+    db.require_find(i, rvec);
+  }
+
+  // overwrite the records; pages are now rewritten
+  for (uint32_t i = 0; i < 5000; i += 3) {
+    rvec.resize(i % 100 == 0 ? 30000 : 64);
+    fill_record(rvec, i + 1);
+    ups_key_t key = ups_make_key(&i, sizeof(i));
+    db.require_overwrite(&key, rvec);
+  }
+  f.close().require_open();
+  db = DbProxy(f.db);
+  for (uint32_t i = 0; i < 5000; i++) {
+    rvec.resize(i % 100 == 0 ? (i % 3 ? 50000 : 30000) : 64);
+    fill_record(rvec, i % 3 ? i : i + 1);
+    db.require_find(i, rvec);
+  }
+}
+
+TEST_CASE("Compression/ZlibPage", "")
+{
+#ifdef HAVE_ZLIB_H
+  page_compression_test(UPS_COMPRESSOR_ZLIB, 0);
+#endif
+}
+
+TEST_CASE("Compression/SnappyPage", "")
+{
+#ifdef HAVE_SNAPPY_H
+  page_compression_test(UPS_COMPRESSOR_SNAPPY, 0);
+#endif
+}
+
+TEST_CASE("Compression/LzfPage", "")
+{
+  page_compression_test(UPS_COMPRESSOR_LZF, 0);
+}
+
+TEST_CASE("Compression/Lz4Page", "")
+{
+#ifdef HAVE_LZ4_H
+  page_compression_test(UPS_COMPRESSOR_LZ4, 0);
+#endif
+}
+
+TEST_CASE("Compression/ZstdPage", "")
+{
+#ifdef HAVE_ZSTD_H
+  page_compression_test(UPS_COMPRESSOR_ZSTD, 0);
+#endif
+}
+
+TEST_CASE("Compression/LzfPageRecovery", "")
+{
+  page_compression_test(UPS_COMPRESSOR_LZF,
+                  UPS_ENABLE_TRANSACTIONS | UPS_DONT_FLUSH_TRANSACTIONS);
+}
+
+// The payload of a headerless page (i.e. a blob continuation page) is
+// user data; it must not be decompressed, even if it looks like the image
+// of a compressed page
+TEST_CASE("Compression/headerlessPage", "")
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_PAGE_COMPRESSION, UPS_COMPRESSOR_LZF },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(0, p);
+  uint32_t page_size = f.lenv()->config.page_size_bytes;
+
+  // store a compressible page and read its compressed image
+  PageProxy pp1(f.lenv());
+  pp1.require_alloc(Page::kTypeBlob, Page::kInitializeWithZeroes);
+  ::memset(pp1.page->payload(), 'x', 100);
+  pp1.page->set_dirty(true);
+  pp1.require_flush();
+
+  std::vector<uint8_t> image(page_size);
+  DeviceProxy dp(f.lenv());
+  dp.require_read(pp1.page->address(), image.data(), page_size);
+  REQUIRE(0 != ::memcmp(image.data(), pp1.page->data(), page_size));
+
+  // now store this image as the payload of a headerless page
+  PageProxy pp2(f.lenv());
+  pp2.require_alloc(Page::kTypeBlob, 0);
+  pp2.page->set_without_header(true);
+  ::memcpy(pp2.page->data(), image.data(), page_size);
+  pp2.page->set_dirty(true);
+  pp2.require_flush();
+
+  PageProxy pp3(f.lenv());
+  pp3.page->set_without_header(true);
+  pp3.require_fetch(pp2.page->address())
+     .require_data(image.data(), page_size);
+
+  // the compressed page is still decompressed
+  PageProxy pp4(f.lenv());
+  pp4.require_fetch(pp1.page->address())
+     .require_data(pp1.page->data(), page_size);
+}
+
+#if HAVE_FALLOCATE
+// Returns the disk space of test.db, after inserting |count| records
+static uint64_t
+disk_usage(ups_parameter_t *params, int count)
+{
+  std::vector<uint8_t> rvec(200);
+  {
+    BaseFixture f;
+    f.require_create(0, params);
+    DbProxy db(f.db);
+    for (int i = 0; i < count; i++) {
+      fill_record(rvec, i);
+      db.require_insert((uint32_t)i, rvec);
+    }
+  }
+
+  struct stat buf = {0};
+  REQUIRE(0 == ::stat("test.db", &buf));
+  return (uint64_t)buf.st_blocks * 512;
+}
+
+TEST_CASE("Compression/pageDiskUsage", "")
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_PAGE_COMPRESSION, UPS_COMPRESSOR_LZF },
+      { 0, 0 }
+  };
+
+  uint64_t compressed = disk_usage(p, 20000);
+  REQUIRE(disk_usage(0, 20000) > compressed * 2);
+}
+#endif
+
+TEST_CASE("Compression/negativePage", "")
+{
+  ups_parameter_t p1[] = {
+      { UPS_PARAM_PAGE_COMPRESSION, UPS_COMPRESSOR_LZF },
+      { 0, 0 }
+  };
+  ups_parameter_t p2[] = {
+      { UPS_PARAM_PAGE_COMPRESSION, UPS_COMPRESSOR_PREFIX },
+      { 0, 0 }
+  };
+  ups_parameter_t p3[] = {
+      { UPS_PARAM_PAGE_COMPRESSION, 44 },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(UPS_IN_MEMORY, p1, UPS_INV_PARAMETER)
+   .require_create(0, p2, UPS_INV_PARAMETER)
+   .require_create(0, p3, UPS_INV_PARAMETER)
+   .require_create(0, 0)
+   .close()
+   .require_open(0, p1, UPS_INV_PARAMETER);
+}
+
+#ifdef HAVE_ZSTD_H
+// Creates a small JSON document; all documents share the same structure
+static std::vector<uint8_t>
+json_record(int i)
+{
+  static const char *countries[] = { "de", "fr", "us", "uk", "jp" };
+  char buffer[256];
+  int len = ::snprintf(buffer, sizeof(buffer),
+                  "{\"id\": %d, \"name\": \"customer-%d\", "
+                  "\"email\": \"customer%d@example.com\", "
+                  "\"country\": \"%s\", \"active\": %s, "
+                  "\"balance\": %d.%02d}", i, i * 7, i,
+                  countries[i % 5], i % 3 ? "true" : "false",
+                  i * 13 % 10000, i % 100);
+  return std::vector<uint8_t>(buffer, buffer + len);
+}
+
+static void
+insert_json_records(BaseFixture &f, int start, int end)
+{
+  DbProxy db(f.db);
+  for (int i = start; i < end; i++) {
+    std::vector<uint8_t> rvec = json_record(i);
+    db.require_insert((uint32_t)i, rvec);
+  }
+}
+
+static void
+find_json_records(BaseFixture &f, int start, int end)
+{
+  DbProxy db(f.db);
+  for (int i = start; i < end; i++) {
+    std::vector<uint8_t> rvec = json_record(i);
+    db.require_find((uint32_t)i, rvec);
+  }
+}
+
+// Returns the compression ratio of the records inserted since the last call
+static double
+record_compression_ratio(BaseFixture &f, ups_env_metrics_t *last)
+{
+  ups_env_metrics_t metrics;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &metrics));
+  double ratio = (double)(metrics.record_bytes_after_compression
+                              - last->record_bytes_after_compression)
+                    / (metrics.record_bytes_before_compression
+                              - last->record_bytes_before_compression);
+  *last = metrics;
+  return ratio;
+}
+
+static void
+dictionary_test(uint32_t env_flags)
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_RECORD_COMPRESSION, UPS_COMPRESSOR_ZSTD },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(env_flags, nullptr, 0, p);
+
+  ups_env_metrics_t metrics = {0};
+  insert_json_records(f, 0, 2000);
+  double plain = record_compression_ratio(f, &metrics);
+
+  REQUIRE(0 == ups_db_train_dictionary(f.db, 0, 0));
+  REQUIRE(UPS_ALREADY_INITIALIZED == ups_db_train_dictionary(f.db, 0, 0));
+
+  // records which are written with the dictionary are a lot smaller
+  insert_json_records(f, 2000, 4000);
+  REQUIRE(record_compression_ratio(f, &metrics) < plain * 0.75);
+  REQUIRE(metrics.record_compression_usec > 0);
+  find_json_records(f, 0, 4000);
+
+  if (NOTSET(env_flags, UPS_IN_MEMORY)) {
+    // the dictionary is persistent
+    f.close().require_open(env_flags);
+    find_json_records(f, 0, 4000);
+    insert_json_records(f, 4000, 4100);
+    find_json_records(f, 0, 4100);
+    REQUIRE(UPS_ALREADY_INITIALIZED == ups_db_train_dictionary(f.db, 0, 0));
+  }
+
+  // erasing the database also erases the dictionary; in-memory databases
+  // are erased when they're closed
+  REQUIRE(0 == ups_db_close(f.db, 0));
+  if (NOTSET(env_flags, UPS_IN_MEMORY))
+    REQUIRE(0 == ups_env_erase_db(f.env, 1, 0));
+  REQUIRE(0 == ups_env_create_db(f.env, &f.db, 1, 0, p));
+  insert_json_records(f, 0, 2000);
+  REQUIRE(0 == ups_db_train_dictionary(f.db, 0, 0));
+  find_json_records(f, 0, 2000);
+}
+
+TEST_CASE("Compression/ZstdDictionary", "")
+{
+  dictionary_test(0);
+}
+
+TEST_CASE("Compression/ZstdDictionaryInMemory", "")
+{
+  dictionary_test(UPS_IN_MEMORY);
+}
+
+TEST_CASE("Compression/ZstdDictionaryRecovery", "")
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_RECORD_COMPRESSION, UPS_COMPRESSOR_ZSTD },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(UPS_ENABLE_TRANSACTIONS, nullptr, 0, p);
+  insert_json_records(f, 0, 2000);
+  REQUIRE(0 == ups_db_train_dictionary(f.db, 0, 0));
+  insert_json_records(f, 2000, 4000);
+
+  f.close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG)
+   .require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+  find_json_records(f, 0, 4000);
+}
+
+TEST_CASE("Compression/ZstdDictionaryUpgradesFile", "")
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_RECORD_COMPRESSION, UPS_COMPRESSOR_ZSTD },
+      { 0, 0 }
+  };
+
+  // emulate a file of version 5
+  BaseFixture f;
+  f.require_create(0, nullptr, 0, p);
+  f.lenv()->header->set_version(UPS_VERSION_MAJ, UPS_VERSION_MIN,
+                  UPS_VERSION_REV, EnvHeader::kOldestFileVersion);
+  f.lenv()->header->header_page->set_dirty(true);
+  insert_json_records(f, 0, 2000);
+  f.close().require_open();
+  REQUIRE(f.lenv()->header->version(3) == EnvHeader::kOldestFileVersion);
+
+  // older versions would not find the dictionary
+  REQUIRE(0 == ups_db_train_dictionary(f.db, 0, 0));
+  REQUIRE(f.lenv()->header->version(3) == UPS_FILE_VERSION);
+  insert_json_records(f, 2000, 2100);
+  f.close().require_open();
+  REQUIRE(f.lenv()->header->version(3) == UPS_FILE_VERSION);
+  find_json_records(f, 0, 2100);
+}
+#endif
+
+TEST_CASE("Compression/negativeDictionary", "")
+{
+  ups_parameter_t p[] = {
+      { UPS_PARAM_RECORD_COMPRESSION, UPS_COMPRESSOR_LZF },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(0, nullptr, 0, p);
+  REQUIRE(UPS_INV_PARAMETER == ups_db_train_dictionary(0, 0, 0));
+  REQUIRE(UPS_INV_PARAMETER == ups_db_train_dictionary(f.db, 0, 1));
+#ifdef HAVE_ZSTD_H
+  REQUIRE(UPS_INV_PARAMETER == ups_db_train_dictionary(f.db, 0, 0));
+  f.close();
+
+  // not enough records for training
+  p[0].value = UPS_COMPRESSOR_ZSTD;
+  f.require_create(0, nullptr, 0, p);
+  DbProxy db(f.db);
+  std::vector<uint8_t> rvec(100, 'x');
+  db.require_insert(1u, rvec);
+  REQUIRE(UPS_INV_PARAMETER == ups_db_train_dictionary(f.db, 0, 0));
+#else
+  REQUIRE(UPS_NOT_IMPLEMENTED == ups_db_train_dictionary(f.db, 0, 0));
+#endif
+}
@@ -24,6 +24,8 @@
 #include "fixture.hpp"
 
 #include "1os/file.h"
+#include "2checksum/checksum.h"
+#include "4env/env_header.h"
 
 using namespace upscaledb;
 
@@ -133,3 +135,80 @@ TEST_CASE("Crc32/corruptMultipageBlobTest", "")
   db.require_find("1", v1, UPS_INTEGRITY_VIOLATED);
 }
 
+TEST_CASE("Crc32/crc32cTest", "")
+{
+  // the check value of CRC32C
+  REQUIRE(Checksum::crc32c(0, "123456789", 9) == 0xe3069283u);
+  REQUIRE(Checksum::crc32c_portable(0, "123456789", 9) == 0xe3069283u);
+  REQUIRE(Checksum::crc32c(0, "", 0) == 0);
+
+  // the accelerated and the portable implementation are identical for
+  // all sizes and alignments; the largest buffer uses the long and the
+  // short streams
+  std::vector<uint8_t> buffer(3 * 8192 * 2 + 3 * 256 + 77);
+  for (size_t i = 0; i < buffer.size(); i++)
+    buffer[i] = (uint8_t)(i * 7919 + (i >> 8));
+
+  size_t sizes[] = {1, 7, 8, 9, 255, 3 * 256, 3 * 256 + 1, 1024 * 16 - 31,
+                    3 * 8192, buffer.size() - 8};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (size_t offset = 0; offset < 8; offset++) {
+      uint32_t crc = Checksum::crc32c(offset, &buffer[offset], sizes[i]);
+      REQUIRE(crc == Checksum::crc32c_portable(offset, &buffer[offset],
+                              sizes[i]));
+    }
+  }
+
+  // crcs can be continued
+  uint32_t crc = Checksum::crc32c(0, buffer.data(), 1000);
+  crc = Checksum::crc32c(crc, buffer.data() + 1000, buffer.size() - 1000);
+  REQUIRE(crc == Checksum::crc32c(0, buffer.data(), buffer.size()));
+}
+
+TEST_CASE("Crc32/defaultAlgorithmTest", "")
+{
+  BaseFixture f;
+  f.require_create(UPS_ENABLE_CRC32);
+  REQUIRE(f.lenv()->header->checksum_algorithm() == Checksum::kCrc32c);
+  f.close();
+
+  f.require_open(UPS_ENABLE_CRC32);
+  REQUIRE(f.lenv()->config.checksum_algorithm == Checksum::kCrc32c);
+}
+
+TEST_CASE("Crc32/olderFileTest", "")
+{
+  std::vector<uint8_t> v1(1024 * 32, 3);
+
+  // files of version 5 store 0 in the header; emulate such a file
+  BaseFixture f;
+  REQUIRE(0 == f.create_env(UPS_ENABLE_CRC32));
+  f.lenv()->header->set_version(UPS_VERSION_MAJ, UPS_VERSION_MIN,
+                  UPS_VERSION_REV, EnvHeader::kOldestFileVersion);
+  f.lenv()->header->set_checksum_algorithm(Checksum::kMurmurHash3);
+  f.lenv()->header->header_page->set_dirty(true);
+  f.lenv()->config.checksum_algorithm = Checksum::kMurmurHash3;
+  f.close();
+
+  REQUIRE(0 == f.open_env(UPS_ENABLE_CRC32));
+  REQUIRE(f.lenv()->config.checksum_algorithm == Checksum::kMurmurHash3);
+  REQUIRE(0 == ups_env_create_db(f.env, &f.db, 1, 0, 0));
+
+  DbProxy db(f.db);
+  db.require_insert("1", v1)
+    .require_insert("2", nullptr);
+
+  // reopen and verify the checksums
+  f.close()
+   .require_open(UPS_ENABLE_CRC32);
+  db = DbProxy(f.db);
+  db.require_find("1", v1)
+    .require_find("2", nullptr);
+  f.close();
+
+  // flip a few bytes in page 16 * 1024
+  garbagify_file("test.db", 1024 * 16 + 200);
+  f.require_open(UPS_ENABLE_CRC32);
+  db = DbProxy(f.db);
+  db.require_find("2", nullptr, UPS_INTEGRITY_VIOLATED);
+}
@@ -19,6 +19,7 @@
 #include "3rdparty/catch/catch.hpp"
 
 #include "2device/device.h"
+#include "2device/device_io_uring.h"
 
 #include "os.hpp"
 #include "fixture.hpp"
@@ -26,8 +27,8 @@
 using namespace upscaledb;
 
 struct DeviceFixture : BaseFixture {
-  DeviceFixture(bool inmemory) {
-    require_create(inmemory ? UPS_IN_MEMORY : 0);
+  DeviceFixture(bool inmemory, uint32_t flags = 0) {
+    require_create((inmemory ? UPS_IN_MEMORY : 0) | flags);
   }
 
   void createCloseTest() {
@@ -116,6 +117,76 @@ struct DeviceFixture : BaseFixture {
     }
   }
 
+  void mmapGrowTest() {
+    uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    std::vector<uint8_t> temp(page_size);
+
+    // the file grows after it was created; write the pages with pwrite
+    DeviceProxy dp(lenv());
+    dp.require_open()
+      .require_truncate(page_size * 128);
+    for (int i = 2; i < 128; i++) {
+      std::fill(temp.begin(), temp.end(), (uint8_t)i);
+      dp.require_write(i * page_size, temp.data(), page_size);
+    }
+
+    // the new pages are nevertheless mapped
+    {
+      PageProxy pp(lenv());
+      pp.set_address(100 * page_size);
+      dp.require_read_page(pp, 100 * page_size);
+      pp.require_allocated(false);
+      std::fill(temp.begin(), temp.end(), (uint8_t)100);
+      pp.require_payload(temp.data(),
+                      page_size - Page::kSizeofPersistentHeader);
+      // modify the private copy of the page
+      ::memset(pp.page->payload(), 0xff,
+                      page_size - Page::kSizeofPersistentHeader);
+    }
+
+    // shrink the file, then grow it again; the pages must not return
+    // stale data
+    dp.require_truncate(page_size * 4)
+      .require_truncate(page_size * 128);
+    {
+      PageProxy pp(lenv());
+      pp.set_address(100 * page_size);
+      dp.require_read_page(pp, 100 * page_size);
+      std::fill(temp.begin(), temp.end(), (uint8_t)0);
+      pp.require_payload(temp.data(),
+                      page_size - Page::kSizeofPersistentHeader);
+    }
+  }
+
+  void directIoGrowTest() {
+    uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    std::vector<uint8_t> temp(page_size);
+
+    // is direct I/O supported by the file system?
+    File probe;
+    probe.create("test.probe", 0644);
+    bool is_direct_io = probe.enable_direct_io();
+    probe.close();
+
+    // the file was created with direct I/O; it grows, but the new pages
+    // must not be mapped
+    DeviceProxy dp(lenv());
+    dp.require_open()
+      .require_truncate(page_size * 128);
+    for (int i = 2; i < 128; i++) {
+      std::fill(temp.begin(), temp.end(), (uint8_t)i);
+      dp.require_write(i * page_size, temp.data(), page_size);
+    }
+
+    PageProxy pp(lenv());
+    pp.set_address(100 * page_size);
+    dp.require_read_page(pp, 100 * page_size);
+    pp.require_allocated(is_direct_io);
+    std::fill(temp.begin(), temp.end(), (uint8_t)100);
+    pp.require_payload(temp.data(),
+                    page_size - Page::kSizeofPersistentHeader);
+  }
+
   void readWriteTest() {
     int i;
     uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
@@ -144,6 +215,162 @@ struct DeviceFixture : BaseFixture {
     }
   }
 
+  void writeBatchTest() {
+    uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    std::vector<std::vector<uint8_t>> buffers(10);
+    std::vector<Device::WriteRequest> requests(10);
+    std::vector<uint8_t> temp(page_size);
+
+    REQUIRE(dynamic_cast<IoUringDevice *>(device()) != 0);
+
+    DeviceProxy dp(lenv());
+    dp.require_open()
+      .require_truncate(page_size * 10);
+
+    for (uint8_t i = 0; i < 10; i++) {
+      buffers[i].resize(page_size);
+      std::fill(buffers[i].begin(), buffers[i].end(), i + 1);
+      requests[i].offset = i * page_size;
+      requests[i].buffer = buffers[i].data();
+      requests[i].size = page_size;
+    }
+    device()->write_batch(requests.data(), requests.size(), true);
+
+    for (uint8_t i = 0; i < 10; i++) {
+      dp.require_read(i * page_size, temp.data(), page_size);
+      REQUIRE(0 == ::memcmp(buffers[i].data(), temp.data(), page_size));
+    }
+  }
+
+  void readPageBatchTest() {
+    uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    std::vector<uint8_t> temp(page_size);
+
+    REQUIRE(device()->supports_batched_reads());
+
+    EnvConfig &cfg = const_cast<EnvConfig &>(lenv()->config);
+    cfg.flags |= UPS_DISABLE_MMAP;
+
+    DeviceProxy dp(lenv());
+    dp.require_open()
+      .require_truncate(page_size * 10);
+    for (uint8_t i = 0; i < 10; i++) {
+      std::fill(temp.begin(), temp.end(), i + 1);
+      dp.require_write(i * page_size, temp.data(), page_size);
+    }
+
+    // read every other page with a single batch
+    std::vector<Page *> pages;
+    std::vector<uint64_t> addresses;
+    for (uint8_t i = 0; i < 10; i += 2) {
+      pages.push_back(new Page(device()));
+      addresses.push_back(i * page_size);
+    }
+    device()->read_page_batch(pages.data(), addresses.data(), pages.size());
+
+    for (size_t i = 0; i < pages.size(); i++) {
+      REQUIRE(pages[i]->is_allocated());
+      std::fill(temp.begin(), temp.end(), (uint8_t)(i * 2 + 1));
+      REQUIRE(0 == ::memcmp(pages[i]->data(), temp.data(), page_size));
+      delete pages[i];
+    }
+  }
+
+  void ioUringEnvTest() {
+    ups_parameter_t params[] = {
+      {UPS_PARAM_CACHE_SIZE, 64 * 1024},
+      {0, 0}
+    };
+
+    // the pages of each operation are flushed as one batch
+    close();
+    REQUIRE(0 == create_env(UPS_ENABLE_IO_URING | UPS_ENABLE_TRANSACTIONS
+                            | UPS_ENABLE_FSYNC | UPS_DISABLE_MMAP, params));
+    REQUIRE(0 == ups_env_create_db(env, &db, 1, 0, 0));
+    for (uint32_t i = 0; i < 2000; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t record = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+    }
+    close();
+
+    // and read without io_uring; with io_uring, the leaves are prefetched
+    // when the keys are counted
+    for (int loop = 0; loop < 2; loop++) {
+      REQUIRE(0 == open_env(loop == 0
+                              ? UPS_ENABLE_IO_URING | UPS_DISABLE_MMAP
+                              : 0, params));
+      REQUIRE(0 == ups_env_open_db(env, &db, 1, 0, 0));
+      uint64_t count = 0;
+      REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+      REQUIRE(count == 2000);
+      for (uint32_t i = 0; i < 2000; i++) {
+        ups_key_t key = ups_make_key(&i, sizeof(i));
+        ups_record_t record = {0};
+        REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+        REQUIRE(*(uint32_t *)record.data == i);
+      }
+      REQUIRE(0 == ups_db_check_integrity(db, 0));
+      close();
+    }
+  }
+
+  void directIoEnvTest() {
+    ups_parameter_t params[] = {
+      {UPS_PARAM_CACHE_SIZE, 64 * 1024},
+      {0, 0}
+    };
+    uint8_t buffer[100];
+
+    // the records are stored in blobs, which are written unaligned
+    for (int loop = 0; loop < 2; loop++) {
+      uint32_t flags = UPS_ENABLE_DIRECT_IO | UPS_ENABLE_TRANSACTIONS
+                            | UPS_ENABLE_FSYNC;
+      if (loop == 1)
+        flags |= UPS_ENABLE_IO_URING;
+      close();
+      REQUIRE(0 == create_env(flags, params));
+      REQUIRE(0 == ups_env_create_db(env, &db, 1, 0, 0));
+
+      // with direct I/O, the page buffers are aligned
+      File probe;
+      probe.create("test.probe", 0644);
+      if (probe.enable_direct_io()) {
+        PageProxy pp(lenv(), ldb());
+        DeviceProxy dp(lenv());
+        dp.alloc_page(pp);
+        pp.require_allocated(true);
+        REQUIRE((uintptr_t)pp.page->data() % File::kDirectIoAlignment == 0);
+        dp.free_page(pp);
+      }
+      probe.close();
+
+      for (uint32_t i = 0; i < 2000; i++) {
+        ups_key_t key = ups_make_key(&i, sizeof(i));
+        ::memset(buffer, (int)i, sizeof(buffer));
+        ups_record_t record = ups_make_record(buffer, sizeof(buffer));
+        REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+      }
+      close();
+
+      // read with and without direct I/O
+      for (int reopen = 0; reopen < 2; reopen++) {
+        REQUIRE(0 == open_env(reopen == 0 ? flags : 0, params));
+        REQUIRE(0 == ups_env_open_db(env, &db, 1, 0, 0));
+        for (uint32_t i = 0; i < 2000; i++) {
+          ups_key_t key = ups_make_key(&i, sizeof(i));
+          ups_record_t record = {0};
+          REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+          REQUIRE(record.size == sizeof(buffer));
+          ::memset(buffer, (int)i, sizeof(buffer));
+          REQUIRE(0 == ::memcmp(record.data, buffer, sizeof(buffer)));
+        }
+        REQUIRE(0 == ups_db_check_integrity(db, 0));
+        close();
+      }
+    }
+  }
+
   void readWritePageTest() {
     PageProxy pages[2] = {{lenv(), ldb()}, {lenv(), ldb()}};
     uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
@@ -222,6 +449,18 @@ TEST_CASE("Device/mmapUnmap", "")
   f.mmapUnmapTest();
 }
 
+TEST_CASE("Device/mmapGrow", "")
+{
+  DeviceFixture f(false);
+  f.mmapGrowTest();
+}
+
+TEST_CASE("Device/directIoGrow", "")
+{
+  DeviceFixture f(false, UPS_ENABLE_DIRECT_IO);
+  f.directIoGrowTest();
+}
+
 TEST_CASE("Device/readWrite", "")
 {
   DeviceFixture f(false);
@@ -234,6 +473,36 @@ TEST_CASE("Device/readWritePage", "")
   f.readWritePageTest();
 }
 
+TEST_CASE("Device/ioUring/readWrite", "")
+{
+  DeviceFixture f(false, UPS_ENABLE_IO_URING);
+  f.readWriteTest();
+}
+
+TEST_CASE("Device/ioUring/readWritePage", "")
+{
+  DeviceFixture f(false, UPS_ENABLE_IO_URING);
+  f.readWritePageTest();
+}
+
+TEST_CASE("Device/ioUring/writeBatch", "")
+{
+  DeviceFixture f(false, UPS_ENABLE_IO_URING);
+  f.writeBatchTest();
+}
+
+TEST_CASE("Device/ioUring/readPageBatch", "")
+{
+  DeviceFixture f(false, UPS_ENABLE_IO_URING);
+  f.readPageBatchTest();
+}
+
+TEST_CASE("Device/ioUring/env", "")
+{
+  DeviceFixture f(false);
+  f.ioUringEnvTest();
+}
+
 
 TEST_CASE("Device/inmem/newDelete", "")
 {
@@ -253,3 +522,10 @@ TEST_CASE("Device/inmem/flush", "")
   f.flushTest();
 }
 
+
+TEST_CASE("Device/directIo/env", "")
+{
+  DeviceFixture f(false);
+  f.directIoEnvTest();
+}
+
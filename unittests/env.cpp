@@ -19,6 +19,9 @@
 #include "3rdparty/catch/catch.hpp"
 
 #include <stdint.h>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
 
 #include "4db/db_local.h"
 #include "4env/env_local.h"
@@ -1148,3 +1151,412 @@ TEST_CASE("Env/inmem/createOpenEmptyTest", "")
   f.createOpenEmptyTest();
 }
 
+
+struct ConcurrentReader {
+  ConcurrentReader(ups_env_t *env_, ups_db_t *db_, ups_db_t *db2_,
+                  boost::atomic<int> *failures_)
+    : env(env_), db(db_), db2(db2_), failures(failures_) {
+  }
+
+  void operator()() {
+    char buffer[400] = {0};
+
+    for (int loop = 0; loop < 3; loop++) {
+      // lookups of numeric keys; the records are stored in blobs
+      for (uint32_t i = 0; i < 2000; i++) {
+        ups_key_t key = ups_make_key(&i, sizeof(i));
+        ups_record_t record = {0};
+        if (ups_db_find(db, 0, &key, &record, 0) != 0
+              || record.size != sizeof(buffer)
+              || *(uint32_t *)record.data != i)
+          (*failures)++;
+      }
+
+      // lookups of extended keys
+      for (uint32_t i = 0; i < 200; i++) {
+        *(uint32_t *)&buffer[0] = i;
+        ups_key_t key = ups_make_key(buffer, sizeof(buffer));
+        ups_record_t record = {0};
+        if (ups_db_find(db2, 0, &key, &record, 0) != 0
+              || record.size != sizeof(i)
+              || *(uint32_t *)record.data != i)
+          (*failures)++;
+      }
+
+      // move a cursor over all keys
+      ups_cursor_t *cursor;
+      if (ups_cursor_create(&cursor, db, 0, 0) != 0) {
+        (*failures)++;
+        return;
+      }
+      uint32_t count = 0;
+      ups_key_t key = {0};
+      while (ups_cursor_move(cursor, &key, 0, UPS_CURSOR_NEXT) == 0) {
+        if (*(uint32_t *)key.data != count)
+          (*failures)++;
+        uint32_t size, duplicates, position;
+        if (ups_cursor_get_record_size(cursor, &size) != 0
+              || size != sizeof(buffer)
+              || ups_cursor_get_duplicate_count(cursor, &duplicates, 0) != 0
+              || duplicates != 1
+              || ups_cursor_get_duplicate_position(cursor, &position) != 0
+              || position != 0)
+          (*failures)++;
+        count++;
+      }
+      if (count != 2000)
+        (*failures)++;
+      ups_cursor_close(cursor);
+
+      uint64_t keys;
+      if (ups_db_count(db, 0, 0, &keys) != 0 || keys != 2000)
+        (*failures)++;
+
+      // run a query
+      uqi_result_t *result;
+      if (uqi_select(env, "COUNT($key) FROM DATABASE 1", &result) != 0) {
+        (*failures)++;
+        return;
+      }
+      uint32_t size;
+      if (*(uint64_t *)uqi_result_get_record_data(result, &size) != 2000)
+        (*failures)++;
+      uqi_result_close(result);
+    }
+  }
+
+  ups_env_t *env;
+  ups_db_t *db;
+  ups_db_t *db2;
+  boost::atomic<int> *failures;
+};
+
+TEST_CASE("Env/concurrentReadsNotPersistentTest", "")
+{
+  BaseFixture f;
+  f.require_create(UPS_ENABLE_CONCURRENT_READS)
+   .require_flags(UPS_ENABLE_CONCURRENT_READS)
+   .close();
+
+  f.require_open()
+   .require_flags(UPS_ENABLE_CONCURRENT_READS, false)
+   .close();
+
+  f.require_open(UPS_ENABLE_CONCURRENT_READS)
+   .require_flags(UPS_ENABLE_CONCURRENT_READS)
+   .close();
+}
+
+TEST_CASE("Env/concurrentReadsTest", "")
+{
+  ups_parameter_t params[] = {
+    {UPS_PARAM_CACHE_SIZE, 64 * 1024},
+    {0, 0}
+  };
+  ups_parameter_t uint32_params[] = {
+    {UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32},
+    {0, 0}
+  };
+
+  // use a small cache; pages are purged while the readers are active
+  BaseFixture f;
+  REQUIRE(0 == f.create_env(UPS_ENABLE_CONCURRENT_READS, params));
+
+  ups_db_t *db1, *db2, *db3;
+  REQUIRE(0 == ups_env_create_db(f.env, &db1, 1, 0, uint32_params));
+  REQUIRE(0 == ups_env_create_db(f.env, &db2, 2, 0, 0));
+  REQUIRE(0 == ups_env_create_db(f.env, &db3, 3, 0, uint32_params));
+
+  char buffer[400] = {0};
+  for (uint32_t i = 0; i < 2000; i++) {
+    ups_key_t key = ups_make_key(&i, sizeof(i));
+    *(uint32_t *)&buffer[0] = i;
+    ups_record_t record = ups_make_record(buffer, sizeof(buffer));
+    REQUIRE(0 == ups_db_insert(db1, 0, &key, &record, 0));
+  }
+  for (uint32_t i = 0; i < 200; i++) {
+    *(uint32_t *)&buffer[0] = i;
+    ups_key_t key = ups_make_key(buffer, sizeof(buffer));
+    ups_record_t record = ups_make_record(&i, sizeof(i));
+    REQUIRE(0 == ups_db_insert(db2, 0, &key, &record, 0));
+  }
+
+  ups_env_metrics_t before;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &before));
+
+  // four readers, and a writer which modifies a different database
+  boost::atomic<int> failures(0);
+  std::vector<boost::thread *> threads;
+  for (int i = 0; i < 4; i++)
+    threads.push_back(new boost::thread(ConcurrentReader(f.env, db1, db2,
+                                &failures)));
+
+  for (uint32_t i = 0; i < 2000; i++) {
+    ups_key_t key = ups_make_key(&i, sizeof(i));
+    ups_record_t record = ups_make_record(buffer, sizeof(buffer));
+    REQUIRE(0 == ups_db_insert(db3, 0, &key, &record, 0));
+  }
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  REQUIRE(failures == 0);
+
+  // the readers did not lose updates of the blob metrics
+  ups_env_metrics_t after;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &after));
+  REQUIRE(after.blob_total_read - before.blob_total_read >= 4 * 3 * 2000);
+  REQUIRE(0 == ups_db_check_integrity(db1, 0));
+  REQUIRE(0 == ups_db_check_integrity(db3, 0));
+}
+
+TEST_CASE("Env/concurrentMissesTest", "")
+{
+  ups_parameter_t params[] = {
+    {UPS_PARAM_CACHE_SIZE, 64 * 1024},
+    {0, 0}
+  };
+  ups_parameter_t uint32_params[] = {
+    {UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32},
+    {0, 0}
+  };
+
+  BaseFixture f;
+  REQUIRE(0 == f.create_env(0));
+
+  ups_db_t *db1, *db2;
+  REQUIRE(0 == ups_env_create_db(f.env, &db1, 1, 0, uint32_params));
+  REQUIRE(0 == ups_env_create_db(f.env, &db2, 2, 0, 0));
+
+  char buffer[400] = {0};
+  for (uint32_t i = 0; i < 2000; i++) {
+    ups_key_t key = ups_make_key(&i, sizeof(i));
+    *(uint32_t *)&buffer[0] = i;
+    ups_record_t record = ups_make_record(buffer, sizeof(buffer));
+    REQUIRE(0 == ups_db_insert(db1, 0, &key, &record, 0));
+  }
+  for (uint32_t i = 0; i < 200; i++) {
+    *(uint32_t *)&buffer[0] = i;
+    ups_key_t key = ups_make_key(buffer, sizeof(buffer));
+    ups_record_t record = ups_make_record(&i, sizeof(i));
+    REQUIRE(0 == ups_db_insert(db2, 0, &key, &record, 0));
+  }
+  f.close();
+
+  // reopen without mmap and with a small cache; most pages are read
+  // from the device while the other readers are active
+  REQUIRE(0 == f.open_env(UPS_ENABLE_CONCURRENT_READS | UPS_DISABLE_MMAP,
+                          params));
+  REQUIRE(0 == ups_env_open_db(f.env, &db1, 1, 0, 0));
+  REQUIRE(0 == ups_env_open_db(f.env, &db2, 2, 0, 0));
+
+  boost::atomic<int> failures(0);
+  std::vector<boost::thread *> threads;
+  for (int i = 0; i < 4; i++)
+    threads.push_back(new boost::thread(ConcurrentReader(f.env, db1, db2,
+                                &failures)));
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  REQUIRE(failures == 0);
+  REQUIRE(0 == ups_db_check_integrity(db1, 0));
+  REQUIRE(0 == ups_db_check_integrity(db2, 0));
+}
+
+struct ConcurrentWriter {
+  ConcurrentWriter(ups_db_t *db_, uint32_t id_, uint32_t num_threads_,
+                  boost::atomic<int> *failures_)
+    : db(db_), id(id_), num_threads(num_threads_), failures(failures_) {
+  }
+
+  void operator()() {
+    // the keys of all threads are interleaved, and most of them are
+    // inserted in the same leaf as the keys of the other threads
+    for (uint32_t i = 0; i < 2000; i++) {
+      uint32_t k = i * num_threads + id;
+      uint64_t r = k;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t record = ups_make_record(&r, sizeof(r));
+      if (ups_db_insert(db, 0, &key, &record, 0) != 0)
+        (*failures)++;
+    }
+  }
+
+  ups_db_t *db;
+  uint32_t id;
+  uint32_t num_threads;
+  boost::atomic<int> *failures;
+};
+
+TEST_CASE("Env/concurrentInsertsTest", "")
+{
+  ups_parameter_t params[] = {
+    {UPS_PARAM_CACHE_SIZE, 64 * 1024},
+    {0, 0}
+  };
+  ups_parameter_t db_params[] = {
+    {UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32},
+    {0, 0}
+  };
+
+  BaseFixture f;
+  REQUIRE(0 == f.create_env(UPS_ENABLE_CONCURRENT_READS, params));
+
+  ups_db_t *db;
+  REQUIRE(0 == ups_env_create_db(f.env, &db, 1, 0, db_params));
+
+  // four writers insert into the same database; leaves which are full
+  // are split by the thread which upgrades its lock
+  const uint32_t kThreads = 4;
+  boost::atomic<int> failures(0);
+  std::vector<boost::thread *> threads;
+  for (uint32_t i = 0; i < kThreads; i++)
+    threads.push_back(new boost::thread(ConcurrentWriter(db, i, kThreads,
+                                &failures)));
+
+  // ups_db_count() runs concurrently to the writers; the number of keys
+  // never decreases
+  uint64_t previous = 0;
+  for (int i = 0; i < 50; i++) {
+    uint64_t keys;
+    REQUIRE(0 == ups_db_count(db, 0, 0, &keys));
+    REQUIRE(keys >= previous);
+    REQUIRE(keys <= 2000 * kThreads);
+    previous = keys;
+  }
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  REQUIRE(failures == 0);
+  REQUIRE(0 == ups_db_check_integrity(db, 0));
+
+  uint64_t count;
+  REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+  REQUIRE(count == 2000 * kThreads);
+  for (uint32_t i = 0; i < 2000 * kThreads; i++) {
+    ups_key_t key = ups_make_key(&i, sizeof(i));
+    ups_record_t record = {0};
+    REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+    REQUIRE(record.size == sizeof(uint64_t));
+    REQUIRE(*(uint64_t *)record.data == i);
+  }
+}
+
+struct ConcurrentCursorReader {
+  ConcurrentCursorReader(ups_db_t *db_, uint32_t modulo_,
+                  boost::atomic<int> *failures_)
+    : db(db_), modulo(modulo_), failures(failures_) {
+  }
+
+  // Iterates over the database while the writers insert new keys; the
+  // keys are sorted, and all keys which existed before are found
+  void operator()() {
+    for (int loop = 0; loop < 10; loop++) {
+      ups_cursor_t *cursor;
+      if (ups_cursor_create(&cursor, db, 0, 0) != 0) {
+        (*failures)++;
+        return;
+      }
+
+      ups_key_t key = {0};
+      ups_record_t record = {0};
+      uint32_t count = 0;
+      bool is_first = true;
+      uint32_t previous = 0;
+      while (ups_cursor_move(cursor, &key, &record, UPS_CURSOR_NEXT) == 0) {
+        uint32_t k = *(uint32_t *)key.data;
+        if (!is_first && k <= previous)
+          (*failures)++;
+        if (k % modulo == modulo - 1)
+          count++;
+        previous = k;
+        is_first = false;
+      }
+      if (count != 2000)
+        (*failures)++;
+
+      count = 0;
+      is_first = true;
+      ups_status_t st = ups_cursor_move(cursor, &key, &record,
+                      UPS_CURSOR_LAST);
+      while (st == 0) {
+        uint32_t k = *(uint32_t *)key.data;
+        if (!is_first && k >= previous)
+          (*failures)++;
+        if (k % modulo == modulo - 1)
+          count++;
+        previous = k;
+        is_first = false;
+        st = ups_cursor_move(cursor, &key, &record, UPS_CURSOR_PREVIOUS);
+      }
+      if (count != 2000)
+        (*failures)++;
+
+      if (ups_cursor_close(cursor) != 0)
+        (*failures)++;
+    }
+  }
+
+  ups_db_t *db;
+  uint32_t modulo;
+  boost::atomic<int> *failures;
+};
+
+TEST_CASE("Env/concurrentInsertsAndCursorsTest", "")
+{
+  ups_parameter_t params[] = {
+    {UPS_PARAM_CACHE_SIZE, 64 * 1024},
+    {0, 0}
+  };
+  ups_parameter_t db_params[] = {
+    {UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32},
+    {0, 0}
+  };
+
+  BaseFixture f;
+  REQUIRE(0 == f.create_env(UPS_ENABLE_CONCURRENT_READS, params));
+
+  ups_db_t *db;
+  REQUIRE(0 == ups_env_create_db(f.env, &db, 1, 0, db_params));
+
+  // the writers use the ids 0 to kThreads - 1; the keys of the last id
+  // exist before the cursors start
+  const uint32_t kThreads = 4;
+  for (uint32_t i = 0; i < 2000; i++) {
+    uint32_t k = i * (kThreads + 1) + kThreads;
+    uint64_t r = k;
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    ups_record_t record = ups_make_record(&r, sizeof(r));
+    REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+  }
+
+  // the writers modify the leaves which the cursors are coupled to
+  boost::atomic<int> failures(0);
+  std::vector<boost::thread *> threads;
+  for (uint32_t i = 0; i < kThreads; i++)
+    threads.push_back(new boost::thread(ConcurrentWriter(db, i, kThreads + 1,
+                                &failures)));
+  for (uint32_t i = 0; i < 2; i++)
+    threads.push_back(new boost::thread(ConcurrentCursorReader(db,
+                                kThreads + 1, &failures)));
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  REQUIRE(failures == 0);
+  REQUIRE(0 == ups_db_check_integrity(db, 0));
+
+  uint64_t count;
+  REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+  REQUIRE(count == 2000 * (kThreads + 1));
+}
@@ -18,6 +18,10 @@
 
 #include "3rdparty/catch/catch.hpp"
 
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
 #include "2lsn_manager/lsn_manager.h"
 #include "3journal/journal.h"
 #include "4txn/txn_local.h"
@@ -127,9 +131,11 @@ struct JournalProxy {
       if (e.lsn == 0)
         continue;
 
-      // skip Changesets
-      while (entry.type == Journal::kEntryTypeChangeset && entry.lsn > 0) {
-        if (!starting)
+      // skip Changesets and Checkpoints; Checkpoints do not consume an lsn
+      while ((entry.type == Journal::kEntryTypeChangeset
+                || entry.type == Journal::kEntryTypeCheckpoint)
+              && entry.lsn > 0) {
+        if (!starting && entry.type == Journal::kEntryTypeChangeset)
           adjust++;
         journal->test_read_entry(&iter, &entry, &auxbuffer);
       }
@@ -1062,9 +1068,492 @@ struct JournalFixture : BaseFixture {
     // close the environment
     close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
 
-    // verify the journal file sizes
-    require_file_size("test.db.jrn0", 33664);
-    require_file_size("test.db.jrn1", 51168);
+    // verify the journal file sizes (each file starts with a checkpoint)
+    require_file_size("test.db.jrn0", 33696);
+    require_file_size("test.db.jrn1", 51200);
+  }
+
+  void emptyChangesetTest() {
+    DbProxy dbp(db);
+    std::vector<uint8_t> rvec = {'a', 'a', 'a', 'a'};
+    for (uint32_t i = 0; i < 10; i++)
+      dbp.require_insert(i, rvec);
+    uint64_t lsn = current_lsn();
+    close(UPS_AUTO_CLEANUP);
+
+    // append a changeset without pages to the journal
+    PJournalEntry entry;
+    entry.lsn = lsn + 1;
+    entry.type = Journal::kEntryTypeChangeset;
+    entry.followup_size = sizeof(PJournalEntryChangeset);
+    PJournalEntryChangeset changeset;
+    File f;
+    f.open("test.db.jrn0", false);
+    uint64_t offset = f.file_size();
+    f.pwrite(offset, &entry, sizeof(entry));
+    f.pwrite(offset + sizeof(entry), &changeset, sizeof(changeset));
+    f.close();
+
+    // recovery has no pages to restore
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+    for (uint32_t i = 0; i < 10; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t record = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+      REQUIRE(record.size == rvec.size());
+    }
+  }
+
+  void syncCommitTest() {
+    ups_env_metrics_t metrics;
+    Journal *j = lenv()->journal.get();
+
+    // every commit requires its own sync
+    for (uint32_t i = 0; i < 3; i++) {
+      ups_txn_t *txn;
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+
+      REQUIRE(j->state.unsynced_commit_lsn == 0);
+      REQUIRE(j->state.synced_lsn == j->state.written_lsn);
+      REQUIRE(j->state.unsynced_files == 0);
+      REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+      REQUIRE(metrics.journal_commit_syncs == i + 1);
+    }
+
+    // waiting for a commit which is already durable does not sync again
+    j->sync(j->state.synced_lsn);
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.journal_commit_syncs == 3);
+  }
+
+  uint64_t commit(uint32_t key, uint32_t flags) {
+    ups_txn_t *txn;
+    ups_key_t k = ups_make_key(&key, sizeof(key));
+    ups_record_t rec = {0};
+    REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+    REQUIRE(0 == ups_db_insert(db, txn, &k, &rec, 0));
+    REQUIRE(0 == ups_txn_commit(txn, flags));
+    return lenv()->journal->state.written_lsn;
+  }
+
+  uint64_t synced_lsn() {
+    Journal *j = lenv()->journal.get();
+    ScopedLock lock(j->state.sync_mutex);
+    return j->state.synced_lsn;
+  }
+
+  void commitDurabilityTest(uint32_t env_flags) {
+    ups_parameter_t params[] = {
+        { UPS_PARAM_JOURNAL_SYNC_INTERVAL, 20 },
+        { 0, 0 }
+    };
+    close();
+    require_create(env_flags | UPS_ENABLE_TRANSACTIONS, params);
+    require_parameter(UPS_PARAM_JOURNAL_SYNC_INTERVAL, 20);
+
+    Journal *j = lenv()->journal.get();
+    ups_env_metrics_t metrics;
+
+    // the commit is not synced
+    uint64_t lsn = commit(1, UPS_TXN_COMMIT_NOSYNC);
+    REQUIRE(synced_lsn() < lsn);
+
+    // the commit is synced before the function returns; this also syncs
+    // the previous commit
+    lsn = commit(2, UPS_TXN_COMMIT_SYNC);
+    REQUIRE(synced_lsn() == lsn);
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.journal_commit_syncs == 1);
+
+    // the default depends on UPS_ENABLE_FSYNC
+    lsn = commit(3, 0);
+    if (ISSET(env_flags, UPS_ENABLE_FSYNC))
+      REQUIRE(synced_lsn() == lsn);
+    else
+      REQUIRE(synced_lsn() < lsn);
+
+    // the commit is synced by the background thread
+    lsn = commit(4, UPS_TXN_COMMIT_DEFERRED);
+    REQUIRE(j->state.syncer.get() != 0);
+    for (int i = 0; i < 500 && synced_lsn() < lsn; i++)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    REQUIRE(synced_lsn() == lsn);
+
+    // only one of the durability flags can be specified
+    ups_txn_t *txn;
+    REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+    REQUIRE(UPS_INV_PARAMETER == ups_txn_commit(txn,
+                UPS_TXN_COMMIT_SYNC | UPS_TXN_COMMIT_NOSYNC));
+    REQUIRE(UPS_INV_PARAMETER == ups_txn_commit(txn,
+                UPS_TXN_COMMIT_SYNC | UPS_TXN_COMMIT_DEFERRED));
+    REQUIRE(0 == ups_txn_commit(txn, UPS_TXN_COMMIT_SYNC));
+  }
+
+  // The Environment is closed before the background thread synced the
+  // deferred commits; they are synced by ups_env_close
+  void closeWithDeferredCommitTest() {
+    ups_parameter_t params[] = {
+        { UPS_PARAM_JOURNAL_SYNC_INTERVAL, 1000000 },
+        { 0, 0 }
+    };
+    close();
+    require_create(UPS_ENABLE_TRANSACTIONS, params);
+
+    for (uint32_t i = 0; i < 10; i++) {
+      uint64_t lsn = commit(i, UPS_TXN_COMMIT_DEFERRED);
+      REQUIRE(synced_lsn() < lsn);
+    }
+
+    close();
+    require_open(UPS_ENABLE_TRANSACTIONS);
+    for (uint32_t i = 0; i < 10; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+    }
+  }
+
+  // Inserts keys in many small Transactions; each commit flushes a
+  // changeset. Then the journal is used to recover a copy of the database
+  // file. If |restore_old_file| is true then the copy was made before the
+  // keys were inserted, and all pages are restored from the journal.
+  // Returns the number of bytes written to the journal
+  uint64_t deltaChangesetTest(uint32_t flags, uint32_t threshold,
+                  bool restore_old_file) {
+    ups_parameter_t env_params[] = {
+        { UPS_PARAM_JOURNAL_SWITCH_THRESHOLD, threshold },
+        { 0, 0 }
+    };
+    ups_parameter_t db_params[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { 0, 0 }
+    };
+    const uint32_t kMax = 300;
+
+    close();
+    flags |= UPS_ENABLE_TRANSACTIONS | UPS_FLUSH_TRANSACTIONS_IMMEDIATELY;
+    require_create(flags, env_params, 0, db_params);
+    if (restore_old_file)
+      REQUIRE(true == os::copy("test.db", "test.db.bak"));
+
+    for (uint32_t i = 0; i < kMax; i++) {
+      ups_txn_t *txn;
+      uint32_t k = (i * 37) % kMax;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    }
+
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    if (ISSET(flags, UPS_ENABLE_DELTA_JOURNAL))
+      REQUIRE(metrics.journal_delta_bytes_saved > 0);
+    else
+      REQUIRE(metrics.journal_delta_bytes_saved == 0);
+
+    // wait till the database file was written, then save the journal
+    lenv()->page_manager->flush_all_pages();
+    if (restore_old_file) {
+      REQUIRE(true == os::copy("test.db.jrn0", "test.db.bak0"));
+      REQUIRE(true == os::copy("test.db.jrn1", "test.db.bak1"));
+    }
+    else
+      backup();
+    close(UPS_AUTO_CLEANUP);
+    restore();
+
+    // recover, then verify that the database is complete
+    require_open(flags | UPS_AUTO_RECOVERY);
+    for (uint32_t i = 0; i < kMax; i++) {
+      uint32_t k = (i * 37) % kMax;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(rec.size == sizeof(i));
+      REQUIRE(*(uint32_t *)rec.data == i);
+    }
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    return metrics.journal_bytes_flushed;
+  }
+
+  void deltaChangesetTest() {
+    // restore all pages from the journal
+    uint64_t full_bytes = deltaChangesetTest(0, 1000, true);
+    uint64_t delta_bytes = deltaChangesetTest(UPS_ENABLE_DELTA_JOURNAL,
+                    1000, true);
+    REQUIRE(delta_bytes * 4 < full_bytes);
+
+    // the files are switched frequently; each switch logs full pages
+    deltaChangesetTest(UPS_ENABLE_DELTA_JOURNAL, 3, false);
+  }
+
+  // Inserts keys in random order, then erases every other key; each
+  // operation runs in its own Transaction. With UPS_ENABLE_DELTA_JOURNAL,
+  // the leaves are logged with logical redo records if the records are
+  // stored in the leaf (|record_size| <= 8). Recovers a copy of the old
+  // database file, and returns the number of bytes written to the journal
+  uint64_t leafRedoTest(uint32_t flags, uint64_t key_type,
+                  uint32_t record_size) {
+    // the files must not be switched, otherwise the copy of the old
+    // database file cannot be recovered
+    ups_parameter_t env_params[] = {
+        { UPS_PARAM_JOURNAL_SWITCH_THRESHOLD, 10000 },
+        { 0, 0 }
+    };
+    ups_parameter_t db_params[] = {
+        { UPS_PARAM_KEY_TYPE, key_type },
+        { 0, 0 }
+    };
+    const uint32_t kMax = 2000;
+    std::vector<uint8_t> data(record_size);
+
+    close();
+    flags |= UPS_ENABLE_TRANSACTIONS | UPS_FLUSH_TRANSACTIONS_IMMEDIATELY;
+    require_create(flags, env_params, 0, db_params);
+    REQUIRE(true == os::copy("test.db", "test.db.bak"));
+
+    for (uint32_t i = 0; i < kMax * 2; i++) {
+      uint32_t k = ((i % kMax) * 7919) % kMax;
+      char buffer[16];
+      ::snprintf(buffer, sizeof(buffer), "%08u", k);
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      if (key_type == UPS_TYPE_BINARY) {
+        key.data = buffer;
+        key.size = 8;
+      }
+      ::memset(data.data(), (int)k, data.size());
+      ups_record_t rec = ups_make_record(data.data(), record_size);
+      ups_txn_t *txn;
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      // the second pass erases every other key
+      if (i < kMax)
+        REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      else if (k % 2 == 0)
+        REQUIRE(0 == ups_db_erase(db, txn, &key, 0));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    }
+
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+
+    lenv()->page_manager->flush_all_pages();
+    REQUIRE(true == os::copy("test.db.jrn0", "test.db.bak0"));
+    REQUIRE(true == os::copy("test.db.jrn1", "test.db.bak1"));
+    close(UPS_AUTO_CLEANUP);
+    restore();
+
+    // recover, then verify that the database is complete
+    require_open(flags | UPS_AUTO_RECOVERY);
+    for (uint32_t k = 0; k < kMax; k++) {
+      char buffer[16];
+      ::snprintf(buffer, sizeof(buffer), "%08u", k);
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      if (key_type == UPS_TYPE_BINARY) {
+        key.data = buffer;
+        key.size = 8;
+      }
+      ups_record_t rec = {0};
+      if (k % 2 == 0) {
+        REQUIRE(UPS_KEY_NOT_FOUND == ups_db_find(db, 0, &key, &rec, 0));
+        continue;
+      }
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(rec.size == record_size);
+      ::memset(data.data(), (int)k, data.size());
+      REQUIRE(0 == ::memcmp(rec.data, data.data(), record_size));
+    }
+    uint64_t count;
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == kMax / 2);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+      return metrics.journal_bytes_flushed;
+  }
+
+  void leafRedoTest() {
+    uint64_t full_bytes = leafRedoTest(0, UPS_TYPE_UINT32, 4);
+    uint64_t redo_bytes = leafRedoTest(UPS_ENABLE_DELTA_JOURNAL,
+                    UPS_TYPE_UINT32, 4);
+    REQUIRE(redo_bytes * 10 < full_bytes);
+
+    // variable length keys
+    full_bytes = leafRedoTest(0, UPS_TYPE_BINARY, 8);
+    redo_bytes = leafRedoTest(UPS_ENABLE_DELTA_JOURNAL, UPS_TYPE_BINARY, 8);
+    REQUIRE(redo_bytes * 10 < full_bytes);
+
+    // the records are stored in blobs; the leaves are logged as byte ranges
+    leafRedoTest(UPS_ENABLE_DELTA_JOURNAL, UPS_TYPE_UINT32, 64);
+  }
+
+  // Recovers a large database from an empty file; the changesets are
+  // restored by several threads
+  void parallelRecoveryTest(int compressor) {
+    ups_parameter_t env_params[] = {
+        { UPS_PARAM_PAGE_SIZE, 1024 },
+        { UPS_PARAM_JOURNAL_SWITCH_THRESHOLD, 1000 },
+        { compressor ? UPS_PARAM_JOURNAL_COMPRESSION : 0,
+              (uint64_t)compressor },
+        { 0, 0 }
+    };
+    ups_parameter_t db_params[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { 0, 0 }
+    };
+    const uint32_t kMax = 20000;
+    const uint32_t kPerTxn = 100;
+    uint32_t flags = UPS_ENABLE_TRANSACTIONS
+                      | UPS_FLUSH_TRANSACTIONS_IMMEDIATELY;
+
+    close();
+    require_create(flags, env_params, 0, db_params);
+    REQUIRE(true == os::copy("test.db", "test.db.bak"));
+
+    for (uint32_t i = 0; i < kMax; i += kPerTxn) {
+      ups_txn_t *txn;
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      for (uint32_t j = i; j < i + kPerTxn; j++) {
+        uint32_t k = (j * 7919) % kMax;
+        ups_key_t key = ups_make_key(&k, sizeof(k));
+        ups_record_t rec = ups_make_record(&j, sizeof(j));
+        REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      }
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    }
+
+    lenv()->page_manager->flush_all_pages();
+    REQUIRE(true == os::copy("test.db.jrn0", "test.db.bak0"));
+    REQUIRE(true == os::copy("test.db.jrn1", "test.db.bak1"));
+    close(UPS_AUTO_CLEANUP);
+    restore();
+
+    require_open(flags | UPS_AUTO_RECOVERY);
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.journal_recovered_pages > 128);
+    REQUIRE(metrics.journal_recovered_bytes > metrics.journal_recovered_pages
+                    * 1024 / 10);
+
+    for (uint32_t j = 0; j < kMax; j++) {
+      uint32_t k = (j * 7919) % kMax;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(rec.size == sizeof(j));
+      REQUIRE(*(uint32_t *)rec.data == j);
+    }
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+  }
+
+  void parallelRecoveryTest() {
+    parallelRecoveryTest(0);
+    parallelRecoveryTest(UPS_COMPRESSOR_LZF);
+  }
+
+  void checkpointIntervalTest(uint32_t flags) {
+    ups_parameter_t env_params[] = {
+        { UPS_PARAM_CHECKPOINT_INTERVAL, 16 * 1024 },
+        { UPS_PARAM_CHECKPOINT_INTERVAL_MS, 1000 * 1000 },
+        { UPS_PARAM_JOURNAL_SWITCH_THRESHOLD, 1000000 },
+        { 0, 0 }
+    };
+    ups_parameter_t db_params[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { 0, 0 }
+    };
+    const uint32_t kMax = 5000;
+
+    close();
+    require_create(flags, env_params, 0, db_params);
+    require_parameter(UPS_PARAM_CHECKPOINT_INTERVAL, 16 * 1024);
+    require_parameter(UPS_PARAM_CHECKPOINT_INTERVAL_MS, 1000 * 1000);
+
+    std::vector<uint8_t> record(64);
+    for (uint32_t i = 0; i < kMax; i++) {
+      ups_txn_t *txn;
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(record.data(),
+                      (uint32_t)record.size());
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    }
+
+    // the journal did not grow without bounds, although the switch
+    // threshold was never reached; committed Txns are merged if they
+    // block a checkpoint
+    Journal *j = lenv()->journal.get();
+    REQUIRE(j->state.count_checkpoints > 0);
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.journal_checkpoints == j->state.count_checkpoints);
+    REQUIRE(j->state.files[0].file_size() < 128 * 1024);
+    REQUIRE(j->state.files[1].file_size() < 128 * 1024);
+
+    // the remaining journal is sufficient for recovery
+    close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
+    require_open(flags | UPS_AUTO_RECOVERY, env_params);
+    for (uint32_t i = 0; i < kMax; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(rec.size == record.size());
+    }
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+  }
+
+  void checkpointWithUnflushedTxnsTest() {
+    ups_parameter_t env_params[] = {
+        { UPS_PARAM_JOURNAL_SWITCH_THRESHOLD, 1 },
+        { 0, 0 }
+    };
+    uint32_t flags = UPS_ENABLE_TRANSACTIONS | UPS_DONT_FLUSH_TRANSACTIONS;
+
+    close();
+    require_create(flags, env_params, 0, 0);
+
+    Journal *j = lenv()->journal.get();
+    std::vector<uint8_t> record;
+    for (uint32_t i = 0; i < 10; i++) {
+      TxnProxy tp(env);
+      DbProxy dbp(db);
+      dbp.require_insert(tp.txn, i, record);
+      tp.commit();
+    }
+
+    // the committed Txns were not yet merged; the file with the oldest
+    // of them must not be cleared
+    REQUIRE(j->state.count_checkpoints == 1);
+
+    REQUIRE(0 == ups_env_flush(env, UPS_FLUSH_COMMITTED_TRANSACTIONS));
+
+    // wait till the pages of the first checkpoint were written
+    while (true) {
+      {
+        ScopedLock lock(j->state.sync_mutex);
+        if (!j->state.checkpoint_pending[0])
+          break;
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    for (uint32_t i = 10; i < 13; i++) {
+      TxnProxy tp(env);
+      DbProxy dbp(db);
+      dbp.require_insert(tp.txn, i, record);
+      tp.commit();
+    }
+    REQUIRE(j->state.count_checkpoints > 1);
+
+    close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
+    require_open(flags | UPS_AUTO_RECOVERY);
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < 13; i++)
+      dbp.require_find(i, record);
   }
 
   void recoverWithCrc32Test() {
@@ -1271,11 +1760,143 @@ TEST_CASE("Journal/issue71Test", "")
   f.issue71Test();
 }
 
+TEST_CASE("Journal/emptyChangesetTest", "")
+{
+  JournalFixture f;
+  f.emptyChangesetTest();
+}
+
 TEST_CASE("Journal/recoverWithCrc32Test", "")
 {
   JournalFixture f;
   f.recoverWithCrc32Test();
 }
 
+TEST_CASE("Journal/parallelRecoveryTest", "")
+{
+  JournalFixture f;
+  f.parallelRecoveryTest();
+}
+
+TEST_CASE("Journal/checkpointIntervalTest", "")
+{
+  JournalFixture f;
+  f.checkpointIntervalTest(UPS_ENABLE_TRANSACTIONS
+                  | UPS_FLUSH_TRANSACTIONS_IMMEDIATELY);
+}
+
+TEST_CASE("Journal/checkpointIntervalDontFlushTest", "")
+{
+  JournalFixture f;
+  f.checkpointIntervalTest(UPS_ENABLE_TRANSACTIONS
+                  | UPS_DONT_FLUSH_TRANSACTIONS);
+}
+
+TEST_CASE("Journal/checkpointWithUnflushedTxnsTest", "")
+{
+  JournalFixture f;
+  f.checkpointWithUnflushedTxnsTest();
+}
+
+TEST_CASE("Journal/deltaChangesetTest", "")
+{
+  JournalFixture f;
+  f.deltaChangesetTest();
+}
+
+TEST_CASE("Journal/leafRedoTest", "")
+{
+  JournalFixture f;
+  f.leafRedoTest();
+}
+
+TEST_CASE("Journal/syncCommitTest", "")
+{
+  JournalFixture f(UPS_ENABLE_FSYNC);
+  f.syncCommitTest();
+}
+
+TEST_CASE("Journal/commitDurabilityTest", "")
+{
+  JournalFixture f;
+  f.commitDurabilityTest(0);
+}
+
+TEST_CASE("Journal/commitDurabilityFsyncTest", "")
+{
+  JournalFixture f;
+  f.commitDurabilityTest(UPS_ENABLE_FSYNC);
+}
+
+TEST_CASE("Journal/closeWithDeferredCommitTest", "")
+{
+  JournalFixture f;
+  f.closeWithDeferredCommitTest();
+}
+
+struct ConcurrentCommitter {
+  ConcurrentCommitter(ups_env_t *env_, ups_db_t *db_, uint32_t id_,
+                  boost::atomic<int> *failures_)
+    : env(env_), db(db_), id(id_), failures(failures_) {
+  }
+
+  void operator()() {
+    for (uint32_t i = 0; i < 200; i++) {
+      uint32_t k = id * 1000 + i;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t record = ups_make_record(&k, sizeof(k));
+      ups_txn_t *txn;
+      if (ups_txn_begin(&txn, env, 0, 0, 0) != 0
+            || ups_db_insert(db, txn, &key, &record, 0) != 0
+            || ups_txn_commit(txn, 0) != 0)
+        (*failures)++;
+    }
+  }
+
+  ups_env_t *env;
+  ups_db_t *db;
+  uint32_t id;
+  boost::atomic<int> *failures;
+};
+
+// Several threads commit concurrently; all commits are durable, but
+// they can share a sync
+TEST_CASE("Journal/groupCommitTest", "")
+{
+  JournalFixture f(UPS_ENABLE_FSYNC);
+
+  const uint32_t kThreads = 4;
+  boost::atomic<int> failures(0);
+  std::vector<boost::thread *> threads;
+  for (uint32_t i = 0; i < kThreads; i++)
+    threads.push_back(new boost::thread(ConcurrentCommitter(f.env, f.db, i,
+                                &failures)));
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  REQUIRE(failures == 0);
+
+  Journal *j = f.lenv()->journal.get();
+  REQUIRE(j->state.synced_lsn == j->state.written_lsn);
+  REQUIRE(j->state.is_syncing == false);
+
+  ups_env_metrics_t metrics;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &metrics));
+  REQUIRE(metrics.journal_commit_syncs > 0);
+  REQUIRE(metrics.journal_commit_syncs <= 200 * kThreads);
+
+  for (uint32_t t = 0; t < kThreads; t++) {
+    for (uint32_t i = 0; i < 200; i++) {
+      uint32_t k = t * 1000 + i;
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t record = {0};
+      REQUIRE(0 == ups_db_find(f.db, 0, &key, &record, 0));
+      REQUIRE(*(uint32_t *)record.data == k);
+    }
+  }
+}
+
 } // namespace upscaledb
 
@@ -20,6 +20,7 @@
 
 #include "3rdparty/catch/catch.hpp"
 
+#include "1mem/mem.h"
 #include "1os/file.h"
 
 #include "os.hpp"
@@ -355,3 +356,95 @@ TEST_CASE("Os/largefile")
     .require_tell(1024 * 1024 * 4);
 }
 
+
+TEST_CASE("Os/directIo")
+{
+  FileProxy fp;
+  fp.require_create("test.db", 0664);
+  if (!fp.f.enable_direct_io())
+    return; // not supported by the file system
+  REQUIRE(fp.f.is_direct_io());
+
+  // unaligned writes are emulated; the file size is not rounded up
+  char buffer[128], orig[128];
+  for (uint32_t i = 0; i < 100; i++) {
+    ::memset(buffer, i, sizeof(buffer));
+    fp.require_pwrite(i * sizeof(buffer) + 3, buffer, sizeof(buffer))
+      .require_size(i * sizeof(buffer) + 3 + sizeof(buffer));
+  }
+  for (uint32_t i = 0; i < 100; i++) {
+    ::memset(orig, i, sizeof(orig));
+    fp.require_pread(i * sizeof(buffer) + 3, buffer, sizeof(buffer));
+    REQUIRE(0 == ::memcmp(buffer, orig, sizeof(buffer)));
+  }
+
+  // aligned I/O bypasses the bounce buffer
+  uint8_t *page = Memory::allocate_aligned<uint8_t>(File::kDirectIoAlignment,
+                          File::kDirectIoAlignment);
+  ::memset(page, 0x13, File::kDirectIoAlignment);
+  fp.require_truncate(File::kDirectIoAlignment)
+    .require_pwrite(File::kDirectIoAlignment, page, File::kDirectIoAlignment)
+    .require_size(2 * File::kDirectIoAlignment);
+  ::memset(page, 0, File::kDirectIoAlignment);
+  fp.require_pread(File::kDirectIoAlignment, page, File::kDirectIoAlignment);
+  for (size_t i = 0; i < File::kDirectIoAlignment; i++)
+    REQUIRE(page[i] == 0x13);
+  Memory::release_aligned(page);
+
+  // sequential writes (as used by the journal) append to the file
+  fp.require_seek(0, File::kSeekEnd);
+  for (uint32_t i = 0; i < 10; i++) {
+    ::memset(buffer, i, sizeof(buffer));
+    fp.f.write(buffer, sizeof(buffer));
+  }
+  fp.require_tell(2 * File::kDirectIoAlignment + 10 * sizeof(buffer))
+    .require_size(2 * File::kDirectIoAlignment + 10 * sizeof(buffer));
+  fp.require_pread(2 * File::kDirectIoAlignment + 9 * sizeof(buffer),
+                  buffer, sizeof(buffer));
+  ::memset(orig, 9, sizeof(orig));
+  REQUIRE(0 == ::memcmp(buffer, orig, sizeof(buffer)));
+}
+
+// Appends aligned pages while another thread performs unaligned writes at
+// the beginning of the file; the unaligned writes must not truncate the
+// appended pages
+static void
+append_aligned_pages(File *file, int count)
+{
+  uint8_t *page = Memory::allocate_aligned<uint8_t>(File::kDirectIoAlignment,
+                          File::kDirectIoAlignment);
+  for (int i = 0; i < count; i++) {
+    ::memset(page, i + 1, File::kDirectIoAlignment);
+    file->pwrite((i + 1) * File::kDirectIoAlignment, page,
+                    File::kDirectIoAlignment);
+  }
+  Memory::release_aligned(page);
+}
+
+TEST_CASE("Os/directIoConcurrentWrites")
+{
+  const int kCount = 200;
+  FileProxy fp;
+  fp.require_create("test.db", 0664);
+  if (!fp.f.enable_direct_io())
+    return; // not supported by the file system
+
+  boost::thread th(append_aligned_pages, &fp.f, kCount);
+  char buffer[100];
+  for (int i = 0; i < 2000; i++) {
+    ::memset(buffer, i, sizeof(buffer));
+    fp.require_pwrite(3, buffer, sizeof(buffer));
+  }
+  th.join();
+
+  fp.require_size((kCount + 1) * File::kDirectIoAlignment);
+  uint8_t *page = Memory::allocate_aligned<uint8_t>(File::kDirectIoAlignment,
+                          File::kDirectIoAlignment);
+  for (int i = 0; i < kCount; i++) {
+    fp.require_pread((i + 1) * File::kDirectIoAlignment, page,
+                    File::kDirectIoAlignment);
+    REQUIRE(page[0] == (uint8_t)(i + 1));
+    REQUIRE(page[File::kDirectIoAlignment - 1] == (uint8_t)(i + 1));
+  }
+  Memory::release_aligned(page);
+}
@@ -226,6 +226,60 @@ struct PageManagerFixture : BaseFixture {
     REQUIRE(false == page_manager->state->cache.is_cache_full());
   }
 
+  void cacheScanResistanceTest() {
+    PageManager *page_manager = lenv()->page_manager.get();
+    Cache &cache = page_manager->state->cache;
+
+    PPageData pers;
+    ::memset(&pers, 0, sizeof(pers));
+    std::vector<Page *> hot;
+    std::vector<Page *> scan;
+
+    // the working set is accessed more than once
+    for (unsigned int i = 0; i < 8; i++) {
+      Page *p = new Page(lenv()->device.get());
+      p->set_without_header(true);
+      p->assign_allocated_buffer(&pers, i + 1);
+      hot.push_back(p);
+      cache.put(p);
+      REQUIRE(p == cache.get(i + 1));
+    }
+
+    // a "full table scan" accesses each page only once
+    for (unsigned int i = 0; i < 16; i++) {
+      Page *p = new Page(lenv()->device.get());
+      p->set_without_header(true);
+      p->assign_allocated_buffer(&pers, i + 100);
+      scan.push_back(p);
+      cache.put(p);
+    }
+    REQUIRE(true == cache.is_cache_full());
+
+    std::vector<uint64_t> candidates;
+    std::vector<Page *> garbage;
+    cache.purge_candidates(candidates, garbage, 0);
+    REQUIRE(garbage.size() > 0);
+    for (size_t i = 0; i < hot.size(); i++) {
+      REQUIRE(std::find(garbage.begin(), garbage.end(), hot[i])
+                      == garbage.end());
+      REQUIRE(std::find(candidates.begin(), candidates.end(),
+                      hot[i]->address()) == candidates.end());
+    }
+
+    ups_env_metrics_t metrics;
+    cache.fill_metrics(&metrics);
+    REQUIRE(metrics.cache_shards == 1u);
+    REQUIRE(metrics.cache_shard_hits[0] == metrics.cache_hits);
+    REQUIRE(metrics.cache_hits >= 8u);
+
+    hot.insert(hot.end(), scan.begin(), scan.end());
+    for (size_t i = 0; i < hot.size(); i++) {
+      cache.del(hot[i]);
+      hot[i]->set_data(0);
+      delete hot[i];
+    }
+  }
+
   void storeStateTest() {
     PageManagerState *state = lenv()->page_manager->state.get();
     uint32_t page_size = lenv()->config.page_size_bytes;
@@ -466,6 +520,19 @@ TEST_CASE("PageManager/cacheFullTest", "")
   f.cacheFullTest();
 }
 
+TEST_CASE("PageManager/cacheScanResistanceTest", "")
+{
+  PageManagerFixture f(false, 16 * UPS_DEFAULT_PAGE_SIZE);
+  f.cacheScanResistanceTest();
+}
+
+TEST_CASE("PageManager/cacheShardsTest", "")
+{
+  PageManagerFixture f(false, 1024 * UPS_DEFAULT_PAGE_SIZE);
+  REQUIRE(f.lenv()->page_manager->state->cache.state.num_shards
+                  == (size_t)UPS_MAX_CACHE_SHARDS);
+}
+
 TEST_CASE("PageManager/storeStateTest", "")
 {
   PageManagerFixture f(false, 16 * UPS_DEFAULT_PAGE_SIZE);
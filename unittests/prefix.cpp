@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "3rdparty/catch/catch.hpp"
+
+#include "3btree/btree_index_factory.h"
+
+#include "os.hpp"
+#include "fixture.hpp"
+
+namespace upscaledb {
+
+struct PrefixFixture : BaseFixture {
+  typedef std::vector<std::string> StringVector;
+
+  PrefixFixture(uint64_t compressor, bool use_duplicates = false) {
+    ups_parameter_t p[] = {
+      { UPS_PARAM_KEY_COMPRESSION, compressor },
+      { 0, 0 }
+    };
+
+    if (compressor == 0)
+      p[0].name = 0;
+
+    require_create(0, nullptr, use_duplicates ? UPS_ENABLE_DUPLICATES : 0, p);
+  }
+
+  // Creates |count| URL-like keys with long common prefixes; every
+  // |long_interval|th key is too long to be stored inline
+  static StringVector create_keys(int count, int long_interval = 0) {
+    static const char *hosts[] = {
+      "http://www.example.com/catalog/products/",
+      "http://www.example.com/catalog/services/",
+      "http://www.example.org/",
+      "https://upscaledb.com/docs/",
+    };
+
+    StringVector svec;
+    char buffer[128];
+    for (int i = 0; i < count; i++) {
+      ::snprintf(buffer, sizeof(buffer), "%s%05d/item%d.html",
+                      hosts[i % 4], i / 7, i);
+      std::string s(buffer);
+      if (long_interval && i % long_interval == 0)
+        s += std::string(300 + i % 50, 'x');
+      svec.push_back(s);
+    }
+    return svec;
+  }
+
+  void insertKeys(const StringVector &svec) {
+    for (StringVector::const_iterator it = svec.begin();
+                    it != svec.end(); it++) {
+      ups_key_t key = ups_make_key((void *)it->data(), (uint16_t)it->size());
+      ups_record_t record = ups_make_record((void *)it->data(),
+                      (uint32_t)std::min<size_t>(it->size(), 8));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+    }
+  }
+
+  void findKeys(const StringVector &svec) {
+    for (StringVector::const_iterator it = svec.begin();
+                    it != svec.end(); it++) {
+      ups_key_t key = ups_make_key((void *)it->data(), (uint16_t)it->size());
+      ups_record_t record = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+      REQUIRE(record.size == std::min<size_t>(it->size(), 8));
+      REQUIRE(0 == ::memcmp(record.data, it->data(), record.size));
+
+      // a key with an additional byte is not found
+      std::string missing = *it + "!";
+      key = ups_make_key((void *)missing.data(), (uint16_t)missing.size());
+      REQUIRE(UPS_KEY_NOT_FOUND == ups_db_find(db, 0, &key, &record, 0));
+    }
+  }
+
+  void cursorKeys(const StringVector &svec) {
+    StringVector sorted(svec);
+    std::sort(sorted.begin(), sorted.end());
+
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+    ups_cursor_t *cursor;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    for (StringVector::const_iterator it = sorted.begin();
+                    it != sorted.end(); it++) {
+      REQUIRE(0 == ups_cursor_move(cursor, &key, &record, UPS_CURSOR_NEXT));
+      REQUIRE(std::string((const char *)key.data, key.size) == *it);
+    }
+    REQUIRE(UPS_KEY_NOT_FOUND == ups_cursor_move(cursor, &key, &record,
+                            UPS_CURSOR_NEXT));
+
+    // and backwards
+    REQUIRE(0 == ups_cursor_move(cursor, &key, &record, UPS_CURSOR_LAST));
+    for (StringVector::const_reverse_iterator it = sorted.rbegin();
+                    it != sorted.rend(); it++) {
+      REQUIRE(std::string((const char *)key.data, key.size) == *it);
+      ups_status_t st = ups_cursor_move(cursor, &key, &record,
+                              UPS_CURSOR_PREVIOUS);
+      REQUIRE(st == (it + 1 == sorted.rend() ? UPS_KEY_NOT_FOUND : 0));
+    }
+    REQUIRE(0 == ups_cursor_close(cursor));
+  }
+
+  void eraseKeys(const StringVector &svec) {
+    for (StringVector::const_iterator it = svec.begin();
+                    it != svec.end(); it++) {
+      ups_key_t key = ups_make_key((void *)it->data(), (uint16_t)it->size());
+      REQUIRE(0 == ups_db_erase(db, 0, &key, 0));
+    }
+
+    for (StringVector::const_iterator it = svec.begin();
+                    it != svec.end(); it++) {
+      ups_key_t key = ups_make_key((void *)it->data(), (uint16_t)it->size());
+      ups_record_t record = {0};
+      REQUIRE(UPS_KEY_NOT_FOUND == ups_db_find(db, 0, &key, &record, 0));
+    }
+  }
+
+  void insertFindEraseFind(const StringVector &svec) {
+    insertKeys(svec);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    findKeys(svec);
+    cursorKeys(svec);
+    eraseKeys(svec);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+  }
+
+  // Inserts |svec| and returns the size of the file
+  uint64_t fileSize(const StringVector &svec) {
+    insertKeys(svec);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    return device()->file_size();
+  }
+};
+
+TEST_CASE("Prefix/randomDataTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(30000);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(svec.begin(), svec.end());
+
+  PrefixFixture f(UPS_COMPRESSOR_PREFIX);
+  f.insertFindEraseFind(svec);
+}
+
+TEST_CASE("Prefix/ascendingDataTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(30000);
+  std::sort(svec.begin(), svec.end());
+
+  PrefixFixture f(UPS_COMPRESSOR_PREFIX);
+  f.insertFindEraseFind(svec);
+}
+
+TEST_CASE("Prefix/descendingDataTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(30000);
+  std::sort(svec.begin(), svec.end());
+  std::reverse(svec.begin(), svec.end());
+
+  PrefixFixture f(UPS_COMPRESSOR_PREFIX);
+  f.insertFindEraseFind(svec);
+}
+
+TEST_CASE("Prefix/extendedKeysTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(10000, 13);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(svec.begin(), svec.end());
+
+  PrefixFixture f(UPS_COMPRESSOR_PREFIX);
+  f.insertFindEraseFind(svec);
+}
+
+TEST_CASE("Prefix/duplicatesTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(5000);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(svec.begin(), svec.end());
+
+  PrefixFixture f(UPS_COMPRESSOR_PREFIX, true);
+  for (int i = 0; i < 3; i++) {
+    for (PrefixFixture::StringVector::const_iterator it = svec.begin();
+                    it != svec.end(); it++) {
+      ups_key_t key = ups_make_key((void *)it->data(), (uint16_t)it->size());
+      ups_record_t record = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(f.db, 0, &key, &record, UPS_DUPLICATE));
+    }
+  }
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+
+  for (PrefixFixture::StringVector::const_iterator it = svec.begin();
+                  it != svec.end(); it++) {
+    ups_key_t key = ups_make_key((void *)it->data(), (uint16_t)it->size());
+    uint32_t count = 0;
+    ups_cursor_t *cursor;
+    REQUIRE(0 == ups_cursor_create(&cursor, f.db, 0, 0));
+    REQUIRE(0 == ups_cursor_find(cursor, &key, 0, 0));
+    REQUIRE(0 == ups_cursor_get_duplicate_count(cursor, &count, 0));
+    REQUIRE(count == 3);
+    REQUIRE(0 == ups_cursor_close(cursor));
+  }
+}
+
+TEST_CASE("Prefix/reopenTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(20000, 101);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(svec.begin(), svec.end());
+
+  PrefixFixture f(UPS_COMPRESSOR_PREFIX);
+  f.insertKeys(svec);
+  f.close().require_open();
+  ups_parameter_t p[] = {
+    { UPS_PARAM_KEY_COMPRESSION, 0 },
+    { 0, 0 }
+  };
+  REQUIRE(0 == ups_db_get_parameters(f.db, p));
+  REQUIRE(p[0].value == UPS_COMPRESSOR_PREFIX);
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+  f.findKeys(svec);
+  f.cursorKeys(svec);
+
+  // erase half of the keys, then insert them again
+  PrefixFixture::StringVector half(svec.begin(),
+                  svec.begin() + svec.size() / 2);
+  f.eraseKeys(half);
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+  f.insertKeys(half);
+  REQUIRE(0 == ups_db_check_integrity(f.db, 0));
+  f.findKeys(svec);
+  f.cursorKeys(svec);
+}
+
+// Compressed pages hold more keys than uncompressed pages
+TEST_CASE("Prefix/pageCountTest", "")
+{
+  PrefixFixture::StringVector svec = PrefixFixture::create_keys(50000);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(svec.begin(), svec.end());
+
+  uint64_t compressed_size;
+  {
+    PrefixFixture f(UPS_COMPRESSOR_PREFIX);
+    compressed_size = f.fileSize(svec);
+  }
+
+  PrefixFixture f(0);
+  REQUIRE(f.fileSize(svec) > compressed_size * 3 / 2);
+}
+
+TEST_CASE("Prefix/invalidKeyTypeTest", "")
+{
+  ups_parameter_t p1[] = {
+    { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+    { UPS_PARAM_KEY_COMPRESSION, UPS_COMPRESSOR_PREFIX },
+    { 0, 0 }
+  };
+  ups_parameter_t p2[] = {
+    { UPS_PARAM_KEY_SIZE, 16 },
+    { UPS_PARAM_KEY_COMPRESSION, UPS_COMPRESSOR_PREFIX },
+    { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(0, 0, 0, p1, UPS_INV_PARAMETER)
+   .require_create(0, 0, 0, p2, UPS_INV_PARAMETER);
+}
+
+} // namespace upscaledb
@@ -16,12 +16,12 @@
  * See the file COPYING for License information.
  */
 
-#ifdef __SSE__
-
 #include "3rdparty/catch/catch.hpp"
 
 #include "2simd/simd.h"
 #include <array>
+#include <vector>
+#include <algorithm>
 
 using namespace upscaledb;
 
@@ -68,4 +68,82 @@ TEST_CASE("Simd/doubleSseTest", "")
   test_linear_search_sse<double, 4>();
 }
 
-#endif // __SSE__
+// Compares the lower bound of each instruction set (which is supported by
+// this CPU) with std::lower_bound; the node sizes cover the vector loops
+// and the remaining keys
+template<typename T>
+static inline void
+test_lower_bound()
+{
+  // uint8_t values must not overflow
+  int max_count = sizeof(T) == 1 ? 127 : 130;
+
+  for (int level = kSimdScalar; level <= simd_detect_level(); level++) {
+    for (int count = 0; count <= max_count; count++) {
+      std::vector<T> values(count);
+      for (int i = 0; i < count; i++)
+        values[i] = (T)(i * 2 + 1);
+
+      // all keys, the gaps between them, and the keys beyond the range
+      for (int k = 0; k <= count * 2 + 1; k++) {
+        T key = (T)k;
+        int expected = std::lower_bound(values.begin(), values.end(), key)
+                            - values.begin();
+        REQUIRE(expected == simd_lower_bound((SimdLevel)level,
+                                values.data(), count, key));
+        REQUIRE(expected == (int)simd_count_less((SimdLevel)level,
+                                values.data(), count, key));
+      }
+    }
+  }
+}
+
+TEST_CASE("Simd/uint8LowerBoundTest")
+{
+  test_lower_bound<uint8_t>();
+}
+
+TEST_CASE("Simd/uint16LowerBoundTest")
+{
+  test_lower_bound<uint16_t>();
+}
+
+TEST_CASE("Simd/uint32LowerBoundTest")
+{
+  test_lower_bound<uint32_t>();
+}
+
+TEST_CASE("Simd/uint64LowerBoundTest")
+{
+  test_lower_bound<uint64_t>();
+}
+
+TEST_CASE("Simd/floatLowerBoundTest")
+{
+  test_lower_bound<float>();
+}
+
+TEST_CASE("Simd/doubleLowerBoundTest")
+{
+  test_lower_bound<double>();
+}
+
+// The sign bit must not change the order of unsigned keys
+TEST_CASE("Simd/unsignedTest")
+{
+  uint32_t values32[] = {1, 0x7fffffff, 0x80000000, 0xfffffffe};
+  uint64_t values64[] = {1, 0x7fffffffffffffffull, 0x8000000000000000ull,
+                         0xfffffffffffffffeull};
+  for (int level = kSimdScalar; level <= simd_detect_level(); level++) {
+    for (int i = 0; i < 4; i++) {
+      REQUIRE(i == simd_lower_bound((SimdLevel)level, values32, 4,
+                              values32[i]));
+      REQUIRE(i == simd_lower_bound((SimdLevel)level, values64, 4,
+                              values64[i]));
+    }
+    REQUIRE(4 == simd_lower_bound((SimdLevel)level, values32, 4,
+                            (uint32_t)0xffffffff));
+    REQUIRE(4 == simd_lower_bound((SimdLevel)level, values64, 4,
+                            (uint64_t)0xffffffffffffffffull));
+  }
+}
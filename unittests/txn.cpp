@@ -19,8 +19,12 @@
 
 #include "3rdparty/catch/catch.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #include <ups/upscaledb.h>
 
+#include "1globals/globals.h"
 #include "4db/db_local.h"
 #include "4env/env_local.h"
 #include "4txn/txn_local.h"
@@ -109,9 +113,7 @@ struct TxnFixture : BaseFixture {
 
     // clean up
     ldb()->txn_index->remove(node1);
-    delete node1;
     ldb()->txn_index->remove(node2);
-    delete node2;
   }
 
   void txnMultipleNodesTest() {
@@ -128,11 +130,8 @@ struct TxnFixture : BaseFixture {
 
     // clean up
     ldb()->txn_index->remove(node1);
-    delete node1;
     ldb()->txn_index->remove(node2);
-    delete node2;
     ldb()->txn_index->remove(node3);
-    delete node3;
   }
 
   void txnMultipleOpsTest() {
@@ -826,6 +825,347 @@ struct HighLevelTxnFixture : BaseFixture {
 
     close();
   }
+
+  void insertTxns(int count, uint32_t flags = 0) {
+    ups_txn_t *txn;
+
+    for (int i = 0; i < count; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, flags));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    }
+  }
+
+  void requireTxns(int count) {
+    for (int i = 0; i < count; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(rec.size == sizeof(i));
+      REQUIRE(*(int *)rec.data == i);
+    }
+  }
+
+  void backgroundMergeTest() {
+    const int kCount = 100;
+    ups_env_metrics_t metrics;
+
+    require_create(UPS_ENABLE_TRANSACTIONS | UPS_ENABLE_BACKGROUND_MERGE);
+    require_parameter(UPS_PARAM_MERGE_BACKLOG_LIMIT, 256);
+    insertTxns(kCount);
+
+    // the commits only request the merge; the transactions are merged by
+    // the background thread. A backlog of less than the flush threshold
+    // remains
+    int merged = kCount - Globals::ms_flush_threshold;
+    for (int i = 0; i < 500; i++) {
+      REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+      if (metrics.txn_background_merges >= (uint64_t)merged)
+        break;
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    REQUIRE(metrics.txn_background_merges >= (uint64_t)merged);
+    REQUIRE(metrics.txn_backpressure_merges == 0);
+    requireTxns(kCount);
+
+    // close while the background thread is (possibly) still merging
+    insertTxns(kCount, UPS_OVERWRITE);
+    close();
+    require_open(UPS_ENABLE_TRANSACTIONS);
+    requireTxns(kCount);
+  }
+
+  void mergeBacklogLimitTest() {
+    ups_parameter_t params[] = {
+        { UPS_PARAM_MERGE_BACKLOG_LIMIT, 5 },
+        { 0, 0 }
+    };
+    ups_env_metrics_t metrics;
+
+    // the backlog limit is lower than the flush threshold, therefore the
+    // background thread is never started
+    require_create(UPS_ENABLE_TRANSACTIONS | UPS_ENABLE_BACKGROUND_MERGE,
+                    params, 0, 0);
+    require_parameter(UPS_PARAM_MERGE_BACKLOG_LIMIT, 5);
+    insertTxns(20);
+
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.txn_background_merges == 0);
+    REQUIRE(metrics.txn_backpressure_merges == 4);
+    REQUIRE(((LocalTxnManager *)lenv()->txn_manager.get())->merger.get() == 0);
+    requireTxns(20);
+  }
+
+  void largeTxnAllocationsTest() {
+    const int kCount = 10000;
+    ups_txn_t *txn;
+    ups_env_metrics_t before, after;
+
+    require_create(UPS_ENABLE_TRANSACTIONS | UPS_IN_MEMORY);
+    REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+    REQUIRE(0 == ups_env_get_metrics(env, &before));
+    for (int i = 0; i < kCount; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+    }
+
+    // the TxnNodes and TxnOperations are allocated in bulk
+    REQUIRE(0 == ups_env_get_metrics(env, &after));
+    REQUIRE(after.mem_current_allocations
+                    < before.mem_current_allocations + kCount / 10);
+
+    // and released as a whole (only a few buffers of the Database remain)
+    REQUIRE(0 == ups_txn_abort(txn, 0));
+    REQUIRE(0 == ups_env_get_metrics(env, &after));
+    REQUIRE(after.mem_current_allocations
+                    < before.mem_current_allocations + 10);
+    REQUIRE(ldb()->txn_index->first() == 0);
+  }
+
+  void smallTxnAllocationsTest() {
+    const int kCount = 1000;
+    ups_txn_t *txn;
+    ups_env_metrics_t before, after;
+
+    require_create(UPS_ENABLE_TRANSACTIONS | UPS_IN_MEMORY);
+    for (int i = 0; i < kCount; i++) {
+      if (i == 1)
+        REQUIRE(0 == ups_env_get_metrics(env, &before));
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    }
+
+    // the TxnIndex is regularly emptied when the Txns are flushed, but the
+    // slab of the TxnNodes is kept; each Txn only allocates itself and the
+    // first chunk of its Arena
+    REQUIRE(0 == ups_env_get_metrics(env, &after));
+    REQUIRE(after.mem_total_allocations
+                    < before.mem_total_allocations + 2 * kCount + kCount / 8);
+  }
+
+  // Stores |keys| in the TxnIndex of |db| (with a TxnBtree) and in the
+  // TxnIndex of a second Database (with a red-black tree), and verifies
+  // that both return the same results
+  void compareTxnIndices(std::vector<ups_key_t> &keys,
+                  ups_parameter_t *params = nullptr) {
+    ups_db_t *db2;
+    Globals::ms_is_txn_btree_enabled = false;
+    REQUIRE(0 == ups_env_create_db(env, &db2, 2, 0, params));
+    Globals::ms_is_txn_btree_enabled = true;
+
+    TxnIndex &btree = *ldb(db)->txn_index.get();
+    TxnIndex &rbtree = *ldb(db2)->txn_index.get();
+    REQUIRE(btree.btree.get() != nullptr);
+    REQUIRE(rbtree.btree.get() == nullptr);
+
+    std::vector<TxnNode *> bnodes, rnodes;
+    bool node_created;
+    for (size_t i = 0; i < keys.size(); i++) {
+      bnodes.push_back(btree.store(&keys[i], &node_created));
+      REQUIRE(node_created == true);
+      rnodes.push_back(rbtree.store(&keys[i], &node_created));
+      REQUIRE(node_created == true);
+      REQUIRE(btree.store(&keys[i], &node_created) == bnodes[i]);
+      REQUIRE(node_created == false);
+    }
+
+    std::vector<bool> removed(keys.size());
+    for (int round = 0; round < 3; round++) {
+      // both trees have the same order, forward and backward
+      TxnNode *b = btree.first();
+      TxnNode *r = rbtree.first();
+      while (r) {
+        REQUIRE(b != nullptr);
+        REQUIRE(b->key() == r->key());
+        b = b->next_sibling();
+        r = r->next_sibling();
+      }
+      REQUIRE(b == nullptr);
+      b = btree.last();
+      r = rbtree.last();
+      while (r) {
+        REQUIRE(b != nullptr);
+        REQUIRE(b->key() == r->key());
+        b = b->previous_sibling();
+        r = r->previous_sibling();
+      }
+      REQUIRE(b == nullptr);
+
+      // exact and approximate lookups return the same node
+      uint32_t flags[] = {0, UPS_FIND_GEQ_MATCH, UPS_FIND_LEQ_MATCH,
+                    UPS_FIND_GT_MATCH, UPS_FIND_LT_MATCH};
+      for (size_t i = 0; i < keys.size(); i++) {
+        for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+          b = btree.get(&keys[i], flags[f]);
+          r = rbtree.get(&keys[i], flags[f]);
+          REQUIRE((b ? b->key() : 0) == (r ? r->key() : 0));
+          if (f == 0)
+            REQUIRE((b != nullptr) == !removed[i]);
+        }
+      }
+
+      // then remove every other (remaining) key
+      for (size_t i = round; i < keys.size(); i += 2) {
+        if (removed[i])
+          continue;
+        btree.remove(bnodes[i]);
+        rbtree.remove(rnodes[i]);
+        removed[i] = true;
+      }
+    }
+
+    // clean up
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!removed[i]) {
+        btree.remove(bnodes[i]);
+        rbtree.remove(rnodes[i]);
+      }
+    }
+    REQUIRE(btree.first() == nullptr);
+    REQUIRE(rbtree.first() == nullptr);
+  }
+
+  void txnBtreeBinaryTest() {
+    const int kCount = 5000;
+    std::vector<std::string> data;
+    std::vector<ups_key_t> keys;
+
+    require_create(UPS_ENABLE_TRANSACTIONS);
+
+    // the keys share a prefix which is longer than the 8 bytes stored
+    // in the TxnBtree, and some keys are shorter than this prefix
+    for (int i = 0; i < kCount; i++) {
+      char buffer[64];
+      ::sprintf(buffer, "common-prefix-%08d", (i * 7919) % kCount);
+      data.push_back(std::string(buffer, 3 + i % 20));
+    }
+    std::sort(data.begin(), data.end());
+    data.erase(std::unique(data.begin(), data.end()), data.end());
+    std::random_shuffle(data.begin(), data.end());
+    for (size_t i = 0; i < data.size(); i++)
+      keys.push_back(ups_make_key((void *)data[i].data(),
+                              (uint16_t)data[i].size()));
+
+    compareTxnIndices(keys);
+  }
+
+  void txnBtreeNumericTest() {
+    const int kCount = 5000;
+    ups_parameter_t params[] = {
+        {UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32},
+        {0, 0}
+    };
+    std::vector<uint32_t> data;
+    std::vector<ups_key_t> keys;
+
+    require_create(UPS_ENABLE_TRANSACTIONS, nullptr, 0, params);
+    for (int i = 0; i < kCount; i++)
+      data.push_back((uint32_t)i * 2654435761u);
+    for (size_t i = 0; i < data.size(); i++)
+      keys.push_back(ups_make_key(&data[i], sizeof(uint32_t)));
+
+    compareTxnIndices(keys, params);
+  }
+
+  void requireSnapshotRecord(ups_txn_t *txn, int k, ups_status_t expected,
+                  int value = 0) {
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    ups_record_t rec = {0};
+    REQUIRE(expected == ups_db_find(db, txn, &key, &rec, 0));
+    if (expected == 0) {
+      REQUIRE(rec.size == sizeof(value));
+      REQUIRE(*(int *)rec.data == value);
+    }
+  }
+
+  void snapshotTest() {
+    ups_txn_t *snapshot, *writer;
+    ups_cursor_t *cursor;
+    int k1 = 1000, k2 = 1001, v = 100;
+    ups_key_t key1 = ups_make_key(&k1, sizeof(k1));
+    ups_key_t key2 = ups_make_key(&k2, sizeof(k2));
+    ups_record_t rec = ups_make_record(&v, sizeof(v));
+    uint64_t count;
+
+    require_create(UPS_ENABLE_TRANSACTIONS);
+    REQUIRE(0 == ups_db_insert(db, 0, &key1, &rec, 0));
+
+    REQUIRE(0 == ups_txn_begin(&snapshot, env, 0, 0, UPS_TXN_READ_ONLY));
+
+    // an active writer does not cause a conflict
+    v = 200;
+    REQUIRE(0 == ups_txn_begin(&writer, env, 0, 0, 0));
+    REQUIRE(0 == ups_db_insert(db, writer, &key1, &rec, UPS_OVERWRITE));
+    REQUIRE(0 == ups_db_insert(db, writer, &key2, &rec, 0));
+    requireSnapshotRecord(snapshot, k1, 0, 100);
+    requireSnapshotRecord(snapshot, k2, UPS_KEY_NOT_FOUND);
+    requireSnapshotRecord(0, k2, UPS_TXN_CONFLICT);
+
+    // and neither does a writer which committed after the snapshot was
+    // taken, even if it is followed by more than enough transactions to
+    // trigger a merge
+    REQUIRE(0 == ups_txn_commit(writer, 0));
+    insertTxns(Globals::ms_flush_threshold * 2);
+    requireSnapshotRecord(snapshot, k1, 0, 100);
+    requireSnapshotRecord(snapshot, k2, UPS_KEY_NOT_FOUND);
+    requireSnapshotRecord(snapshot, 0, UPS_KEY_NOT_FOUND);
+    requireSnapshotRecord(0, k1, 0, 200);
+
+    REQUIRE(0 == ups_db_count(db, snapshot, 0, &count));
+    REQUIRE(count == 1);
+    REQUIRE(0 == ups_cursor_create(&cursor, db, snapshot, 0));
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+    REQUIRE(0 == ups_cursor_move(cursor, &key, &record, UPS_CURSOR_FIRST));
+    REQUIRE(*(int *)key.data == k1);
+    REQUIRE(*(int *)record.data == 100);
+    REQUIRE(UPS_KEY_NOT_FOUND
+              == ups_cursor_move(cursor, &key, &record, UPS_CURSOR_NEXT));
+    REQUIRE(0 == ups_cursor_close(cursor));
+
+    // read-only transactions cannot modify the database
+    REQUIRE(UPS_WRITE_PROTECTED
+              == ups_db_insert(db, snapshot, &key2, &rec, 0));
+    REQUIRE(UPS_WRITE_PROTECTED == ups_db_erase(db, snapshot, &key1, 0));
+
+    // the newer transactions are only merged after the snapshot ended
+    LocalTxnManager *ltm = (LocalTxnManager *)lenv()->txn_manager.get();
+    REQUIRE(ltm->oldest_snapshot_lsn() == ((LocalTxn *)snapshot)->lsn);
+    REQUIRE(0 == ups_txn_commit(snapshot, 0));
+    REQUIRE(ltm->oldest_snapshot_lsn() == 0);
+    REQUIRE(0 == ups_env_flush(env, UPS_FLUSH_COMMITTED_TRANSACTIONS));
+    REQUIRE(ltm->oldest_txn() == 0);
+    requireSnapshotRecord(0, k1, 0, 200);
+    requireSnapshotRecord(0, k2, 0, 200);
+  }
+
+  void closeWithSnapshotTest() {
+    ups_txn_t *writer, *snapshot;
+    int k = 1;
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    ups_record_t rec = ups_make_record(&k, sizeof(k));
+
+    // the writer is older than the snapshot, but commits after the
+    // snapshot was taken; it can only be merged when the snapshot ended
+    require_create(UPS_ENABLE_TRANSACTIONS);
+    REQUIRE(0 == ups_txn_begin(&writer, env, 0, 0, 0));
+    REQUIRE(0 == ups_txn_begin(&snapshot, env, 0, 0, UPS_TXN_READ_ONLY));
+    REQUIRE(0 == ups_db_insert(db, writer, &key, &rec, 0));
+    REQUIRE(0 == ups_txn_commit(writer, 0));
+    REQUIRE(0 == ups_env_flush(env, UPS_FLUSH_COMMITTED_TRANSACTIONS));
+    REQUIRE(lenv()->txn_manager->oldest_txn() == (Txn *)writer);
+    requireSnapshotRecord(snapshot, k, UPS_KEY_NOT_FOUND);
+
+    close(UPS_AUTO_CLEANUP | UPS_TXN_AUTO_ABORT);
+    require_open();
+    requireSnapshotRecord(0, k, 0, k);
+  }
 };
 
 TEST_CASE("Txn/high/noPersistentDatabaseFlagTest", "")
@@ -919,6 +1259,54 @@ TEST_CASE("Txn/high/insertTxnsWithDelay", "")
     f.insertTxnsWithDelay(i);
 }
 
+TEST_CASE("Txn/high/backgroundMergeTest", "")
+{
+  HighLevelTxnFixture f;
+  f.backgroundMergeTest();
+}
+
+TEST_CASE("Txn/high/mergeBacklogLimitTest", "")
+{
+  HighLevelTxnFixture f;
+  f.mergeBacklogLimitTest();
+}
+
+TEST_CASE("Txn/high/largeTxnAllocationsTest", "")
+{
+  HighLevelTxnFixture f;
+  f.largeTxnAllocationsTest();
+}
+
+TEST_CASE("Txn/high/smallTxnAllocationsTest", "")
+{
+  HighLevelTxnFixture f;
+  f.smallTxnAllocationsTest();
+}
+
+TEST_CASE("Txn/high/txnBtreeBinaryTest", "")
+{
+  HighLevelTxnFixture f;
+  f.txnBtreeBinaryTest();
+}
+
+TEST_CASE("Txn/high/txnBtreeNumericTest", "")
+{
+  HighLevelTxnFixture f;
+  f.txnBtreeNumericTest();
+}
+
+TEST_CASE("Txn/high/snapshotTest", "")
+{
+  HighLevelTxnFixture f;
+  f.snapshotTest();
+}
+
+TEST_CASE("Txn/high/closeWithSnapshotTest", "")
+{
+  HighLevelTxnFixture f;
+  f.closeWithSnapshotTest();
+}
+
 struct InMemoryTxnFixture : BaseFixture {
   InMemoryTxnFixture() {
     require_create(UPS_IN_MEMORY | UPS_ENABLE_TRANSACTIONS, 0,
@@ -122,6 +122,33 @@ struct UpscaledbFixture : BaseFixture {
         ups_env_open(&env, "data/inv-file-header.hdb", 0, 0));
   }
 
+  // Stores |version| as the file version of test.db
+  void setFileVersion(uint8_t version) {
+    File f;
+    f.open("test.db", 0);
+    f.pwrite(Page::kSizeofPersistentHeader
+                    + offsetof(PEnvironmentHeader, version) + 3, &version, 1);
+    f.close();
+  }
+
+  void invVersionTest() {
+    close();
+    require_create(0);
+    REQUIRE(lenv()->header->version(3) == UPS_FILE_VERSION);
+    close();
+
+    // files of version 5 can still be opened, all others are rejected
+    setFileVersion(EnvHeader::kOldestFileVersion);
+    require_open();
+    REQUIRE(lenv()->header->version(3) == EnvHeader::kOldestFileVersion);
+    close();
+
+    setFileVersion(EnvHeader::kOldestFileVersion - 1);
+    require_open(0, 0, UPS_INV_FILE_VERSION);
+    setFileVersion(UPS_FILE_VERSION + 1);
+    require_open(0, 0, UPS_INV_FILE_VERSION);
+  }
+
   void createTest() {
     ups_env_t *env;
     ups_parameter_t cs[] = { { UPS_PARAM_CACHESIZE, 1024 }, { 0, 0 } };
@@ -2123,6 +2150,12 @@ TEST_CASE("Upscaledb/invHeaderTest", "")
   f.invHeaderTest();
 }
 
+TEST_CASE("Upscaledb/invVersionTest", "")
+{
+  UpscaledbFixture f;
+  f.invVersionTest();
+}
+
 TEST_CASE("Upscaledb/createTest", "")
 {
   UpscaledbFixture f;
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include <ups/upscaledb_uqi.h>
+
+#include "3rdparty/catch/catch.hpp"
+
+#include "3btree/btree_index_factory.h"
+
+#include "os.hpp"
+#include "fixture.hpp"
+
+namespace upscaledb {
+
+struct Zint64Fixture : BaseFixture {
+  typedef std::vector<uint64_t> IntVector;
+
+  Zint64Fixture(uint64_t compressor, bool use_duplicates,
+                  uint64_t record_size) {
+    ups_parameter_t p[] = {
+      { UPS_PARAM_RECORD_SIZE, record_size },
+      { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT64 },
+      { UPS_PARAM_KEY_COMPRESSION, compressor },
+      { 0, 0 }
+    };
+
+    if (compressor == 0) {
+      p[2].name = 0;
+      p[2].value = 0;
+    }
+
+    require_create(0, nullptr, use_duplicates ? UPS_ENABLE_DUPLICATES : 0, p);
+  }
+
+  // Creates |count| keys with large (and varying) gaps, i.e. timestamps
+  static IntVector create_keys(int count, uint64_t base) {
+    IntVector ivec;
+    for (int i = 0; i < count; i++)
+      ivec.push_back(base + (uint64_t)i * 1000003ull + (i % 7) * 97);
+    return ivec;
+  }
+
+  void insertFindEraseFind(const IntVector &ivec) {
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+
+    for (IntVector::const_iterator it = ivec.begin(); it != ivec.end(); it++) {
+      uint64_t k = *it;
+      key.data = (void *)&k;
+      key.size = sizeof(k);
+      record.data = (void *)&k;
+      record.size = sizeof(uint32_t);
+
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+    }
+
+    // all keys are returned in sorted order
+    IntVector sorted(ivec);
+    std::sort(sorted.begin(), sorted.end());
+    ups_cursor_t *cursor;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    for (IntVector::const_iterator it = sorted.begin();
+                    it != sorted.end(); it++) {
+      REQUIRE(0 == ups_cursor_move(cursor, &key, &record, UPS_CURSOR_NEXT));
+      REQUIRE(key.size == sizeof(uint64_t));
+      REQUIRE(*(uint64_t *)key.data == *it);
+    }
+    REQUIRE(UPS_KEY_NOT_FOUND == ups_cursor_move(cursor, &key, &record,
+                            UPS_CURSOR_NEXT));
+    REQUIRE(0 == ups_cursor_close(cursor));
+
+    for (IntVector::const_iterator it = ivec.begin();
+                    it != ivec.end(); it++) {
+      uint64_t k = *it;
+      key.data = (void *)&k;
+      key.size = sizeof(k);
+
+      REQUIRE(0 == ups_db_find(db, 0, &key, &record, 0));
+      REQUIRE(record.size == sizeof(uint32_t));
+      REQUIRE(*(uint32_t *)record.data == (uint32_t)k);
+
+      // a key in the gap is not found
+      uint64_t missing = k + 1;
+      key.data = (void *)&missing;
+      REQUIRE(UPS_KEY_NOT_FOUND == ups_db_find(db, 0, &key, &record, 0));
+    }
+
+    for (IntVector::const_iterator it = ivec.begin();
+                    it != ivec.end(); it++) {
+      uint64_t k = *it;
+      key.data = (void *)&k;
+      key.size = sizeof(k);
+
+      REQUIRE(0 == ups_db_erase(db, 0, &key, 0));
+    }
+
+    for (IntVector::const_iterator it = ivec.begin();
+                    it != ivec.end(); it++) {
+      uint64_t k = *it;
+      key.data = (void *)&k;
+      key.size = sizeof(k);
+
+      REQUIRE(UPS_KEY_NOT_FOUND == ups_db_find(db, 0, &key, &record, 0));
+    }
+  }
+
+  void uqiTest() {
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+
+    for (uint64_t i = 0; i < 30000; i++) {
+      key.data = (void *)&i;
+      key.size = sizeof(i);
+
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+    }
+
+    uqi_result_t *result;
+    uint32_t size;
+
+    REQUIRE(0 == uqi_select(env, "SUM($key) from database 1", &result));
+    REQUIRE(uqi_result_get_record_type(result) == UPS_TYPE_UINT64);
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(result, &size) == 449985000ull);
+
+    uqi_result_close(result);
+
+    REQUIRE(0 == uqi_select(env, "AVERAGE($key) from database 1", &result));
+    REQUIRE(uqi_result_get_record_type(result) == UPS_TYPE_REAL64);
+    REQUIRE(*(double *)uqi_result_get_record_data(result, &size) == 14999.5);
+
+    uqi_result_close(result);
+  }
+
+  // Inserts |ivec| and returns the size of the file
+  uint64_t insertKeys(const IntVector &ivec) {
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+
+    for (IntVector::const_iterator it = ivec.begin(); it != ivec.end(); it++) {
+      uint64_t k = *it;
+      key.data = (void *)&k;
+      key.size = sizeof(k);
+
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+    }
+
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+    return device()->file_size();
+  }
+};
+
+TEST_CASE("Zint64/For/bitPackingTest", "")
+{
+  uint8_t data[9 * 64 + 8];
+  for (uint32_t bits = 1; bits <= 64; bits++) {
+    ::memset(data, 0, sizeof(data));
+    uint64_t mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+    for (uint32_t i = 0; i < 64; i++)
+      Zint64::for64_write(data, bits, i, (0x9e3779b97f4a7c15ull * (i + 1)) & mask);
+    for (uint32_t i = 0; i < 64; i++)
+      REQUIRE(Zint64::for64_read(data, bits, i)
+                      == ((0x9e3779b97f4a7c15ull * (i + 1)) & mask));
+  }
+}
+
+TEST_CASE("Zint64/Varbyte/randomDataTest", "")
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(30000,
+                  1ull << 40);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(ivec.begin(), ivec.end());
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_VARBYTE, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/Varbyte/ascendingDataTest", "")
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(30000,
+                  1ull << 40);
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_VARBYTE, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/Varbyte/descendingDataTest", "")
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(30000,
+                  1ull << 40);
+  std::reverse(ivec.begin(), ivec.end());
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_VARBYTE, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/Varbyte/largeGapsTest", "")
+{
+  Zint64Fixture::IntVector ivec;
+  for (uint64_t i = 0; i < 3000; i++)
+    ivec.push_back(i * 0x0005555555555555ull + (i & 3));
+  ivec.push_back(~0ull - 1);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(ivec.begin(), ivec.end());
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_VARBYTE, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/Varbyte/uqiTest", "")
+{
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_VARBYTE, false, 0);
+  f.uqiTest();
+}
+
+// Compressed pages hold more keys than uncompressed pages
+static void
+pageCountTest(uint64_t compressor)
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(50000,
+                  1ull << 40);
+  uint64_t compressed_size;
+  {
+    Zint64Fixture f(compressor, false, 0);
+    compressed_size = f.insertKeys(ivec);
+  }
+
+  Zint64Fixture f(0, false, 0);
+  REQUIRE(f.insertKeys(ivec) > compressed_size * 3 / 2);
+}
+
+TEST_CASE("Zint64/Varbyte/pageCountTest", "")
+{
+  pageCountTest(UPS_COMPRESSOR_UINT64_VARBYTE);
+}
+
+TEST_CASE("Zint64/For/randomDataTest", "")
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(30000,
+                  1ull << 40);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(ivec.begin(), ivec.end());
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_FOR, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/For/ascendingDataTest", "")
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(30000,
+                  1ull << 40);
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_FOR, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/For/descendingDataTest", "")
+{
+  Zint64Fixture::IntVector ivec = Zint64Fixture::create_keys(30000,
+                  1ull << 40);
+  std::reverse(ivec.begin(), ivec.end());
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_FOR, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/For/largeGapsTest", "")
+{
+  Zint64Fixture::IntVector ivec;
+  for (uint64_t i = 0; i < 3000; i++)
+    ivec.push_back(i * 0x0005555555555555ull + (i & 3));
+  ivec.push_back(~0ull - 1);
+  std::srand(0); // make this reproducible
+  std::random_shuffle(ivec.begin(), ivec.end());
+
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_FOR, false, 4);
+  f.insertFindEraseFind(ivec);
+}
+
+TEST_CASE("Zint64/For/uqiTest", "")
+{
+  Zint64Fixture f(UPS_COMPRESSOR_UINT64_FOR, false, 0);
+  f.uqiTest();
+}
+
+TEST_CASE("Zint64/For/pageCountTest", "")
+{
+  pageCountTest(UPS_COMPRESSOR_UINT64_FOR);
+}
+
+TEST_CASE("Zint64/Zint64/invalidKeyTypeTest", "")
+{
+  ups_parameter_t p[] = {
+    { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+    { UPS_PARAM_KEY_COMPRESSION, UPS_COMPRESSOR_UINT64_VARBYTE},
+    { 0, 0 }
+  };
+
+  ups_env_t *env;
+  ups_db_t *db;
+
+  REQUIRE(0 == ups_env_create(&env, "test.db", 0, 0644, 0));
+  REQUIRE(UPS_INV_PARAMETER == ups_env_create_db(env, &db, 1, 0, &p[0]));
+  ups_env_close(env, 0);
+}
+
+} // namespace upscaledb